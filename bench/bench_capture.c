@@ -0,0 +1,177 @@
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "capture.h"
+#include "codec.h"
+#include "impair.h"
+#include "replay.h"
+#include "rtp.h"
+
+#define BENCH_PACKETS (5000)
+#define BENCH_REPLAYS (5)
+
+typedef struct
+{
+    const char *name;
+    const char *spec;
+} CaptureProfile;
+
+static const CaptureProfile profiles[] = {
+    {"clean", "seed=7"},
+    {"wifi", "delay=15,jitter=8,dist=pareto,loss=1,burst=2,seed=7"},
+    {"lte", "delay=40,jitter=15,dist=normal,loss=3,burst=4,reorder=1,"
+            "dup=0.5,seed=7"},
+};
+
+/* Captures a PCMU stream through a seeded impairment profile as the
+ * receiving thread would, timing each capture_packet() call. */
+static int capture_profile(const ImpairConfig *impair_config,
+                           const char *path, BenchTimer *timer,
+                           Capture *capture)
+{
+    if (capture_start(capture, path, 5000) == -1)
+        return -1;
+    Impairment imp;
+    impair_init(&imp, impair_config);
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, &codec_pcmu, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    RtpSession rtp;
+    rtp_session_init(&rtp, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    struct sockaddr_in from;
+    memset(&from, 0, sizeof(from));
+    from.sin_family = AF_INET;
+    from.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    from.sin_port = htons(6000);
+
+    SAMPLE pcm[FRAMES_PER_BUFFER];
+    uint8_t datagram[IMPAIR_PACKET_MAX];
+    uint32_t seed = 5;
+    uint64_t frame_ns = 1000000000ull * FRAMES_PER_BUFFER / SAMPLE_RATE;
+    for (int i = 0; i < BENCH_PACKETS; i++)
+    {
+        uint64_t now = i * frame_ns;
+        bench_fill_voice(pcm, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)i * FRAMES_PER_BUFFER, &seed);
+        RtpHeader header;
+        rtp_session_next_header(&rtp, codec_pcmu.payload_type,
+                                FRAMES_PER_BUFFER, &header);
+        size_t offset = rtp_write_header(datagram, &header);
+        int length = codec_encode(&encoder, pcm, FRAMES_PER_BUFFER,
+                                  datagram + offset,
+                                  (int)(sizeof(datagram) - offset));
+        impair_submit(&imp, datagram, (int)offset + length, NULL, now);
+        uint64_t release_ns;
+        int received;
+        while ((received = impair_pop(&imp, now, datagram, sizeof(datagram),
+                                      &release_ns, NULL)) > 0)
+        {
+            uint64_t start = monotonic_ns();
+            capture_packet(capture, datagram, received, &from, release_ns);
+            bench_timer_add(timer, monotonic_ns() - start);
+        }
+    }
+    rtp_session_destroy(&rtp);
+    codec_encoder_close(&encoder);
+    impair_destroy(&imp);
+    capture_stop(capture);
+    return 0;
+}
+
+static void bench_capture(const CaptureProfile *profile)
+{
+    ImpairConfig impair_config;
+    impair_config_default(&impair_config);
+    if (impair_config_parse(&impair_config, profile->spec) == -1)
+    {
+        fprintf(stderr, "Invalid profile '%s'\n", profile->spec);
+        return;
+    }
+    char path[] = "/tmp/bench_capture_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+    {
+        perror("mkstemp() failed");
+        return;
+    }
+    close(fd);
+    BenchTimer capture_timer;
+    bench_timer_init(&capture_timer, BENCH_PACKETS * 2);
+    Capture capture;
+    if (capture_profile(&impair_config, path, &capture_timer, &capture) == -1)
+    {
+        unlink(path);
+        bench_timer_destroy(&capture_timer);
+        return;
+    }
+
+    /* The same capture replayed again and again must play the same. */
+    BenchTimer replay_timer;
+    bench_timer_init(&replay_timer, BENCH_REPLAYS);
+    ReplayConfig config;
+    replay_config_default(&config);
+    ReplayStats stats;
+    uint64_t checksum = 0;
+    bool deterministic = true;
+    for (int i = 0; i < BENCH_REPLAYS; i++)
+    {
+        CaptureReader reader;
+        if (capture_reader_open(&reader, path) == -1)
+            break;
+        replay_run(&config, &reader, NULL, &stats);
+        capture_reader_close(&reader);
+        if (i > 0 && stats.checksum != checksum)
+            deterministic = false;
+        checksum = stats.checksum;
+        if (stats.frames_played > 0)
+            bench_timer_add(&replay_timer,
+                            (uint64_t)(stats.elapsed_seconds * 1e9 /
+                                       stats.frames_played));
+    }
+    unlink(path);
+
+    uint64_t written = atomic_load(&capture.packets_written);
+    uint64_t dropped = atomic_load(&capture.packets_dropped);
+    double speed = stats.elapsed_seconds > 0.0
+                       ? stats.audio_seconds / stats.elapsed_seconds
+                       : 0.0;
+    char name[64];
+    char params[512];
+    snprintf(name, sizeof(name), "capture %s", profile->name);
+    snprintf(params, sizeof(params),
+             "\"profile\":\"%s\",\"spec\":\"%s\",\"written\":%llu,"
+             "\"dropped\":%llu",
+             profile->name, profile->spec, (unsigned long long)written,
+             (unsigned long long)dropped);
+    bench_report_params(name, &capture_timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    snprintf(name, sizeof(name), "replay %s", profile->name);
+    snprintf(params, sizeof(params),
+             "\"profile\":\"%s\",\"audio_seconds\":%.1f,"
+             "\"realtime_factor\":%.0f,\"concealed\":%llu,\"late\":%llu,"
+             "\"checksum\":\"%016llx\",\"deterministic\":%s",
+             profile->name, stats.audio_seconds, speed,
+             (unsigned long long)stats.jb.frames_concealed,
+             (unsigned long long)stats.jb.packets_late,
+             (unsigned long long)checksum, deterministic ? "true" : "false");
+    bench_report_params(name, &replay_timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    printf("%-32s %llu packets captured, %llu dropped; %.1f s replayed at "
+           "%.0fx real time, checksum %016llx%s\n",
+           "", (unsigned long long)written, (unsigned long long)dropped,
+           stats.audio_seconds, speed, (unsigned long long)checksum,
+           deterministic ? "" : " (NOT DETERMINISTIC)");
+    bench_timer_destroy(&capture_timer);
+    bench_timer_destroy(&replay_timer);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_capture");
+    printf("Capture benchmark: time per packet captured on the receiving "
+           "thread, and per frame replayed from the capture\n");
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+        bench_capture(&profiles[i]);
+    bench_finish();
+    return 0;
+}
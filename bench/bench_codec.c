@@ -0,0 +1,96 @@
+#include "bench_common.h"
+#include "codec.h"
+
+#define BENCH_SECONDS (60)
+
+static double snr_db(const SAMPLE *ref, const SAMPLE *test, int len)
+{
+    double signal = 0.0, noise = 0.0;
+    for (int i = 0; i < len; i++)
+    {
+        double e = (double)ref[i] - (double)test[i];
+        signal += (double)ref[i] * (double)ref[i];
+        noise += e * e;
+    }
+    if (noise == 0.0)
+        return INFINITY;
+    return 10.0 * log10(signal / noise);
+}
+
+static void bench_codec(const Codec *codec, int sample_rate, int frame_size)
+{
+    int frames = BENCH_SECONDS * sample_rate / frame_size;
+    SAMPLE *input = (SAMPLE *)malloc((size_t)frames * frame_size * sizeof(SAMPLE));
+    SAMPLE *output = (SAMPLE *)malloc((size_t)frames * frame_size * sizeof(SAMPLE));
+    int capacity = codec->max_payload_bytes(frame_size);
+    uint8_t *payloads = (uint8_t *)malloc((size_t)frames * capacity);
+    int *sizes = (int *)malloc(frames * sizeof(int));
+    uint32_t seed = 3;
+    bench_fill_voice(input, frames * frame_size, sample_rate, 0, &seed);
+
+    CodecEncoder enc = {0};
+    CodecDecoder dec = {0};
+    if (codec_encoder_open(&enc, codec, sample_rate, frame_size) == -1 ||
+        codec_decoder_open(&dec, codec, sample_rate, frame_size) == -1)
+    {
+        printf("%-10s unsupported at %d Hz / %d frames\n", codec->name,
+               sample_rate, frame_size);
+        goto done;
+    }
+
+    uint64_t total_bytes = 0;
+    uint64_t start = monotonic_ns();
+    for (int i = 0; i < frames; i++)
+    {
+        sizes[i] = codec_encode(&enc, input + (size_t)i * frame_size,
+                                frame_size, payloads + (size_t)i * capacity,
+                                capacity);
+        total_bytes += sizes[i];
+    }
+    uint64_t encode_ns = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (int i = 0; i < frames; i++)
+        codec_decode(&dec, payloads + (size_t)i * capacity, sizes[i],
+                     output + (size_t)i * frame_size, frame_size);
+    uint64_t decode_ns = monotonic_ns() - start;
+
+    double kbps = total_bytes * 8.0 / BENCH_SECONDS / 1000.0;
+    double encode_fps = frames / (encode_ns / 1e9);
+    double decode_fps = frames / (decode_ns / 1e9);
+    double snr = snr_db(input, output, frames * frame_size);
+    printf("%-10s encode %10.0f frames/s  decode %10.0f frames/s  "
+           "%7.1f kbit/s  SNR %5.1f dB\n",
+           codec->name, encode_fps, decode_fps, kbps, snr);
+    bench_json_record(codec->name,
+                      "\"frame_size\":%d,\"sample_rate\":%d,"
+                      "\"encode_ns_per_frame\":%.1f,"
+                      "\"decode_ns_per_frame\":%.1f,"
+                      "\"encode_frames_per_sec\":%.1f,"
+                      "\"decode_frames_per_sec\":%.1f,\"kbps\":%.2f,"
+                      "\"snr_db\":%.2f",
+                      frame_size, sample_rate, 1e9 / encode_fps,
+                      1e9 / decode_fps, encode_fps, decode_fps, kbps,
+                      isinf(snr) ? 999.0 : snr);
+
+done:
+    codec_encoder_close(&enc);
+    codec_decoder_close(&dec);
+    free(input);
+    free(output);
+    free(payloads);
+    free(sizes);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_codec");
+    printf("Codec benchmark: %d frames/packet at %d Hz, single core "
+           "(real time is %.1f frames/s)\n",
+           FRAMES_PER_BUFFER, SAMPLE_RATE,
+           (double)SAMPLE_RATE / FRAMES_PER_BUFFER);
+    for (int i = 0; i < codec_count(); i++)
+        bench_codec(codec_at(i), SAMPLE_RATE, FRAMES_PER_BUFFER);
+    bench_finish();
+    return 0;
+}
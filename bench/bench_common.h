@@ -0,0 +1,159 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_config.h"
+#include "time_util.h"
+
+typedef struct
+{
+    uint64_t *samples;
+    int count;
+    int capacity;
+} BenchTimer;
+
+static inline void bench_timer_init(BenchTimer *timer, int capacity)
+{
+    timer->samples = (uint64_t *)malloc(capacity * sizeof(uint64_t));
+    timer->count = 0;
+    timer->capacity = capacity;
+}
+
+static inline void bench_timer_destroy(BenchTimer *timer)
+{
+    free(timer->samples);
+}
+
+static inline void bench_timer_add(BenchTimer *timer, uint64_t ns)
+{
+    if (timer->count < timer->capacity)
+        timer->samples[timer->count++] = ns;
+}
+
+static int bench_compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Machine-readable results: one JSON object per line, appended to the file
+ * given with --json PATH or the BENCH_JSON environment variable. BENCH_LABEL
+ * (e.g. a commit id) is copied into every record. */
+static FILE *bench_json;
+static const char *bench_program = "bench";
+
+static inline void bench_init(int argc, char *argv[], const char *program)
+{
+    const char *path = getenv("BENCH_JSON");
+    bench_program = program;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            path = argv[++i];
+    }
+    if (path && path[0] != '\0')
+    {
+        bench_json = fopen(path, "a");
+        if (!bench_json)
+            perror(path);
+    }
+}
+
+static inline void bench_finish(void)
+{
+    if (bench_json)
+        fclose(bench_json);
+    bench_json = NULL;
+}
+
+static inline void bench_json_record(const char *name, const char *fmt, ...)
+{
+    if (!bench_json)
+        return;
+    const char *label = getenv("BENCH_LABEL");
+    fprintf(bench_json,
+            "{\"program\":\"%s\",\"case\":\"%s\",\"label\":\"%s\","
+            "\"timestamp\":%lld,",
+            bench_program, name, label ? label : "", (long long)time(NULL));
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(bench_json, fmt, args);
+    va_end(args);
+    fprintf(bench_json, "}\n");
+    fflush(bench_json);
+}
+
+/* params is an optional JSON fragment ("\"tail_ms\":120") describing the
+ * configuration the case ran with. */
+static inline void bench_report_params(const char *name, BenchTimer *timer,
+                                       int frame_size, int sample_rate,
+                                       const char *params)
+{
+    if (timer->count == 0)
+        return;
+    qsort(timer->samples, timer->count, sizeof(uint64_t), bench_compare_u64);
+    uint64_t total = 0;
+    for (int i = 0; i < timer->count; i++)
+        total += timer->samples[i];
+    double mean = (double)total / timer->count;
+    uint64_t p50 = timer->samples[timer->count / 2];
+    uint64_t p99 = timer->samples[(int)(timer->count * 0.99)];
+    uint64_t max = timer->samples[timer->count - 1];
+    double budget_ns = 1e9 * frame_size / sample_rate;
+    double frames_per_sec = mean > 0.0 ? 1e9 / mean : 0.0;
+    printf("%-32s %10.0f ns/frame  p50 %8llu  p99 %8llu  max %8llu  "
+           "%11.0f frames/s  %7.3f%% of %.1f ms\n",
+           name, mean, (unsigned long long)p50, (unsigned long long)p99,
+           (unsigned long long)max, frames_per_sec, 100.0 * mean / budget_ns,
+           budget_ns / 1e6);
+    bench_json_record(name,
+                      "\"frame_size\":%d,\"sample_rate\":%d,%s%s"
+                      "\"iterations\":%d,\"mean_ns\":%.1f,\"p50_ns\":%llu,"
+                      "\"p99_ns\":%llu,\"max_ns\":%llu,"
+                      "\"frames_per_sec\":%.1f,\"budget_pct\":%.4f",
+                      frame_size, sample_rate, params ? params : "",
+                      params ? "," : "", timer->count, mean,
+                      (unsigned long long)p50, (unsigned long long)p99,
+                      (unsigned long long)max, frames_per_sec,
+                      100.0 * mean / budget_ns);
+}
+
+static inline void bench_report(const char *name, BenchTimer *timer,
+                                int frame_size, int sample_rate)
+{
+    bench_report_params(name, timer, frame_size, sample_rate, NULL);
+}
+
+static inline uint32_t bench_rand(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static inline void bench_fill_voice(SAMPLE *out, int len, int sample_rate,
+                                    long offset, uint32_t *seed)
+{
+    for (int i = 0; i < len; i++)
+    {
+        double t = (double)(offset + i) / sample_rate;
+        double f0 = 140.0 + 30.0 * sin(2.0 * M_PI * 0.7 * t);
+        double envelope = 0.5 + 0.5 * sin(2.0 * M_PI * 3.0 * t);
+        double v = 0.0;
+        for (int h = 1; h <= 8; h++)
+            v += sin(2.0 * M_PI * f0 * h * t) / h;
+        double noise = ((double)(bench_rand(seed) & 0xffff) - 32768.0) / 32768.0;
+        out[i] = (SAMPLE)(6000.0 * envelope * v + 200.0 * noise);
+    }
+}
+
+#endif
@@ -0,0 +1,305 @@
+#include <stdbool.h>
+
+#include "audio_packet.h"
+#include "bench_common.h"
+#include "codec.h"
+#include "dsp_kernels.h"
+#include "jitter_buffer.h"
+#include "packet_pool.h"
+#include "resampler.h"
+
+#define BENCH_HOURS (2)
+#define BENCH_VOICE_FRAMES (64)
+#define BENCH_SETTLE_MINUTES (10)
+#define BENCH_NETWORK_MS (20.0)
+#define BENCH_JITTER_MS (10.0)
+#define BENCH_SNR_SAMPLES (44100)
+/* A compensated call fails if its delay after settling moves by more than
+ * this, or its drift estimate is further than this from the truth. */
+#define BENCH_DELAY_RANGE_MAX_MS (1.0)
+#define BENCH_DRIFT_TOLERANCE_PPM (15.0)
+
+typedef struct
+{
+    const char *name;
+    double sender_ppm;
+    bool adaptive;
+    bool compensate;
+} DriftCase;
+
+/* The sender's sound card runs sender_ppm fast relative to ours. */
+static const DriftCase cases[] = {
+    {"0ppm adaptive", 0.0, true, true},
+    {"+100ppm adaptive", 100.0, true, true},
+    {"+100ppm adaptive uncorrected", 100.0, true, false},
+    {"-300ppm adaptive", -300.0, true, true},
+    {"-300ppm adaptive uncorrected", -300.0, true, false},
+    {"+300ppm fixed", 300.0, false, true},
+    {"+300ppm fixed uncorrected", 300.0, false, false},
+    {"-300ppm fixed", -300.0, false, true},
+    {"-300ppm fixed uncorrected", -300.0, false, false},
+};
+
+typedef struct
+{
+    double settled_ms;
+    double end_ms;
+    double min_ms;
+    double max_ms;
+    JitterBufferStats jb;
+} DriftRun;
+
+/* A sine through the resampler at a 300 ppm correction, against the same
+ * sine evaluated at the positions the output should land on. */
+static double resampler_snr_db(double hz)
+{
+    Resampler rs;
+    resampler_init(&rs, FRAMES_PER_BUFFER);
+    double ratio = 1.0 + 300e-6;
+    SAMPLE in[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER + RESAMPLER_TAPS];
+    double signal = 0.0, noise = 0.0;
+    long fed = 0, produced = 0;
+    while (fed < BENCH_SNR_SAMPLES)
+    {
+        for (int i = 0; i < FRAMES_PER_BUFFER; i++)
+            in[i] = (SAMPLE)lrint(
+                16000.0 * sin(2.0 * M_PI * hz * (fed + i) / SAMPLE_RATE));
+        fed += FRAMES_PER_BUFFER;
+        int count = resampler_process(&rs, in, FRAMES_PER_BUFFER, out,
+                                      FRAMES_PER_BUFFER + RESAMPLER_TAPS,
+                                      ratio);
+        for (int i = 0; i < count; i++, produced++)
+        {
+            if (produced < RESAMPLER_TAPS)
+                continue;
+            double expected = 16000.0 * sin(2.0 * M_PI * hz * produced *
+                                            ratio / SAMPLE_RATE);
+            signal += expected * expected;
+            noise += (out[i] - expected) * (out[i] - expected);
+        }
+    }
+    resampler_destroy(&rs);
+    return 10.0 * log10(signal / (noise > 0.0 ? noise : 1e-9));
+}
+
+static void bench_resampler(void)
+{
+    static const double tones[] = {300.0, 1000.0, 3400.0, 8000.0};
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_SNR_SAMPLES / FRAMES_PER_BUFFER * 4);
+    Resampler rs;
+    resampler_init(&rs, FRAMES_PER_BUFFER);
+    SAMPLE in[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER + RESAMPLER_TAPS];
+    uint32_t seed = 11;
+    for (int i = 0; i < timer.capacity; i++)
+    {
+        bench_fill_voice(in, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)i * FRAMES_PER_BUFFER, &seed);
+        uint64_t start = monotonic_ns();
+        resampler_process(&rs, in, FRAMES_PER_BUFFER, out,
+                          FRAMES_PER_BUFFER + RESAMPLER_TAPS, 1.0 - 300e-6);
+        bench_timer_add(&timer, monotonic_ns() - start);
+    }
+    resampler_destroy(&rs);
+
+    char params[256];
+    int used = snprintf(params, sizeof(params), "\"kernels\":\"%s\"",
+                        dsp_kernels()->name);
+    printf("%-32s SNR", "");
+    for (size_t i = 0; i < sizeof(tones) / sizeof(tones[0]); i++)
+    {
+        double snr = resampler_snr_db(tones[i]);
+        used += snprintf(params + used, sizeof(params) - used,
+                         ",\"snr_%.0fhz_db\":%.1f", tones[i], snr);
+        printf(" %.0f Hz %.1f dB%s", tones[i], snr,
+               i + 1 < sizeof(tones) / sizeof(tones[0]) ? "," : "\n");
+    }
+    bench_report_params("resample", &timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    bench_timer_destroy(&timer);
+}
+
+/* Plays BENCH_HOURS of a call on a virtual clock: the sender emits a frame
+ * every frame period of its own clock, the network adds a seeded delay and
+ * the receiver plays one frame every period of ours. Depth is averaged per
+ * minute, so the figures show the trend rather than packet-by-packet
+ * steps. */
+static void run_case(const DriftCase *drift, const uint8_t *voice,
+                     const int *voice_sizes, BenchTimer *timer, DriftRun *run)
+{
+    JitterBufferConfig config;
+    jitter_buffer_config_default(&config);
+    config.adaptive = drift->adaptive;
+    config.drift_compensation = drift->compensate;
+    JitterBuffer jb;
+    jitter_buffer_init(&jb, &config);
+    PacketPool pool;
+    packet_pool_init(&pool, config.slot_count + 1);
+
+    double frame_ns = 1e9 * FRAMES_PER_BUFFER / SAMPLE_RATE;
+    double send_period_ns = frame_ns / (1.0 + drift->sender_ppm * 1e-6);
+    long frames = (long)(BENCH_HOURS * 3600.0 * 1e9 / frame_ns);
+    long minute_frames = (long)(60.0 * 1e9 / frame_ns);
+    uint32_t seed = 3;
+    uint32_t sent = 0;
+    double next_arrival_ns = BENCH_NETWORK_MS * 1e6;
+    SAMPLE out[FRAMES_PER_BUFFER];
+    double minute_sum = 0.0;
+    int minute = 0;
+    run->min_ms = 1e9;
+    run->max_ms = 0.0;
+
+    for (long i = 0; i < frames; i++)
+    {
+        double now = i * frame_ns;
+        uint64_t start = monotonic_ns();
+        while (next_arrival_ns <= now)
+        {
+            PacketBuffer *buffer = packet_pool_acquire(&pool);
+            if (!buffer)
+                break;
+            int index = sent % BENCH_VOICE_FRAMES;
+            memcpy(buffer->data, voice + index * AUDIO_PAYLOAD_MAX,
+                   voice_sizes[index]);
+            AudioPacket packet;
+            packet.sequence_number = (uint16_t)sent;
+            packet.timestamp = sent * FRAMES_PER_BUFFER;
+            packet.payload_type = codec_pcmu.payload_type;
+            packet.flags = 0;
+            packet.payload_size = (uint16_t)voice_sizes[index];
+            packet.payload = buffer->data;
+            packet.buffer = buffer;
+            jitter_buffer_put(&jb, &packet, (uint64_t)next_arrival_ns);
+            packet_buffer_release(buffer);
+            sent++;
+            /* Jitter below one frame period keeps packets in order. */
+            double jitter_ms = BENCH_JITTER_MS *
+                               (bench_rand(&seed) & 0xffff) / 65536.0;
+            next_arrival_ns = sent * send_period_ns +
+                              (BENCH_NETWORK_MS + jitter_ms) * 1e6;
+        }
+        jitter_buffer_get(&jb, out, FRAMES_PER_BUFFER);
+        bench_timer_add(timer, monotonic_ns() - start);
+
+        JitterBufferStats stats;
+        jitter_buffer_get_stats(&jb, &stats);
+        minute_sum += stats.current_delay_ms;
+        if ((i + 1) % minute_frames != 0)
+            continue;
+        double mean = minute_sum / minute_frames;
+        minute_sum = 0.0;
+        if (++minute < BENCH_SETTLE_MINUTES)
+            continue;
+        if (minute == BENCH_SETTLE_MINUTES)
+            run->settled_ms = mean;
+        run->end_ms = mean;
+        if (mean < run->min_ms)
+            run->min_ms = mean;
+        if (mean > run->max_ms)
+            run->max_ms = mean;
+    }
+    jitter_buffer_get_stats(&jb, &run->jb);
+    jitter_buffer_destroy(&jb);
+    packet_pool_destroy(&pool);
+}
+
+/* Runs one case. A compensated case must hold its delay steady with no
+ * underruns or losses and estimate the drift within the tolerance;
+ * returns 1 if it does not. */
+static int bench_drift(const DriftCase *drift, const uint8_t *voice,
+                       const int *voice_sizes)
+{
+    BenchTimer timer;
+    bench_timer_init(&timer,
+                     (int)(BENCH_HOURS * 3600.0 * SAMPLE_RATE /
+                           FRAMES_PER_BUFFER) + 1);
+    DriftRun run;
+    run_case(drift, voice, voice_sizes, &timer, &run);
+    uint64_t scaled = run.jb.samples_compressed + run.jb.samples_expanded;
+
+    char name[64];
+    char params[512];
+    snprintf(name, sizeof(name), "drift %s", drift->name);
+    snprintf(params, sizeof(params),
+             "\"sender_ppm\":%.1f,\"adaptive\":%s,\"compensation\":%s,"
+             "\"hours\":%d,\"settled_delay_ms\":%.2f,\"end_delay_ms\":%.2f,"
+             "\"min_delay_ms\":%.2f,\"max_delay_ms\":%.2f,"
+             "\"drift_estimate_ppm\":%.1f,\"underruns\":%llu,\"lost\":%llu,"
+             "\"late\":%llu,\"time_scaled_samples\":%llu",
+             drift->sender_ppm, drift->adaptive ? "true" : "false",
+             drift->compensate ? "true" : "false", BENCH_HOURS,
+             run.settled_ms, run.end_ms, run.min_ms, run.max_ms,
+             run.jb.drift_ppm, (unsigned long long)run.jb.underruns,
+             (unsigned long long)run.jb.packets_lost,
+             (unsigned long long)run.jb.packets_late,
+             (unsigned long long)scaled);
+    bench_report_params(name, &timer, FRAMES_PER_BUFFER, SAMPLE_RATE, params);
+    printf("%-32s delay %.1f -> %.1f ms (range %.1f-%.1f), estimate "
+           "%+.1f ppm, underruns %llu, lost %llu, time-scaled %llu\n",
+           "", run.settled_ms, run.end_ms, run.min_ms, run.max_ms,
+           run.jb.drift_ppm, (unsigned long long)run.jb.underruns,
+           (unsigned long long)run.jb.packets_lost,
+           (unsigned long long)scaled);
+    bench_timer_destroy(&timer);
+    if (!drift->compensate)
+        return 0;
+
+    int failed = 0;
+    if (run.max_ms - run.min_ms > BENCH_DELAY_RANGE_MAX_MS)
+    {
+        printf("%-32s FAIL: delay moved %.2f ms, more than %.1f\n", "",
+               run.max_ms - run.min_ms, BENCH_DELAY_RANGE_MAX_MS);
+        failed = 1;
+    }
+    if (run.jb.underruns > 0 || run.jb.packets_lost > 0)
+    {
+        printf("%-32s FAIL: %llu underruns, %llu lost\n", "",
+               (unsigned long long)run.jb.underruns,
+               (unsigned long long)run.jb.packets_lost);
+        failed = 1;
+    }
+    if (fabs(run.jb.drift_ppm - drift->sender_ppm) >
+        BENCH_DRIFT_TOLERANCE_PPM)
+    {
+        printf("%-32s FAIL: estimate %+.1f ppm, more than %.0f ppm from "
+               "%+.1f\n",
+               "", run.jb.drift_ppm, BENCH_DRIFT_TOLERANCE_PPM,
+               drift->sender_ppm);
+        failed = 1;
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_drift");
+    printf("Clock drift benchmark: %d h calls on a virtual clock, delay "
+           "averaged per minute from minute %d on, time per frame played\n",
+           BENCH_HOURS, BENCH_SETTLE_MINUTES);
+    bench_resampler();
+
+    /* The voice is encoded once up front and looped. */
+    static uint8_t voice[BENCH_VOICE_FRAMES * AUDIO_PAYLOAD_MAX];
+    int voice_sizes[BENCH_VOICE_FRAMES];
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, &codec_pcmu, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    SAMPLE pcm[FRAMES_PER_BUFFER];
+    uint32_t seed = 5;
+    for (int i = 0; i < BENCH_VOICE_FRAMES; i++)
+    {
+        bench_fill_voice(pcm, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)i * FRAMES_PER_BUFFER, &seed);
+        voice_sizes[i] = codec_encode(&encoder, pcm, FRAMES_PER_BUFFER,
+                                      voice + i * AUDIO_PAYLOAD_MAX,
+                                      AUDIO_PAYLOAD_MAX);
+    }
+    codec_encoder_close(&encoder);
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        failures += bench_drift(&cases[i], voice, voice_sizes);
+    bench_finish();
+    return failures ? 1 : 0;
+}
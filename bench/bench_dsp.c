@@ -0,0 +1,233 @@
+#include "bench_common.h"
+#include "dsp_kernels.h"
+
+#define BENCH_FRAMES (20000)
+#define MAX_KERNELS (4)
+#define CHECK_MAX_LEN (1031)
+#define BENCH_FIR_TAPS (32)
+
+static void fill_random(SAMPLE *out, int len, uint32_t *seed)
+{
+    for (int i = 0; i < len; i++)
+        out[i] = (SAMPLE)(bench_rand(seed) & 0xffff);
+}
+
+static void fill_extremes(SAMPLE *out, int len, uint32_t *seed)
+{
+    static const SAMPLE values[] = {-32768, 32767, -32767, 0, 1, -1};
+    for (int i = 0; i < len; i++)
+        out[i] = values[bench_rand(seed) % 6];
+}
+
+/* Every implementation must reproduce the scalar kernels exactly, including
+ * at full-scale input, for every tail length. Returns the mismatch count. */
+static int check_kernels(const DspKernels *impl)
+{
+    static const float gains[] = {0.0f,  0.5f,  1.0f,   1.2f,
+                                  3.7f,  5.0f,  -2.0f,  1e6f};
+    SAMPLE a[CHECK_MAX_LEN], b[CHECK_MAX_LEN];
+    SAMPLE expected[CHECK_MAX_LEN], actual[CHECK_MAX_LEN];
+    int32_t acc_expected[CHECK_MAX_LEN], acc_actual[CHECK_MAX_LEN];
+    int16_t taps[CHECK_MAX_LEN];
+    uint32_t seed = 17;
+    int cases = 0, failures = 0;
+
+    for (int len = 0; len <= CHECK_MAX_LEN; len += (len < 80 ? 1 : 97))
+    {
+        for (int pattern = 0; pattern < 3; pattern++)
+        {
+            if (pattern == 0)
+            {
+                bench_fill_voice(a, len, SAMPLE_RATE, len, &seed);
+                bench_fill_voice(b, len, SAMPLE_RATE, len * 7, &seed);
+            }
+            else if (pattern == 1)
+            {
+                fill_random(a, len, &seed);
+                fill_random(b, len, &seed);
+            }
+            else
+            {
+                fill_extremes(a, len, &seed);
+                fill_extremes(b, len, &seed);
+            }
+
+            cases++;
+            if (impl->sum_squares(a, len) !=
+                dsp_kernels_scalar.sum_squares(a, len))
+            {
+                failures++;
+                printf("  %s sum_squares mismatch, len %d pattern %d\n",
+                       impl->name, len, pattern);
+            }
+
+            for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++)
+            {
+                cases++;
+                dsp_kernels_scalar.apply_gain(a, expected, len, gains[g]);
+                impl->apply_gain(a, actual, len, gains[g]);
+                if (memcmp(expected, actual, len * sizeof(SAMPLE)) != 0)
+                {
+                    failures++;
+                    printf("  %s apply_gain mismatch, len %d gain %g\n",
+                           impl->name, len, gains[g]);
+                }
+                memcpy(actual, a, len * sizeof(SAMPLE));
+                impl->apply_gain(actual, actual, len, gains[g]);
+                if (memcmp(expected, actual, len * sizeof(SAMPLE)) != 0)
+                {
+                    failures++;
+                    printf("  %s in-place apply_gain mismatch, len %d\n",
+                           impl->name, len);
+                }
+            }
+
+            cases++;
+            memcpy(expected, a, len * sizeof(SAMPLE));
+            memcpy(actual, a, len * sizeof(SAMPLE));
+            dsp_kernels_scalar.mix(expected, b, len);
+            impl->mix(actual, b, len);
+            if (memcmp(expected, actual, len * sizeof(SAMPLE)) != 0)
+            {
+                failures++;
+                printf("  %s mix mismatch, len %d pattern %d\n", impl->name,
+                       len, pattern);
+            }
+
+            /* Start from a sum of three inputs so narrowing has to clip. */
+            for (int i = 0; i < len; i++)
+                acc_expected[i] = acc_actual[i] = 3 * (int32_t)a[i];
+            cases++;
+            dsp_kernels_scalar.accumulate(acc_expected, b, len);
+            impl->accumulate(acc_actual, b, len);
+            if (memcmp(acc_expected, acc_actual, len * sizeof(int32_t)) != 0)
+            {
+                failures++;
+                printf("  %s accumulate mismatch, len %d pattern %d\n",
+                       impl->name, len, pattern);
+            }
+            for (int minus = 0; minus < 2; minus++)
+            {
+                const SAMPLE *in = minus ? a : NULL;
+                cases++;
+                dsp_kernels_scalar.mix_minus(acc_expected, in, expected, len);
+                impl->mix_minus(acc_expected, in, actual, len);
+                if (memcmp(expected, actual, len * sizeof(SAMPLE)) != 0)
+                {
+                    failures++;
+                    printf("  %s mix_minus mismatch, len %d pattern %d\n",
+                           impl->name, len, pattern);
+                }
+            }
+
+            /* Taps within +-32 keep even the longest sum in range. */
+            for (int i = 0; i < len; i++)
+                taps[i] = (int16_t)(b[i] >> 10);
+            cases++;
+            if (impl->dot_product(a, taps, len) !=
+                dsp_kernels_scalar.dot_product(a, taps, len))
+            {
+                failures++;
+                printf("  %s dot_product mismatch, len %d pattern %d\n",
+                       impl->name, len, pattern);
+            }
+        }
+    }
+    printf("%-32s %s on %d cases\n", impl->name,
+           failures ? "MISMATCH" : "bit-exact with scalar", cases);
+    bench_json_record(impl->name, "\"check_cases\":%d,\"check_failures\":%d",
+                      cases, failures);
+    return failures;
+}
+
+static void bench_kernels(const DspKernels *impl)
+{
+    BenchTimer rms_timer, gain_timer, mix_timer, mix_minus_timer, fir_timer;
+    bench_timer_init(&rms_timer, BENCH_FRAMES);
+    bench_timer_init(&gain_timer, BENCH_FRAMES);
+    bench_timer_init(&mix_timer, BENCH_FRAMES);
+    bench_timer_init(&mix_minus_timer, BENCH_FRAMES);
+    bench_timer_init(&fir_timer, BENCH_FRAMES);
+    SAMPLE in[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    int32_t acc[FRAMES_PER_BUFFER];
+    int16_t taps[BENCH_FIR_TAPS];
+    uint32_t seed = 23;
+    volatile uint64_t sink = 0;
+
+    for (int i = 0; i < BENCH_FIR_TAPS; i++)
+        taps[i] = (int16_t)(1024 - 64 * abs(i - BENCH_FIR_TAPS / 2));
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        bench_fill_voice(in, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)(i % 64) * FRAMES_PER_BUFFER, &seed);
+        uint64_t start = monotonic_ns();
+        sink += impl->sum_squares(in, FRAMES_PER_BUFFER);
+        uint64_t t1 = monotonic_ns();
+        impl->apply_gain(in, out, FRAMES_PER_BUFFER, 1.2f);
+        uint64_t t2 = monotonic_ns();
+        impl->mix(out, in, FRAMES_PER_BUFFER);
+        uint64_t t3 = monotonic_ns();
+        sink += out[i % FRAMES_PER_BUFFER];
+        memset(acc, 0, sizeof(acc));
+        uint64_t t4 = monotonic_ns();
+        impl->accumulate(acc, in, FRAMES_PER_BUFFER);
+        impl->accumulate(acc, out, FRAMES_PER_BUFFER);
+        impl->mix_minus(acc, in, out, FRAMES_PER_BUFFER);
+        uint64_t t5 = monotonic_ns();
+        sink += out[i % FRAMES_PER_BUFFER];
+        uint64_t t6 = monotonic_ns();
+        for (int j = 0; j + BENCH_FIR_TAPS <= FRAMES_PER_BUFFER; j++)
+            acc[j] = impl->dot_product(in + j, taps, BENCH_FIR_TAPS);
+        uint64_t t7 = monotonic_ns();
+        sink += acc[i % (FRAMES_PER_BUFFER - BENCH_FIR_TAPS)];
+        bench_timer_add(&rms_timer, t1 - start);
+        bench_timer_add(&gain_timer, t2 - t1);
+        bench_timer_add(&mix_timer, t3 - t2);
+        bench_timer_add(&mix_minus_timer, t5 - t4);
+        bench_timer_add(&fir_timer, t7 - t6);
+    }
+
+    char name[64];
+    char params[64];
+    snprintf(params, sizeof(params), "\"kernels\":\"%s\"", impl->name);
+    snprintf(name, sizeof(name), "rms %s", impl->name);
+    bench_report_params(name, &rms_timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    snprintf(name, sizeof(name), "gain %s", impl->name);
+    bench_report_params(name, &gain_timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    snprintf(name, sizeof(name), "mix %s", impl->name);
+    bench_report_params(name, &mix_timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    /* Two inputs accumulated, then one removed again while narrowing. */
+    snprintf(name, sizeof(name), "mix-minus %s", impl->name);
+    bench_report_params(name, &mix_minus_timer, FRAMES_PER_BUFFER,
+                        SAMPLE_RATE, params);
+    /* The resampler's inner loop: one dot product per output sample. */
+    snprintf(name, sizeof(name), "fir%d %s", BENCH_FIR_TAPS, impl->name);
+    bench_report_params(name, &fir_timer, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                        params);
+    bench_timer_destroy(&rms_timer);
+    bench_timer_destroy(&gain_timer);
+    bench_timer_destroy(&mix_timer);
+    bench_timer_destroy(&mix_minus_timer);
+    bench_timer_destroy(&fir_timer);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_dsp");
+    const DspKernels *list[MAX_KERNELS];
+    int count = dsp_kernels_supported(list, MAX_KERNELS);
+    printf("DSP kernel benchmark: %d frames at %d Hz, dispatch selects %s\n",
+           FRAMES_PER_BUFFER, SAMPLE_RATE, dsp_kernels()->name);
+
+    int failures = 0;
+    for (int i = 1; i < count; i++)
+        failures += check_kernels(list[i]);
+    for (int i = 0; i < count; i++)
+        bench_kernels(list[i]);
+    bench_finish();
+    return failures ? 1 : 0;
+}
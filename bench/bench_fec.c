@@ -0,0 +1,201 @@
+#include <stdbool.h>
+
+#include "audio_packet.h"
+#include "bench_common.h"
+#include "codec.h"
+#include "jitter_buffer.h"
+#include "packet_pool.h"
+#include "red.h"
+
+#define BENCH_FRAMES (20000)
+#define BENCH_MEAN_BURST (3.0)
+/* Under random loss at rate p, a frame sent with depth copies is lost for
+ * good only if its packet and the next depth packets are all lost, so at
+ * least 1 - p^depth of the lost frames should come back. A case recovering
+ * less than that, minus this margin for the seeded channel, fails. */
+#define BENCH_RECOVERY_MARGIN_PCT (3.0)
+
+typedef enum
+{
+    LOSS_RANDOM,
+    LOSS_BURSTY,
+} LossModel;
+
+/* Two-state Gilbert-Elliott channel. Bursty loss drops every packet in the
+ * bad state and leaves it after BENCH_MEAN_BURST packets on average; the
+ * entry probability is chosen so the long-run loss rate is rate. */
+typedef struct
+{
+    LossModel model;
+    double rate;
+    bool bad;
+    uint32_t seed;
+} LossChannel;
+
+static double channel_uniform(LossChannel *channel)
+{
+    return (bench_rand(&channel->seed) & 0xffffff) / 16777216.0;
+}
+
+static bool channel_drops(LossChannel *channel)
+{
+    if (channel->model == LOSS_RANDOM)
+        return channel_uniform(channel) < channel->rate;
+    double leave = 1.0 / BENCH_MEAN_BURST;
+    double enter = channel->rate * leave / (1.0 - channel->rate);
+    channel->bad = channel_uniform(channel) < (channel->bad ? 1.0 - leave
+                                                            : enter);
+    return channel->bad;
+}
+
+/* Sends a voice signal through the RFC 2198 packer, a lossy channel and the
+ * receive path (red_parse() and the jitter buffer, which adapts its delay
+ * to the redundancy it sees), and counts how many lost frames were rebuilt
+ * before their playout time. Returns 1 if too few were. */
+static int bench_fec(const Codec *codec, LossModel model, int loss_percent,
+                      int depth)
+{
+    JitterBufferConfig config;
+    jitter_buffer_config_default(&config);
+    JitterBuffer jb;
+    jitter_buffer_init(&jb, &config);
+    PacketPool pool;
+    packet_pool_init(&pool, config.slot_count + 1);
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, codec, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    RedEncoder red;
+    red_encoder_init(&red);
+    LossChannel channel = {model, loss_percent / 100.0, false, 11};
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+
+    SAMPLE pcm[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    uint8_t primary[AUDIO_PAYLOAD_MAX];
+    uint8_t payload[RED_PAYLOAD_MAX + AUDIO_PAYLOAD_MAX];
+    AudioPacket packet;
+    uint32_t seed = 5;
+    uint64_t now = 0;
+    uint64_t frame_ns = 1000000000ull * FRAMES_PER_BUFFER / SAMPLE_RATE;
+    uint64_t dropped = 0;
+    uint64_t bytes = 0;
+
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        bench_fill_voice(pcm, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)i * FRAMES_PER_BUFFER, &seed);
+        uint32_t timestamp = (uint32_t)(i * FRAMES_PER_BUFFER);
+        int length = codec_encode(&encoder, pcm, FRAMES_PER_BUFFER, primary,
+                                  sizeof(primary));
+        int red_length = red_encoder_pack(&red, depth, codec->payload_type,
+                                          timestamp, primary, length, payload,
+                                          sizeof(payload));
+        bytes += red_length > 0 ? red_length : length;
+
+        uint64_t start = monotonic_ns();
+        if (channel_drops(&channel))
+        {
+            dropped++;
+        }
+        else
+        {
+            /* The copy stands in for the kernel's write into the receive
+             * buffer. */
+            PacketBuffer *buffer = packet_pool_acquire(&pool);
+            memcpy(buffer->data, red_length > 0 ? payload : primary,
+                   red_length > 0 ? red_length : length);
+            RedBlock blocks[RED_MAX_BLOCKS] = {
+                {codec->payload_type, timestamp, buffer->data, length}};
+            int count = red_length > 0
+                            ? red_parse(buffer->data, red_length, timestamp,
+                                        blocks, RED_MAX_BLOCKS)
+                            : 1;
+            for (int b = 0; b < count; b++)
+            {
+                packet.sequence_number = i;
+                packet.timestamp = blocks[b].timestamp;
+                packet.payload_type = blocks[b].payload_type;
+                packet.flags = b > 0 ? AUDIO_PACKET_REDUNDANT : 0;
+                packet.payload_size = (uint16_t)blocks[b].length;
+                packet.payload = blocks[b].data;
+                packet.buffer = buffer;
+                jitter_buffer_put(&jb, &packet, now);
+            }
+            packet_buffer_release(buffer);
+        }
+        now += frame_ns;
+        if (i >= config.initial_delay_frames)
+            jitter_buffer_get(&jb, out, FRAMES_PER_BUFFER);
+        bench_timer_add(&timer, monotonic_ns() - start);
+    }
+
+    JitterBufferStats stats;
+    jitter_buffer_get_stats(&jb, &stats);
+    double recovered_pct =
+        dropped ? 100.0 * stats.frames_recovered / dropped : 0.0;
+    double kbps = bytes * 8.0 * SAMPLE_RATE / FRAMES_PER_BUFFER /
+                  BENCH_FRAMES / 1000.0;
+    char name[64];
+    char params[256];
+    snprintf(name, sizeof(name), "fec %s %s %d%% depth %d", codec->name,
+             model == LOSS_RANDOM ? "random" : "bursty", loss_percent, depth);
+    snprintf(params, sizeof(params),
+             "\"codec\":\"%s\",\"loss_model\":\"%s\",\"loss_pct\":%d,"
+             "\"depth\":%d,\"dropped\":%llu,\"recovered\":%llu,"
+             "\"recovered_pct\":%.2f,\"concealed\":%llu,\"payload_kbps\":%.1f,"
+             "\"target_delay_ms\":%.1f",
+             codec->name, model == LOSS_RANDOM ? "random" : "bursty",
+             loss_percent, depth, (unsigned long long)dropped,
+             (unsigned long long)stats.frames_recovered, recovered_pct,
+             (unsigned long long)stats.frames_concealed, kbps,
+             stats.target_delay_ms);
+    bench_report_params(name, &timer, FRAMES_PER_BUFFER, SAMPLE_RATE, params);
+    printf("%-32s lost %llu, recovered %llu (%.1f%%), concealed %llu, "
+           "%.1f kbps, target delay %.1f ms\n",
+           "", (unsigned long long)dropped,
+           (unsigned long long)stats.frames_recovered, recovered_pct,
+           (unsigned long long)stats.frames_concealed, kbps,
+           stats.target_delay_ms);
+
+    int failed = 0;
+    if (model == LOSS_RANDOM && depth > 0 && dropped)
+    {
+        double unrecoverable = 1.0;
+        for (int d = 0; d < depth; d++)
+            unrecoverable *= channel.rate;
+        double floor_pct =
+            100.0 * (1.0 - unrecoverable) - BENCH_RECOVERY_MARGIN_PCT;
+        if (recovered_pct < floor_pct)
+        {
+            printf("%-32s FAIL: recovered %.1f%%, expected at least %.1f%%\n",
+                   "", recovered_pct, floor_pct);
+            failed = 1;
+        }
+    }
+    bench_timer_destroy(&timer);
+    codec_encoder_close(&encoder);
+    jitter_buffer_destroy(&jb);
+    packet_pool_destroy(&pool);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_fec");
+    static const int losses[] = {1, 5, 10};
+    int failures = 0;
+    printf("FEC benchmark: RFC 2198 redundancy over random and bursty "
+           "(mean burst %.0f) loss, time per frame received and played\n",
+           BENCH_MEAN_BURST);
+    for (int model = LOSS_RANDOM; model <= LOSS_BURSTY; model++)
+    {
+        for (size_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++)
+        {
+            for (int depth = 0; depth <= RED_MAX_DEPTH; depth++)
+                failures += bench_fec(&codec_ima_adpcm, (LossModel)model,
+                                      losses[i], depth);
+        }
+    }
+    bench_finish();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+#include <stdbool.h>
+
+#include "audio_packet.h"
+#include "bench_common.h"
+#include "codec.h"
+#include "impair.h"
+#include "jitter_buffer.h"
+#include "packet_pool.h"
+
+#define BENCH_FRAMES (20000)
+#define BENCH_INDEX_SIZE (4)
+
+typedef struct
+{
+    const char *name;
+    const char *spec;
+} ImpairProfile;
+
+static const ImpairProfile profiles[] = {
+    {"clean", "seed=7"},
+    {"lan", "delay=2,jitter=1,loss=0.1,seed=7"},
+    {"wifi", "delay=15,jitter=8,dist=pareto,loss=1,burst=2,seed=7"},
+    {"lte", "delay=40,jitter=15,dist=normal,loss=3,burst=4,reorder=1,"
+            "dup=0.5,seed=7"},
+    {"congested", "delay=60,jitter=30,dist=pareto,loss=5,burst=3,"
+                  "reorder=2,rate=200,queue=32,seed=7"},
+};
+
+typedef struct
+{
+    uint64_t checksum;
+    JitterBufferStats jb;
+    ImpairStats impair;
+} ImpairRun;
+
+/* Plays a voice stream through one seeded impairment profile into the
+ * jitter buffer on a virtual clock, so the same profile always yields the
+ * same arrivals and the same decoded output. */
+static void run_profile(const Codec *codec, const ImpairConfig *impair_config,
+                        BenchTimer *timer, ImpairRun *run)
+{
+    JitterBufferConfig config;
+    jitter_buffer_config_default(&config);
+    JitterBuffer jb;
+    jitter_buffer_init(&jb, &config);
+    PacketPool pool;
+    packet_pool_init(&pool, config.slot_count + 1);
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, codec, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    Impairment imp;
+    impair_init(&imp, impair_config);
+
+    SAMPLE pcm[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    uint8_t datagram[IMPAIR_PACKET_MAX];
+    AudioPacket packet;
+    uint32_t seed = 5;
+    uint64_t now = 0;
+    uint64_t frame_ns = 1000000000ull * FRAMES_PER_BUFFER / SAMPLE_RATE;
+    uint64_t checksum = 1469598103934665603ull;
+
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        bench_fill_voice(pcm, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)i * FRAMES_PER_BUFFER, &seed);
+        memcpy(datagram, &i, BENCH_INDEX_SIZE);
+        int length = codec_encode(&encoder, pcm, FRAMES_PER_BUFFER,
+                                  datagram + BENCH_INDEX_SIZE,
+                                  sizeof(datagram) - BENCH_INDEX_SIZE);
+
+        uint64_t start = monotonic_ns();
+        impair_submit(&imp, datagram, BENCH_INDEX_SIZE + length, NULL,
+                      now);
+        uint64_t release_ns;
+        PacketBuffer *buffer;
+        int received;
+        while ((buffer = packet_pool_acquire(&pool)) &&
+               (received = impair_pop(&imp, now, buffer->data,
+                                      RTP_PACKET_MAX, &release_ns, NULL)) > 0)
+        {
+            int index;
+            memcpy(&index, buffer->data, BENCH_INDEX_SIZE);
+            packet.sequence_number = (uint16_t)index;
+            packet.timestamp = (uint32_t)(index * FRAMES_PER_BUFFER);
+            packet.payload_type = codec->payload_type;
+            packet.flags = 0;
+            packet.payload_size = (uint16_t)(received - BENCH_INDEX_SIZE);
+            packet.payload = buffer->data + BENCH_INDEX_SIZE;
+            packet.buffer = buffer;
+            jitter_buffer_put(&jb, &packet, release_ns);
+            packet_buffer_release(buffer);
+        }
+        if (buffer)
+            packet_buffer_release(buffer);
+        if (i >= config.initial_delay_frames)
+        {
+            jitter_buffer_get(&jb, out, FRAMES_PER_BUFFER);
+            for (int s = 0; s < FRAMES_PER_BUFFER; s++)
+                checksum = (checksum ^ (uint16_t)out[s]) * 1099511628211ull;
+        }
+        if (timer)
+            bench_timer_add(timer, monotonic_ns() - start);
+        now += frame_ns;
+    }
+
+    run->checksum = checksum;
+    jitter_buffer_get_stats(&jb, &run->jb);
+    run->impair = imp.stats;
+    impair_destroy(&imp);
+    codec_encoder_close(&encoder);
+    jitter_buffer_destroy(&jb);
+    packet_pool_destroy(&pool);
+}
+
+static void bench_impair(const Codec *codec, const ImpairProfile *profile)
+{
+    ImpairConfig impair_config;
+    impair_config_default(&impair_config);
+    if (impair_config_parse(&impair_config, profile->spec) == -1)
+    {
+        fprintf(stderr, "Invalid profile '%s'\n", profile->spec);
+        return;
+    }
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+    ImpairRun first;
+    ImpairRun second;
+    run_profile(codec, &impair_config, &timer, &first);
+    run_profile(codec, &impair_config, NULL, &second);
+    bool deterministic = first.checksum == second.checksum;
+
+    double concealed_pct = 100.0 * first.jb.frames_concealed / BENCH_FRAMES;
+    char name[64];
+    char params[512];
+    snprintf(name, sizeof(name), "impair %s %s", codec->name, profile->name);
+    snprintf(params, sizeof(params),
+             "\"codec\":\"%s\",\"profile\":\"%s\",\"spec\":\"%s\","
+             "\"lost\":%llu,\"queue_drops\":%llu,\"reordered\":%llu,"
+             "\"duplicated\":%llu,\"late\":%llu,\"concealed\":%llu,"
+             "\"concealed_pct\":%.2f,\"target_delay_ms\":%.1f,"
+             "\"jitter_ms\":%.2f,\"checksum\":\"%016llx\","
+             "\"deterministic\":%s",
+             codec->name, profile->name, profile->spec,
+             (unsigned long long)first.impair.lost,
+             (unsigned long long)first.impair.queue_drops,
+             (unsigned long long)first.impair.reordered,
+             (unsigned long long)first.impair.duplicated,
+             (unsigned long long)first.jb.packets_late,
+             (unsigned long long)first.jb.frames_concealed, concealed_pct,
+             first.jb.target_delay_ms, first.jb.jitter_ms,
+             (unsigned long long)first.checksum,
+             deterministic ? "true" : "false");
+    bench_report_params(name, &timer, FRAMES_PER_BUFFER, SAMPLE_RATE, params);
+    printf("%-32s lost %llu, late %llu, concealed %.2f%%, target delay "
+           "%.1f ms, checksum %016llx%s\n",
+           "", (unsigned long long)first.impair.lost,
+           (unsigned long long)first.jb.packets_late, concealed_pct,
+           first.jb.target_delay_ms, (unsigned long long)first.checksum,
+           deterministic ? "" : " (NOT DETERMINISTIC)");
+    bench_timer_destroy(&timer);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_impair");
+    printf("Impairment benchmark: seeded network profiles into the jitter "
+           "buffer, time per frame received and played\n");
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+        bench_impair(&codec_ima_adpcm, &profiles[i]);
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <stdbool.h>
+
+#include "bench_common.h"
+#include "dsp_kernels.h"
+#include "mixer.h"
+
+#define BENCH_FRAMES (20000)
+#define BENCH_NOISE_RMS (60)
+
+/* Participant 0 talks, 1 interjects now and then and the rest only send
+ * background noise, as in most conference frames. */
+static void fill_inputs(SAMPLE inputs[][FRAMES_PER_BUFFER], int count,
+                        long offset, uint32_t *seed)
+{
+    for (int p = 0; p < count; p++)
+    {
+        bool talking = p == 0 || (p == 1 && (offset / 44100) % 4 == 0);
+        if (talking)
+        {
+            bench_fill_voice(inputs[p], FRAMES_PER_BUFFER, SAMPLE_RATE,
+                             offset + p * 7919, seed);
+            continue;
+        }
+        for (int i = 0; i < FRAMES_PER_BUFFER; i++)
+            inputs[p][i] = (SAMPLE)((int)(bench_rand(seed) %
+                                          (2 * BENCH_NOISE_RMS + 1)) -
+                                    BENCH_NOISE_RMS);
+    }
+}
+
+/* Each participant's mix-minus must equal a plain saturating sum of the
+ * local input and every other mixed participant. Returns mismatches. */
+static int check_mix_minus(const Mixer *mixer, SAMPLE inputs[][FRAMES_PER_BUFFER],
+                           int count, const SAMPLE *local)
+{
+    SAMPLE actual[FRAMES_PER_BUFFER];
+    int failures = 0;
+    for (int p = 0; p < count; p++)
+    {
+        mixer_mix_minus(mixer, p, inputs[p], actual);
+        for (int i = 0; i < FRAMES_PER_BUFFER; i++)
+        {
+            int32_t sum = local[i];
+            for (int q = 0; q < count; q++)
+            {
+                if (q != p && mixer->selected[q])
+                    sum += inputs[q][i];
+            }
+            sum = sum > 32767 ? 32767 : sum < -32768 ? -32768 : sum;
+            if (actual[i] != sum)
+            {
+                failures++;
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+/* Times one conference frame on the bridge: levels, speaker selection, the
+ * speaker mix and a mix-minus for every participant. */
+static void bench_mixer(int count, int speakers)
+{
+    static SAMPLE inputs[MIXER_INPUTS_MAX][FRAMES_PER_BUFFER];
+    const SAMPLE *pointers[MIXER_INPUTS_MAX];
+    SAMPLE local[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    SAMPLE minus[FRAMES_PER_BUFFER];
+    Mixer mixer;
+    mixer_init(&mixer, FRAMES_PER_BUFFER, speakers, 30.0f);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+    uint32_t seed = 29;
+    int failures = 0;
+    uint64_t mixed = 0;
+    volatile int sink = 0;
+
+    for (int p = 0; p < count; p++)
+        pointers[p] = inputs[p];
+    for (int f = 0; f < BENCH_FRAMES; f++)
+    {
+        long offset = (long)f * FRAMES_PER_BUFFER;
+        fill_inputs(inputs, count, offset, &seed);
+        bench_fill_voice(local, FRAMES_PER_BUFFER, SAMPLE_RATE, offset * 3,
+                         &seed);
+
+        uint64_t start = monotonic_ns();
+        mixed += mixer_mix(&mixer, pointers, count, out);
+        mixer_set_local(&mixer, local);
+        for (int p = 0; p < count; p++)
+        {
+            mixer_mix_minus(&mixer, p, inputs[p], minus);
+            sink += minus[p];
+        }
+        bench_timer_add(&timer, monotonic_ns() - start);
+        if (f % 1000 == 0)
+            failures += check_mix_minus(&mixer, inputs, count, local);
+    }
+
+    char name[64];
+    char params[128];
+    snprintf(name, sizeof(name), "mixer %d peers, %d speakers", count,
+             speakers);
+    snprintf(params, sizeof(params),
+             "\"peers\":%d,\"speakers\":%d,\"kernels\":\"%s\","
+             "\"mean_mixed\":%.2f,\"check_failures\":%d",
+             count, speakers, dsp_kernels()->name,
+             (double)mixed / BENCH_FRAMES, failures);
+    bench_report_params(name, &timer, FRAMES_PER_BUFFER, SAMPLE_RATE, params);
+    printf("%-32s mixed %.2f inputs per frame, mix-minus %s\n", "",
+           (double)mixed / BENCH_FRAMES,
+           failures ? "MISMATCH" : "matches a plain sum");
+    bench_timer_destroy(&timer);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_mixer");
+    static const int counts[] = {2, 4, 8};
+    printf("Mixer benchmark: speaker mix and per-participant mix-minus on "
+           "the %s kernels, time per frame\n",
+           dsp_kernels()->name);
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        bench_mixer(counts[i], MIXER_DEFAULT_SPEAKERS);
+        bench_mixer(counts[i], counts[i]);
+    }
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <arpa/inet.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "codec.h"
+#include "net_io.h"
+#include "rtp.h"
+
+#define BENCH_ROUNDS (20000)
+#define BENCH_WARMUP_ROUNDS (200)
+#define BENCH_LOCAL_PORT (47000)
+
+/* Both sockets live on loopback; each round sends a burst of packets and
+ * reads them back, either one syscall per datagram or one per burst. */
+typedef struct
+{
+    NetSocket tx;
+    NetSocket rx;
+    struct sockaddr_in rx_addr;
+} BenchLink;
+
+static int link_open(BenchLink *link)
+{
+    if (net_socket_open(&link->tx, 0) == -1)
+        return -1;
+    for (int port = BENCH_LOCAL_PORT; port < BENCH_LOCAL_PORT + 100; port++)
+    {
+        if (net_socket_open(&link->rx, port) == 0)
+        {
+            memset(&link->rx_addr, 0, sizeof(link->rx_addr));
+            link->rx_addr.sin_family = AF_INET;
+            link->rx_addr.sin_port = htons(port);
+            link->rx_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            return 0;
+        }
+    }
+    net_socket_close(&link->tx);
+    return -1;
+}
+
+static void link_close(BenchLink *link)
+{
+    net_socket_close(&link->tx);
+    net_socket_close(&link->rx);
+}
+
+static void bench_burst(int burst, bool batched, int payload_size)
+{
+    BenchLink link;
+    if (link_open(&link) == -1)
+    {
+        fprintf(stderr, "cannot open loopback sockets\n");
+        return;
+    }
+    static uint8_t tx_datagrams[NET_BATCH_MAX][RTP_PACKET_MAX];
+    static uint8_t rx_datagrams[NET_BATCH_MAX][RTP_PACKET_MAX];
+    const void *tx_buffers[NET_BATCH_MAX];
+    void *rx_buffers[NET_BATCH_MAX];
+    size_t lengths[NET_BATCH_MAX];
+    struct sockaddr_in addrs[NET_BATCH_MAX];
+    NetDatagramInfo info[NET_BATCH_MAX];
+    for (int i = 0; i < burst; i++)
+    {
+        RtpHeader header = {(uint16_t)i, 0, 1, PAYLOAD_L16, false};
+        rtp_write_header(tx_datagrams[i], &header);
+        tx_buffers[i] = tx_datagrams[i];
+        rx_buffers[i] = rx_datagrams[i];
+        lengths[i] = RTP_HEADER_SIZE + payload_size;
+        addrs[i] = link.rx_addr;
+    }
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_ROUNDS);
+    uint64_t lost = 0;
+
+    for (int round = 0; round < BENCH_WARMUP_ROUNDS + BENCH_ROUNDS; round++)
+    {
+        int received = 0;
+        uint64_t start = monotonic_ns();
+        if (batched)
+        {
+            net_send_batch(&link.tx, tx_buffers, lengths, addrs, burst);
+            while (received < burst &&
+                   net_wait_readable(&link.rx, 100) > 0)
+                received += net_recv_batch(&link.rx, rx_buffers + received,
+                                           RTP_PACKET_MAX,
+                                           info + received, burst - received);
+        }
+        else
+        {
+            for (int i = 0; i < burst; i++)
+                net_send_batch(&link.tx, &tx_buffers[i], &lengths[i],
+                               &addrs[i], 1);
+            while (received < burst &&
+                   net_wait_readable(&link.rx, 100) > 0)
+                received += net_recv_batch(&link.rx, &rx_buffers[received],
+                                           RTP_PACKET_MAX,
+                                           &info[received], 1);
+        }
+        uint64_t elapsed = monotonic_ns() - start;
+        lost += burst - received;
+        if (round >= BENCH_WARMUP_ROUNDS)
+            bench_timer_add(&timer, elapsed / burst);
+    }
+
+    uint64_t rounds = BENCH_WARMUP_ROUNDS + BENCH_ROUNDS;
+    double syscalls = (double)(link.tx.send_calls + link.rx.recv_calls) /
+                      (rounds * burst);
+    char name[64];
+    char params[128];
+    snprintf(name, sizeof(name), "udp %s burst %d",
+             batched ? "mmsg" : "single", burst);
+    snprintf(params, sizeof(params),
+             "\"burst\":%d,\"batched\":%s,\"syscalls_per_packet\":%.3f,"
+             "\"lost\":%llu",
+             burst, batched ? "true" : "false", syscalls,
+             (unsigned long long)lost);
+    bench_report_params(name, &timer, FRAMES_PER_BUFFER, SAMPLE_RATE, params);
+    printf("%-32s %.3f syscalls/packet, %llu lost\n", "", syscalls,
+           (unsigned long long)lost);
+    bench_timer_destroy(&timer);
+    link_close(&link);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_net");
+    static const int bursts[] = {1, 4, 16};
+    int payload_size = FRAMES_PER_BUFFER * (int)sizeof(SAMPLE);
+    printf("UDP loopback benchmark: %d byte payloads, time per packet "
+           "(send and receive)\n",
+           payload_size);
+    for (size_t i = 0; i < sizeof(bursts) / sizeof(bursts[0]); i++)
+    {
+        bench_burst(bursts[i], false, payload_size);
+        bench_burst(bursts[i], true, payload_size);
+    }
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,658 @@
+#include <pthread.h>
+#include <speex/speex_echo.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "call.h"
+#include "codec.h"
+#include "dsp_kernels.h"
+#include "frame_notifier.h"
+#include "jitter_buffer.h"
+#include "latency.h"
+#include "metrics.h"
+#include "packet_pool.h"
+#include "preprocess.h"
+#include "recorder.h"
+#include "ring_buffer.h"
+
+#define BENCH_FRAMES (20000)
+#define BENCH_AEC_FRAMES (3000)
+#define BENCH_WARMUP_FRAMES (200)
+
+static const int frame_sizes[] = {128, 256, 512, 1024};
+static const int tail_lengths_ms[] = {60, 120, 250};
+
+typedef struct
+{
+    int sample_rate;
+    double frame_ms; /* 0 for the build's FRAMES_PER_BUFFER */
+    int packet_frames;
+} FormatCase;
+
+static const FormatCase formats[] = {
+    {44100, 0.0, 1}, {48000, 2.5, 1}, {48000, 5.0, 1},
+    {48000, 5.0, 4}, {48000, 10.0, 1}, {48000, 10.0, 2},
+    {48000, 20.0, 1}, {16000, 10.0, 2},
+};
+
+/* Near-end chains, from everything bypassed to every stage on. */
+typedef struct
+{
+    const char *name;
+    bool aec;
+    PreprocessConfig config;
+} PreprocessCase;
+
+static const PreprocessCase chains[] = {
+    {"bypass", false, {false, false, -15, false, 8000.0f, false}},
+    {"vad", false, {false, false, -15, false, 8000.0f, true}},
+    {"denoise", false, {false, true, -15, false, 8000.0f, false}},
+    {"denoise vad", false, {false, true, -15, false, 8000.0f, true}},
+    {"denoise vad agc", false, {false, true, -15, true, 8000.0f, true}},
+    {"aec", true, {false, false, -15, false, 8000.0f, false}},
+    {"aec denoise vad", true, {false, true, -15, false, 8000.0f, true}},
+    {"aec all", true, {true, true, -15, true, 8000.0f, true}},
+};
+
+static int frame_size_count(void)
+{
+    int count = 0;
+    for (size_t i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]); i++)
+    {
+        if (frame_sizes[i] <= FRAMES_PER_BUFFER)
+            count++;
+    }
+    return count;
+}
+
+static void bench_ring_buffer(int frame_size)
+{
+    RingBuffer rb;
+    rb_init(&rb, DSP_RING_FRAMES * frame_size);
+    BenchTimer write_timer, read_timer;
+    bench_timer_init(&write_timer, BENCH_FRAMES);
+    bench_timer_init(&read_timer, BENCH_FRAMES);
+    SAMPLE in[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    uint32_t seed = 11;
+    bench_fill_voice(in, frame_size, SAMPLE_RATE, 0, &seed);
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_FRAMES; i++)
+    {
+        uint64_t start = monotonic_ns();
+        rb_write(&rb, in, frame_size);
+        uint64_t mid = monotonic_ns();
+        rb_read(&rb, out, frame_size);
+        uint64_t end = monotonic_ns();
+        if (i < BENCH_WARMUP_FRAMES)
+            continue;
+        bench_timer_add(&write_timer, mid - start);
+        bench_timer_add(&read_timer, end - mid);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "rb_write %d", frame_size);
+    bench_report(name, &write_timer, frame_size, SAMPLE_RATE);
+    snprintf(name, sizeof(name), "rb_read %d", frame_size);
+    bench_report(name, &read_timer, frame_size, SAMPLE_RATE);
+    bench_timer_destroy(&write_timer);
+    bench_timer_destroy(&read_timer);
+    rb_destroy(&rb);
+}
+
+typedef struct
+{
+    Metrics *metrics;
+    atomic_bool running;
+} MetricsWriter;
+
+/* The network thread's share of the updates: a packet in and one out. */
+static void *metrics_writer_func(void *data)
+{
+    MetricsWriter *writer = (MetricsWriter *)data;
+    while (atomic_load_explicit(&writer->running, memory_order_relaxed))
+    {
+        metrics_add(writer->metrics, METRIC_PACKETS_RECEIVED, 1);
+        metrics_add(writer->metrics, METRIC_BYTES_RECEIVED, 172);
+        metrics_add(writer->metrics, METRIC_PACKETS_SENT, 1);
+        metrics_add(writer->metrics, METRIC_BYTES_SENT, 172);
+    }
+    return NULL;
+}
+
+/* The metrics one frame updates on the audio and DSP threads, timed while
+ * another thread hammers the network counters, then the cost of a scrape
+ * (one Prometheus exposition of every metric). */
+static void bench_metrics(void)
+{
+    Metrics metrics;
+    metrics_reset(&metrics);
+    MetricsWriter writer = {&metrics, true};
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, metrics_writer_func, &writer) != 0)
+    {
+        perror("pthread_create() failed");
+        return;
+    }
+    BenchTimer update_timer;
+    bench_timer_init(&update_timer, BENCH_FRAMES);
+    JitterBufferStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_FRAMES; i++)
+    {
+        stats.frames_concealed = i / 50;
+        stats.current_delay_ms = 40.0 + i % 7;
+        uint64_t start = monotonic_ns();
+        metrics_add(&metrics, METRIC_AUDIO_CALLBACKS, 1);
+        metrics_store(&metrics, METRIC_PACKETS_LATE, stats.packets_late);
+        metrics_store(&metrics, METRIC_PACKETS_DUPLICATE,
+                      stats.packets_duplicate);
+        metrics_store(&metrics, METRIC_PACKETS_LOST, stats.packets_lost);
+        metrics_store(&metrics, METRIC_JITTER_UNDERRUNS, stats.underruns);
+        metrics_store(&metrics, METRIC_FRAMES_CONCEALED,
+                      stats.frames_concealed);
+        metrics_set(&metrics, METRIC_JITTER_DELAY_MS, stats.current_delay_ms);
+        metrics_set(&metrics, METRIC_JITTER_TARGET_MS, stats.target_delay_ms);
+        metrics_set(&metrics, METRIC_JITTER_MS, stats.jitter_ms);
+        metrics_set(&metrics, METRIC_CLOCK_DRIFT_PPM, stats.drift_ppm);
+        metrics_set(&metrics, METRIC_MIC_LEVEL, 1000.0);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&update_timer, elapsed);
+    }
+
+    BenchTimer scrape_timer;
+    bench_timer_init(&scrape_timer, BENCH_AEC_FRAMES);
+    char text[METRICS_TEXT_MAX];
+    int length = 0;
+    for (int i = 0; i < BENCH_AEC_FRAMES; i++)
+    {
+        uint64_t start = monotonic_ns();
+        length = metrics_format_prometheus(&metrics, text, sizeof(text));
+        bench_timer_add(&scrape_timer, monotonic_ns() - start);
+    }
+    atomic_store(&writer.running, false);
+    pthread_join(tid, NULL);
+
+    char params[64];
+    bench_report("metrics update", &update_timer, FRAMES_PER_BUFFER,
+                 SAMPLE_RATE);
+    snprintf(params, sizeof(params), "\"bytes\":%d", length);
+    bench_report_params("metrics scrape", &scrape_timer, FRAMES_PER_BUFFER,
+                        SAMPLE_RATE, params);
+    bench_timer_destroy(&update_timer);
+    bench_timer_destroy(&scrape_timer);
+}
+
+/* The DSP thread is emulated outside the timed region: after every callback
+ * the capture ring is drained and one playout frame is queued. */
+static void bench_audio_callback(int frame_size)
+{
+    Call call;
+    memset(&call, 0, sizeof(call));
+    atomic_store(&call.is_running, true);
+    rb_init(&call.capture_rb, DSP_RING_FRAMES * frame_size);
+    rb_init(&call.playout_rb, DSP_RING_FRAMES * frame_size);
+    if (frame_notifier_init(&call.dsp_notifier) == -1)
+    {
+        perror("frame_notifier_init() failed");
+        return;
+    }
+    callback_stats_reset(&call.callback_stats);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+    SAMPLE mic[FRAMES_PER_BUFFER];
+    SAMPLE speaker[FRAMES_PER_BUFFER];
+    SAMPLE scratch[FRAMES_PER_BUFFER];
+    uint32_t seed = 5;
+    bench_fill_voice(mic, frame_size, SAMPLE_RATE, 0, &seed);
+    AudioCallbackInfo info;
+    memset(&info, 0, sizeof(info));
+
+    rb_write(&call.playout_rb, mic, frame_size);
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_FRAMES; i++)
+    {
+        uint64_t start = monotonic_ns();
+        call_audio_process(mic, speaker, frame_size, &info, &call);
+        uint64_t elapsed = monotonic_ns() - start;
+        rb_read(&call.capture_rb, scratch, frame_size);
+        rb_write(&call.playout_rb, scratch, frame_size);
+        if (i % 64 == 0)
+            frame_notifier_drain(&call.dsp_notifier);
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&timer, elapsed);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "audio_callback %d", frame_size);
+    bench_report(name, &timer, frame_size, SAMPLE_RATE);
+    bench_timer_destroy(&timer);
+    frame_notifier_destroy(&call.dsp_notifier);
+    rb_destroy(&call.capture_rb);
+    rb_destroy(&call.playout_rb);
+}
+
+/* The per-frame cost of latency instrumentation on one hop: stamping the
+ * frame, taking the stamp on the far side and recording the stage. */
+static void bench_latency_trace(int frame_size)
+{
+    LatencyTrace trace;
+    Latency *latency = (Latency *)malloc(sizeof(Latency));
+    latency_init(latency, false, SAMPLE_RATE);
+    latency_trace_reset(&trace, 0);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+    LatencyStamp stamp;
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_FRAMES; i++)
+    {
+        uint64_t start = monotonic_ns();
+        latency_trace_put(&trace, start, start, frame_size);
+        if (latency_trace_take(&trace, frame_size, &stamp))
+            latency_record(latency, LATENCY_CAPTURE_QUEUE,
+                           latency_since(stamp.queued_ns, monotonic_ns()));
+        uint64_t elapsed = monotonic_ns() - start;
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&timer, elapsed);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "latency_trace %d", frame_size);
+    bench_report(name, &timer, frame_size, SAMPLE_RATE);
+    bench_timer_destroy(&timer);
+    free(latency);
+}
+
+/* What recording costs the DSP thread per frame, with the writer thread
+ * emptying the queue to a scratch file meanwhile. Frames come faster than
+ * real time, so the loop gives the writer time to catch up rather than
+ * timing dropped frames. */
+static void bench_recorder(int frame_size)
+{
+    char path[] = "/tmp/bench_recorder_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+    {
+        perror("mkstemp() failed");
+        return;
+    }
+    close(fd);
+    Recorder recorder;
+    if (recorder_start(&recorder, path, SAMPLE_RATE) == -1)
+    {
+        unlink(path);
+        return;
+    }
+    SAMPLE *near_end = (SAMPLE *)malloc(frame_size * sizeof(SAMPLE));
+    SAMPLE *far_end = (SAMPLE *)malloc(frame_size * sizeof(SAMPLE));
+    uint32_t seed = 1;
+    bench_fill_voice(near_end, frame_size, SAMPLE_RATE, 0, &seed);
+    bench_fill_voice(far_end, frame_size, SAMPLE_RATE, frame_size, &seed);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_FRAMES; i++)
+    {
+        uint64_t start = monotonic_ns();
+        recorder_write(&recorder, near_end, far_end, frame_size);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&timer, elapsed);
+        while (rb_available_write(&recorder.ring) < (size_t)frame_size * 2)
+            usleep(1000);
+    }
+    uint64_t dropped = atomic_load(&recorder.frames_dropped);
+    recorder_stop(&recorder);
+    unlink(path);
+
+    char name[64];
+    char params[64];
+    snprintf(name, sizeof(name), "recorder %d", frame_size);
+    snprintf(params, sizeof(params), "\"frames_dropped\":%llu",
+             (unsigned long long)dropped);
+    bench_report_params(name, &timer, frame_size, SAMPLE_RATE, params);
+    bench_timer_destroy(&timer);
+    free(near_end);
+    free(far_end);
+}
+
+static void bench_jitter_buffer(int frame_size)
+{
+    JitterBufferConfig config;
+    jitter_buffer_config_default(&config);
+    config.frame_size = frame_size;
+    JitterBuffer jb;
+    if (jitter_buffer_init(&jb, &config) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_init() failed\n");
+        return;
+    }
+    PacketPool pool;
+    packet_pool_init(&pool, config.slot_count + 1);
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, &codec_l16, SAMPLE_RATE, frame_size);
+    BenchTimer put_timer, get_timer;
+    bench_timer_init(&put_timer, BENCH_FRAMES);
+    bench_timer_init(&get_timer, BENCH_FRAMES);
+    AudioPacket packet;
+    SAMPLE pcm[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    uint32_t seed = 9;
+    uint64_t frame_ns = 1000000000ull * frame_size / SAMPLE_RATE;
+    uint64_t now = 0;
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_FRAMES; i++)
+    {
+        bench_fill_voice(pcm, frame_size, SAMPLE_RATE, (long)i * frame_size,
+                         &seed);
+        PacketBuffer *buffer = packet_pool_acquire(&pool);
+        packet.sequence_number = i;
+        packet.timestamp = (uint32_t)(i * frame_size);
+        packet.payload_type = codec_l16.payload_type;
+        packet.flags = 0;
+        packet.payload_size = codec_encode(&encoder, pcm, frame_size,
+                                           buffer->data, AUDIO_PAYLOAD_MAX);
+        packet.payload = buffer->data;
+        packet.buffer = buffer;
+        uint64_t jitter = bench_rand(&seed) % (frame_ns / 2);
+        now += frame_ns;
+
+        uint64_t start = monotonic_ns();
+        jitter_buffer_put(&jb, &packet, now + jitter);
+        uint64_t mid = monotonic_ns();
+        jitter_buffer_get(&jb, out, frame_size);
+        uint64_t end = monotonic_ns();
+        packet_buffer_release(buffer);
+        if (i < BENCH_WARMUP_FRAMES)
+            continue;
+        bench_timer_add(&put_timer, mid - start);
+        bench_timer_add(&get_timer, end - mid);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "jitter_buffer_put %d", frame_size);
+    bench_report(name, &put_timer, frame_size, SAMPLE_RATE);
+    snprintf(name, sizeof(name), "jitter_buffer_get %d", frame_size);
+    bench_report(name, &get_timer, frame_size, SAMPLE_RATE);
+    bench_timer_destroy(&put_timer);
+    bench_timer_destroy(&get_timer);
+    codec_encoder_close(&encoder);
+    jitter_buffer_destroy(&jb);
+    packet_pool_destroy(&pool);
+}
+
+/* Far end is synthetic voice; the microphone hears it through a 20 ms,
+ * -10 dB echo path plus a quieter near-end talker. */
+static void bench_aec(int frame_size, int tail_ms)
+{
+    int tail_length_samples = SAMPLE_RATE * tail_ms / 1000;
+    SpeexEchoState *echo_state =
+        speex_echo_state_init(frame_size, tail_length_samples);
+    speex_echo_ctl(echo_state, SPEEX_ECHO_SET_SAMPLING_RATE,
+                   (void *)&(int){SAMPLE_RATE});
+    int echo_delay = SAMPLE_RATE / 50;
+    int total = (BENCH_WARMUP_FRAMES + BENCH_AEC_FRAMES) * frame_size;
+    SAMPLE *far_end = (SAMPLE *)malloc((total + echo_delay) * sizeof(SAMPLE));
+    SAMPLE *near_end = (SAMPLE *)malloc(total * sizeof(SAMPLE));
+    uint32_t seed = 13;
+    memset(far_end, 0, echo_delay * sizeof(SAMPLE));
+    bench_fill_voice(far_end + echo_delay, total, SAMPLE_RATE, 0, &seed);
+    bench_fill_voice(near_end, total, SAMPLE_RATE, 12345, &seed);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_AEC_FRAMES);
+    SAMPLE mic[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_AEC_FRAMES; i++)
+    {
+        const SAMPLE *play = far_end + echo_delay + i * frame_size;
+        const SAMPLE *echo = far_end + i * frame_size;
+        const SAMPLE *talk = near_end + i * frame_size;
+        for (int j = 0; j < frame_size; j++)
+            mic[j] = (SAMPLE)(echo[j] * 0.3f + talk[j] * 0.1f);
+        uint64_t start = monotonic_ns();
+        speex_echo_playback(echo_state, play);
+        speex_echo_capture(echo_state, mic, out);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&timer, elapsed);
+    }
+
+    char name[64];
+    char params[64];
+    snprintf(name, sizeof(name), "speex_aec %d tail %d ms", frame_size,
+             tail_ms);
+    snprintf(params, sizeof(params), "\"tail_ms\":%d", tail_ms);
+    bench_report_params(name, &timer, frame_size, SAMPLE_RATE, params);
+    bench_timer_destroy(&timer);
+    free(far_end);
+    free(near_end);
+    speex_echo_state_destroy(echo_state);
+}
+
+/* The near-end chain as the DSP thread runs it, on the microphone of
+ * bench_aec() plus a little background noise. The timer covers the whole
+ * chain; the stages' own accounting is reported beside it, so the cost of
+ * each stage can be read off against the frame's CPU budget. */
+static void bench_preprocess(const PreprocessCase *chain)
+{
+    int frame = FRAMES_PER_BUFFER;
+    SpeexEchoState *echo_state = NULL;
+    if (chain->aec)
+    {
+        echo_state =
+            speex_echo_state_init(frame, SAMPLE_RATE * TAIL_LENGTH_MS / 1000);
+        speex_echo_ctl(echo_state, SPEEX_ECHO_SET_SAMPLING_RATE,
+                       (void *)&(int){SAMPLE_RATE});
+    }
+    Preprocess pp;
+    if (preprocess_init(&pp, SAMPLE_RATE, frame, echo_state) == -1)
+    {
+        fprintf(stderr, "preprocess_init() failed\n");
+        if (echo_state)
+            speex_echo_state_destroy(echo_state);
+        return;
+    }
+    int echo_delay = SAMPLE_RATE / 50;
+    int total = (BENCH_WARMUP_FRAMES + BENCH_AEC_FRAMES) * frame;
+    SAMPLE *far_end = (SAMPLE *)malloc((total + echo_delay) * sizeof(SAMPLE));
+    SAMPLE *near_end = (SAMPLE *)malloc(total * sizeof(SAMPLE));
+    uint32_t seed = 13;
+    memset(far_end, 0, echo_delay * sizeof(SAMPLE));
+    bench_fill_voice(far_end + echo_delay, total, SAMPLE_RATE, 0, &seed);
+    bench_fill_voice(near_end, total, SAMPLE_RATE, 12345, &seed);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_AEC_FRAMES);
+    SAMPLE mic[FRAMES_PER_BUFFER];
+    SAMPLE clean[FRAMES_PER_BUFFER];
+    SAMPLE send[FRAMES_PER_BUFFER];
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + BENCH_AEC_FRAMES; i++)
+    {
+        /* Warm up on the default chain, then count only the one measured. */
+        if (i == BENCH_WARMUP_FRAMES)
+            preprocess_configure(&pp, &chain->config);
+        const SAMPLE *play = far_end + echo_delay + i * frame;
+        const SAMPLE *echo = far_end + i * frame;
+        const SAMPLE *talk = near_end + i * frame;
+        for (int j = 0; j < frame; j++)
+        {
+            int noise = (int)(bench_rand(&seed) % 201) - 100;
+            mic[j] = (SAMPLE)(echo[j] * 0.3f + talk[j] * 0.1f + noise);
+        }
+        if (echo_state)
+            speex_echo_playback(echo_state, play);
+        uint64_t start = monotonic_ns();
+        preprocess_frame(&pp, mic, clean, send, 1.2f, 150.0f);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&timer, elapsed);
+    }
+
+    uint64_t frames = atomic_load(&pp.stats.frames);
+    double stage_ns[PREPROCESS_STAGE_COUNT];
+    for (int i = 0; i < PREPROCESS_STAGE_COUNT; i++)
+        stage_ns[i] = frames ? (double)atomic_load(
+                                   &pp.stats.stages[i].total_ns) /
+                                   frames
+                             : 0.0;
+    double speech = frames ? 100.0 * atomic_load(&pp.stats.speech_frames) /
+                                 frames
+                           : 0.0;
+    char name[64];
+    char params[256];
+    snprintf(name, sizeof(name), "preprocess %s", chain->name);
+    snprintf(params, sizeof(params),
+             "\"aec_ns\":%.0f,\"speex_ns\":%.0f,\"gate_ns\":%.0f,"
+             "\"gain_ns\":%.0f,\"speech_pct\":%.1f",
+             stage_ns[PREPROCESS_AEC], stage_ns[PREPROCESS_SPEEX],
+             stage_ns[PREPROCESS_GATE], stage_ns[PREPROCESS_GAIN], speech);
+    bench_report_params(name, &timer, frame, SAMPLE_RATE, params);
+    printf("%-32s aec %.1f us, speex %.1f us, gate %.1f us, gain %.1f us; "
+           "speech %.1f%%\n",
+           "", stage_ns[PREPROCESS_AEC] / 1e3,
+           stage_ns[PREPROCESS_SPEEX] / 1e3, stage_ns[PREPROCESS_GATE] / 1e3,
+           stage_ns[PREPROCESS_GAIN] / 1e3, speech);
+    bench_timer_destroy(&timer);
+    free(far_end);
+    free(near_end);
+    preprocess_destroy(&pp);
+    if (echo_state)
+        speex_echo_state_destroy(echo_state);
+}
+
+/* One call's worth of work per format: echo cancellation and gain on every
+ * frame, and PCMU encode, jitter buffer and decode on every packet, timed
+ * per frame. Smaller frames cut buffering latency but cost more packets,
+ * more header bytes on the wire and more wakeups per second. */
+static void bench_format(const FormatCase *format)
+{
+    int rate = format->sample_rate;
+    int frame = format->frame_ms > 0.0
+                    ? (int)lrint(rate * format->frame_ms / 1000.0)
+                    : FRAMES_PER_BUFFER;
+    int packet = frame * format->packet_frames;
+    if (frame > AUDIO_FRAME_MAX || packet > AUDIO_PACKET_SAMPLES_MAX)
+        return;
+    SpeexEchoState *echo_state =
+        speex_echo_state_init(frame, rate * TAIL_LENGTH_MS / 1000);
+    speex_echo_ctl(echo_state, SPEEX_ECHO_SET_SAMPLING_RATE, (void *)&rate);
+    JitterBufferConfig config;
+    jitter_buffer_config_default(&config);
+    config.sample_rate = rate;
+    config.frame_size = packet;
+    JitterBuffer jb;
+    if (jitter_buffer_init(&jb, &config) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_init() failed\n");
+        speex_echo_state_destroy(echo_state);
+        return;
+    }
+    PacketPool pool;
+    packet_pool_init(&pool, config.slot_count + 1);
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, &codec_pcmu, rate, packet);
+    /* Five seconds of every format, so each one covers the same audio. */
+    int frames = 5 * rate / frame;
+    BenchTimer timer;
+    bench_timer_init(&timer, frames);
+    SAMPLE mic[AUDIO_FRAME_MAX];
+    SAMPLE play[AUDIO_FRAME_MAX];
+    SAMPLE clean[AUDIO_FRAME_MAX];
+    SAMPLE send[AUDIO_PACKET_SAMPLES_MAX];
+    uint32_t seed = 17;
+    uint64_t frame_ns = 1000000000ull * frame / rate;
+    uint32_t sequence = 0;
+    int queued = 0, payload_bytes = 0;
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES + frames; i++)
+    {
+        bench_fill_voice(mic, frame, rate, (long)i * frame, &seed);
+        uint64_t start = monotonic_ns();
+        jitter_buffer_get(&jb, play, frame);
+        speex_echo_playback(echo_state, play);
+        speex_echo_capture(echo_state, mic, clean);
+        dsp_apply_gain(clean, send + queued, frame, 1.0f);
+        queued += frame;
+        if (queued == packet)
+        {
+            PacketBuffer *buffer = packet_pool_acquire(&pool);
+            AudioPacket out;
+            out.sequence_number = (uint16_t)sequence;
+            out.timestamp = sequence * (uint32_t)packet;
+            out.payload_type = codec_pcmu.payload_type;
+            out.flags = 0;
+            out.payload_size = codec_encode(&encoder, send, packet,
+                                            buffer->data, AUDIO_PAYLOAD_MAX);
+            out.payload = buffer->data;
+            out.buffer = buffer;
+            /* Loop the packet back, as the peer's would arrive. */
+            jitter_buffer_put(&jb, &out, (uint64_t)(i + 1) * frame_ns);
+            packet_buffer_release(buffer);
+            payload_bytes = out.payload_size;
+            sequence++;
+            queued = 0;
+        }
+        uint64_t elapsed = monotonic_ns() - start;
+        if (i >= BENCH_WARMUP_FRAMES)
+            bench_timer_add(&timer, elapsed);
+    }
+
+    /* IPv4 and UDP headers, then the RTP header, on every packet. */
+    double packets_per_sec = (double)rate / packet;
+    double wire_bytes = packets_per_sec * (28 + 12 + payload_bytes);
+    double buffering_ms = 1000.0 *
+                          (frame * (1 + DSP_PLAYOUT_PREFILL_FRAMES) +
+                           2.0 * packet) /
+                          rate;
+    char name[64];
+    char params[192];
+    snprintf(name, sizeof(name), "format %d Hz %.1f ms x%d", rate,
+             1000.0 * frame / rate, format->packet_frames);
+    snprintf(params, sizeof(params),
+             "\"frame_ms\":%.2f,\"packet_ms\":%.2f,\"packets_per_sec\":%.1f,"
+             "\"wire_bytes_per_sec\":%.0f,\"buffering_ms\":%.2f",
+             1000.0 * frame / rate, 1000.0 * packet / rate, packets_per_sec,
+             wire_bytes, buffering_ms);
+    bench_report_params(name, &timer, frame, rate, params);
+    printf("%-32s %.0f packets/s, %.1f kB/s on the wire, buffering %.1f "
+           "ms\n",
+           "", packets_per_sec, wire_bytes / 1000.0, buffering_ms);
+    bench_timer_destroy(&timer);
+    codec_encoder_close(&encoder);
+    jitter_buffer_destroy(&jb);
+    packet_pool_destroy(&pool);
+    speex_echo_state_destroy(echo_state);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_pipeline");
+    printf("Pipeline benchmark at %d Hz (build FRAMES_PER_BUFFER %d, "
+           "TAIL_LENGTH_MS %d)\n",
+           SAMPLE_RATE, FRAMES_PER_BUFFER, TAIL_LENGTH_MS);
+    int sizes = frame_size_count();
+    for (int i = 0; i < sizes; i++)
+        bench_ring_buffer(frame_sizes[i]);
+    for (int i = 0; i < sizes; i++)
+        bench_audio_callback(frame_sizes[i]);
+    for (int i = 0; i < sizes; i++)
+        bench_latency_trace(frame_sizes[i]);
+    for (int i = 0; i < sizes; i++)
+        bench_recorder(frame_sizes[i]);
+    for (int i = 0; i < sizes; i++)
+        bench_jitter_buffer(frame_sizes[i]);
+    for (int i = 0; i < sizes; i++)
+    {
+        for (size_t t = 0;
+             t < sizeof(tail_lengths_ms) / sizeof(tail_lengths_ms[0]); t++)
+            bench_aec(frame_sizes[i], tail_lengths_ms[t]);
+    }
+    for (size_t i = 0; i < sizeof(chains) / sizeof(chains[0]); i++)
+        bench_preprocess(&chains[i]);
+    bench_metrics();
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+        bench_format(&formats[i]);
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "bench_common.h"
+#include "codec.h"
+#include "jitter_buffer.h"
+#include "packet_pool.h"
+#include "plc.h"
+
+#define BENCH_FRAMES (20000)
+
+static void bench_plc_direct(void)
+{
+    PlcState plc;
+    plc_init(&plc, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    BenchTimer good, first, cont;
+    bench_timer_init(&good, BENCH_FRAMES);
+    bench_timer_init(&first, BENCH_FRAMES);
+    bench_timer_init(&cont, BENCH_FRAMES);
+    SAMPLE frame[FRAMES_PER_BUFFER];
+    uint32_t seed = 1;
+    long offset = 0;
+
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        bench_fill_voice(frame, FRAMES_PER_BUFFER, SAMPLE_RATE, offset, &seed);
+        offset += FRAMES_PER_BUFFER;
+        uint64_t start = monotonic_ns();
+        if (i % 10 == 3)
+        {
+            plc_conceal(&plc, frame, FRAMES_PER_BUFFER);
+            bench_timer_add(&first, monotonic_ns() - start);
+        }
+        else if (i % 10 == 4)
+        {
+            plc_conceal(&plc, frame, FRAMES_PER_BUFFER);
+            bench_timer_add(&cont, monotonic_ns() - start);
+        }
+        else
+        {
+            plc_good_frame(&plc, frame, FRAMES_PER_BUFFER);
+            bench_timer_add(&good, monotonic_ns() - start);
+        }
+    }
+    bench_report("plc_good_frame", &good, FRAMES_PER_BUFFER, SAMPLE_RATE);
+    bench_report("plc_conceal (loss onset)", &first, FRAMES_PER_BUFFER,
+                 SAMPLE_RATE);
+    bench_report("plc_conceal (continued)", &cont, FRAMES_PER_BUFFER,
+                 SAMPLE_RATE);
+    bench_timer_destroy(&good);
+    bench_timer_destroy(&first);
+    bench_timer_destroy(&cont);
+    plc_destroy(&plc);
+}
+
+static void bench_jitter_buffer_with_loss(int loss_percent)
+{
+    JitterBufferConfig config;
+    jitter_buffer_config_default(&config);
+    JitterBuffer jb;
+    jitter_buffer_init(&jb, &config);
+    PacketPool pool;
+    packet_pool_init(&pool, config.slot_count + 1);
+    BenchTimer timer;
+    bench_timer_init(&timer, BENCH_FRAMES);
+    AudioPacket packet;
+    SAMPLE pcm[FRAMES_PER_BUFFER];
+    SAMPLE out[FRAMES_PER_BUFFER];
+    CodecEncoder encoder;
+    codec_encoder_open(&encoder, &codec_l16, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    uint32_t seed = 7;
+    uint64_t now = 0;
+    uint64_t frame_ns = 1000000000ull * FRAMES_PER_BUFFER / SAMPLE_RATE;
+
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        bench_fill_voice(pcm, FRAMES_PER_BUFFER, SAMPLE_RATE,
+                         (long)i * FRAMES_PER_BUFFER, &seed);
+        PacketBuffer *buffer = packet_pool_acquire(&pool);
+        packet.sequence_number = i;
+        packet.timestamp = (uint32_t)(i * FRAMES_PER_BUFFER);
+        packet.payload_type = codec_l16.payload_type;
+        packet.flags = 0;
+        packet.payload_size = codec_encode(&encoder, pcm, FRAMES_PER_BUFFER,
+                                           buffer->data, AUDIO_PAYLOAD_MAX);
+        packet.payload = buffer->data;
+        packet.buffer = buffer;
+        if ((int)(bench_rand(&seed) % 100) >= loss_percent)
+            jitter_buffer_put(&jb, &packet, now);
+        packet_buffer_release(buffer);
+        now += frame_ns;
+        if (i < config.initial_delay_frames)
+            continue;
+        uint64_t start = monotonic_ns();
+        jitter_buffer_get(&jb, out, FRAMES_PER_BUFFER);
+        bench_timer_add(&timer, monotonic_ns() - start);
+    }
+
+    JitterBufferStats stats;
+    jitter_buffer_get_stats(&jb, &stats);
+    char name[64];
+    snprintf(name, sizeof(name), "jitter_buffer_get %d%% loss", loss_percent);
+    bench_report(name, &timer, FRAMES_PER_BUFFER, SAMPLE_RATE);
+    printf("%-32s concealed %llu of %d frames\n", "",
+           (unsigned long long)stats.frames_concealed, timer.count);
+    bench_timer_destroy(&timer);
+    codec_encoder_close(&encoder);
+    jitter_buffer_destroy(&jb);
+    packet_pool_destroy(&pool);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_plc");
+    printf("PLC benchmark: %d frames/packet at %d Hz\n", FRAMES_PER_BUFFER,
+           SAMPLE_RATE);
+    bench_plc_direct();
+    bench_jitter_buffer_with_loss(0);
+    bench_jitter_buffer_with_loss(5);
+    bench_jitter_buffer_with_loss(20);
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "bench_common.h"
+#include "relay.h"
+#include "relay_load.h"
+
+#define BENCH_DURATION_S (2.0)
+#define BENCH_LOAD_THREADS (2)
+#define BENCH_CHURN_ROUNDS (8)
+#define BENCH_CHURN_DURATION_S (0.2)
+/* Longer than relay_load waits between joining and sending, and shorter
+ * than the gap between rounds, so a round finds the members of the one
+ * before it timed out. */
+#define BENCH_CHURN_TIMEOUT_MS (300)
+#define BENCH_CHURN_PAUSE_MS (300)
+
+static double thread_cpu_seconds(pthread_t thread)
+{
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) != 0 ||
+        clock_gettime(clock, &ts) == -1)
+        return 0.0;
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Runs the load generator against an in-process relay. The offered load is
+ * fixed, so the rate each worker sustains per second of its own CPU time is
+ * what shows how far one core would go. */
+static void bench_relay(int workers, int calls, int members)
+{
+    RelayConfig config;
+    relay_config_default(&config);
+    config.port = 0;
+    config.workers = workers;
+    config.rooms = calls;
+    Relay relay;
+    if (relay_start(&relay, &config) == -1)
+    {
+        fprintf(stderr, "cannot start the relay\n");
+        return;
+    }
+
+    RelayLoadConfig load;
+    relay_load_config_default(&load);
+    load.relay.sin_port = htons(relay.port);
+    load.calls = calls;
+    load.members = members;
+    load.threads = BENCH_LOAD_THREADS;
+    load.duration_s = BENCH_DURATION_S;
+    RelayLoadStats stats;
+    int result = relay_load_run(&load, &stats);
+
+    double cpu_seconds = 0.0;
+    for (int i = 0; i < relay.config.workers; i++)
+        cpu_seconds += thread_cpu_seconds(relay.workers[i].tid);
+    relay_stop(&relay);
+    RelayWorkerStats total;
+    relay_total_stats(&relay, &total);
+    relay_destroy(&relay);
+    if (result == -1)
+        return;
+
+    uint64_t forwarded = atomic_load(&total.packets_out);
+    double seconds = stats.seconds;
+    double per_core = forwarded / seconds / workers;
+    double per_cpu_second = cpu_seconds > 0.0 ? forwarded / cpu_seconds : 0.0;
+    double loss = stats.packets_expected > stats.packets_received
+                      ? 100.0 *
+                            (double)(stats.packets_expected -
+                                     stats.packets_received) /
+                            (double)stats.packets_expected
+                      : 0.0;
+    double fwd_p50 = histogram_percentile(&total.latency, 0.50) / 1000.0;
+    double fwd_p99 = histogram_percentile(&total.latency, 0.99) / 1000.0;
+    double e2e_p50 = histogram_percentile(&stats.latency, 0.50) / 1000.0;
+    double e2e_p99 = histogram_percentile(&stats.latency, 0.99) / 1000.0;
+
+    char name[64];
+    snprintf(name, sizeof(name), "relay %d workers, %d x %d", workers, calls,
+             members);
+    printf("%-32s %8.0f pkt/s/core  %9.0f pkt/cpu-s  fwd p50 %6.1f p99 %7.1f "
+           "us  e2e p50 %6.1f p99 %7.1f us  %.3f%% lost\n",
+           name, per_core, per_cpu_second, fwd_p50, fwd_p99, e2e_p50, e2e_p99,
+           loss);
+    bench_json_record(name,
+                      "\"workers\":%d,\"calls\":%d,\"members\":%d,"
+                      "\"packets_out\":%llu,\"pps_per_core\":%.1f,"
+                      "\"pps_per_cpu_second\":%.1f,\"forward_p50_us\":%.2f,"
+                      "\"forward_p99_us\":%.2f,\"e2e_p50_us\":%.2f,"
+                      "\"e2e_p99_us\":%.2f,\"loss_pct\":%.4f",
+                      workers, calls, members, (unsigned long long)forwarded,
+                      per_core, per_cpu_second, fwd_p50, fwd_p99, e2e_p50,
+                      e2e_p99, loss);
+}
+
+/* Calls come and go: every round joins from new sockets, and every other
+ * round moves on to new room numbers, so rooms fill with members that
+ * have timed out and the rooms and addresses used come to several times
+ * what the tables are sized for. Joins are only refused, and media lost,
+ * if places are not given back. */
+static void bench_relay_churn(int calls, int members)
+{
+    RelayConfig config;
+    relay_config_default(&config);
+    config.port = 0;
+    config.workers = 2;
+    config.rooms = calls;
+    config.member_timeout_ms = BENCH_CHURN_TIMEOUT_MS;
+    Relay relay;
+    if (relay_start(&relay, &config) == -1)
+    {
+        fprintf(stderr, "cannot start the relay\n");
+        return;
+    }
+
+    RelayLoadConfig load;
+    relay_load_config_default(&load);
+    load.relay.sin_port = htons(relay.port);
+    load.calls = calls;
+    load.members = members;
+    load.threads = BENCH_LOAD_THREADS;
+    load.duration_s = BENCH_CHURN_DURATION_S;
+    uint64_t expected = 0;
+    uint64_t received = 0;
+    int rounds = 0;
+    for (; rounds < BENCH_CHURN_ROUNDS; rounds++)
+    {
+        RelayLoadStats stats;
+        load.first_room = 1 + (uint32_t)(rounds / 2 * calls);
+        if (relay_load_run(&load, &stats) == -1)
+            break;
+        expected += stats.packets_expected;
+        received += stats.packets_received;
+        struct timespec pause = {0, BENCH_CHURN_PAUSE_MS * 1000000L};
+        nanosleep(&pause, NULL);
+    }
+    relay_stop(&relay);
+    RelayWorkerStats total;
+    relay_total_stats(&relay, &total);
+    relay_destroy(&relay);
+    if (rounds < BENCH_CHURN_ROUNDS)
+        return;
+
+    int room_numbers = (rounds + 1) / 2 * calls;
+    int addresses = rounds * calls * members;
+    double loss = expected > received
+                      ? 100.0 * (double)(expected - received) /
+                            (double)expected
+                      : 0.0;
+    char name[64];
+    snprintf(name, sizeof(name), "relay churn, %d x %d", calls, members);
+    printf("%-32s %d rounds, %d rooms and %d addresses for a table of %d "
+           "rooms: %llu joins, %llu replaced, %llu rejected, %.3f%% lost\n",
+           name, rounds, room_numbers, addresses, calls,
+           (unsigned long long)total.joins,
+           (unsigned long long)total.reclaimed,
+           (unsigned long long)total.rejected, loss);
+    bench_json_record(name,
+                      "\"rounds\":%d,\"calls\":%d,\"members\":%d,"
+                      "\"room_numbers\":%d,\"addresses\":%d,\"joins\":%llu,"
+                      "\"reclaimed\":%llu,\"rejected\":%llu,"
+                      "\"loss_pct\":%.4f",
+                      rounds, calls, members, room_numbers, addresses,
+                      (unsigned long long)total.joins,
+                      (unsigned long long)total.reclaimed,
+                      (unsigned long long)total.rejected, loss);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_relay");
+    static const int workers[] = {1, 2, 4};
+    printf("Relay benchmark: calls x members on loopback, one packet per %d ms "
+           "per member, %.0f s per case\n",
+           RELAY_LOAD_DEFAULT_PTIME_MS, BENCH_DURATION_S);
+    for (size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); i++)
+        bench_relay(workers[i], 1000, 2);
+    bench_relay(2, 250, 4);
+    bench_relay_churn(64, RELAY_ROOM_MEMBERS_MAX);
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "audio_packet.h"
+#include "bench_common.h"
+#include "codec.h"
+#include "comfort_noise.h"
+#include "vad.h"
+
+#define BENCH_SECONDS (120)
+#define BENCH_TALK_MS (1004)
+#define BENCH_PAUSE_MS (1587)
+#define BENCH_NOISE_RMS (60.0)
+#define BENCH_FLOOR_RMS (180.0f)
+#define BENCH_CN_REFRESH_MS (500)
+#define BENCH_CN_LEVEL_DELTA (3)
+/* IPv4 + UDP + RTP headers on every packet. */
+#define BENCH_PACKET_OVERHEAD (20 + 8 + 12)
+
+/* A one-sided conversation: talkspurts and pauses of randomized length,
+ * with the means of ITU-T P.59, over constant background noise.
+ * talking[i] is the ground truth for frame i. */
+static void fill_conversation(SAMPLE *pcm, bool *talking, int frames,
+                              int frame_size)
+{
+    uint32_t seed = 7;
+    int frame = 0;
+    bool talk = false;
+    while (frame < frames)
+    {
+        int ms = talk ? BENCH_TALK_MS : BENCH_PAUSE_MS;
+        ms = ms / 2 + (int)(bench_rand(&seed) % (uint32_t)ms);
+        int length = ms * SAMPLE_RATE / 1000 / frame_size;
+        for (int i = 0; i < length && frame < frames; i++, frame++)
+        {
+            SAMPLE *out = pcm + (size_t)frame * frame_size;
+            talking[frame] = talk;
+            if (talk)
+                bench_fill_voice(out, frame_size, SAMPLE_RATE,
+                                 (long)frame * frame_size, &seed);
+            for (int j = 0; j < frame_size; j++)
+            {
+                double noise =
+                    ((double)(bench_rand(&seed) & 0xffff) - 32768.0) / 32768.0;
+                double v = (talk ? out[j] : 0.0) +
+                           BENCH_NOISE_RMS * sqrt(3.0) * noise;
+                out[j] = (SAMPLE)v;
+            }
+        }
+        talk = !talk;
+    }
+}
+
+static void bench_dtx(const Codec *codec, const SAMPLE *pcm,
+                      const bool *talking, int frames, int frame_size)
+{
+    CodecEncoder enc;
+    if (codec_encoder_open(&enc, codec, SAMPLE_RATE, frame_size) == -1)
+    {
+        printf("%-10s unsupported\n", codec->name);
+        return;
+    }
+    uint8_t payload[AUDIO_PAYLOAD_MAX];
+    uint64_t full_packets = 0, full_bytes = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        int bytes = codec_encode(&enc, pcm + (size_t)i * frame_size,
+                                 frame_size, payload, sizeof(payload));
+        full_packets++;
+        full_bytes += BENCH_PACKET_OVERHEAD + (bytes > 0 ? bytes : 0);
+    }
+    codec_encoder_close(&enc);
+    codec_encoder_open(&enc, codec, SAMPLE_RATE, frame_size);
+
+    /* The same policy as the network thread: speech frames are encoded,
+     * silence sends a comfort noise packet when it begins, when its level
+     * moves and otherwise every BENCH_CN_REFRESH_MS. */
+    Vad vad;
+    vad_init(&vad, SAMPLE_RATE, frame_size);
+    BenchTimer timer;
+    bench_timer_init(&timer, frames);
+    int refresh_frames = BENCH_CN_REFRESH_MS * SAMPLE_RATE / 1000 / frame_size;
+    bool silent = false;
+    int since_cn = 0;
+    uint8_t cn_level = 0;
+    uint64_t packets = 0, bytes_sent = 0, cn_packets = 0;
+    int speech_missed = 0, speech_frames = 0, noise_sent = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        const SAMPLE *frame = pcm + (size_t)i * frame_size;
+        uint64_t start = monotonic_ns();
+        bool active = vad_process(&vad, frame, frame_size, BENCH_FLOOR_RMS);
+        bench_timer_add(&timer, monotonic_ns() - start);
+        speech_frames += talking[i];
+        speech_missed += talking[i] && !active;
+        noise_sent += !talking[i] && active;
+        int bytes = -1;
+        if (active)
+        {
+            silent = false;
+            bytes = codec_encode(&enc, frame, frame_size, payload,
+                                 sizeof(payload));
+        }
+        else
+        {
+            uint8_t level = comfort_noise_level(vad_noise_rms(&vad));
+            if (!silent || abs((int)level - (int)cn_level) >= BENCH_CN_LEVEL_DELTA ||
+                ++since_cn >= refresh_frames)
+            {
+                silent = true;
+                since_cn = 0;
+                cn_level = level;
+                cn_packets++;
+                bytes = comfort_noise_encode(vad_noise_rms(&vad), payload,
+                                             sizeof(payload));
+            }
+        }
+        if (bytes < 0)
+            continue;
+        packets++;
+        bytes_sent += BENCH_PACKET_OVERHEAD + bytes;
+    }
+    codec_encoder_close(&enc);
+
+    double seconds = (double)frames * frame_size / SAMPLE_RATE;
+    double packet_ratio = (double)packets / full_packets;
+    double byte_ratio = (double)bytes_sent / full_bytes;
+    char name[64];
+    char params[256];
+    snprintf(name, sizeof(name), "vad dtx %s", codec->name);
+    snprintf(params, sizeof(params),
+             "\"codec\":\"%s\",\"packets_per_sec\":%.1f,"
+             "\"full_packets_per_sec\":%.1f,\"kbps\":%.1f,\"full_kbps\":%.1f,"
+             "\"cn_packets\":%llu,\"speech_missed_pct\":%.2f,"
+             "\"noise_sent_pct\":%.2f",
+             codec->name, packets / seconds, full_packets / seconds,
+             bytes_sent * 8.0 / seconds / 1000.0,
+             full_bytes * 8.0 / seconds / 1000.0,
+             (unsigned long long)cn_packets,
+             100.0 * speech_missed / speech_frames,
+             100.0 * noise_sent / (frames - speech_frames));
+    bench_report_params(name, &timer, frame_size, SAMPLE_RATE, params);
+    printf("%-32s %.1f -> %.1f packets/s (%.0f%%), %.1f -> %.1f kbps "
+           "(%.0f%%), speech missed %.2f%%, noise sent %.2f%%\n",
+           "", full_packets / seconds, packets / seconds, 100.0 * packet_ratio,
+           full_bytes * 8.0 / seconds / 1000.0,
+           bytes_sent * 8.0 / seconds / 1000.0, 100.0 * byte_ratio,
+           100.0 * speech_missed / speech_frames,
+           100.0 * noise_sent / (frames - speech_frames));
+    bench_timer_destroy(&timer);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init(argc, argv, "bench_vad");
+    int frame_size = FRAMES_PER_BUFFER;
+    int frames = BENCH_SECONDS * SAMPLE_RATE / frame_size;
+    SAMPLE *pcm = (SAMPLE *)malloc((size_t)frames * frame_size * sizeof(SAMPLE));
+    bool *talking = (bool *)malloc(frames * sizeof(bool));
+    fill_conversation(pcm, talking, frames, frame_size);
+    printf("VAD/DTX benchmark: %d s conversation, IP/UDP/RTP overhead "
+           "included\n",
+           BENCH_SECONDS);
+    for (int i = 0; i < codec_count(); i++)
+        bench_dtx(codec_at(i), pcm, talking, frames, frame_size);
+    free(talking);
+    free(pcm);
+    bench_finish();
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include "audio_backend.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void audio_backend_config_default(AudioBackendConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->source = AUDIO_SOURCE_PORTAUDIO;
+    config->sink = AUDIO_SINK_PORTAUDIO;
+    config->clock = AUDIO_CLOCK_REALTIME;
+    config->tone_hz = 440.0;
+    config->sample_rate = SAMPLE_RATE;
+    config->frame_size = FRAMES_PER_BUFFER;
+}
+
+int audio_backend_parse_source(AudioBackendConfig *config, const char *spec)
+{
+    if (strcmp(spec, "pa") == 0)
+        config->source = AUDIO_SOURCE_PORTAUDIO;
+    else if (strcmp(spec, "silence") == 0)
+        config->source = AUDIO_SOURCE_SILENCE;
+    else if (strcmp(spec, "tone") == 0)
+        config->source = AUDIO_SOURCE_TONE;
+    else if (strncmp(spec, "tone:", 5) == 0)
+    {
+        config->source = AUDIO_SOURCE_TONE;
+        config->tone_hz = atof(spec + 5);
+    }
+    else if (strncmp(spec, "wav:", 4) == 0 && spec[4] != '\0')
+    {
+        config->source = AUDIO_SOURCE_WAV;
+        config->source_path = spec + 4;
+    }
+    else if (strcmp(spec, "loop") == 0)
+        config->source = AUDIO_SOURCE_LOOP;
+    else
+        return -1;
+    return 0;
+}
+
+int audio_backend_parse_sink(AudioBackendConfig *config, const char *spec)
+{
+    if (strcmp(spec, "pa") == 0)
+        config->sink = AUDIO_SINK_PORTAUDIO;
+    else if (strcmp(spec, "null") == 0)
+        config->sink = AUDIO_SINK_NULL;
+    else if (strncmp(spec, "wav:", 4) == 0 && spec[4] != '\0')
+    {
+        config->sink = AUDIO_SINK_WAV;
+        config->sink_path = spec + 4;
+    }
+    else
+        return -1;
+    return 0;
+}
+
+int audio_backend_set_format(AudioBackendConfig *config, int sample_rate,
+                             double frame_ms)
+{
+    static const int rates[] = {8000, 16000, 32000, 44100, 48000};
+    bool known = false;
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+        known = known || rates[i] == sample_rate;
+    if (!known || (frame_ms != 0.0 && (frame_ms < AUDIO_FRAME_MS_MIN ||
+                                       frame_ms > AUDIO_FRAME_MS_MAX)))
+        return -1;
+    config->sample_rate = sample_rate;
+    if (frame_ms != 0.0)
+        config->frame_size = (int)lrint(sample_rate * frame_ms / 1000.0);
+    else if (sample_rate == SAMPLE_RATE)
+        config->frame_size = FRAMES_PER_BUFFER;
+    else
+        config->frame_size = sample_rate / 100;
+    return 0;
+}
+
+static int pa_stream_callback(const void *inputBuffer, void *outputBuffer,
+                              unsigned long framesPerBuffer,
+                              const PaStreamCallbackTimeInfo *timeInfo,
+                              PaStreamCallbackFlags statusFlags, void *userData)
+{
+    AudioBackend *backend = (AudioBackend *)userData;
+    AudioCallbackInfo info;
+    info.input_adc_time = timeInfo ? timeInfo->inputBufferAdcTime : 0.0;
+    info.current_time = timeInfo ? timeInfo->currentTime : 0.0;
+    info.output_dac_time = timeInfo ? timeInfo->outputBufferDacTime : 0.0;
+    info.status = 0;
+    if (statusFlags & paInputUnderflow)
+        info.status |= AUDIO_STATUS_INPUT_UNDERFLOW;
+    if (statusFlags & paInputOverflow)
+        info.status |= AUDIO_STATUS_INPUT_OVERFLOW;
+    if (statusFlags & paOutputUnderflow)
+        info.status |= AUDIO_STATUS_OUTPUT_UNDERFLOW;
+    if (statusFlags & paOutputOverflow)
+        info.status |= AUDIO_STATUS_OUTPUT_OVERFLOW;
+    backend->process((const SAMPLE *)inputBuffer, (SAMPLE *)outputBuffer,
+                     (int)framesPerBuffer, &info, backend->user_data);
+    return paContinue;
+}
+
+static void read_source(AudioBackend *backend, SAMPLE *in, int frames)
+{
+    int got = 0;
+    switch (backend->config.source)
+    {
+    case AUDIO_SOURCE_TONE:
+    {
+        double step = 2.0 * M_PI * backend->config.tone_hz /
+                      backend->config.sample_rate;
+        for (int i = 0; i < frames; i++)
+        {
+            in[i] = (SAMPLE)lrint(8000.0 * sin(backend->tone_phase));
+            backend->tone_phase += step;
+            if (backend->tone_phase > 2.0 * M_PI)
+                backend->tone_phase -= 2.0 * M_PI;
+        }
+        got = frames;
+        break;
+    }
+    case AUDIO_SOURCE_WAV:
+        got = wav_reader_read(&backend->reader, in, frames);
+        if (got < frames && backend->config.max_frames == 0)
+            atomic_store(&backend->finished, true);
+        break;
+    default:
+        break;
+    }
+    if (got < frames)
+        memset(in + got, 0, (frames - got) * sizeof(SAMPLE));
+}
+
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+static void *file_clock_thread(void *data)
+{
+    AudioBackend *backend = (AudioBackend *)data;
+    int frames = backend->config.frame_size;
+    SAMPLE in[AUDIO_FRAME_MAX];
+    SAMPLE out[AUDIO_FRAME_MAX];
+    double period_s = (double)frames / backend->config.sample_rate;
+    long period_ns = (long)(1e9 * period_s /
+                            (1.0 + backend->config.clock_skew_ppm * 1e-6));
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    memset(out, 0, sizeof(out));
+
+    while (atomic_load(&backend->running))
+    {
+        /* A loop feeds what was just played back in, as a speaker
+         * facing the microphone would. */
+        if (backend->config.source == AUDIO_SOURCE_LOOP)
+            memcpy(in, out, frames * sizeof(SAMPLE));
+        else
+            read_source(backend, in, frames);
+        AudioCallbackInfo info;
+        info.current_time = backend->frames_processed * period_s;
+        info.input_adc_time = info.current_time;
+        info.output_dac_time = info.current_time;
+        info.status = 0;
+        backend->process(in, out, frames, &info, backend->user_data);
+        if (backend->config.sink == AUDIO_SINK_WAV)
+            wav_writer_write(&backend->writer, out, frames);
+        backend->frames_processed++;
+        if (backend->config.max_frames &&
+            backend->frames_processed * frames >=
+                backend->config.max_frames)
+            break;
+
+        if (backend->config.clock == AUDIO_CLOCK_REALTIME)
+        {
+            timespec_add_ns(&deadline, period_ns);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                                   NULL) == EINTR)
+            {
+            }
+        }
+    }
+    atomic_store(&backend->finished, true);
+    return NULL;
+}
+
+int audio_backend_open(AudioBackend *backend, const AudioBackendConfig *config,
+                       AudioProcessFn process, void *user_data)
+{
+    memset(backend, 0, sizeof(*backend));
+    backend->config = *config;
+    backend->process = process;
+    backend->user_data = user_data;
+    atomic_init(&backend->running, false);
+    atomic_init(&backend->finished, false);
+
+    bool pa_source = config->source == AUDIO_SOURCE_PORTAUDIO;
+    bool pa_sink = config->sink == AUDIO_SINK_PORTAUDIO;
+    if (pa_source != pa_sink)
+    {
+        fprintf(stderr, "[AUDIO] PortAudio is full duplex: use it for both "
+                        "input and output or for neither\n");
+        return -1;
+    }
+
+    if (pa_source)
+    {
+        PaError err = Pa_Initialize();
+        if (err != paNoError)
+        {
+            fprintf(stderr, "PortAudio error: %s\n", Pa_GetErrorText(err));
+            return -1;
+        }
+        backend->pa_initialized = true;
+        err = Pa_OpenDefaultStream(&backend->stream, NUM_CHANNELS, NUM_CHANNELS,
+                                   PA_SAMPLE_TYPE, config->sample_rate,
+                                   config->frame_size, pa_stream_callback,
+                                   backend);
+        if (err != paNoError)
+        {
+            fprintf(stderr, "PortAudio error: %s\n", Pa_GetErrorText(err));
+            audio_backend_close(backend);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (config->source == AUDIO_SOURCE_WAV)
+    {
+        if (wav_reader_open(&backend->reader, config->source_path) == -1)
+        {
+            fprintf(stderr, "[AUDIO] Cannot read 16-bit PCM WAV '%s'\n",
+                    config->source_path);
+            return -1;
+        }
+        if (backend->reader.sample_rate != config->sample_rate)
+            fprintf(stderr, "[AUDIO] Warning: '%s' is %d Hz, playing as %d Hz\n",
+                    config->source_path, backend->reader.sample_rate,
+                    config->sample_rate);
+    }
+    if (config->sink == AUDIO_SINK_WAV &&
+        wav_writer_open(&backend->writer, config->sink_path,
+                        config->sample_rate, NUM_CHANNELS) == -1)
+    {
+        fprintf(stderr, "[AUDIO] Cannot write '%s'\n", config->sink_path);
+        wav_reader_close(&backend->reader);
+        return -1;
+    }
+    return 0;
+}
+
+int audio_backend_start(AudioBackend *backend)
+{
+    if (backend->stream)
+    {
+        PaError err = Pa_StartStream(backend->stream);
+        if (err != paNoError)
+        {
+            fprintf(stderr, "PortAudio error: %s\n", Pa_GetErrorText(err));
+            return -1;
+        }
+        atomic_store(&backend->running, true);
+        return 0;
+    }
+    atomic_store(&backend->running, true);
+    if (pthread_create(&backend->thread, NULL, file_clock_thread, backend) != 0)
+    {
+        atomic_store(&backend->running, false);
+        return -1;
+    }
+    backend->thread_started = true;
+    return 0;
+}
+
+void audio_backend_stop(AudioBackend *backend)
+{
+    if (!atomic_exchange(&backend->running, false))
+        return;
+    if (backend->stream)
+    {
+        PaError err = Pa_StopStream(backend->stream);
+        if (err != paNoError)
+            fprintf(stderr, "PortAudio error: %s\n", Pa_GetErrorText(err));
+    }
+    if (backend->thread_started)
+    {
+        pthread_join(backend->thread, NULL);
+        backend->thread_started = false;
+    }
+}
+
+void audio_backend_close(AudioBackend *backend)
+{
+    audio_backend_stop(backend);
+    if (backend->stream)
+    {
+        PaError err = Pa_CloseStream(backend->stream);
+        if (err != paNoError)
+            fprintf(stderr, "PortAudio error: %s\n", Pa_GetErrorText(err));
+        backend->stream = NULL;
+    }
+    if (backend->pa_initialized)
+    {
+        Pa_Terminate();
+        backend->pa_initialized = false;
+    }
+    wav_reader_close(&backend->reader);
+    wav_writer_close(&backend->writer);
+}
+
+bool audio_backend_finished(AudioBackend *backend)
+{
+    return atomic_load(&backend->finished);
+}
@@ -0,0 +1,103 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include <portaudio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "audio_config.h"
+#include "wav_file.h"
+
+typedef enum
+{
+    AUDIO_SOURCE_PORTAUDIO,
+    AUDIO_SOURCE_SILENCE,
+    AUDIO_SOURCE_TONE,
+    AUDIO_SOURCE_WAV,
+    AUDIO_SOURCE_LOOP,
+} AudioSourceKind;
+
+typedef enum
+{
+    AUDIO_SINK_PORTAUDIO,
+    AUDIO_SINK_NULL,
+    AUDIO_SINK_WAV,
+} AudioSinkKind;
+
+typedef enum
+{
+    AUDIO_CLOCK_REALTIME,
+    AUDIO_CLOCK_FAST,
+} AudioClockMode;
+
+#define AUDIO_STATUS_INPUT_UNDERFLOW (0x1)
+#define AUDIO_STATUS_INPUT_OVERFLOW (0x2)
+#define AUDIO_STATUS_OUTPUT_UNDERFLOW (0x4)
+#define AUDIO_STATUS_OUTPUT_OVERFLOW (0x8)
+
+typedef struct
+{
+    AudioSourceKind source;
+    AudioSinkKind sink;
+    AudioClockMode clock;
+    const char *source_path;
+    const char *sink_path;
+    double tone_hz;
+    unsigned long long max_frames;
+    /* A realtime file clock this many ppm fast (or, negative, slow), like a
+     * sound card whose crystal is off. */
+    double clock_skew_ppm;
+    /* Samples per second, and per callback: the frame every stage up to
+     * the packetizer works in. */
+    int sample_rate;
+    int frame_size;
+} AudioBackendConfig;
+
+/* Times are in seconds on the backend's own clock, mirroring
+ * PaStreamCallbackTimeInfo; status uses the AUDIO_STATUS_* bits. */
+typedef struct
+{
+    double input_adc_time;
+    double current_time;
+    double output_dac_time;
+    unsigned long status;
+} AudioCallbackInfo;
+
+typedef void (*AudioProcessFn)(const SAMPLE *in, SAMPLE *out, int frames,
+                               const AudioCallbackInfo *info, void *user_data);
+
+typedef struct
+{
+    AudioBackendConfig config;
+    AudioProcessFn process;
+    void *user_data;
+    PaStream *stream;
+    bool pa_initialized;
+    pthread_t thread;
+    bool thread_started;
+    atomic_bool running;
+    atomic_bool finished;
+    WavReader reader;
+    WavWriter writer;
+    double tone_phase;
+    unsigned long long frames_processed;
+} AudioBackend;
+
+void audio_backend_config_default(AudioBackendConfig *config);
+int audio_backend_parse_source(AudioBackendConfig *config, const char *spec);
+int audio_backend_parse_sink(AudioBackendConfig *config, const char *spec);
+/* Sets the rate, one of 8, 16, 32, 44.1 and 48 kHz, and frames of frame_ms
+ * (AUDIO_FRAME_MS_MIN to AUDIO_FRAME_MS_MAX) rounded to whole samples.
+ * frame_ms 0 keeps FRAMES_PER_BUFFER at the default rate and means 10 ms
+ * at any other. Returns -1 if either is out of range. */
+int audio_backend_set_format(AudioBackendConfig *config, int sample_rate,
+                             double frame_ms);
+int audio_backend_open(AudioBackend *backend, const AudioBackendConfig *config,
+                       AudioProcessFn process, void *user_data);
+int audio_backend_start(AudioBackend *backend);
+void audio_backend_stop(AudioBackend *backend);
+void audio_backend_close(AudioBackend *backend);
+bool audio_backend_finished(AudioBackend *backend);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef AUDIO_CONFIG_H
+#define AUDIO_CONFIG_H
+
+/* The default format. The sample rate and the frame size are chosen when
+ * the audio backend opens (AudioBackendConfig), within the bounds below. */
+#define SAMPLE_RATE (44100)
+#define NUM_CHANNELS (1)
+#ifndef FRAMES_PER_BUFFER
+#define FRAMES_PER_BUFFER (512)
+#endif
+#define PA_SAMPLE_TYPE paInt16
+typedef short SAMPLE;
+#define RING_BUFFER_MILLISECONDS (300)
+#define RING_BUFFER_SIZE(rate) (((rate) * RING_BUFFER_MILLISECONDS) / 1000)
+#ifndef TAIL_LENGTH_MS
+#define TAIL_LENGTH_MS (120)
+#endif
+
+/* Runtime formats: 8 to 48 kHz, frames of 2.5 to 20 ms and packets of up
+ * to 40 ms. Buffers sized by the bounds also hold the default frame. */
+#define AUDIO_RATE_MAX (48000)
+#define AUDIO_FRAME_MS_MIN (2.5)
+#define AUDIO_FRAME_MS_MAX (20)
+#define AUDIO_PACKET_MS_MAX (40)
+#define AUDIO_FRAME_MAX                                                        \
+    (FRAMES_PER_BUFFER > AUDIO_RATE_MAX * AUDIO_FRAME_MS_MAX / 1000            \
+         ? FRAMES_PER_BUFFER                                                   \
+         : AUDIO_RATE_MAX * AUDIO_FRAME_MS_MAX / 1000)
+#define AUDIO_PACKET_SAMPLES_MAX                                               \
+    (FRAMES_PER_BUFFER > AUDIO_RATE_MAX * AUDIO_PACKET_MS_MAX / 1000           \
+         ? FRAMES_PER_BUFFER                                                   \
+         : AUDIO_RATE_MAX * AUDIO_PACKET_MS_MAX / 1000)
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef AUDIO_PACKET_H
+#define AUDIO_PACKET_H
+
+#include <stdint.h>
+
+#include "audio_config.h"
+
+/* Room for the longest packet in the widest codec (L16). */
+#define AUDIO_PAYLOAD_MAX (AUDIO_PACKET_SAMPLES_MAX * (int)sizeof(SAMPLE))
+#define AUDIO_PACKET_REDUNDANT (1u << 0)
+
+struct PacketBuffer;
+
+/* A media frame as held by the jitter buffer. On the wire it travels as an
+ * RTP packet (rtp.h); sequence_number is the receiver's extended 32-bit
+ * sequence number. A frame rebuilt from the redundant copy in a later packet
+ * is flagged AUDIO_PACKET_REDUNDANT and carries that packet's number. The
+ * payload is not copied: it points into the pooled datagram buffer it
+ * arrived in (packet_pool.h). Its length, and the number of samples it
+ * decodes to, follow the sender's packet time. */
+typedef struct
+{
+    uint32_t sequence_number;
+    uint32_t timestamp;
+    uint8_t payload_type;
+    uint8_t flags;
+    uint16_t payload_size;
+    const uint8_t *payload;
+    struct PacketBuffer *buffer;
+} AudioPacket;
+
+#endif
@@ -0,0 +1,1659 @@
+#include "call.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "dsp_kernels.h"
+#include "rt_thread.h"
+#include "time_util.h"
+#include "unpack.h"
+
+#define LOCKSTEP_RECV_ATTEMPTS (5)
+#define LOCKSTEP_RECV_TIMEOUT_MS (100)
+
+void call_config_default(CallConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->codec = codec_at(0);
+    jitter_buffer_config_default(&config->jb_config);
+    audio_backend_config_default(&config->audio);
+    config->aec_enabled = true;
+    config->aec_tail_ms = TAIL_LENGTH_MS;
+    config->packet_frames = 1;
+    config->dtx_enabled = true;
+    config->fec_depth = RED_DEPTH_AUTO;
+    impair_config_default(&config->impair);
+    config->conference_speakers = MIXER_DEFAULT_SPEAKERS;
+    config->capture_time = true;
+    preprocess_config_default(&config->preprocess);
+    config->gain_factor = 1.2f;
+    config->noise_gate_threshold = 150.0f;
+    config->dsp_rt_priority = DSP_DEFAULT_RT_PRIORITY;
+    config->dsp_cpu = -1;
+}
+
+static uint64_t seconds_to_ns(double seconds)
+{
+    return seconds > 0.0 ? (uint64_t)(seconds * 1e9) : 0;
+}
+
+/* Counts a callback and the over- and underflows the device reported. */
+static void count_callback(Metrics *metrics, unsigned long status)
+{
+    metrics_add(metrics, METRIC_AUDIO_CALLBACKS, 1);
+    if (!status)
+        return;
+    if (status & AUDIO_STATUS_INPUT_UNDERFLOW)
+        metrics_add(metrics, METRIC_INPUT_UNDERFLOWS, 1);
+    if (status & AUDIO_STATUS_INPUT_OVERFLOW)
+        metrics_add(metrics, METRIC_INPUT_OVERFLOWS, 1);
+    if (status & AUDIO_STATUS_OUTPUT_UNDERFLOW)
+        metrics_add(metrics, METRIC_OUTPUT_UNDERFLOWS, 1);
+    if (status & AUDIO_STATUS_OUTPUT_OVERFLOW)
+        metrics_add(metrics, METRIC_OUTPUT_OVERFLOWS, 1);
+}
+
+/* Besides moving the audio, stamps each captured frame with the time its
+ * first sample left the ADC, and times each played frame from the DSP
+ * thread to the DAC. Between calls the audio still flows, but nothing is
+ * measured. */
+void call_audio_process(const SAMPLE *mic_in, SAMPLE *speaker_out,
+                        int frames, const AudioCallbackInfo *info,
+                        void *user_data)
+{
+    Call *call = (Call *)user_data;
+    Latency *latency = &call->latency;
+    LatencyStamp stamp;
+    bool in_call = atomic_load(&call->is_running);
+
+    if (call->lockstep)
+    {
+        while (atomic_load(&call->is_running) &&
+               rb_available_read(&call->playout_rb) < (size_t)frames)
+            frame_notifier_wait(&call->playout_notifier, 100);
+    }
+
+    uint64_t start_ns = monotonic_ns();
+    if (in_call)
+        count_callback(&call->metrics, info->status);
+    size_t played = rb_read(&call->playout_rb, speaker_out, frames);
+    if (played < (size_t)frames)
+    {
+        memset(speaker_out + played, 0, (frames - played) * sizeof(SAMPLE));
+        if (in_call)
+        {
+            atomic_fetch_add_explicit(
+                &call->callback_stats.playout_underruns, 1,
+                memory_order_relaxed);
+            metrics_add(&call->metrics, METRIC_PLAYOUT_UNDERRUNS, 1);
+        }
+    }
+    if (latency_trace_take(&call->playout_trace, played, &stamp) && in_call)
+        latency_on_played(
+            latency, latency_since(stamp.queued_ns, start_ns),
+            seconds_to_ns(info->output_dac_time - info->current_time));
+    bool probing = in_call && latency->probe.enabled;
+    if (probing)
+        latency_probe_detect(latency, speaker_out, frames,
+                             info->output_dac_time);
+
+    SAMPLE probe[probing ? frames : 1];
+    if (probing)
+    {
+        latency_probe_emit(latency, probe, frames, info->input_adc_time);
+        mic_in = probe;
+    }
+    size_t captured;
+    if (mic_in != NULL)
+    {
+        captured = rb_write(&call->capture_rb, mic_in, frames);
+    }
+    else
+    {
+        SAMPLE silence_buffer[frames];
+        memset(silence_buffer, 0, sizeof(silence_buffer));
+        captured = rb_write(&call->capture_rb, silence_buffer, frames);
+    }
+    if (captured < (size_t)frames && in_call)
+    {
+        atomic_fetch_add_explicit(&call->callback_stats.capture_overruns, 1,
+                                  memory_order_relaxed);
+        metrics_add(&call->metrics, METRIC_CAPTURE_OVERRUNS, 1);
+    }
+    uint64_t input_ns =
+        seconds_to_ns(info->current_time - info->input_adc_time);
+    if (in_call)
+        latency_record(latency, LATENCY_INPUT, input_ns);
+    latency_trace_put(&call->capture_trace, start_ns - input_ns, start_ns,
+                      captured);
+    frame_notifier_signal(&call->dsp_notifier);
+
+    if (in_call)
+        callback_stats_record(&call->callback_stats,
+                              monotonic_ns() - start_ns);
+}
+
+/* Queues one processed near-end frame for the network thread: for the
+ * peer, or for each participant of a conference, mixed with the others if
+ * this call is a bridge. A two-party frame keeps its capture time, if
+ * known (not 0). */
+static void queue_send(Call *call, const SAMPLE *pcm, int frames,
+                       uint64_t capture_ns)
+{
+    if (!call->config.conference)
+    {
+        size_t written = rb_write(&call->send_rb, pcm, frames);
+        if (capture_ns > 0)
+            latency_trace_put(&call->send_trace, capture_ns, monotonic_ns(),
+                              written);
+        if (rb_available_read(&call->send_rb) >= (size_t)call->packet_size)
+            frame_notifier_signal(&call->send_notifier);
+        return;
+    }
+    Conference *conf = &call->conference;
+    int count = atomic_load(&conf->count);
+    bool bridge = call->config.conference_bridge;
+    SAMPLE mix[frames];
+    if (bridge)
+        mixer_set_local(&conf->mixer, pcm);
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        if (peer->receive_only)
+            continue;
+        if (bridge)
+            mixer_mix_minus(&conf->mixer, i, peer->pcm, mix);
+        rb_write(&peer->send_rb, bridge ? mix : pcm, frames);
+    }
+    if (count > 0)
+        frame_notifier_signal(&call->send_notifier);
+}
+
+/* Publishes the jitter buffer's counters, which the DSP thread alone
+ * writes, and its depth. */
+static void publish_jitter_stats(Call *call, const JitterBufferStats *stats)
+{
+    Metrics *metrics = &call->metrics;
+    metrics_store(metrics, METRIC_PACKETS_LATE, stats->packets_late);
+    metrics_store(metrics, METRIC_PACKETS_DUPLICATE,
+                  stats->packets_duplicate);
+    metrics_store(metrics, METRIC_PACKETS_LOST, stats->packets_lost);
+    metrics_store(metrics, METRIC_JITTER_UNDERRUNS, stats->underruns);
+    metrics_store(metrics, METRIC_FRAMES_CONCEALED, stats->frames_concealed);
+    metrics_set(metrics, METRIC_JITTER_DELAY_MS, stats->current_delay_ms);
+    metrics_set(metrics, METRIC_JITTER_TARGET_MS, stats->target_delay_ms);
+    metrics_set(metrics, METRIC_JITTER_MS, stats->jitter_ms);
+    metrics_set(metrics, METRIC_CLOCK_DRIFT_PPM, stats->drift_ppm);
+}
+
+/* Plays one frame from the jitter buffer, or in a conference one frame
+ * from each participant's jitter buffer, mixed. A conference publishes the
+ * participants' counters summed and the deepest buffer. */
+static void play_frame(Call *call, SAMPLE *out)
+{
+    JitterBufferStats stats;
+    if (!call->config.conference)
+    {
+        jitter_buffer_get(&call->jitter_buffer, out, call->frame_size);
+        jitter_buffer_get_stats(&call->jitter_buffer, &stats);
+        uint64_t delay_ns = (uint64_t)(stats.current_delay_ms * 1e6);
+        atomic_store_explicit(&call->latency.last_jitter_ns, delay_ns,
+                              memory_order_relaxed);
+        if (delay_ns > 0)
+            latency_record(&call->latency, LATENCY_JITTER_BUFFER, delay_ns);
+        publish_jitter_stats(call, &stats);
+        return;
+    }
+    Conference *conf = &call->conference;
+    const SAMPLE *inputs[CONFERENCE_PEERS_MAX];
+    JitterBufferStats total;
+    memset(&total, 0, sizeof(total));
+    int count = atomic_load(&conf->count);
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        jitter_buffer_get(&peer->jitter_buffer, peer->pcm, call->frame_size);
+        inputs[i] = peer->pcm;
+        jitter_buffer_get_stats(&peer->jitter_buffer, &stats);
+        total.packets_late += stats.packets_late;
+        total.packets_duplicate += stats.packets_duplicate;
+        total.packets_lost += stats.packets_lost;
+        total.underruns += stats.underruns;
+        total.frames_concealed += stats.frames_concealed;
+        if (stats.current_delay_ms >= total.current_delay_ms)
+        {
+            total.current_delay_ms = stats.current_delay_ms;
+            total.target_delay_ms = stats.target_delay_ms;
+            total.jitter_ms = stats.jitter_ms;
+            total.drift_ppm = stats.drift_ppm;
+        }
+    }
+    mixer_mix(&conf->mixer, inputs, count, out);
+    publish_jitter_stats(call, &total);
+}
+
+static void process_near_end(Call *call, const SAMPLE *mic,
+                             SAMPLE *near_end, int frames, uint64_t capture_ns)
+{
+    /* With DTX the VAD on the send side takes over from the gate. */
+    float gate_rms =
+        call->dtx.enabled ? -1.0f
+                          : atomic_load_explicit(&call->noise_gate_threshold,
+                                                 memory_order_relaxed);
+    float gain =
+        atomic_load_explicit(&call->gain_factor, memory_order_relaxed);
+    SAMPLE send_buffer[frames];
+    float rms = preprocess_frame(&call->preprocess, mic, near_end,
+                                 send_buffer, gain, gate_rms);
+    metrics_set(&call->metrics, METRIC_MIC_LEVEL, rms);
+    queue_send(call, send_buffer, frames, capture_ns);
+}
+
+/* Reads one datagram into a RTP_PACKET_MAX buffer; -1 if nothing arrived
+ * within timeout_ms. */
+static int receive_datagram(Call *call, uint8_t *datagram,
+                            NetDatagramInfo *info, int timeout_ms)
+{
+    void *buffer = datagram;
+    if (net_wait_readable(&call->net, timeout_ms) <= 0)
+        return -1;
+    if (net_recv_batch(&call->net, &buffer, RTP_PACKET_MAX, info, 1) <= 0)
+        return -1;
+    metrics_add(&call->metrics, METRIC_PACKETS_RECEIVED, 1);
+    metrics_add(&call->metrics, METRIC_BYTES_RECEIVED, info->length);
+    return info->length;
+}
+
+/* Hands datagrams to the kernel and counts those it took. */
+static int send_datagrams(Call *call, const void *const *buffers,
+                          const size_t *lengths,
+                          const struct sockaddr_in *addrs, int count)
+{
+    int sent = net_send_batch(&call->net, buffers, lengths, addrs, count);
+    size_t bytes = 0;
+    for (int i = 0; i < sent; i++)
+        bytes += lengths[i];
+    if (sent > 0)
+    {
+        metrics_add(&call->metrics, METRIC_PACKETS_SENT, sent);
+        metrics_add(&call->metrics, METRIC_BYTES_SENT, bytes);
+    }
+    return sent;
+}
+
+static void report_first_audio(Call *call)
+{
+    if (call->first_audio_reported ||
+        !jitter_buffer_is_primed(&call->jitter_buffer))
+        return;
+    call->first_audio_reported = true;
+    call->first_audio_ns = monotonic_ns() - call->start_ns;
+    if (call->on_first_audio)
+        call->on_first_audio(call->user_data);
+}
+
+/* Announces this side's format to one destination. */
+static void send_format_to(Call *call, RtpSession *rtp,
+                           const struct sockaddr_in *addr)
+{
+    uint8_t format[RTCP_FORMAT_SIZE];
+    const void *buffer = format;
+    size_t length = rtp_session_build_format(rtp, format, sizeof(format));
+    send_datagrams(call, &buffer, &length, addr, 1);
+}
+
+/* Routes a datagram to the participant that sent it. Media from an
+ * unknown source joins the conference while there is room. */
+static ConferencePeer *conference_sender(Call *call, const uint8_t *datagram,
+                                         int length,
+                                         const struct sockaddr_in *from)
+{
+    Conference *conf = &call->conference;
+    uint32_t ssrc = rtp_sender_ssrc(datagram, length);
+    int index = conference_find_peer(conf, from, ssrc);
+    if (index >= 0)
+        return &conf->peers[index];
+    if (!from || from->sin_family != AF_INET ||
+        !unpack_is_media(datagram, length))
+        return NULL;
+    index = conference_add_peer(conf, from);
+    if (index < 0)
+        return NULL;
+    conference_find_peer(conf, from, ssrc);
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from->sin_addr, ip, sizeof(ip));
+    printf("[CONF] %s:%d joined as participant %d (SSRC %08x)%s.\n", ip,
+           ntohs(from->sin_port), index + 1, ssrc,
+           conf->peers[index].receive_only ? " through the relay" : "");
+    /* The announcement at the start of the call went out before this
+     * participant was listening. */
+    if (!conf->peers[index].receive_only)
+        send_format_to(call, &conf->peers[index].rtp, from);
+    return &conf->peers[index];
+}
+
+/* Times the peer's frame from its capture to its arrival here. When the
+ * clocks are not synchronized, the network part falls back to half the
+ * round trip. */
+static void note_capture_time(Call *call, const uint8_t *datagram, int length,
+                              uint64_t arrival_ns)
+{
+    uint64_t sent_wall_ns;
+    uint32_t sender_delay_us;
+    if (!rtp_read_capture_time(datagram, length, &sent_wall_ns,
+                               &sender_delay_us))
+        return;
+    RtpStats stats;
+    rtp_session_get_stats(&call->rtp, &stats);
+    latency_on_packet(&call->latency, sent_wall_ns, sender_delay_us,
+                      realtime_at(arrival_ns),
+                      stats.have_rtt ? (uint64_t)(stats.rtt_ms * 1e6) : 0);
+}
+
+/* Follows the packet size the sender announces. A different sample rate
+ * cannot be followed, only reported. */
+static void follow_peer_format(Call *call, RtpSession *rtp, JitterBuffer *jb)
+{
+    int rate, packet_samples;
+    if (!rtp_session_take_format(rtp, &rate, &packet_samples))
+        return;
+    if (rate != call->sample_rate)
+    {
+        if (!call->peer_rate_mismatch)
+            fprintf(stderr, "[FMT] The peer sends %d Hz audio, but this "
+                            "phone runs at %d Hz\n",
+                    rate, call->sample_rate);
+        call->peer_rate_mismatch = true;
+        return;
+    }
+    if (packet_samples <= 0 || packet_samples > AUDIO_PACKET_SAMPLES_MAX)
+        return;
+    if (jitter_buffer_set_frame_size(jb, packet_samples) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_set_frame_size() failed\n");
+        return;
+    }
+    if (jb == &call->jitter_buffer)
+        call->peer_packet_size = packet_samples;
+    printf("[FMT] Peer sends %.1f ms packets (%d samples).\n",
+           1000.0 * packet_samples / rate, packet_samples);
+}
+
+static void deliver_datagram(Call *call, PacketBuffer *buffer, int length,
+                             const struct sockaddr_in *from,
+                             uint64_t arrival_ns, uint64_t media_arrival_ns)
+{
+    const uint8_t *datagram = buffer->data;
+    RtpSession *rtp = &call->rtp;
+    JitterBuffer *jb = &call->jitter_buffer;
+    if (call->config.capture_path)
+        capture_packet(&call->capture, datagram, length, from,
+                       media_arrival_ns);
+    /* The announcement at the start of the call is lost if the peer was
+     * not listening yet; now it is. */
+    if (!call->config.conference && !call->peer_heard)
+    {
+        call->peer_heard = true;
+        send_format_to(call, &call->rtp, &call->peer_addr);
+    }
+    if (call->config.conference)
+    {
+        ConferencePeer *peer = conference_sender(call, datagram, length, from);
+        if (!peer)
+            return;
+        rtp = &peer->rtp;
+        jb = &peer->jitter_buffer;
+    }
+    AudioPacket packets[RED_MAX_BLOCKS];
+    int frames = unpack_datagram(rtp, buffer, length, arrival_ns,
+                                 media_arrival_ns, packets);
+    if (frames == 0)
+        follow_peer_format(call, rtp, jb);
+    for (int i = 0; i < frames; i++)
+        jitter_buffer_put(jb, &packets[i], media_arrival_ns);
+    if (frames > 0 && !call->config.conference)
+        note_capture_time(call, datagram, length, arrival_ns);
+    if (frames > 0)
+        report_first_audio(call);
+}
+
+/* Passes a received datagram on, through the impairment stage if one is
+ * configured. */
+static void accept_datagram(Call *call, PacketBuffer *buffer, int length,
+                            const struct sockaddr_in *from,
+                            uint64_t arrival_ns, uint64_t media_arrival_ns)
+{
+    if (call->config.impair.enabled)
+        impair_submit(&call->impair, buffer->data, length, from,
+                      media_arrival_ns);
+    else
+        deliver_datagram(call, buffer, length, from, arrival_ns,
+                         media_arrival_ns);
+}
+
+/* Delivers every impaired datagram due by now_ns, stamped with the time it
+ * was due. In lockstep that time is virtual, so RTCP gets the wall clock. */
+static void release_impaired(Call *call, uint64_t now_ns)
+{
+    struct sockaddr_in from;
+    uint64_t release_ns;
+    if (!call->config.impair.enabled)
+        return;
+    for (;;)
+    {
+        PacketBuffer *buffer = packet_pool_acquire(&call->packet_pool);
+        if (!buffer)
+            return;
+        int length = impair_pop(&call->impair, now_ns, buffer->data,
+                                RTP_PACKET_MAX, &release_ns, &from);
+        if (length > 0)
+            deliver_datagram(call, buffer, length, &from,
+                             call->lockstep ? monotonic_ns() : release_ns,
+                             release_ns);
+        packet_buffer_release(buffer);
+        if (length <= 0)
+            return;
+    }
+}
+
+/* Lockstep: take exactly one media packet from the socket per played
+ * frame, stamped with a virtual arrival time. An impairment stage then runs
+ * on the same virtual clock and sees only media, since RTCP follows the wall
+ * clock, which keeps impaired runs reproducible. Once
+ * the peer has been silent for LOCKSTEP_RECV_ATTEMPTS receive timeouts it is
+ * treated as gone and only packets that are already queued are taken. */
+static void receive_lockstep(Call *call, uint64_t arrival_ns,
+                             bool *peer_alive)
+{
+    NetDatagramInfo info;
+    int attempts = *peer_alive ? LOCKSTEP_RECV_ATTEMPTS : 1;
+    int timeout_ms = *peer_alive ? LOCKSTEP_RECV_TIMEOUT_MS : 0;
+    bool received = false;
+    while (atomic_load(&call->is_running) && attempts > 0 && !received)
+    {
+        PacketBuffer *buffer = packet_pool_acquire(&call->packet_pool);
+        if (!buffer)
+            break;
+        int length = receive_datagram(call, buffer->data, &info, timeout_ms);
+        if (length < 0)
+            attempts--;
+        else if ((received = unpack_is_media(buffer->data, length)))
+            accept_datagram(call, buffer, length, &info.addr,
+                            info.timestamp_ns, arrival_ns);
+        else
+            deliver_datagram(call, buffer, length, &info.addr,
+                             info.timestamp_ns, arrival_ns);
+        packet_buffer_release(buffer);
+    }
+    *peer_alive = received;
+    release_impaired(call, arrival_ns);
+}
+
+static void send_probe(Call *call)
+{
+    uint8_t probe[RTP_HEADER_SIZE];
+    RtpHeader header = {0, 0, call->rtp.ssrc, LOCKSTEP_PROBE_PAYLOAD_TYPE,
+                        false};
+    rtp_write_header(probe, &header);
+    sendto(call->net.fd, probe, sizeof(probe), 0,
+           (struct sockaddr *)&call->peer_addr, sizeof(call->peer_addr));
+}
+
+/* Both lockstep peers must be listening before the first media packet is
+ * sent, otherwise whichever starts first loses its opening frames. Each side
+ * probes until it hears the peer, then probes once more so the peer hears
+ * it too. */
+static void lockstep_handshake(Call *call)
+{
+    uint8_t datagram[RTP_PACKET_MAX];
+    NetDatagramInfo info;
+    while (atomic_load(&call->is_running))
+    {
+        send_probe(call);
+        int length = receive_datagram(call, datagram, &info,
+                                      LOCKSTEP_RECV_TIMEOUT_MS);
+        if (length < 0)
+            continue;
+        /* The peer's format announcement may be what is heard first. */
+        if (rtp_is_rtcp(datagram, length))
+        {
+            if (call->config.capture_path)
+                capture_packet(&call->capture, datagram, length, &info.addr,
+                               info.timestamp_ns);
+            rtp_session_on_rtcp(&call->rtp, datagram, length,
+                                info.timestamp_ns);
+            follow_peer_format(call, &call->rtp, &call->jitter_buffer);
+        }
+        break;
+    }
+    send_probe(call);
+    /* Ahead of any media, now that the peer is listening. */
+    call->peer_heard = true;
+    send_format_to(call, &call->rtp, &call->peer_addr);
+    printf("[DSP] Lockstep peer connected.\n");
+}
+
+/* Engine threads: joins the call that has started, if it is still
+ * running, waiting for one with wait set. */
+static bool call_enter(Call *call, bool wait)
+{
+    bool entered = false;
+    pthread_mutex_lock(&call->state_lock);
+    while (wait && !atomic_load(&call->is_running) &&
+           !atomic_load(&call->engine_closing))
+        pthread_cond_wait(&call->state_changed, &call->state_lock);
+    if (atomic_load(&call->is_running) && !atomic_load(&call->engine_closing))
+    {
+        call->threads_in_call++;
+        entered = true;
+    }
+    pthread_mutex_unlock(&call->state_lock);
+    return entered;
+}
+
+static void call_leave(Call *call)
+{
+    pthread_mutex_lock(&call->state_lock);
+    call->threads_in_call--;
+    pthread_cond_broadcast(&call->state_changed);
+    pthread_mutex_unlock(&call->state_lock);
+}
+
+/* Between calls: the microphone is discarded and silence played, keeping
+ * the playout queue at the depth a call starts with. */
+static void dsp_idle(Call *call)
+{
+    int frame = call->frame_size;
+    SAMPLE mic[AUDIO_FRAME_MAX];
+    SAMPLE silence[AUDIO_FRAME_MAX];
+    LatencyStamp stamp;
+
+    memset(silence, 0, sizeof(silence));
+    while (!atomic_load(&call->is_running) &&
+           !atomic_load(&call->engine_closing))
+    {
+        if (frame_notifier_wait(&call->dsp_notifier, 100) <= 0)
+            continue;
+        /* A frame captured once the call started belongs to the call. */
+        while (rb_available_read(&call->capture_rb) >= (size_t)frame &&
+               !atomic_load(&call->is_running))
+        {
+            rb_read(&call->capture_rb, mic, frame);
+            latency_trace_take(&call->capture_trace, frame, &stamp);
+            if (rb_available_read(&call->playout_rb) <
+                (size_t)DSP_PLAYOUT_MAX_FRAMES * frame)
+                latency_trace_put(&call->playout_trace, 0, monotonic_ns(),
+                                  rb_write(&call->playout_rb, silence, frame));
+        }
+    }
+}
+
+static void dsp_run_call(Call *call)
+{
+    int frame = call->frame_size;
+    SAMPLE mic[AUDIO_FRAME_MAX];
+    SAMPLE far_end[AUDIO_FRAME_MAX];
+    SAMPLE near_end[AUDIO_FRAME_MAX];
+    int64_t frame_ns = (int64_t)frame * 1000000000ll / call->sample_rate;
+    uint64_t frames_played = 0;
+    uint64_t samples_received = 0;
+    bool peer_alive = true;
+
+    memset(far_end, 0, sizeof(far_end));
+    if (call->lockstep)
+    {
+        lockstep_handshake(call);
+        if (call->echo_state)
+            speex_echo_playback(call->echo_state, far_end);
+    }
+    while (atomic_load(&call->is_running))
+    {
+        /* Frames may be waiting already: the wakeup for them can have been
+         * taken while the thread was idle. */
+        frame_notifier_wait(&call->dsp_notifier, 100);
+        while (atomic_load(&call->is_running) &&
+               rb_available_read(&call->capture_rb) >= (size_t)frame)
+        {
+            LatencyStamp stamp;
+            uint64_t capture_ns = 0;
+            rb_read(&call->capture_rb, mic, frame);
+            if (latency_trace_take(&call->capture_trace, frame, &stamp))
+            {
+                latency_record(&call->latency, LATENCY_CAPTURE_QUEUE,
+                               latency_since(stamp.queued_ns, monotonic_ns()));
+                capture_ns = stamp.capture_ns;
+            }
+            if (call->lockstep)
+            {
+                process_near_end(call, mic, near_end, frame, capture_ns);
+                /* Every packet the peer has completed by the end of this
+                 * frame: one per frame unless it packs several. */
+                uint64_t arrival_ns = frames_played++ * frame_ns;
+                while (samples_received + call->peer_packet_size <=
+                       frames_played * frame)
+                {
+                    receive_lockstep(call, arrival_ns, &peer_alive);
+                    samples_received += call->peer_packet_size;
+                }
+            }
+            play_frame(call, far_end);
+            if (call->lockstep && call->config.record_path)
+                recorder_write(&call->recorder, near_end, far_end, frame);
+            if (rb_available_read(&call->playout_rb) <
+                (size_t)DSP_PLAYOUT_MAX_FRAMES * frame)
+                latency_trace_put(&call->playout_trace, 0, monotonic_ns(),
+                                  rb_write(&call->playout_rb, far_end, frame));
+            frame_notifier_signal(&call->playout_notifier);
+
+            if (call->lockstep)
+            {
+                if (call->echo_state)
+                    speex_echo_playback(call->echo_state, far_end);
+                continue;
+            }
+            if (call->echo_state)
+                speex_echo_playback(call->echo_state, far_end);
+            process_near_end(call, mic, near_end, frame, capture_ns);
+            if (call->config.record_path)
+                recorder_write(&call->recorder, near_end, far_end, frame);
+        }
+    }
+}
+
+static void *dsp_thread_func(void *data)
+{
+    Call *call = (Call *)data;
+
+    printf("[DSP] DSP thread started.\n");
+    while (!atomic_load(&call->engine_closing))
+    {
+        if (!call_enter(call, false))
+        {
+            dsp_idle(call);
+            continue;
+        }
+        dsp_run_call(call);
+        call_leave(call);
+    }
+    printf("[DSP] DSP thread finished.\n");
+    return NULL;
+}
+
+typedef enum
+{
+    FRAME_SEND,
+    FRAME_SEND_MARKED,
+    FRAME_COMFORT_NOISE,
+    FRAME_SKIP,
+} FrameAction;
+
+/* Decides what to transmit for one frame. During silence a comfort noise
+ * packet goes out when it starts, when the noise level moves by
+ * DTX_CN_LEVEL_DELTA dB and otherwise every DTX_CN_REFRESH_MS. */
+static FrameAction dtx_frame_action(Call *call, const SAMPLE *pcm, int frames)
+{
+    CallDtx *dtx = &call->dtx;
+    if (!dtx->enabled)
+        return FRAME_SEND;
+    float floor_rms =
+        atomic_load_explicit(&call->noise_gate_threshold,
+                             memory_order_relaxed) *
+        atomic_load_explicit(&call->gain_factor, memory_order_relaxed);
+    if (vad_process(&dtx->vad, pcm, frames, floor_rms))
+    {
+        bool resumed = dtx->silent;
+        dtx->silent = false;
+        dtx->frames_sent++;
+        return resumed ? FRAME_SEND_MARKED : FRAME_SEND;
+    }
+    dtx->frames_suppressed++;
+    uint8_t level = comfort_noise_level(vad_noise_rms(&dtx->vad));
+    int change = abs((int)level - (int)dtx->cn_level);
+    if (dtx->silent && change < DTX_CN_LEVEL_DELTA &&
+        ++dtx->frames_since_cn < dtx->cn_refresh_frames)
+        return FRAME_SKIP;
+    dtx->silent = true;
+    dtx->frames_since_cn = 0;
+    dtx->cn_level = level;
+    dtx->cn_packets++;
+    return FRAME_COMFORT_NOISE;
+}
+
+/* Picks the redundancy depth from the loss the peer reports for this
+ * stream. A level is left only once loss falls below half the rate that
+ * raised it, so the depth does not flap around a threshold. */
+static void update_fec_depth(Call *call)
+{
+    static const double raise_at[RED_MAX_DEPTH] = {0.01, 0.05};
+    if (call->config.fec_depth != RED_DEPTH_AUTO)
+        return;
+    RtpStats stats;
+    rtp_session_get_stats(&call->rtp, &stats);
+    if (!stats.have_remote_report)
+        return;
+    double loss = stats.remote_fraction_lost;
+    int depth = call->fec.depth;
+    while (depth < RED_MAX_DEPTH && loss >= raise_at[depth])
+        depth++;
+    while (depth > 0 && loss < raise_at[depth - 1] / 2)
+        depth--;
+    if (depth != call->fec.depth)
+        printf("[FEC] Peer reports %.1f%% loss, redundancy depth %d.\n",
+               loss * 100.0, depth);
+    call->fec.depth = depth;
+}
+
+/* Encodes every whole frame queued by the DSP thread straight into RTP
+ * datagrams and hands them to the kernel with one sendmmsg(). With
+ * redundancy the frame is encoded aside and packed behind copies of the
+ * frames before it. A frame whose capture time is known carries it in a
+ * header extension. */
+static void send_pending(Call *call, uint8_t (*datagrams)[RTP_PACKET_MAX])
+{
+    const void *buffers[NET_BATCH_MAX];
+    size_t lengths[NET_BATCH_MAX];
+    size_t header_lengths[NET_BATCH_MAX];
+    struct sockaddr_in addrs[NET_BATCH_MAX];
+    RtpHeader headers[NET_BATCH_MAX];
+    int packet = call->packet_size;
+    SAMPLE pcm[AUDIO_PACKET_SAMPLES_MAX];
+    uint8_t primary[AUDIO_PAYLOAD_MAX];
+
+    update_fec_depth(call);
+
+    while (rb_available_read(&call->send_rb) >= (size_t)packet)
+    {
+        int count = 0;
+        while (count < NET_BATCH_MAX &&
+               rb_available_read(&call->send_rb) >= (size_t)packet)
+        {
+            uint8_t *datagram = datagrams[count];
+            LatencyStamp stamp;
+            rb_read(&call->send_rb, pcm, packet);
+            bool stamped =
+                latency_trace_take(&call->send_trace, packet, &stamp);
+            size_t header_length =
+                stamped && call->config.capture_time
+                    ? RTP_HEADER_SIZE + RTP_EXT_CAPTURE_SIZE
+                    : RTP_HEADER_SIZE;
+            uint8_t *payload = datagram + header_length;
+            FrameAction action = dtx_frame_action(call, pcm, packet);
+            if (action == FRAME_SKIP)
+            {
+                red_encoder_reset(&call->fec.encoder);
+                rtp_session_skip(&call->rtp, packet);
+                continue;
+            }
+            uint8_t payload_type = PAYLOAD_CN;
+            int payload_size;
+            bool redundant = false;
+            if (action == FRAME_COMFORT_NOISE)
+            {
+                red_encoder_reset(&call->fec.encoder);
+                payload_size = comfort_noise_encode(
+                    vad_noise_rms(&call->dtx.vad), payload, AUDIO_PAYLOAD_MAX);
+            }
+            else
+            {
+                redundant = call->fec.depth > 0;
+                payload_type = call->encoder.codec->payload_type;
+                payload_size = codec_encode(&call->encoder, pcm, packet,
+                                            redundant ? primary : payload,
+                                            AUDIO_PAYLOAD_MAX);
+            }
+            if (payload_size < 0)
+                continue;
+            rtp_session_next_header(&call->rtp, payload_type, packet,
+                                    &headers[count]);
+            headers[count].marker = action == FRAME_SEND_MARKED;
+            if (redundant)
+            {
+                int red_size = red_encoder_pack(
+                    &call->fec.encoder, call->fec.depth, payload_type,
+                    headers[count].timestamp, primary, payload_size, payload,
+                    RTP_PAYLOAD_MAX);
+                if (red_size > 0)
+                {
+                    headers[count].payload_type = PAYLOAD_RED;
+                    payload_size = red_size;
+                    call->fec.packets++;
+                }
+                else
+                {
+                    memcpy(payload, primary, payload_size);
+                }
+            }
+            rtp_write_header(datagram, &headers[count]);
+            if (stamped)
+            {
+                uint64_t now = monotonic_ns();
+                latency_record(&call->latency, LATENCY_SEND_QUEUE,
+                               latency_since(stamp.queued_ns, now));
+                if (call->config.capture_time)
+                    rtp_write_capture_time(
+                        datagram, realtime_at(now),
+                        (uint32_t)(latency_since(stamp.capture_ns, now) /
+                                   1000));
+            }
+            buffers[count] = datagram;
+            header_lengths[count] = header_length;
+            lengths[count] = header_length + payload_size;
+            addrs[count] = call->peer_addr;
+            count++;
+        }
+        if (count == 0)
+            continue;
+        int sent = send_datagrams(call, buffers, lengths, addrs, count);
+        uint64_t now = monotonic_ns();
+        for (int i = 0; i < sent; i++)
+            rtp_session_on_sent(&call->rtp, &headers[i],
+                                lengths[i] - header_lengths[i], now);
+    }
+}
+
+/* Datagrams for several conference participants on their way into one
+ * sendmmsg(). */
+typedef struct
+{
+    const void *buffers[NET_BATCH_MAX];
+    size_t lengths[NET_BATCH_MAX];
+    struct sockaddr_in addrs[NET_BATCH_MAX];
+    RtpHeader headers[NET_BATCH_MAX];
+    ConferencePeer *owners[NET_BATCH_MAX];
+    int count;
+} ConferenceBatch;
+
+static void flush_conference(Call *call, ConferenceBatch *batch)
+{
+    if (batch->count == 0)
+        return;
+    int sent = send_datagrams(call, batch->buffers, batch->lengths,
+                              batch->addrs, batch->count);
+    uint64_t now = monotonic_ns();
+    for (int i = 0; i < sent; i++)
+        rtp_session_on_sent(&batch->owners[i]->rtp, &batch->headers[i],
+                            batch->lengths[i] - RTP_HEADER_SIZE, now);
+    batch->count = 0;
+}
+
+/* Encodes what each participant is to hear with its own encoder and RTP
+ * stream, and sends the datagrams for all of them in shared batches. */
+static void send_conference(Call *call, uint8_t (*datagrams)[RTP_PACKET_MAX])
+{
+    Conference *conf = &call->conference;
+    ConferenceBatch batch;
+    int packet = call->packet_size;
+    SAMPLE pcm[AUDIO_PACKET_SAMPLES_MAX];
+    int count = atomic_load(&conf->count);
+    batch.count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        while (rb_available_read(&peer->send_rb) >= (size_t)packet)
+        {
+            if (batch.count == NET_BATCH_MAX)
+                flush_conference(call, &batch);
+            uint8_t *datagram = datagrams[batch.count];
+            rb_read(&peer->send_rb, pcm, packet);
+            int payload_size = codec_encode(&peer->encoder, pcm, packet,
+                                            datagram + RTP_HEADER_SIZE,
+                                            AUDIO_PAYLOAD_MAX);
+            if (payload_size < 0)
+                continue;
+            RtpHeader *header = &batch.headers[batch.count];
+            rtp_session_next_header(&peer->rtp, conf->codec->payload_type,
+                                    packet, header);
+            rtp_write_header(datagram, header);
+            batch.buffers[batch.count] = datagram;
+            batch.lengths[batch.count] = RTP_HEADER_SIZE + payload_size;
+            batch.addrs[batch.count] = peer->addr;
+            batch.owners[batch.count] = peer;
+            batch.count++;
+        }
+    }
+    flush_conference(call, &batch);
+}
+
+/* Drains the socket in batches of up to NET_BATCH_MAX datagrams, each
+ * stamped with its kernel receive time. The kernel writes straight into
+ * pooled buffers, which the jitter buffers keep. spare holds the buffers
+ * not yet received into from one call to the next. */
+static void receive_pending(Call *call, PacketBuffer **spare)
+{
+    void *buffers[NET_BATCH_MAX];
+    NetDatagramInfo info[NET_BATCH_MAX];
+    int count;
+    do
+    {
+        int ready = 0;
+        for (; ready < NET_BATCH_MAX; ready++)
+        {
+            if (!spare[ready])
+                spare[ready] = packet_pool_acquire(&call->packet_pool);
+            if (!spare[ready])
+                break;
+            buffers[ready] = spare[ready]->data;
+        }
+        if (ready == 0)
+            return;
+        count = net_recv_batch(&call->net, buffers, RTP_PACKET_MAX, info,
+                               ready);
+        for (int i = 0; i < count; i++)
+        {
+            metrics_add(&call->metrics, METRIC_PACKETS_RECEIVED, 1);
+            metrics_add(&call->metrics, METRIC_BYTES_RECEIVED, info[i].length);
+            accept_datagram(call, spare[i], info[i].length, &info[i].addr,
+                            info[i].timestamp_ns, info[i].timestamp_ns);
+            packet_buffer_release(spare[i]);
+            spare[i] = NULL;
+        }
+    } while (count == NET_BATCH_MAX);
+}
+
+static void send_session_report(Call *call, RtpSession *rtp,
+                                const struct sockaddr_in *addr, uint64_t now)
+{
+    uint8_t report[RTCP_PACKET_MAX];
+    if (!rtp_session_report_due(rtp, now))
+        return;
+    size_t length = rtp_session_build_report(rtp, report, sizeof(report), now);
+    const void *buffer = report;
+    if (length > 0)
+        send_datagrams(call, &buffer, &length, addr, 1);
+}
+
+static void send_report(Call *call)
+{
+    uint64_t now = monotonic_ns();
+    if (!call->config.conference)
+    {
+        send_session_report(call, &call->rtp, &call->peer_addr, now);
+        return;
+    }
+    Conference *conf = &call->conference;
+    int count = atomic_load(&conf->count);
+    for (int i = 0; i < count; i++)
+    {
+        if (!conf->peers[i].receive_only)
+            send_session_report(call, &conf->peers[i].rtp,
+                                &conf->peers[i].addr, now);
+    }
+}
+
+/* Tells the peer, or each participant, the format of the stream it is
+ * sent, without waiting for the first report. */
+static void send_format(Call *call)
+{
+    if (!call->config.conference)
+    {
+        send_format_to(call, &call->rtp, &call->peer_addr);
+        return;
+    }
+    Conference *conf = &call->conference;
+    int count = atomic_load(&conf->count);
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        if (!peer->receive_only)
+            send_format_to(call, &peer->rtp, &peer->addr);
+    }
+}
+
+/* Repeats the request to join the relay room, which also keeps the relay's
+ * (and any NAT's) state for this address alive. */
+static void send_relay_join(Call *call)
+{
+    uint64_t now = monotonic_ns();
+    if (!call->config.relay_join || now < call->next_join_ns)
+        return;
+    call->next_join_ns = now + (uint64_t)RELAY_JOIN_INTERVAL_MS * 1000000ull;
+    uint8_t join[RELAY_JOIN_SIZE];
+    const void *buffer = join;
+    if (!call->config.conference)
+    {
+        size_t length = relay_build_join(join, sizeof(join), call->rtp.ssrc,
+                                         call->config.relay_room);
+        send_datagrams(call, &buffer, &length, &call->peer_addr, 1);
+        return;
+    }
+    Conference *conf = &call->conference;
+    int count = atomic_load(&conf->count);
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        if (peer->receive_only)
+            continue;
+        size_t length = relay_build_join(join, sizeof(join), peer->rtp.ssrc,
+                                         call->config.relay_room);
+        send_datagrams(call, &buffer, &length, &peer->addr, 1);
+    }
+}
+
+/* One thread serves the socket and the send queue and emits the periodic
+ * RTCP report. send_notifier doubles as the shutdown wakeup. In lockstep
+ * the DSP thread reads the socket itself, so only the send side is
+ * watched. */
+static void net_run_call(Call *call)
+{
+    PacketBuffer *rx_buffers[NET_BATCH_MAX] = {NULL};
+    uint8_t tx_datagrams[NET_BATCH_MAX][RTP_PACKET_MAX];
+    NetPoller poller;
+    int send_fd = frame_notifier_fd(&call->send_notifier);
+
+    if (net_poller_init(&poller) == -1)
+    {
+        perror("net_poller_init() failed");
+        return;
+    }
+    net_poller_add(&poller, send_fd);
+    if (!call->lockstep)
+        net_poller_add(&poller, call->net.fd);
+    send_format(call);
+    while (atomic_load(&call->is_running))
+    {
+        int ready[NET_POLLER_MAX];
+        int timeout_ms = 100;
+        if (!call->lockstep && call->config.impair.enabled)
+        {
+            int due_ms = impair_timeout_ms(&call->impair, monotonic_ns());
+            if (due_ms >= 0 && due_ms < timeout_ms)
+                timeout_ms = due_ms;
+        }
+        int count = net_poller_wait(&poller, ready, NET_POLLER_MAX, timeout_ms);
+        for (int i = 0; i < count && atomic_load(&call->is_running); i++)
+        {
+            if (ready[i] == send_fd)
+            {
+                frame_notifier_drain(&call->send_notifier);
+                if (call->config.conference)
+                    send_conference(call, tx_datagrams);
+                else
+                    send_pending(call, tx_datagrams);
+            }
+            else
+            {
+                receive_pending(call, rx_buffers);
+            }
+        }
+        if (!call->lockstep)
+            release_impaired(call, monotonic_ns());
+        if (atomic_load(&call->is_running))
+        {
+            send_relay_join(call);
+            send_report(call);
+        }
+    }
+    for (int i = 0; i < NET_BATCH_MAX; i++)
+    {
+        if (rx_buffers[i])
+            packet_buffer_release(rx_buffers[i]);
+    }
+    net_poller_destroy(&poller);
+}
+
+static void *net_thread_func(void *data)
+{
+    Call *call = (Call *)data;
+
+    printf("[NET] Network thread started.\n");
+    while (call_enter(call, true))
+    {
+        net_run_call(call);
+        call_leave(call);
+    }
+    printf("[NET] Network thread finished.\n");
+    return NULL;
+}
+
+/* Every jitter buffer slot may hold a different datagram while a batch
+ * of spare buffers waits for the next receive, so the pool never runs
+ * dry. The pool lasts as long as the engine and any of its calls may be a
+ * conference, so there is a jitter buffer's worth for every participant. */
+static int call_packet_buffers(const CallConfig *config)
+{
+    int slots = config->jb_config.slot_count < 2 ? 2
+                                                 : config->jb_config.slot_count;
+    return CONFERENCE_PEERS_MAX * slots + NET_BATCH_MAX;
+}
+
+/* Participants to call or a bridge imply a conference. */
+static void normalize_config(CallConfig *config)
+{
+    if (config->conference_peer_count > 0 || config->conference_bridge)
+        config->conference = true;
+}
+
+int call_engine_open(Call *call)
+{
+    CallConfig *config = &call->config;
+    uint64_t start_ns = monotonic_ns();
+    call->lockstep = config->audio.clock == AUDIO_CLOCK_FAST;
+    normalize_config(config);
+    /* Lockstep peers share one virtual clock, so there is no drift to
+     * correct, and playout stays sample-exact. */
+    if (call->lockstep)
+        config->jb_config.drift_compensation = false;
+    call->sample_rate = config->audio.sample_rate;
+    call->frame_size = config->audio.frame_size;
+    config->jb_config.sample_rate = call->sample_rate;
+    config->jb_config.frame_size = call->frame_size;
+    call->echo_state = NULL;
+    call->threads_in_call = 0;
+    atomic_store(&call->is_running, false);
+    atomic_store(&call->engine_closing, false);
+    pthread_mutex_init(&call->state_lock, NULL);
+    pthread_cond_init(&call->state_changed, NULL);
+
+    /* Every ring is set up, so that the error path can free them all. */
+    int frame = call->frame_size;
+    bool rings = rb_init(&call->send_rb,
+                         RING_BUFFER_SIZE(call->sample_rate)) == 0;
+    rings = rb_init(&call->capture_rb, DSP_RING_FRAMES * frame) == 0 && rings;
+    rings = rb_init(&call->playout_rb, DSP_RING_FRAMES * frame) == 0 && rings;
+    if (!rings)
+    {
+        fprintf(stderr, "Cannot allocate the ring buffers\n");
+        goto error_rings;
+    }
+    SAMPLE prefill[AUDIO_FRAME_MAX];
+    memset(prefill, 0, sizeof(prefill));
+    for (int i = 0; i < DSP_PLAYOUT_PREFILL_FRAMES; i++)
+        rb_write(&call->playout_rb, prefill, frame);
+    callback_stats_reset(&call->callback_stats);
+    latency_init(&call->latency, false, call->sample_rate);
+    latency_trace_reset(&call->capture_trace, 0);
+    latency_trace_reset(&call->send_trace, 0);
+    latency_trace_reset(&call->playout_trace,
+                        DSP_PLAYOUT_PREFILL_FRAMES * frame);
+    if (frame_notifier_init(&call->send_notifier) == -1)
+    {
+        perror("frame_notifier_init() failed");
+        goto error_rings;
+    }
+    if (frame_notifier_init(&call->dsp_notifier) == -1)
+    {
+        perror("frame_notifier_init() failed");
+        goto error_send_notifier;
+    }
+    if (frame_notifier_init(&call->playout_notifier) == -1)
+    {
+        perror("frame_notifier_init() failed");
+        goto error_dsp_notifier;
+    }
+    if (packet_pool_init(&call->packet_pool, call_packet_buffers(config)) ==
+        -1)
+    {
+        fprintf(stderr, "packet_pool_init() failed\n");
+        goto error_playout_notifier;
+    }
+    if (jitter_buffer_init(&call->jitter_buffer, &config->jb_config) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_init() failed\n");
+        goto error_packet_pool;
+    }
+    /* The canceller adapts once per frame, over a tail as long in time
+     * whatever the rate. */
+    if (config->aec_enabled)
+    {
+        int tail_length_samples =
+            (call->sample_rate * config->aec_tail_ms) / 1000;
+        call->echo_state = speex_echo_state_init(frame, tail_length_samples);
+        speex_echo_ctl(call->echo_state, SPEEX_ECHO_SET_SAMPLING_RATE,
+                       (void *)&call->sample_rate);
+    }
+    if (preprocess_init(&call->preprocess, call->sample_rate, frame,
+                        call->echo_state) == -1)
+    {
+        fprintf(stderr, "preprocess_init() failed\n");
+        goto error_echo;
+    }
+    if (audio_backend_open(&call->audio, &config->audio, call_audio_process,
+                           call) == -1)
+        goto error_preprocess;
+
+    if (pthread_create(&call->dsp_tid, NULL, dsp_thread_func, call) != 0)
+    {
+        perror("pthread_create() failed");
+        goto error_audio;
+    }
+    if (config->dsp_rt_priority > 0)
+        rt_thread_set_fifo(call->dsp_tid, config->dsp_rt_priority);
+    if (config->dsp_cpu >= 0)
+        rt_thread_pin_cpu(call->dsp_tid, config->dsp_cpu);
+    if (pthread_create(&call->net_tid, NULL, net_thread_func, call) != 0)
+    {
+        perror("pthread_create() failed");
+        atomic_store(&call->engine_closing, true);
+        pthread_join(call->dsp_tid, NULL);
+        goto error_audio;
+    }
+    call->engine_open = true;
+    /* A sound card runs from here on; a file clock only during calls. */
+    if (call->audio.stream && audio_backend_start(&call->audio) == -1)
+    {
+        call_engine_close(call);
+        return -1;
+    }
+    printf("[INFO] Media engine ready in %.1f ms: %d Hz, %.1f ms frames "
+           "(%d samples).\n",
+           (monotonic_ns() - start_ns) / 1e6, call->sample_rate,
+           1000.0 * frame / call->sample_rate, frame);
+    return 0;
+
+error_audio:
+    audio_backend_close(&call->audio);
+error_preprocess:
+    preprocess_destroy(&call->preprocess);
+error_echo:
+    if (call->echo_state)
+    {
+        speex_echo_state_destroy(call->echo_state);
+        call->echo_state = NULL;
+    }
+    jitter_buffer_destroy(&call->jitter_buffer);
+error_packet_pool:
+    packet_pool_destroy(&call->packet_pool);
+error_playout_notifier:
+    frame_notifier_destroy(&call->playout_notifier);
+error_dsp_notifier:
+    frame_notifier_destroy(&call->dsp_notifier);
+error_send_notifier:
+    frame_notifier_destroy(&call->send_notifier);
+error_rings:
+    rb_destroy(&call->send_rb);
+    rb_destroy(&call->capture_rb);
+    rb_destroy(&call->playout_rb);
+    pthread_cond_destroy(&call->state_changed);
+    pthread_mutex_destroy(&call->state_lock);
+    return -1;
+}
+
+void call_engine_close(Call *call)
+{
+    if (!call->engine_open)
+        return;
+    call_stop(call);
+    pthread_mutex_lock(&call->state_lock);
+    atomic_store(&call->engine_closing, true);
+    pthread_cond_broadcast(&call->state_changed);
+    pthread_mutex_unlock(&call->state_lock);
+    frame_notifier_signal(&call->dsp_notifier);
+    pthread_join(call->dsp_tid, NULL);
+    pthread_join(call->net_tid, NULL);
+    audio_backend_close(&call->audio);
+    preprocess_destroy(&call->preprocess);
+    if (call->echo_state)
+    {
+        speex_echo_state_destroy(call->echo_state);
+        call->echo_state = NULL;
+    }
+    jitter_buffer_destroy(&call->jitter_buffer);
+    packet_pool_destroy(&call->packet_pool);
+    frame_notifier_destroy(&call->send_notifier);
+    frame_notifier_destroy(&call->dsp_notifier);
+    frame_notifier_destroy(&call->playout_notifier);
+    rb_destroy(&call->send_rb);
+    rb_destroy(&call->capture_rb);
+    rb_destroy(&call->playout_rb);
+    pthread_cond_destroy(&call->state_changed);
+    pthread_mutex_destroy(&call->state_lock);
+    call->engine_open = false;
+}
+
+/* Everything set up here is per call; the engine's threads do not touch
+ * any of it until is_running is set. */
+int call_start(Call *call)
+{
+    CallConfig *config = &call->config;
+    call->start_ns = monotonic_ns();
+    if (!call->engine_open && call_engine_open(call) == -1)
+        return -1;
+    if (atomic_load(&call->is_running))
+    {
+        fprintf(stderr, "A call is already running\n");
+        return -1;
+    }
+    normalize_config(config);
+    if (config->conference && call->lockstep)
+    {
+        fprintf(stderr, "A conference cannot run in lockstep\n");
+        return -1;
+    }
+    /* The pool covers a conference of any size, but not more jitter
+     * buffer slots than the engine was opened with. */
+    if (call_packet_buffers(config) > call->packet_pool.count)
+    {
+        fprintf(stderr, "The jitter buffer slot count has grown since the "
+                        "media engine was opened\n");
+        return -1;
+    }
+    int rate = call->sample_rate;
+    int packet = call->frame_size * config->packet_frames;
+    if (config->packet_frames < 1 || packet > AUDIO_PACKET_SAMPLES_MAX ||
+        packet * 1000 > rate * AUDIO_PACKET_MS_MAX)
+    {
+        fprintf(stderr, "Packets of %d frames exceed %d ms\n",
+                config->packet_frames, AUDIO_PACKET_MS_MAX);
+        return -1;
+    }
+    call->packet_size = packet;
+    call->peer_packet_size = packet;
+    call->peer_rate_mismatch = false;
+    call->peer_heard = false;
+    rtp_session_init(&call->rtp, rate, packet);
+    memset(&call->dtx, 0, sizeof(call->dtx));
+    call->dtx.enabled = config->dtx_enabled && !call->lockstep &&
+                        !config->conference && !config->latency_probe;
+    call->dtx.cn_refresh_frames = DTX_CN_REFRESH_MS * rate / 1000 / packet;
+    vad_init(&call->dtx.vad, rate, packet);
+    red_encoder_init(&call->fec.encoder);
+    call->fec.depth = config->fec_depth;
+    if (call->fec.depth == RED_DEPTH_AUTO)
+        call->fec.depth = 0;
+    call->fec.packets = 0;
+    call->first_audio_reported = false;
+    call->first_audio_ns = 0;
+    atomic_store(&call->gain_factor, config->gain_factor);
+    atomic_store(&call->noise_gate_threshold, config->noise_gate_threshold);
+    metrics_reset(&call->metrics);
+
+    if (net_socket_open(&call->net, config->local_port) == -1)
+        goto error_sockets;
+    memset(&call->peer_addr, 0, sizeof(call->peer_addr));
+    call->peer_addr.sin_family = AF_INET;
+    call->peer_addr.sin_port = htons(config->peer_port);
+    if (inet_pton(AF_INET, config->peer_ip, &call->peer_addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid peer address '%s'\n", config->peer_ip);
+        goto error_sockets;
+    }
+
+    rb_clear(&call->send_rb);
+    latency_trace_reset(&call->send_trace, 0);
+    /* Until the peer announces its packet size, assume it matches. */
+    if (jitter_buffer_set_frame_size(&call->jitter_buffer, packet) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_set_frame_size() failed\n");
+        goto error_sockets;
+    }
+    jitter_buffer_reset(&call->jitter_buffer);
+    callback_stats_reset(&call->callback_stats);
+    latency_init(&call->latency, config->latency_probe, rate);
+    if (config->impair.enabled)
+    {
+        char description[256];
+        if (impair_init(&call->impair, &config->impair) == -1)
+        {
+            fprintf(stderr, "impair_init() failed\n");
+            goto error_sockets;
+        }
+        impair_config_describe(&config->impair, description,
+                               sizeof(description));
+        printf("[IMPAIR] Receive path: %s.\n", description);
+    }
+    if (config->conference)
+    {
+        JitterBufferConfig jb_config = config->jb_config;
+        jb_config.frame_size = packet;
+        conference_init(&call->conference, config->codec, &jb_config,
+                        call->frame_size, config->conference_speakers);
+        call->conference.by_ssrc = config->relay_join;
+        for (int i = 0; i < config->conference_peer_count; i++)
+        {
+            const CallPeerAddress *peer = &config->conference_peers[i];
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(peer->port);
+            if (inet_pton(AF_INET, peer->ip, &addr.sin_addr) != 1)
+            {
+                fprintf(stderr, "Invalid peer address '%s'\n", peer->ip);
+                goto error_conference;
+            }
+            if (conference_add_peer(&call->conference, &addr) == -1)
+                goto error_conference;
+        }
+        printf("[CONF] %s with %d participants to start, mixing the %d "
+               "loudest.\n",
+               config->conference_bridge ? "Bridge" : "Conference",
+               config->conference_peer_count,
+               call->conference.mixer.speakers_max);
+    }
+    if (codec_encoder_open(&call->encoder, config->codec, rate, packet) ==
+        -1)
+    {
+        fprintf(stderr, "codec_encoder_open(%s) failed\n", config->codec->name);
+        goto error_conference;
+    }
+    printf("[INFO] Sending %s (payload type %d) in %.1f ms packets.\n",
+           config->codec->name, config->codec->payload_type,
+           1000.0 * packet / rate);
+    preprocess_configure(&call->preprocess, &config->preprocess);
+    char chain[256];
+    preprocess_describe(&call->preprocess, chain, sizeof(chain));
+    printf("[PREPROCESS] %s.\n", chain);
+    if (config->relay_join)
+        printf("[RELAY] Joining room %u through the peer.\n",
+               config->relay_room);
+    if (config->latency_probe)
+        printf("[LATENCY] Probing with a %d ms burst every %d ms; the peer "
+               "must loop its output back to its input.\n",
+               LATENCY_PROBE_BURST_MS, LATENCY_PROBE_INTERVAL_MS);
+    if (config->record_path &&
+        recorder_start(&call->recorder, config->record_path, rate) == -1)
+        goto error_encoder;
+    if (config->capture_path &&
+        capture_start(&call->capture, config->capture_path,
+                      config->local_port) == -1)
+        goto error_recorder;
+
+    pthread_mutex_lock(&call->state_lock);
+    atomic_store(&call->is_running, true);
+    pthread_cond_broadcast(&call->state_changed);
+    pthread_mutex_unlock(&call->state_lock);
+    frame_notifier_signal(&call->dsp_notifier);
+    if (!atomic_load(&call->audio.running) &&
+        audio_backend_start(&call->audio) == -1)
+    {
+        call_stop(call);
+        return -1;
+    }
+    call->setup_ns = monotonic_ns() - call->start_ns;
+    printf("[INFO] Call set up in %.1f ms.\n", call->setup_ns / 1e6);
+    return 0;
+
+error_recorder:
+    if (config->record_path)
+        recorder_stop(&call->recorder);
+error_encoder:
+    codec_encoder_close(&call->encoder);
+error_conference:
+    if (config->conference)
+        conference_destroy(&call->conference);
+    if (config->impair.enabled)
+        impair_destroy(&call->impair);
+error_sockets:
+    net_socket_close(&call->net);
+    rtp_session_destroy(&call->rtp);
+    return -1;
+}
+
+static void print_session_quality(RtpSession *rtp, const char *label)
+{
+    RtpStats stats;
+    rtp_session_get_stats(rtp, &stats);
+    printf("[RTP] %srx %llu packets, lost %lld (%.1f%%), jitter %.2f ms; "
+           "tx %llu packets",
+           label,
+           (unsigned long long)stats.packets_received,
+           (long long)stats.packets_lost, stats.fraction_lost * 100.0,
+           stats.jitter_ms, (unsigned long long)stats.packets_sent);
+    if (stats.have_remote_report)
+        printf(", peer lost %lld (%.1f%%), peer jitter %.2f ms",
+               (long long)stats.remote_packets_lost,
+               stats.remote_fraction_lost * 100.0, stats.remote_jitter_ms);
+    if (stats.have_rtt)
+        printf(", rtt %.1f ms", stats.rtt_ms);
+    printf("\n");
+}
+
+static void print_jitter_stats(JitterBuffer *jb, const char *label)
+{
+    JitterBufferStats jb_stats;
+    jitter_buffer_get_stats(jb, &jb_stats);
+    printf("[JITTER] %sdelay %.1f ms (target %.1f ms), jitter %.2f ms, "
+           "late loss %.2f%%, lost %llu, recovered %llu, underruns %llu, "
+           "comfort noise %llu, clock drift %+.1f ppm\n",
+           label, jb_stats.current_delay_ms, jb_stats.target_delay_ms,
+           jb_stats.jitter_ms, jb_stats.late_loss_rate * 100.0,
+           (unsigned long long)jb_stats.packets_lost,
+           (unsigned long long)jb_stats.frames_recovered,
+           (unsigned long long)jb_stats.underruns,
+           (unsigned long long)jb_stats.frames_comfort_noise,
+           jb_stats.drift_ppm);
+}
+
+void call_set_gain(Call *call, float gain_factor)
+{
+    call->config.gain_factor = gain_factor;
+    atomic_store_explicit(&call->gain_factor, gain_factor,
+                          memory_order_relaxed);
+}
+
+void call_set_gate(Call *call, float threshold)
+{
+    call->config.noise_gate_threshold = threshold;
+    atomic_store_explicit(&call->noise_gate_threshold, threshold,
+                          memory_order_relaxed);
+}
+
+void call_print_quality(Call *call)
+{
+    if (!call->config.conference)
+    {
+        print_session_quality(&call->rtp, "");
+        print_jitter_stats(&call->jitter_buffer, "");
+        return;
+    }
+    Conference *conf = &call->conference;
+    int count = atomic_load(&conf->count);
+    for (int i = 0; i < count; i++)
+    {
+        char label[64];
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &conf->peers[i].addr.sin_addr, ip, sizeof(ip));
+        snprintf(label, sizeof(label), "%s:%d: ", ip,
+                 ntohs(conf->peers[i].addr.sin_port));
+        print_session_quality(&conf->peers[i].rtp, label);
+    }
+}
+
+static void print_conference_stats(Call *call)
+{
+    Conference *conf = &call->conference;
+    int count = atomic_load(&conf->count);
+    uint64_t frames = conf->mixer.mixes;
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        char label[64];
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &peer->addr.sin_addr, ip, sizeof(ip));
+        snprintf(label, sizeof(label), "%s:%d: ", ip,
+                 ntohs(peer->addr.sin_port));
+        print_jitter_stats(&peer->jitter_buffer, label);
+        printf("[CONF] %smixed in %llu frames (%.1f%%)\n", label,
+               (unsigned long long)conf->mixer.frames_mixed[i],
+               frames ? 100.0 * conf->mixer.frames_mixed[i] / frames : 0.0);
+    }
+}
+
+static void call_print_stats(Call *call)
+{
+    uint64_t callbacks = atomic_load(&call->callback_stats.count);
+    printf("[AUDIO] callback avg %.1f us, worst %.1f us over %llu calls, "
+           "playout underruns %llu, capture overruns %llu\n",
+           callbacks ? atomic_load(&call->callback_stats.total_ns) / 1e3 /
+                           callbacks
+                     : 0.0,
+           atomic_load(&call->callback_stats.max_ns) / 1e3,
+           (unsigned long long)callbacks,
+           (unsigned long long)atomic_load(
+               &call->callback_stats.playout_underruns),
+           (unsigned long long)atomic_load(
+               &call->callback_stats.capture_overruns));
+    preprocess_print_stats(&call->preprocess, call->sample_rate);
+    if (call->config.conference)
+        print_conference_stats(call);
+    if (call->dtx.enabled)
+    {
+        uint64_t frames = call->dtx.frames_sent + call->dtx.frames_suppressed;
+        printf("[DTX] sent %llu of %llu frames (%.1f%%), "
+               "comfort noise packets %llu\n",
+               (unsigned long long)call->dtx.frames_sent,
+               (unsigned long long)frames,
+               frames ? 100.0 * call->dtx.frames_sent / frames : 0.0,
+               (unsigned long long)call->dtx.cn_packets);
+    }
+    if (call->config.impair.enabled)
+    {
+        ImpairStats *impair = &call->impair.stats;
+        printf("[IMPAIR] %llu datagrams in, %llu delivered, %llu lost, "
+               "%llu queue drops, %llu reordered, %llu duplicated\n",
+               (unsigned long long)impair->submitted,
+               (unsigned long long)impair->delivered,
+               (unsigned long long)impair->lost,
+               (unsigned long long)impair->queue_drops,
+               (unsigned long long)impair->reordered,
+               (unsigned long long)impair->duplicated);
+    }
+    if (call->fec.packets > 0)
+        printf("[FEC] sent %llu packets with redundancy, final depth %d\n",
+               (unsigned long long)call->fec.packets, call->fec.depth);
+    printf("[NET] received %llu packets in %llu syscalls, "
+           "sent %llu packets in %llu syscalls\n",
+           (unsigned long long)call->net.packets_received,
+           (unsigned long long)call->net.recv_calls,
+           (unsigned long long)call->net.packets_sent,
+           (unsigned long long)call->net.send_calls);
+    uint64_t exhausted = atomic_load(&call->packet_pool.exhausted);
+    if (exhausted > 0)
+        printf("[NET] packet pool ran out of buffers %llu times\n",
+               (unsigned long long)exhausted);
+    call_print_quality(call);
+    latency_print(&call->latency);
+}
+
+void call_stop(Call *call)
+{
+    if (!atomic_load(&call->is_running))
+        return;
+    pthread_mutex_lock(&call->state_lock);
+    atomic_store(&call->is_running, false);
+    pthread_mutex_unlock(&call->state_lock);
+    frame_notifier_signal(&call->dsp_notifier);
+    frame_notifier_signal(&call->send_notifier);
+    frame_notifier_signal(&call->playout_notifier);
+    if (!call->audio.stream)
+        audio_backend_stop(&call->audio);
+    pthread_mutex_lock(&call->state_lock);
+    while (call->threads_in_call > 0)
+        pthread_cond_wait(&call->state_changed, &call->state_lock);
+    pthread_mutex_unlock(&call->state_lock);
+    if (call->config.record_path)
+        recorder_stop(&call->recorder);
+    if (call->config.capture_path)
+        capture_stop(&call->capture);
+    codec_encoder_close(&call->encoder);
+    call_print_stats(call);
+    net_socket_close(&call->net);
+    rtp_session_destroy(&call->rtp);
+    if (call->config.impair.enabled)
+        impair_destroy(&call->impair);
+    if (call->config.conference)
+        conference_destroy(&call->conference);
+}
@@ -0,0 +1,242 @@
+#ifndef CALL_H
+#define CALL_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <speex/speex_echo.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_backend.h"
+#include "callback_stats.h"
+#include "capture.h"
+#include "codec.h"
+#include "comfort_noise.h"
+#include "conference.h"
+#include "frame_notifier.h"
+#include "impair.h"
+#include "jitter_buffer.h"
+#include "latency.h"
+#include "metrics.h"
+#include "net_io.h"
+#include "packet_pool.h"
+#include "preprocess.h"
+#include "red.h"
+#include "relay.h"
+#include "ring_buffer.h"
+#include "recorder.h"
+#include "rtp.h"
+#include "vad.h"
+
+#define DSP_RING_FRAMES (8)
+#define DSP_PLAYOUT_PREFILL_FRAMES (2)
+#define DSP_PLAYOUT_MAX_FRAMES (4)
+#define DSP_DEFAULT_RT_PRIORITY (60)
+#define CALL_PEER_IP_MAX (64)
+#define DTX_CN_REFRESH_MS (500)
+#define DTX_CN_LEVEL_DELTA (3)
+
+typedef struct
+{
+    char ip[CALL_PEER_IP_MAX];
+    int port;
+} CallPeerAddress;
+
+/* With conference set the call talks to every participant in
+ * conference_peers (peer_ip and peer_port are not used) and to anyone else
+ * who calls in while there is room. A bridge sends each participant the
+ * near end mixed with everyone else (mix-minus), so two-party clients
+ * calling in hear each other; otherwise each participant gets the near end
+ * alone, as in a full mesh where everyone calls everyone.
+ *
+ * With relay_join the peer (or each conference participant) is a
+ * voip_relay, which is asked to put this call into relay_room. In a
+ * conference the other members then all arrive from the relay's address
+ * and are told apart by SSRC.
+ *
+ * Every stage of the audio path is timed into latency histograms. With
+ * capture_time each packet of a two-party call also tells the peer when
+ * its frame was captured, from which the peer derives the network delay
+ * and the whole mouth-to-ear delay. latency_probe replaces the microphone
+ * with periodic tone bursts and times their return from a peer that loops
+ * its output back to its input.
+ *
+ * The near end goes through the echo canceller and the stages of
+ * preprocess (preprocess.h), then the gate at noise_gate_threshold and
+ * gain_factor. Without DTX the gate closes on frames that are not speech
+ * or are quieter than the threshold; with DTX the send side decides.
+ *
+ * With record_path set the near end after preprocessing and the far
+ * end as played are written to a stereo WAV file by a background thread.
+ * With capture_path set every datagram handed to the receive path is
+ * written to a pcap file, stamped with the arrival time the jitter buffer
+ * was given, for replay offline (replay.h).
+ *
+ * audio.sample_rate and audio.frame_size set the format the engine runs
+ * at: the audio callback, the DSP thread and the echo canceller work in
+ * frames of frame_size, and each packet carries packet_frames of them.
+ * The packet size is announced to the peer, whose jitter buffer follows
+ * it, so the two ends may packetize differently; the sample rate has to
+ * match.
+ *
+ * audio, jb_config, aec_enabled, aec_tail_ms, dsp_rt_priority and dsp_cpu
+ * belong to the media engine and are read when it opens; the rest is read
+ * by every call_start. */
+typedef struct
+{
+    char peer_ip[CALL_PEER_IP_MAX];
+    int peer_port;
+    int local_port;
+    const Codec *codec;
+    JitterBufferConfig jb_config;
+    AudioBackendConfig audio;
+    bool aec_enabled;
+    int aec_tail_ms;
+    int packet_frames;
+    bool dtx_enabled;
+    int fec_depth;
+    ImpairConfig impair;
+    bool conference;
+    bool conference_bridge;
+    int conference_speakers;
+    CallPeerAddress conference_peers[CONFERENCE_PEERS_MAX];
+    int conference_peer_count;
+    bool relay_join;
+    uint32_t relay_room;
+    bool capture_time;
+    bool latency_probe;
+    const char *record_path;
+    const char *capture_path;
+    PreprocessConfig preprocess;
+    float gain_factor;
+    float noise_gate_threshold;
+    int dsp_rt_priority;
+    int dsp_cpu;
+} CallConfig;
+
+/* Discontinuous transmission on the send side, owned by the network
+ * thread. */
+typedef struct
+{
+    bool enabled;
+    Vad vad;
+    bool silent;
+    int frames_since_cn;
+    int cn_refresh_frames;
+    uint8_t cn_level;
+    uint64_t frames_sent;
+    uint64_t frames_suppressed;
+    uint64_t cn_packets;
+} CallDtx;
+
+/* RFC 2198 redundancy on the send side, owned by the network thread.
+ * depth follows the loss the peer reports unless the config fixes it. */
+typedef struct
+{
+    RedEncoder encoder;
+    int depth;
+    uint64_t packets;
+} CallFec;
+
+/* The media pipeline of one call, independent of the UI. A single network
+ * thread owns the UDP socket and batches sends and receives. With a fast
+ * audio clock the call runs in lockstep: with each captured frame the DSP
+ * thread takes exactly the packets the peer completed by then and plays
+ * one frame, so the output does not depend on scheduling. A conference
+ * replaces the single jitter buffer, RTP session and send queue with one
+ * set per participant; DTX and redundancy are only used in two-party
+ * calls.
+ *
+ * The media engine outlives the calls made with it: the audio stream, the
+ * rings, the packet pool, the jitter buffer, the echo canceller, the
+ * preprocessor and the DSP and network threads are set up once by
+ * call_engine_open. Between calls the stream keeps running on silence and
+ * the threads wait, so call_start only opens the socket and the encoder
+ * and switches the threads over, and the echo canceller and the
+ * preprocessor keep what they have learned about the room. A file
+ * clock, which would otherwise run through its input, only runs during a
+ * call. */
+typedef struct
+{
+    CallConfig config;
+    bool engine_open;
+    atomic_bool engine_closing;
+    pthread_mutex_t state_lock;
+    pthread_cond_t state_changed;
+    int threads_in_call;
+    atomic_bool is_running;
+    bool lockstep;
+    int sample_rate;
+    int frame_size;
+    int packet_size;
+    int peer_packet_size;
+    bool peer_rate_mismatch;
+    /* The peer has been heard, so it is listening for our format. */
+    bool peer_heard;
+    NetSocket net;
+    struct sockaddr_in peer_addr;
+    RtpSession rtp;
+    CallDtx dtx;
+    CallFec fec;
+    Impairment impair;
+    Conference conference;
+    PacketPool packet_pool;
+    uint64_t next_join_ns;
+    CodecEncoder encoder;
+    RingBuffer send_rb;
+    FrameNotifier send_notifier;
+    pthread_t net_tid;
+    RingBuffer capture_rb;
+    RingBuffer playout_rb;
+    FrameNotifier dsp_notifier;
+    FrameNotifier playout_notifier;
+    pthread_t dsp_tid;
+    CallbackStats callback_stats;
+    Latency latency;
+    LatencyTrace capture_trace;
+    LatencyTrace send_trace;
+    LatencyTrace playout_trace;
+    Recorder recorder;
+    Capture capture;
+    JitterBuffer jitter_buffer;
+    SpeexEchoState *echo_state;
+    Preprocess preprocess;
+    AudioBackend audio;
+    Metrics metrics;
+    /* config.gain_factor and config.noise_gate_threshold as the DSP and
+     * network threads read them; the UI may change them during a call. */
+    _Atomic float gain_factor;
+    _Atomic float noise_gate_threshold;
+    uint64_t start_ns;
+    uint64_t setup_ns;
+    uint64_t first_audio_ns;
+    bool first_audio_reported;
+    void (*on_first_audio)(void *user_data);
+    void *user_data;
+} Call;
+
+void call_config_default(CallConfig *config);
+/* Opens the audio stream and starts the engine's threads, idle. */
+int call_engine_open(Call *call);
+/* Ends any call, joins the threads and closes the stream. */
+void call_engine_close(Call *call);
+/* Starts a call on the engine, opening the engine first if need be, and
+ * prints how long that took. first_audio_ns is the time from here until
+ * the peer's audio is ready to play, set before on_first_audio runs. */
+int call_start(Call *call);
+/* Ends the call and prints its statistics; the engine stays open. */
+void call_stop(Call *call);
+/* The audio callback: moves one buffer between the backend and the capture
+ * and playout rings and wakes the DSP thread. */
+void call_audio_process(const SAMPLE *mic_in, SAMPLE *speaker_out, int frames,
+                        const AudioCallbackInfo *info, void *user_data);
+/* Change the near-end gain or the gate threshold, also during a call. */
+void call_set_gain(Call *call, float gain_factor);
+void call_set_gate(Call *call, float threshold);
+/* Prints the RTP/RTCP quality of both directions as one "[RTP]" line and,
+ * outside a conference, the jitter buffer's depth and clock drift as a
+ * "[JITTER]" line. */
+void call_print_quality(Call *call);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef CALLBACK_STATS_H
+#define CALLBACK_STATS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Execution time of the audio callback. Written only by the callback
+ * itself, read from any thread. */
+typedef struct
+{
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+    atomic_uint_fast64_t playout_underruns;
+    atomic_uint_fast64_t capture_overruns;
+} CallbackStats;
+
+static inline void callback_stats_reset(CallbackStats *stats)
+{
+    atomic_store(&stats->count, 0);
+    atomic_store(&stats->total_ns, 0);
+    atomic_store(&stats->max_ns, 0);
+    atomic_store(&stats->playout_underruns, 0);
+    atomic_store(&stats->capture_overruns, 0);
+}
+
+static inline void callback_stats_record(CallbackStats *stats, uint64_t ns)
+{
+    atomic_fetch_add_explicit(&stats->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->total_ns, ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&stats->max_ns, memory_order_relaxed))
+        atomic_store_explicit(&stats->max_ns, ns, memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,366 @@
+#include "capture.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "time_util.h"
+
+#define PCAP_MAGIC_NS (0xa1b23c4du)
+#define PCAP_MAGIC_US (0xa1b2c3d4u)
+#define PCAP_LINK_ETHERNET (1)
+#define PCAP_LINK_RAW_BSD (12)
+#define PCAP_LINK_RAW (101)
+#define PCAP_LINK_LINUX_SLL (113)
+#define PCAP_LINK_IPV4 (228)
+#define PCAP_FILE_HEADER_SIZE (24)
+#define PCAP_RECORD_HEADER_SIZE (16)
+#define IPV4_HEADER_SIZE (20)
+#define UDP_HEADER_SIZE (8)
+#define ETHERTYPE_IPV4 (0x0800)
+#define ETHERTYPE_VLAN (0x8100)
+
+/* What the network thread queues ahead of each datagram, in whole
+ * samples of the ring. */
+typedef struct
+{
+    uint64_t arrival_ns;
+    uint32_t addr;
+    uint16_t port;
+    uint16_t length;
+} CaptureEntry;
+
+#define ENTRY_SAMPLES (sizeof(CaptureEntry) / sizeof(SAMPLE))
+
+static size_t payload_samples(int length)
+{
+    return ((size_t)length + sizeof(SAMPLE) - 1) / sizeof(SAMPLE);
+}
+
+static void put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint16_t ipv4_checksum(const uint8_t *header)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < IPV4_HEADER_SIZE; i += 2)
+        sum += get_u16(header + i);
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/* Writes one pcap record: the datagram behind an IPv4 and UDP header from
+ * the sender to the local port. The UDP checksum is left out (zero), as
+ * IPv4 allows. */
+static int write_record(Capture *capture, const CaptureEntry *entry,
+                        const uint8_t *payload)
+{
+    uint8_t headers[PCAP_RECORD_HEADER_SIZE + IPV4_HEADER_SIZE +
+                    UDP_HEADER_SIZE];
+    uint64_t wall_ns = entry->arrival_ns + capture->wall_offset_ns;
+    uint32_t record[4];
+    uint32_t size = IPV4_HEADER_SIZE + UDP_HEADER_SIZE + entry->length;
+    record[0] = (uint32_t)(wall_ns / 1000000000ull);
+    record[1] = (uint32_t)(wall_ns % 1000000000ull);
+    record[2] = size;
+    record[3] = size;
+    memcpy(headers, record, sizeof(record));
+
+    uint8_t *ip = headers + PCAP_RECORD_HEADER_SIZE;
+    memset(ip, 0, IPV4_HEADER_SIZE + UDP_HEADER_SIZE);
+    ip[0] = 0x45;
+    put_u16(ip + 2, (uint16_t)size);
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    memcpy(ip + 12, &entry->addr, 4);
+    uint32_t local = htonl(INADDR_LOOPBACK);
+    memcpy(ip + 16, &local, 4);
+    put_u16(ip + 10, ipv4_checksum(ip));
+    uint8_t *udp = ip + IPV4_HEADER_SIZE;
+    put_u16(udp, ntohs(entry->port));
+    put_u16(udp + 2, capture->local_port);
+    put_u16(udp + 4, (uint16_t)(UDP_HEADER_SIZE + entry->length));
+
+    if (fwrite(headers, sizeof(headers), 1, capture->file) != 1 ||
+        fwrite(payload, entry->length, 1, capture->file) != 1)
+        return -1;
+    return 0;
+}
+
+static void write_queued(Capture *capture)
+{
+    SAMPLE payload[CAPTURE_SNAPLEN / sizeof(SAMPLE)];
+    CaptureEntry entry;
+    bool wrote = false;
+    while (rb_available_read(&capture->ring) >= ENTRY_SAMPLES)
+    {
+        rb_read(&capture->ring, (SAMPLE *)&entry, ENTRY_SAMPLES);
+        rb_read(&capture->ring, payload, payload_samples(entry.length));
+        if (write_record(capture, &entry, (const uint8_t *)payload) == -1)
+            atomic_fetch_add(&capture->write_errors, 1);
+        else
+            atomic_fetch_add(&capture->packets_written, 1);
+        wrote = true;
+    }
+    if (wrote)
+        fflush(capture->file);
+}
+
+static void *writer_thread_func(void *data)
+{
+    Capture *capture = (Capture *)data;
+    while (atomic_load(&capture->running))
+    {
+        frame_notifier_wait(&capture->notifier, CAPTURE_FLUSH_MS);
+        write_queued(capture);
+    }
+    write_queued(capture);
+    return NULL;
+}
+
+int capture_start(Capture *capture, const char *path, int local_port)
+{
+    capture->local_port = (uint16_t)local_port;
+    capture->pending = 0;
+    capture->wall_offset_ns = realtime_ns() - monotonic_ns();
+    atomic_store(&capture->packets_written, 0);
+    atomic_store(&capture->packets_dropped, 0);
+    atomic_store(&capture->write_errors, 0);
+    capture->file = fopen(path, "wb");
+    if (!capture->file)
+    {
+        fprintf(stderr, "Cannot create capture '%s'\n", path);
+        return -1;
+    }
+    /* Written in our byte order; readers tell it from the magic. */
+    uint8_t header[PCAP_FILE_HEADER_SIZE] = {0};
+    uint32_t magic = PCAP_MAGIC_NS, snaplen = CAPTURE_SNAPLEN;
+    uint32_t link_type = PCAP_LINK_RAW;
+    uint16_t version[2] = {2, 4};
+    memcpy(header, &magic, 4);
+    memcpy(header + 4, version, 4);
+    memcpy(header + 16, &snaplen, 4);
+    memcpy(header + 20, &link_type, 4);
+    if (fwrite(header, sizeof(header), 1, capture->file) != 1)
+    {
+        perror("fwrite() of the capture header failed");
+        goto error_file;
+    }
+    if (frame_notifier_init(&capture->notifier) == -1)
+    {
+        perror("frame_notifier_init() failed");
+        goto error_file;
+    }
+    if (rb_init(&capture->ring, CAPTURE_BUFFER_BYTES / sizeof(SAMPLE)) == -1)
+    {
+        fprintf(stderr, "Cannot allocate the capture buffer\n");
+        goto error_notifier;
+    }
+    atomic_store(&capture->running, true);
+    if (pthread_create(&capture->tid, NULL, writer_thread_func, capture) != 0)
+    {
+        perror("pthread_create() failed");
+        goto error_ring;
+    }
+    printf("[CAPTURE] Capturing received packets to %s.\n", path);
+    return 0;
+
+error_ring:
+    atomic_store(&capture->running, false);
+    rb_destroy(&capture->ring);
+error_notifier:
+    frame_notifier_destroy(&capture->notifier);
+error_file:
+    fclose(capture->file);
+    capture->file = NULL;
+    return -1;
+}
+
+void capture_packet(Capture *capture, const uint8_t *datagram, int length,
+                    const struct sockaddr_in *from, uint64_t arrival_ns)
+{
+    SAMPLE entry[ENTRY_SAMPLES + CAPTURE_SNAPLEN / sizeof(SAMPLE)];
+    if (length <= 0)
+        return;
+    if (length > CAPTURE_SNAPLEN)
+        length = CAPTURE_SNAPLEN;
+    size_t samples = ENTRY_SAMPLES + payload_samples(length);
+    if (rb_available_write(&capture->ring) < samples)
+    {
+        atomic_fetch_add_explicit(&capture->packets_dropped, 1,
+                                  memory_order_relaxed);
+        return;
+    }
+    /* Header and payload go in with one write, so the writer never sees
+     * one without the other. */
+    CaptureEntry header;
+    header.arrival_ns = arrival_ns;
+    header.addr = from ? from->sin_addr.s_addr : 0;
+    header.port = from ? from->sin_port : 0;
+    header.length = (uint16_t)length;
+    memcpy(entry, &header, sizeof(header));
+    memcpy(entry + ENTRY_SAMPLES, datagram, length);
+    rb_write(&capture->ring, entry, samples);
+    if (++capture->pending >= CAPTURE_WAKE_PACKETS)
+    {
+        capture->pending = 0;
+        frame_notifier_signal(&capture->notifier);
+    }
+}
+
+void capture_stop(Capture *capture)
+{
+    atomic_store(&capture->running, false);
+    frame_notifier_signal(&capture->notifier);
+    pthread_join(capture->tid, NULL);
+    fclose(capture->file);
+    capture->file = NULL;
+    rb_destroy(&capture->ring);
+    frame_notifier_destroy(&capture->notifier);
+    printf("[CAPTURE] %llu packets written, %llu dropped, %llu write "
+           "errors\n",
+           (unsigned long long)atomic_load(&capture->packets_written),
+           (unsigned long long)atomic_load(&capture->packets_dropped),
+           (unsigned long long)atomic_load(&capture->write_errors));
+}
+
+static uint32_t reader_u32(const CaptureReader *reader, const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return reader->swapped ? __builtin_bswap32(value) : value;
+}
+
+int capture_reader_open(CaptureReader *reader, const char *path)
+{
+    uint8_t header[PCAP_FILE_HEADER_SIZE];
+    reader->file = fopen(path, "rb");
+    if (!reader->file)
+    {
+        fprintf(stderr, "Cannot open capture '%s'\n", path);
+        return -1;
+    }
+    if (fread(header, sizeof(header), 1, reader->file) != 1)
+        goto error_format;
+    uint32_t magic;
+    memcpy(&magic, header, sizeof(magic));
+    reader->swapped = magic == __builtin_bswap32(PCAP_MAGIC_NS) ||
+                      magic == __builtin_bswap32(PCAP_MAGIC_US);
+    if (reader->swapped)
+        magic = __builtin_bswap32(magic);
+    if (magic != PCAP_MAGIC_NS && magic != PCAP_MAGIC_US)
+        goto error_format;
+    reader->nanoseconds = magic == PCAP_MAGIC_NS;
+    reader->link_type = reader_u32(reader, header + 20) & 0xffff;
+    return 0;
+
+error_format:
+    fprintf(stderr, "'%s' is not a pcap file\n", path);
+    fclose(reader->file);
+    reader->file = NULL;
+    return -1;
+}
+
+/* Finds the IPv4 header behind the link layer; NULL if there is none. */
+static const uint8_t *link_payload(const CaptureReader *reader,
+                                   const uint8_t *frame, uint32_t *length)
+{
+    size_t skip;
+    uint16_t type;
+    switch (reader->link_type)
+    {
+    case PCAP_LINK_RAW:
+    case PCAP_LINK_RAW_BSD:
+    case PCAP_LINK_IPV4:
+        return frame;
+    case PCAP_LINK_ETHERNET:
+        if (*length < 14)
+            return NULL;
+        skip = 14;
+        type = get_u16(frame + 12);
+        if (type == ETHERTYPE_VLAN && *length >= 18)
+        {
+            skip = 18;
+            type = get_u16(frame + 16);
+        }
+        break;
+    case PCAP_LINK_LINUX_SLL:
+        if (*length < 16)
+            return NULL;
+        skip = 16;
+        type = get_u16(frame + 14);
+        break;
+    default:
+        return NULL;
+    }
+    if (type != ETHERTYPE_IPV4)
+        return NULL;
+    *length -= (uint32_t)skip;
+    return frame + skip;
+}
+
+int capture_reader_next(CaptureReader *reader, uint8_t *datagram,
+                        int capacity, CapturedDatagram *info)
+{
+    uint8_t header[PCAP_RECORD_HEADER_SIZE];
+    for (;;)
+    {
+        if (fread(header, sizeof(header), 1, reader->file) != 1)
+            return 0;
+        uint32_t seconds = reader_u32(reader, header);
+        uint32_t fraction = reader_u32(reader, header + 4);
+        uint32_t length = reader_u32(reader, header + 8);
+        if (length > CAPTURE_SNAPLEN * 32u)
+            return -1;
+        uint32_t kept = length < CAPTURE_SNAPLEN ? length : CAPTURE_SNAPLEN;
+        if (fread(reader->record, 1, kept, reader->file) != kept ||
+            (length > kept &&
+             fseek(reader->file, (long)(length - kept), SEEK_CUR) != 0))
+            return -1;
+
+        const uint8_t *ip = link_payload(reader, reader->record, &kept);
+        if (!ip || kept < IPV4_HEADER_SIZE || (ip[0] >> 4) != 4 ||
+            ip[9] != IPPROTO_UDP)
+            continue;
+        /* Fragments are skipped; media datagrams fit in one packet. */
+        if (get_u16(ip + 6) & 0x3fff)
+            continue;
+        uint32_t ip_header = (ip[0] & 0x0f) * 4u;
+        if (kept < ip_header + UDP_HEADER_SIZE)
+            continue;
+        const uint8_t *udp = ip + ip_header;
+        int udp_length = get_u16(udp + 4) - UDP_HEADER_SIZE;
+        int available = (int)(kept - ip_header - UDP_HEADER_SIZE);
+        if (udp_length <= 0)
+            continue;
+        if (udp_length > available)
+            udp_length = available;
+        if (udp_length > capacity)
+            udp_length = capacity;
+        memcpy(datagram, udp + UDP_HEADER_SIZE, udp_length);
+        info->time_ns = (uint64_t)seconds * 1000000000ull +
+                        (reader->nanoseconds ? fraction : fraction * 1000ull);
+        memset(&info->from, 0, sizeof(info->from));
+        info->from.sin_family = AF_INET;
+        memcpy(&info->from.sin_addr.s_addr, ip + 12, 4);
+        info->from.sin_port = htons(get_u16(udp));
+        info->to_port = get_u16(udp + 2);
+        return udp_length;
+    }
+}
+
+void capture_reader_close(CaptureReader *reader)
+{
+    if (reader->file)
+        fclose(reader->file);
+    reader->file = NULL;
+}
@@ -0,0 +1,81 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "frame_notifier.h"
+#include "ring_buffer.h"
+
+/* Queued datagrams the writer may fall behind by before some are dropped. */
+#define CAPTURE_BUFFER_BYTES (4 << 20)
+/* The writer is woken after this many datagrams, or at the latest after
+ * CAPTURE_FLUSH_MS. */
+#define CAPTURE_WAKE_PACKETS (64)
+#define CAPTURE_FLUSH_MS (250)
+/* The longest datagram kept; longer ones are cut, as tcpdump's -s does. */
+#define CAPTURE_SNAPLEN (2048)
+
+/* Captures received datagrams to a pcap file with nanosecond timestamps,
+ * each wrapped in a made-up IPv4 and UDP header (link type RAW) so that
+ * Wireshark decodes them as RTP. The timestamp is the arrival time the
+ * jitter buffer was given, shifted once onto the wall clock, so the
+ * differences between packets are exact. Like the recorder, the network
+ * thread only copies each datagram into a ring; a writer thread empties it
+ * to disk. When the ring is full the datagram is dropped and counted. */
+typedef struct
+{
+    RingBuffer ring;
+    FrameNotifier notifier;
+    FILE *file;
+    pthread_t tid;
+    atomic_bool running;
+    uint64_t wall_offset_ns;
+    uint16_t local_port;
+    int pending;
+    _Atomic uint64_t packets_written;
+    _Atomic uint64_t packets_dropped;
+    _Atomic uint64_t write_errors;
+} Capture;
+
+int capture_start(Capture *capture, const char *path, int local_port);
+/* Receiving thread (the network thread, or the DSP thread in lockstep):
+ * queues one datagram received from 'from' at arrival_ns. */
+void capture_packet(Capture *capture, const uint8_t *datagram, int length,
+                    const struct sockaddr_in *from, uint64_t arrival_ns);
+/* Writes what is still queued, closes the file and prints a "[CAPTURE]"
+ * line. */
+void capture_stop(Capture *capture);
+
+/* A UDP datagram read back from a capture. */
+typedef struct
+{
+    uint64_t time_ns;
+    struct sockaddr_in from;
+    uint16_t to_port;
+} CapturedDatagram;
+
+/* Reads UDP over IPv4 from pcap files in either byte order with micro- or
+ * nanosecond timestamps, as written above or by tcpdump on Ethernet, raw
+ * IP or Linux cooked links. Other packets are skipped. */
+typedef struct
+{
+    FILE *file;
+    bool swapped;
+    bool nanoseconds;
+    uint32_t link_type;
+    uint8_t record[CAPTURE_SNAPLEN];
+} CaptureReader;
+
+int capture_reader_open(CaptureReader *reader, const char *path);
+/* Copies the next UDP payload into datagram and returns its length; 0 at
+ * the end of the file, -1 if the file is damaged. */
+int capture_reader_next(CaptureReader *reader, uint8_t *datagram,
+                        int capacity, CapturedDatagram *info);
+void capture_reader_close(CaptureReader *reader);
+
+#endif
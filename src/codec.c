@@ -0,0 +1,148 @@
+#include "codec.h"
+
+#include <string.h>
+#include <strings.h>
+
+static const Codec *const codecs[] = {
+    &codec_l16,
+    &codec_pcmu,
+    &codec_pcma,
+    &codec_ima_adpcm,
+#ifdef HAVE_OPUS
+    &codec_opus,
+#endif
+};
+
+#define CODEC_COUNT ((int)(sizeof(codecs) / sizeof(codecs[0])))
+
+static int l16_max_payload_bytes(int frames)
+{
+    return frames * (int)sizeof(SAMPLE);
+}
+
+static int l16_encode(void *state, const SAMPLE *pcm, int frames, uint8_t *out,
+                      int capacity)
+{
+    if (capacity < frames * 2)
+        return -1;
+    for (int i = 0; i < frames; i++)
+    {
+        uint16_t v = (uint16_t)pcm[i];
+        out[2 * i] = (uint8_t)(v >> 8);
+        out[2 * i + 1] = (uint8_t)v;
+    }
+    return frames * 2;
+}
+
+static int l16_decode(void *state, const uint8_t *payload, int bytes,
+                      SAMPLE *pcm, int frames)
+{
+    int count = bytes / 2;
+    if (count > frames)
+        count = frames;
+    for (int i = 0; i < count; i++)
+        pcm[i] = (SAMPLE)(uint16_t)((payload[2 * i] << 8) | payload[2 * i + 1]);
+    return count;
+}
+
+const Codec codec_l16 = {
+    .name = "L16",
+    .payload_type = PAYLOAD_L16,
+    .max_payload_bytes = l16_max_payload_bytes,
+    .encode = l16_encode,
+    .decode = l16_decode,
+};
+
+const Codec *codec_find(uint8_t payload_type)
+{
+    for (int i = 0; i < CODEC_COUNT; i++)
+    {
+        if (codecs[i]->payload_type == payload_type)
+            return codecs[i];
+    }
+    return NULL;
+}
+
+const Codec *codec_find_by_name(const char *name)
+{
+    for (int i = 0; i < CODEC_COUNT; i++)
+    {
+        if (strcasecmp(codecs[i]->name, name) == 0)
+            return codecs[i];
+    }
+    return NULL;
+}
+
+const Codec *codec_at(int index)
+{
+    if (index < 0 || index >= CODEC_COUNT)
+        return NULL;
+    return codecs[index];
+}
+
+int codec_count(void)
+{
+    return CODEC_COUNT;
+}
+
+int codec_encoder_open(CodecEncoder *enc, const Codec *codec, int sample_rate,
+                       int frames)
+{
+    enc->codec = codec;
+    enc->state = NULL;
+    if (codec->encoder_create)
+    {
+        enc->state = codec->encoder_create(sample_rate, frames);
+        if (!enc->state)
+        {
+            enc->codec = NULL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void codec_encoder_close(CodecEncoder *enc)
+{
+    if (enc->codec && enc->codec->encoder_destroy && enc->state)
+        enc->codec->encoder_destroy(enc->state);
+    enc->codec = NULL;
+    enc->state = NULL;
+}
+
+int codec_encode(CodecEncoder *enc, const SAMPLE *pcm, int frames,
+                 uint8_t *out, int capacity)
+{
+    return enc->codec->encode(enc->state, pcm, frames, out, capacity);
+}
+
+int codec_decoder_open(CodecDecoder *dec, const Codec *codec, int sample_rate,
+                       int frames)
+{
+    dec->codec = codec;
+    dec->state = NULL;
+    if (codec->decoder_create)
+    {
+        dec->state = codec->decoder_create(sample_rate, frames);
+        if (!dec->state)
+        {
+            dec->codec = NULL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void codec_decoder_close(CodecDecoder *dec)
+{
+    if (dec->codec && dec->codec->decoder_destroy && dec->state)
+        dec->codec->decoder_destroy(dec->state);
+    dec->codec = NULL;
+    dec->state = NULL;
+}
+
+int codec_decode(CodecDecoder *dec, const uint8_t *payload, int bytes,
+                 SAMPLE *pcm, int frames)
+{
+    return dec->codec->decode(dec->state, payload, bytes, pcm, frames);
+}
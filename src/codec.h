@@ -0,0 +1,74 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+
+#include "audio_config.h"
+
+typedef enum
+{
+    PAYLOAD_PCMU = 0,
+    PAYLOAD_PCMA = 8,
+    PAYLOAD_L16 = 11,
+    PAYLOAD_CN = 13,
+    PAYLOAD_IMA_ADPCM = 96,
+    PAYLOAD_OPUS = 111,
+    PAYLOAD_RED = 121,
+} PayloadType;
+
+/* Encoder and decoder state is created per direction; stateless codecs
+ * return NULL from their create hooks. encode() returns the payload size in
+ * bytes and decode() the number of samples produced, or -1 on error. */
+typedef struct
+{
+    const char *name;
+    uint8_t payload_type;
+    int (*max_payload_bytes)(int frames);
+    void *(*encoder_create)(int sample_rate, int frames);
+    void (*encoder_destroy)(void *state);
+    int (*encode)(void *state, const SAMPLE *pcm, int frames, uint8_t *out,
+                  int capacity);
+    void *(*decoder_create)(int sample_rate, int frames);
+    void (*decoder_destroy)(void *state);
+    int (*decode)(void *state, const uint8_t *payload, int bytes, SAMPLE *pcm,
+                  int frames);
+} Codec;
+
+typedef struct
+{
+    const Codec *codec;
+    void *state;
+} CodecEncoder;
+
+typedef struct
+{
+    const Codec *codec;
+    void *state;
+} CodecDecoder;
+
+extern const Codec codec_l16;
+extern const Codec codec_pcmu;
+extern const Codec codec_pcma;
+extern const Codec codec_ima_adpcm;
+#ifdef HAVE_OPUS
+extern const Codec codec_opus;
+#endif
+
+const Codec *codec_find(uint8_t payload_type);
+const Codec *codec_find_by_name(const char *name);
+const Codec *codec_at(int index);
+int codec_count(void);
+
+int codec_encoder_open(CodecEncoder *enc, const Codec *codec, int sample_rate,
+                       int frames);
+void codec_encoder_close(CodecEncoder *enc);
+int codec_encode(CodecEncoder *enc, const SAMPLE *pcm, int frames,
+                 uint8_t *out, int capacity);
+
+int codec_decoder_open(CodecDecoder *dec, const Codec *codec, int sample_rate,
+                       int frames);
+void codec_decoder_close(CodecDecoder *dec);
+int codec_decode(CodecDecoder *dec, const uint8_t *payload, int bytes,
+                 SAMPLE *pcm, int frames);
+
+#endif
@@ -0,0 +1,148 @@
+#include "codec.h"
+
+#include <stdlib.h>
+
+#define ADPCM_HEADER_BYTES (4)
+
+typedef struct
+{
+    int predictor;
+    int index;
+} AdpcmState;
+
+static const int8_t ima_index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                           -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t ima_step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static inline int clamp_sample(int v)
+{
+    return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+static inline int clamp_index(int v)
+{
+    return v > 88 ? 88 : (v < 0 ? 0 : v);
+}
+
+static inline uint8_t adpcm_encode_sample(AdpcmState *st, int sample)
+{
+    int step = ima_step_table[st->index];
+    int diff = sample - st->predictor;
+    int code = 0;
+    if (diff < 0)
+    {
+        code = 8;
+        diff = -diff;
+    }
+    int delta = step >> 3;
+    if (diff >= step)
+    {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        code |= 1;
+        delta += step;
+    }
+    st->predictor = clamp_sample(st->predictor + ((code & 8) ? -delta : delta));
+    st->index = clamp_index(st->index + ima_index_table[code]);
+    return (uint8_t)code;
+}
+
+static inline SAMPLE adpcm_decode_sample(AdpcmState *st, uint8_t code)
+{
+    int step = ima_step_table[st->index];
+    int delta = step >> 3;
+    if (code & 4)
+        delta += step;
+    if (code & 2)
+        delta += step >> 1;
+    if (code & 1)
+        delta += step >> 2;
+    st->predictor = clamp_sample(st->predictor + ((code & 8) ? -delta : delta));
+    st->index = clamp_index(st->index + ima_index_table[code]);
+    return (SAMPLE)st->predictor;
+}
+
+static int adpcm_max_payload_bytes(int frames)
+{
+    return ADPCM_HEADER_BYTES + (frames + 1) / 2;
+}
+
+static void *adpcm_encoder_create(int sample_rate, int frames)
+{
+    return calloc(1, sizeof(AdpcmState));
+}
+
+static int adpcm_encode(void *state, const SAMPLE *pcm, int frames,
+                        uint8_t *out, int capacity)
+{
+    AdpcmState *st = (AdpcmState *)state;
+    int bytes = adpcm_max_payload_bytes(frames);
+    if (capacity < bytes)
+        return -1;
+    out[0] = (uint8_t)st->predictor;
+    out[1] = (uint8_t)(st->predictor >> 8);
+    out[2] = (uint8_t)st->index;
+    out[3] = 0;
+    uint8_t *dst = out + ADPCM_HEADER_BYTES;
+    for (int i = 0; i + 1 < frames; i += 2)
+    {
+        uint8_t lo = adpcm_encode_sample(st, pcm[i]);
+        uint8_t hi = adpcm_encode_sample(st, pcm[i + 1]);
+        *dst++ = (uint8_t)(lo | (hi << 4));
+    }
+    if (frames & 1)
+        *dst = adpcm_encode_sample(st, pcm[frames - 1]);
+    return bytes;
+}
+
+static int adpcm_decode(void *state, const uint8_t *payload, int bytes,
+                        SAMPLE *pcm, int frames)
+{
+    if (bytes < ADPCM_HEADER_BYTES)
+        return -1;
+    AdpcmState st;
+    st.predictor = (int16_t)(payload[0] | (payload[1] << 8));
+    st.index = clamp_index(payload[2]);
+    int count = (bytes - ADPCM_HEADER_BYTES) * 2;
+    if (count > frames)
+        count = frames;
+    const uint8_t *src = payload + ADPCM_HEADER_BYTES;
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t byte = src[i >> 1];
+        pcm[i] = adpcm_decode_sample(&st, (i & 1) ? (byte >> 4) : (byte & 0x0f));
+    }
+    return count;
+}
+
+const Codec codec_ima_adpcm = {
+    .name = "IMA-ADPCM",
+    .payload_type = PAYLOAD_IMA_ADPCM,
+    .max_payload_bytes = adpcm_max_payload_bytes,
+    .encoder_create = adpcm_encoder_create,
+    .encoder_destroy = free,
+    .encode = adpcm_encode,
+    .decode = adpcm_decode,
+};
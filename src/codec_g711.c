@@ -0,0 +1,174 @@
+#include "codec.h"
+
+#include <pthread.h>
+
+#define G711_SIGN_BIT (0x80)
+#define G711_QUANT_MASK (0x0f)
+#define G711_SEG_SHIFT (4)
+#define G711_SEG_MASK (0x70)
+#define ULAW_BIAS (0x84)
+#define ULAW_CLIP (8159)
+
+static uint8_t ulaw_encode_table[1 << 14];
+static uint8_t alaw_encode_table[1 << 13];
+static SAMPLE ulaw_decode_table[256];
+static SAMPLE alaw_decode_table[256];
+static pthread_once_t g711_tables_once = PTHREAD_ONCE_INIT;
+
+static const int16_t seg_uend[8] = {0x3f,  0x7f,  0xff,  0x1ff,
+                                    0x3ff, 0x7ff, 0xfff, 0x1fff};
+static const int16_t seg_aend[8] = {0x1f,  0x3f,  0x7f,  0xff,
+                                    0x1ff, 0x3ff, 0x7ff, 0xfff};
+
+static int segment(int value, const int16_t *table)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        if (value <= table[i])
+            return i;
+    }
+    return 8;
+}
+
+static uint8_t linear14_to_ulaw(int pcm)
+{
+    int mask;
+    if (pcm < 0)
+    {
+        pcm = -pcm;
+        mask = 0x7f;
+    }
+    else
+    {
+        mask = 0xff;
+    }
+    if (pcm > ULAW_CLIP)
+        pcm = ULAW_CLIP;
+    pcm += ULAW_BIAS >> 2;
+    int seg = segment(pcm, seg_uend);
+    if (seg >= 8)
+        return (uint8_t)(0x7f ^ mask);
+    int uval = (seg << G711_SEG_SHIFT) | ((pcm >> (seg + 1)) & G711_QUANT_MASK);
+    return (uint8_t)(uval ^ mask);
+}
+
+static uint8_t linear13_to_alaw(int pcm)
+{
+    int mask;
+    if (pcm >= 0)
+    {
+        mask = 0xd5;
+    }
+    else
+    {
+        mask = 0x55;
+        pcm = -pcm - 1;
+    }
+    int seg = segment(pcm, seg_aend);
+    if (seg >= 8)
+        return (uint8_t)(0x7f ^ mask);
+    int aval = seg << G711_SEG_SHIFT;
+    if (seg < 2)
+        aval |= (pcm >> 1) & G711_QUANT_MASK;
+    else
+        aval |= (pcm >> seg) & G711_QUANT_MASK;
+    return (uint8_t)(aval ^ mask);
+}
+
+static SAMPLE ulaw_to_linear(uint8_t uval)
+{
+    uval = ~uval;
+    int t = ((uval & G711_QUANT_MASK) << 3) + ULAW_BIAS;
+    t <<= (uval & G711_SEG_MASK) >> G711_SEG_SHIFT;
+    return (SAMPLE)((uval & G711_SIGN_BIT) ? (ULAW_BIAS - t) : (t - ULAW_BIAS));
+}
+
+static SAMPLE alaw_to_linear(uint8_t aval)
+{
+    aval ^= 0x55;
+    int t = (aval & G711_QUANT_MASK) << 4;
+    int seg = (aval & G711_SEG_MASK) >> G711_SEG_SHIFT;
+    if (seg == 0)
+        t += 8;
+    else if (seg == 1)
+        t += 0x108;
+    else
+        t = (t + 0x108) << (seg - 1);
+    return (SAMPLE)((aval & G711_SIGN_BIT) ? t : -t);
+}
+
+static void g711_build_tables(void)
+{
+    for (int i = 0; i < (1 << 14); i++)
+        ulaw_encode_table[i] = linear14_to_ulaw(i - (1 << 13));
+    for (int i = 0; i < (1 << 13); i++)
+        alaw_encode_table[i] = linear13_to_alaw(i - (1 << 12));
+    for (int i = 0; i < 256; i++)
+    {
+        ulaw_decode_table[i] = ulaw_to_linear((uint8_t)i);
+        alaw_decode_table[i] = alaw_to_linear((uint8_t)i);
+    }
+}
+
+static int g711_max_payload_bytes(int frames)
+{
+    return frames;
+}
+
+static int pcmu_encode(void *state, const SAMPLE *pcm, int frames, uint8_t *out,
+                       int capacity)
+{
+    if (capacity < frames)
+        return -1;
+    pthread_once(&g711_tables_once, g711_build_tables);
+    for (int i = 0; i < frames; i++)
+        out[i] = ulaw_encode_table[(pcm[i] >> 2) + (1 << 13)];
+    return frames;
+}
+
+static int pcmu_decode(void *state, const uint8_t *payload, int bytes,
+                       SAMPLE *pcm, int frames)
+{
+    int count = bytes < frames ? bytes : frames;
+    pthread_once(&g711_tables_once, g711_build_tables);
+    for (int i = 0; i < count; i++)
+        pcm[i] = ulaw_decode_table[payload[i]];
+    return count;
+}
+
+static int pcma_encode(void *state, const SAMPLE *pcm, int frames, uint8_t *out,
+                       int capacity)
+{
+    if (capacity < frames)
+        return -1;
+    pthread_once(&g711_tables_once, g711_build_tables);
+    for (int i = 0; i < frames; i++)
+        out[i] = alaw_encode_table[(pcm[i] >> 3) + (1 << 12)];
+    return frames;
+}
+
+static int pcma_decode(void *state, const uint8_t *payload, int bytes,
+                       SAMPLE *pcm, int frames)
+{
+    int count = bytes < frames ? bytes : frames;
+    pthread_once(&g711_tables_once, g711_build_tables);
+    for (int i = 0; i < count; i++)
+        pcm[i] = alaw_decode_table[payload[i]];
+    return count;
+}
+
+const Codec codec_pcmu = {
+    .name = "PCMU",
+    .payload_type = PAYLOAD_PCMU,
+    .max_payload_bytes = g711_max_payload_bytes,
+    .encode = pcmu_encode,
+    .decode = pcmu_decode,
+};
+
+const Codec codec_pcma = {
+    .name = "PCMA",
+    .payload_type = PAYLOAD_PCMA,
+    .max_payload_bytes = g711_max_payload_bytes,
+    .encode = pcma_encode,
+    .decode = pcma_decode,
+};
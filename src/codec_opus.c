@@ -0,0 +1,97 @@
+#ifdef HAVE_OPUS
+
+#include "codec.h"
+
+#include <opus.h>
+#include <stdio.h>
+
+#define OPUS_MAX_PAYLOAD_BYTES (1275)
+#define OPUS_DEFAULT_BITRATE (32000)
+
+static int opus_config_supported(int sample_rate, int frames)
+{
+    if (sample_rate != 8000 && sample_rate != 12000 && sample_rate != 16000 &&
+        sample_rate != 24000 && sample_rate != 48000)
+        return 0;
+    static const int multiples[] = {1, 2, 4, 8, 16, 24};
+    for (int i = 0; i < 6; i++)
+    {
+        if (frames * 400 == sample_rate * multiples[i])
+            return 1;
+    }
+    return 0;
+}
+
+static int opus_max_payload_bytes(int frames)
+{
+    return OPUS_MAX_PAYLOAD_BYTES;
+}
+
+static void *opus_codec_encoder_create(int sample_rate, int frames)
+{
+    if (!opus_config_supported(sample_rate, frames))
+    {
+        fprintf(stderr,
+                "[CODEC] Opus needs 8/12/16/24/48 kHz and 2.5-60 ms frames "
+                "(got %d Hz, %d frames)\n",
+                sample_rate, frames);
+        return NULL;
+    }
+    int err;
+    OpusEncoder *enc =
+        opus_encoder_create(sample_rate, NUM_CHANNELS, OPUS_APPLICATION_VOIP,
+                            &err);
+    if (err != OPUS_OK)
+        return NULL;
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE(OPUS_DEFAULT_BITRATE));
+    return enc;
+}
+
+static void opus_codec_encoder_destroy(void *state)
+{
+    opus_encoder_destroy((OpusEncoder *)state);
+}
+
+static int opus_codec_encode(void *state, const SAMPLE *pcm, int frames,
+                             uint8_t *out, int capacity)
+{
+    int bytes = opus_encode((OpusEncoder *)state, pcm, frames, out, capacity);
+    return bytes < 0 ? -1 : bytes;
+}
+
+static void *opus_codec_decoder_create(int sample_rate, int frames)
+{
+    if (!opus_config_supported(sample_rate, frames))
+        return NULL;
+    int err;
+    OpusDecoder *dec = opus_decoder_create(sample_rate, NUM_CHANNELS, &err);
+    if (err != OPUS_OK)
+        return NULL;
+    return dec;
+}
+
+static void opus_codec_decoder_destroy(void *state)
+{
+    opus_decoder_destroy((OpusDecoder *)state);
+}
+
+static int opus_codec_decode(void *state, const uint8_t *payload, int bytes,
+                             SAMPLE *pcm, int frames)
+{
+    int count = opus_decode((OpusDecoder *)state, payload, bytes, pcm, frames, 0);
+    return count < 0 ? -1 : count;
+}
+
+const Codec codec_opus = {
+    .name = "Opus",
+    .payload_type = PAYLOAD_OPUS,
+    .max_payload_bytes = opus_max_payload_bytes,
+    .encoder_create = opus_codec_encoder_create,
+    .encoder_destroy = opus_codec_encoder_destroy,
+    .encode = opus_codec_encode,
+    .decoder_create = opus_codec_decoder_create,
+    .decoder_destroy = opus_codec_decoder_destroy,
+    .decode = opus_codec_decode,
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "comfort_noise.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CN_FULL_SCALE (32767.0f)
+#define CN_LOWPASS (0.6f)
+
+uint8_t comfort_noise_level(float rms)
+{
+    if (rms < 1.0f)
+        return CN_LEVEL_SILENT;
+    float level = -20.0f * log10f(rms / CN_FULL_SCALE);
+    if (level < 0.0f)
+        level = 0.0f;
+    if (level > CN_LEVEL_SILENT)
+        level = CN_LEVEL_SILENT;
+    return (uint8_t)lrintf(level);
+}
+
+int comfort_noise_encode(float rms, uint8_t *payload, int capacity)
+{
+    if (capacity < CN_PAYLOAD_SIZE)
+        return -1;
+    payload[0] = comfort_noise_level(rms);
+    return CN_PAYLOAD_SIZE;
+}
+
+void comfort_noise_init(ComfortNoise *cn)
+{
+    memset(cn, 0, sizeof(*cn));
+    cn->seed = 0x2545f491u;
+}
+
+void comfort_noise_set_payload(ComfortNoise *cn, const uint8_t *payload,
+                               int bytes)
+{
+    if (bytes < CN_PAYLOAD_SIZE)
+        return;
+    uint8_t level = payload[0] & 0x7f;
+    cn->rms = level >= CN_LEVEL_SILENT
+                  ? 0.0f
+                  : CN_FULL_SCALE * powf(10.0f, -level / 20.0f);
+}
+
+void comfort_noise_generate(ComfortNoise *cn, SAMPLE *out, int len)
+{
+    /* Uniform noise has an RMS of 1/sqrt(3); the one-pole low-pass scales
+     * its power by (1 - a) / (1 + a). */
+    float gain = cn->rms * sqrtf(3.0f) /
+                 sqrtf((1.0f - CN_LOWPASS) / (1.0f + CN_LOWPASS));
+    for (int i = 0; i < len; i++)
+    {
+        cn->seed ^= cn->seed << 13;
+        cn->seed ^= cn->seed >> 17;
+        cn->seed ^= cn->seed << 5;
+        float white = (float)(int32_t)cn->seed / 2147483648.0f;
+        cn->lowpass = CN_LOWPASS * cn->lowpass + (1.0f - CN_LOWPASS) * white;
+        float v = cn->lowpass * gain;
+        if (v > 32767.0f)
+            v = 32767.0f;
+        else if (v < -32768.0f)
+            v = -32768.0f;
+        out[i] = (SAMPLE)v;
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef COMFORT_NOISE_H
+#define COMFORT_NOISE_H
+
+#include <stdint.h>
+
+#include "audio_config.h"
+
+#define CN_PAYLOAD_SIZE (1)
+#define CN_LEVEL_SILENT (127)
+
+/* RFC 3389 comfort noise. The payload carries only the noise level in
+ * -dBov, where 0 dBov is a full-scale square wave; the receiver fills DTX
+ * gaps with gently low-passed noise of that level. */
+typedef struct
+{
+    uint32_t seed;
+    float rms;
+    float lowpass;
+} ComfortNoise;
+
+uint8_t comfort_noise_level(float rms);
+int comfort_noise_encode(float rms, uint8_t *payload, int capacity);
+void comfort_noise_init(ComfortNoise *cn);
+void comfort_noise_set_payload(ComfortNoise *cn, const uint8_t *payload,
+                               int bytes);
+void comfort_noise_generate(ComfortNoise *cn, SAMPLE *out, int len);
+
+#endif
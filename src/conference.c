@@ -0,0 +1,106 @@
+#include "conference.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int conference_init(Conference *conf, const Codec *codec,
+                    const JitterBufferConfig *jb_config, int frame_size,
+                    int speakers_max)
+{
+    memset(conf, 0, sizeof(*conf));
+    atomic_init(&conf->count, 0);
+    conf->codec = codec;
+    conf->jb_config = *jb_config;
+    mixer_init(&conf->mixer, frame_size, speakers_max,
+               CONFERENCE_MIX_FLOOR_RMS);
+    return 0;
+}
+
+void conference_destroy(Conference *conf)
+{
+    int count = atomic_load(&conf->count);
+    for (int i = 0; i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        rtp_session_destroy(&peer->rtp);
+        jitter_buffer_destroy(&peer->jitter_buffer);
+        codec_encoder_close(&peer->encoder);
+        rb_destroy(&peer->send_rb);
+    }
+    atomic_store(&conf->count, 0);
+}
+
+static bool same_address(const struct sockaddr_in *a,
+                         const struct sockaddr_in *b)
+{
+    return a->sin_port == b->sin_port &&
+           a->sin_addr.s_addr == b->sin_addr.s_addr;
+}
+
+int conference_add_peer(Conference *conf, const struct sockaddr_in *addr)
+{
+    int index = atomic_load(&conf->count);
+    if (index >= CONFERENCE_PEERS_MAX)
+        return -1;
+    ConferencePeer *peer = &conf->peers[index];
+    memset(peer, 0, sizeof(*peer));
+    peer->addr = *addr;
+    for (int i = 0; conf->by_ssrc && i < index; i++)
+    {
+        if (same_address(&conf->peers[i].addr, addr))
+            peer->receive_only = true;
+    }
+    if (jitter_buffer_init(&peer->jitter_buffer, &conf->jb_config) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_init() failed\n");
+        return -1;
+    }
+    int rate = conf->jb_config.sample_rate;
+    if (codec_encoder_open(&peer->encoder, conf->codec, rate,
+                           conf->jb_config.frame_size) == -1)
+    {
+        fprintf(stderr, "codec_encoder_open(%s) failed\n", conf->codec->name);
+        jitter_buffer_destroy(&peer->jitter_buffer);
+        return -1;
+    }
+    if (rb_init(&peer->send_rb, RING_BUFFER_SIZE(rate)) == -1)
+    {
+        fprintf(stderr, "Cannot allocate a send ring\n");
+        codec_encoder_close(&peer->encoder);
+        jitter_buffer_destroy(&peer->jitter_buffer);
+        return -1;
+    }
+    rtp_session_init(&peer->rtp, rate, conf->jb_config.frame_size);
+    atomic_store(&conf->count, index + 1);
+    return index;
+}
+
+int conference_find_peer(Conference *conf, const struct sockaddr_in *addr,
+                         uint32_t ssrc)
+{
+    int count = atomic_load(&conf->count);
+    for (int i = 0; addr && i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        if (!same_address(&peer->addr, addr) ||
+            (conf->by_ssrc && peer->have_ssrc && ssrc != 0 &&
+             peer->ssrc != ssrc))
+            continue;
+        if (ssrc != 0)
+        {
+            peer->ssrc = ssrc;
+            peer->have_ssrc = true;
+        }
+        return i;
+    }
+    for (int i = 0; ssrc != 0 && i < count; i++)
+    {
+        ConferencePeer *peer = &conf->peers[i];
+        if (!peer->have_ssrc || peer->ssrc != ssrc)
+            continue;
+        if (addr && addr->sin_family == AF_INET)
+            peer->addr = *addr;
+        return i;
+    }
+    return -1;
+}
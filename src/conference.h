@@ -0,0 +1,70 @@
+#ifndef CONFERENCE_H
+#define CONFERENCE_H
+
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "codec.h"
+#include "jitter_buffer.h"
+#include "mixer.h"
+#include "ring_buffer.h"
+#include "rtp.h"
+
+#define CONFERENCE_PEERS_MAX (MIXER_INPUTS_MAX)
+/* Inputs quieter than this (silence, an unprimed jitter buffer) are not
+ * mixed. */
+#define CONFERENCE_MIX_FLOOR_RMS (30.0f)
+
+/* One remote participant: its own RTP session (receive statistics and the
+ * stream sent to it), jitter buffer and decoder, and the encoder and PCM
+ * queue of what it is sent. A receive-only participant reaches us through
+ * a relay that already gets our stream, so nothing is sent to it. */
+typedef struct
+{
+    struct sockaddr_in addr;
+    uint32_t ssrc;
+    bool have_ssrc;
+    bool receive_only;
+    RtpSession rtp;
+    JitterBuffer jitter_buffer;
+    CodecEncoder encoder;
+    RingBuffer send_rb;
+    SAMPLE pcm[AUDIO_FRAME_MAX];
+} ConferencePeer;
+
+/* The participants of a multi-party call. Only the network thread adds
+ * peers; a slot is fully set up before count is raised, so the DSP thread
+ * can walk the first count entries without a lock. With by_ssrc several
+ * participants may share an address (a relay's) and are told apart by
+ * SSRC. jb_config gives the sample rate, and the packet size that
+ * participants are sent in and assumed to send in until they announce
+ * their own; the mixer works in frames of frame_size. */
+typedef struct
+{
+    ConferencePeer peers[CONFERENCE_PEERS_MAX];
+    atomic_int count;
+    bool by_ssrc;
+    const Codec *codec;
+    JitterBufferConfig jb_config;
+    Mixer mixer;
+} Conference;
+
+int conference_init(Conference *conf, const Codec *codec,
+                    const JitterBufferConfig *jb_config, int frame_size,
+                    int speakers_max);
+void conference_destroy(Conference *conf);
+/* Returns the index of the new participant, or -1 if the conference is
+ * full or its state could not be set up. With by_ssrc a participant at the
+ * address of an earlier one is receive-only. */
+int conference_add_peer(Conference *conf, const struct sockaddr_in *addr);
+/* Finds the sender of a datagram by source address, then by SSRC, which
+ * follows a participant whose address changed (the address is updated).
+ * With by_ssrc an address match must also match a known SSRC.
+ * addr may be NULL and ssrc 0 if unknown. Returns -1 if there is no
+ * match. */
+int conference_find_peer(Conference *conf, const struct sockaddr_in *addr,
+                         uint32_t ssrc);
+
+#endif
@@ -0,0 +1,134 @@
+#include "dsp_kernels.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t scalar_sum_squares(const SAMPLE *in, int len)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < len; i++)
+        sum += (uint64_t)((int32_t)in[i] * (int32_t)in[i]);
+    return sum;
+}
+
+static void scalar_apply_gain(const SAMPLE *in, SAMPLE *out, int len,
+                              float gain)
+{
+    for (int i = 0; i < len; i++)
+    {
+        float boosted_sample = (float)in[i] * gain;
+        if (boosted_sample > 32767.0f)
+            boosted_sample = 32767.0f;
+        if (boosted_sample < -32768.0f)
+            boosted_sample = -32768.0f;
+        out[i] = (SAMPLE)boosted_sample;
+    }
+}
+
+static void scalar_mix(SAMPLE *acc, const SAMPLE *in, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        int32_t sum = (int32_t)acc[i] + (int32_t)in[i];
+        if (sum > 32767)
+            sum = 32767;
+        if (sum < -32768)
+            sum = -32768;
+        acc[i] = (SAMPLE)sum;
+    }
+}
+
+static void scalar_accumulate(int32_t *acc, const SAMPLE *in, int len)
+{
+    for (int i = 0; i < len; i++)
+        acc[i] += in[i];
+}
+
+static void scalar_mix_minus(const int32_t *acc, const SAMPLE *in,
+                             SAMPLE *out, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        int32_t sum = acc[i] - (in ? in[i] : 0);
+        if (sum > 32767)
+            sum = 32767;
+        if (sum < -32768)
+            sum = -32768;
+        out[i] = (SAMPLE)sum;
+    }
+}
+
+static int32_t scalar_dot_product(const SAMPLE *in, const int16_t *taps,
+                                  int len)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < len; i++)
+        sum += (int32_t)in[i] * taps[i];
+    return sum;
+}
+
+const DspKernels dsp_kernels_scalar = {
+    .name = "scalar",
+    .sum_squares = scalar_sum_squares,
+    .apply_gain = scalar_apply_gain,
+    .mix = scalar_mix,
+    .accumulate = scalar_accumulate,
+    .mix_minus = scalar_mix_minus,
+    .dot_product = scalar_dot_product,
+};
+
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+static const DspKernels *selected = &dsp_kernels_scalar;
+
+int dsp_kernels_supported(const DspKernels **list, int capacity)
+{
+    int count = 0;
+    if (count < capacity)
+        list[count++] = &dsp_kernels_scalar;
+#ifdef DSP_KERNELS_X86
+    __builtin_cpu_init();
+    if (count < capacity && __builtin_cpu_supports("sse2"))
+        list[count++] = &dsp_kernels_sse2;
+    if (count < capacity && __builtin_cpu_supports("avx2"))
+        list[count++] = &dsp_kernels_avx2;
+#endif
+#ifdef DSP_KERNELS_NEON
+    if (count < capacity)
+        list[count++] = &dsp_kernels_neon;
+#endif
+    return count;
+}
+
+static void select_kernels(void)
+{
+    const DspKernels *list[4];
+    int count = dsp_kernels_supported(list, 4);
+    selected = list[count - 1];
+#ifdef DSP_KERNELS_X86
+    if (count > 1)
+        selected = &dsp_kernels_sse2;
+#endif
+    const char *forced = getenv("VOIP_DSP_KERNELS");
+    if (forced && forced[0] != '\0')
+    {
+        int i;
+        for (i = 0; i < count; i++)
+        {
+            if (strcmp(list[i]->name, forced) == 0)
+                break;
+        }
+        if (i < count)
+            selected = list[i];
+        else
+            fprintf(stderr, "[DSP] Kernels '%s' not supported, using %s\n",
+                    forced, selected->name);
+    }
+}
+
+const DspKernels *dsp_kernels(void)
+{
+    pthread_once(&select_once, select_kernels);
+    return selected;
+}
@@ -0,0 +1,92 @@
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "audio_config.h"
+
+/* Per-frame sample kernels. Every implementation is bit-exact with the
+ * scalar one: sums of squares and dot products are exact integers and gain
+ * is clamped in float before truncation, so vector and scalar paths
+ * agree. */
+typedef struct
+{
+    const char *name;
+    uint64_t (*sum_squares)(const SAMPLE *in, int len);
+    void (*apply_gain)(const SAMPLE *in, SAMPLE *out, int len, float gain);
+    void (*mix)(SAMPLE *acc, const SAMPLE *in, int len);
+    void (*accumulate)(int32_t *acc, const SAMPLE *in, int len);
+    void (*mix_minus)(const int32_t *acc, const SAMPLE *in, SAMPLE *out,
+                      int len);
+    int32_t (*dot_product)(const SAMPLE *in, const int16_t *taps, int len);
+} DspKernels;
+
+extern const DspKernels dsp_kernels_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_KERNELS_X86
+extern const DspKernels dsp_kernels_sse2;
+extern const DspKernels dsp_kernels_avx2;
+#endif
+#if defined(__ARM_NEON)
+#define DSP_KERNELS_NEON
+extern const DspKernels dsp_kernels_neon;
+#endif
+
+/* The implementation used by the pipeline, chosen on first use: NEON on
+ * ARM, SSE2 on x86. AVX2 is twice as fast in a tight loop but slower when
+ * run once per audio frame, because the upper vector lanes are powered
+ * down again between frames; it is still selectable. The VOIP_DSP_KERNELS
+ * environment variable (scalar, sse2, avx2, neon) forces a specific one. */
+const DspKernels *dsp_kernels(void);
+int dsp_kernels_supported(const DspKernels **list, int capacity);
+
+static inline uint64_t dsp_sum_squares(const SAMPLE *in, int len)
+{
+    return dsp_kernels()->sum_squares(in, len);
+}
+
+static inline float dsp_rms(const SAMPLE *in, int len)
+{
+    if (len <= 0)
+        return 0.0f;
+    return (float)sqrt((double)dsp_sum_squares(in, len) / len);
+}
+
+/* out = saturate(in * gain), truncated toward zero. in and out may alias. */
+static inline void dsp_apply_gain(const SAMPLE *in, SAMPLE *out, int len,
+                                  float gain)
+{
+    dsp_kernels()->apply_gain(in, out, len, gain);
+}
+
+/* acc = saturate(acc + in). */
+static inline void dsp_mix(SAMPLE *acc, const SAMPLE *in, int len)
+{
+    dsp_kernels()->mix(acc, in, len);
+}
+
+/* acc += in in 32 bits, so a sum of many inputs only clips once, when it
+ * is narrowed by dsp_mix_minus(). */
+static inline void dsp_accumulate(int32_t *acc, const SAMPLE *in, int len)
+{
+    dsp_kernels()->accumulate(acc, in, len);
+}
+
+/* out = saturate(acc - in): a mix without one of its inputs. in may be NULL
+ * to narrow the whole mix. */
+static inline void dsp_mix_minus(const int32_t *acc, const SAMPLE *in,
+                                 SAMPLE *out, int len)
+{
+    dsp_kernels()->mix_minus(acc, in, out, len);
+}
+
+/* Sum of in[i] * taps[i]. The taps' magnitudes must add up to less than
+ * 65536 so the sum cannot overflow. */
+static inline int32_t dsp_dot_product(const SAMPLE *in, const int16_t *taps,
+                                      int len)
+{
+    return dsp_kernels()->dot_product(in, taps, len);
+}
+
+#endif
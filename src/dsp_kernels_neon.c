@@ -0,0 +1,120 @@
+#include "dsp_kernels.h"
+
+#ifdef DSP_KERNELS_NEON
+
+#include <arm_neon.h>
+
+static uint64_t neon_sum_squares(const SAMPLE *in, int len)
+{
+    uint64x2_t acc = vdupq_n_u64(0);
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t x = vld1q_s16(in + i);
+        uint32x4_t lo = vreinterpretq_u32_s32(
+            vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+        uint32x4_t hi = vreinterpretq_u32_s32(
+            vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+        acc = vpadalq_u32(acc, lo);
+        acc = vpadalq_u32(acc, hi);
+    }
+    uint64_t sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+    for (; i < len; i++)
+        sum += (uint64_t)((int32_t)in[i] * (int32_t)in[i]);
+    return sum;
+}
+
+static int16x4_t neon_gain_4(int16x4_t x, float32x4_t gain, float32x4_t lo,
+                             float32x4_t hi)
+{
+    float32x4_t y = vmulq_f32(vcvtq_f32_s32(vmovl_s16(x)), gain);
+    y = vminq_f32(vmaxq_f32(y, lo), hi);
+    return vqmovn_s32(vcvtq_s32_f32(y));
+}
+
+static void neon_apply_gain(const SAMPLE *in, SAMPLE *out, int len,
+                            float gain)
+{
+    float32x4_t g = vdupq_n_f32(gain);
+    float32x4_t lo = vdupq_n_f32(-32768.0f);
+    float32x4_t hi = vdupq_n_f32(32767.0f);
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t x = vld1q_s16(in + i);
+        int16x8_t y = vcombine_s16(neon_gain_4(vget_low_s16(x), g, lo, hi),
+                                   neon_gain_4(vget_high_s16(x), g, lo, hi));
+        vst1q_s16(out + i, y);
+    }
+    dsp_kernels_scalar.apply_gain(in + i, out + i, len - i, gain);
+}
+
+static void neon_mix(SAMPLE *acc, const SAMPLE *in, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+        vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i), vld1q_s16(in + i)));
+    dsp_kernels_scalar.mix(acc + i, in + i, len - i);
+}
+
+static void neon_accumulate(int32_t *acc, const SAMPLE *in, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_s32(acc + i, vaddw_s16(vld1q_s32(acc + i), vget_low_s16(x)));
+        vst1q_s32(acc + i + 4,
+                  vaddw_s16(vld1q_s32(acc + i + 4), vget_high_s16(x)));
+    }
+    dsp_kernels_scalar.accumulate(acc + i, in + i, len - i);
+}
+
+static void neon_mix_minus(const int32_t *acc, const SAMPLE *in, SAMPLE *out,
+                           int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        int32x4_t lo = vld1q_s32(acc + i);
+        int32x4_t hi = vld1q_s32(acc + i + 4);
+        if (in)
+        {
+            int16x8_t x = vld1q_s16(in + i);
+            lo = vsubw_s16(lo, vget_low_s16(x));
+            hi = vsubw_s16(hi, vget_high_s16(x));
+        }
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    dsp_kernels_scalar.mix_minus(acc + i, in ? in + i : NULL, out + i,
+                                 len - i);
+}
+
+static int32_t neon_dot_product(const SAMPLE *in, const int16_t *taps,
+                                int len)
+{
+    int32x4_t acc = vdupq_n_s32(0);
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t x = vld1q_s16(in + i);
+        int16x8_t t = vld1q_s16(taps + i);
+        acc = vmlal_s16(acc, vget_low_s16(x), vget_low_s16(t));
+        acc = vmlal_s16(acc, vget_high_s16(x), vget_high_s16(t));
+    }
+    int32_t sum = vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) +
+                  vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+    return sum + dsp_kernels_scalar.dot_product(in + i, taps + i, len - i);
+}
+
+const DspKernels dsp_kernels_neon = {
+    .name = "neon",
+    .sum_squares = neon_sum_squares,
+    .apply_gain = neon_apply_gain,
+    .mix = neon_mix,
+    .accumulate = neon_accumulate,
+    .mix_minus = neon_mix_minus,
+    .dot_product = neon_dot_product,
+};
+
+#endif
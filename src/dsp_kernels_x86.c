@@ -0,0 +1,263 @@
+#include "dsp_kernels.h"
+
+#ifdef DSP_KERNELS_X86
+
+#include <immintrin.h>
+
+/* madd of two int16 squares is at most 2^31, which only fits unsigned, so
+ * the even and odd 32-bit pair sums are zero-extended into 64-bit lanes
+ * before accumulating. */
+__attribute__((target("sse2"))) static uint64_t
+sse2_sum_squares(const SAMPLE *in, int len)
+{
+    __m128i low_mask = _mm_set1_epi64x(0xffffffff);
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i pairs = _mm_madd_epi16(x, x);
+        acc = _mm_add_epi64(acc, _mm_and_si128(pairs, low_mask));
+        acc = _mm_add_epi64(acc, _mm_srli_epi64(pairs, 32));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    uint64_t sum = lanes[0] + lanes[1];
+    for (; i < len; i++)
+        sum += (uint64_t)((int32_t)in[i] * (int32_t)in[i]);
+    return sum;
+}
+
+__attribute__((target("sse2"))) static __m128i
+sse2_gain_4(__m128i x32, __m128 gain, __m128 lo, __m128 hi)
+{
+    __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(x32), gain);
+    y = _mm_min_ps(_mm_max_ps(y, lo), hi);
+    return _mm_cvttps_epi32(y);
+}
+
+__attribute__((target("sse2"))) static void
+sse2_apply_gain(const SAMPLE *in, SAMPLE *out, int len, float gain)
+{
+    __m128 g = _mm_set1_ps(gain);
+    __m128 lo = _mm_set1_ps(-32768.0f);
+    __m128 hi = _mm_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i x_lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i x_hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        __m128i y = _mm_packs_epi32(sse2_gain_4(x_lo, g, lo, hi),
+                                    sse2_gain_4(x_hi, g, lo, hi));
+        _mm_storeu_si128((__m128i *)(out + i), y);
+    }
+    dsp_kernels_scalar.apply_gain(in + i, out + i, len - i, gain);
+}
+
+__attribute__((target("sse2"))) static void
+sse2_mix(SAMPLE *acc, const SAMPLE *in, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_adds_epi16(a, b));
+    }
+    dsp_kernels_scalar.mix(acc + i, in + i, len - i);
+}
+
+__attribute__((target("sse2"))) static void
+sse2_accumulate(int32_t *acc, const SAMPLE *in, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i x_lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i x_hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        __m128i a_lo = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i a_hi = _mm_loadu_si128((const __m128i *)(acc + i + 4));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi32(a_lo, x_lo));
+        _mm_storeu_si128((__m128i *)(acc + i + 4), _mm_add_epi32(a_hi, x_hi));
+    }
+    dsp_kernels_scalar.accumulate(acc + i, in + i, len - i);
+}
+
+__attribute__((target("sse2"))) static void
+sse2_mix_minus(const int32_t *acc, const SAMPLE *in, SAMPLE *out, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i a_lo = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i a_hi = _mm_loadu_si128((const __m128i *)(acc + i + 4));
+        if (in)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+            a_lo = _mm_sub_epi32(a_lo,
+                                 _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+            a_hi = _mm_sub_epi32(a_hi,
+                                 _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a_lo, a_hi));
+    }
+    dsp_kernels_scalar.mix_minus(acc + i, in ? in + i : NULL, out + i,
+                                 len - i);
+}
+
+__attribute__((target("sse2"))) static int32_t
+sse2_dot_product(const SAMPLE *in, const int16_t *taps, int len)
+{
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i t = _mm_loadu_si128((const __m128i *)(taps + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(x, t));
+    }
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           dsp_kernels_scalar.dot_product(in + i, taps + i, len - i);
+}
+
+const DspKernels dsp_kernels_sse2 = {
+    .name = "sse2",
+    .sum_squares = sse2_sum_squares,
+    .apply_gain = sse2_apply_gain,
+    .mix = sse2_mix,
+    .accumulate = sse2_accumulate,
+    .mix_minus = sse2_mix_minus,
+    .dot_product = sse2_dot_product,
+};
+
+__attribute__((target("avx2"))) static uint64_t
+avx2_sum_squares(const SAMPLE *in, int len)
+{
+    __m256i low_mask = _mm256_set1_epi64x(0xffffffff);
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i pairs = _mm256_madd_epi16(x, x);
+        acc = _mm256_add_epi64(acc, _mm256_and_si256(pairs, low_mask));
+        acc = _mm256_add_epi64(acc, _mm256_srli_epi64(pairs, 32));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < len; i++)
+        sum += (uint64_t)((int32_t)in[i] * (int32_t)in[i]);
+    return sum;
+}
+
+__attribute__((target("avx2"))) static __m256i
+avx2_gain_8(__m128i x16, __m256 gain, __m256 lo, __m256 hi)
+{
+    __m256 y = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x16)),
+                             gain);
+    y = _mm256_min_ps(_mm256_max_ps(y, lo), hi);
+    return _mm256_cvttps_epi32(y);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_apply_gain(const SAMPLE *in, SAMPLE *out, int len, float gain)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    __m256 lo = _mm256_set1_ps(-32768.0f);
+    __m256 hi = _mm256_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i a = avx2_gain_8(_mm256_castsi256_si128(x), g, lo, hi);
+        __m256i b = avx2_gain_8(_mm256_extracti128_si256(x, 1), g, lo, hi);
+        /* packs works per 128-bit lane; restore sample order. */
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)(out + i), y);
+    }
+    dsp_kernels_sse2.apply_gain(in + i, out + i, len - i, gain);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_mix(SAMPLE *acc, const SAMPLE *in, int len)
+{
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm256_storeu_si256((__m256i *)(acc + i), _mm256_adds_epi16(a, b));
+    }
+    dsp_kernels_sse2.mix(acc + i, in + i, len - i);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_accumulate(int32_t *acc, const SAMPLE *in, int len)
+{
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256i x = _mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(in + i)));
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+        _mm256_storeu_si256((__m256i *)(acc + i), _mm256_add_epi32(a, x));
+    }
+    dsp_kernels_sse2.accumulate(acc + i, in + i, len - i);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_mix_minus(const int32_t *acc, const SAMPLE *in, SAMPLE *out, int len)
+{
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(acc + i + 8));
+        if (in)
+        {
+            a = _mm256_sub_epi32(a, _mm256_cvtepi16_epi32(_mm_loadu_si128(
+                                        (const __m128i *)(in + i))));
+            b = _mm256_sub_epi32(b, _mm256_cvtepi16_epi32(_mm_loadu_si128(
+                                        (const __m128i *)(in + i + 8))));
+        }
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)(out + i), y);
+    }
+    dsp_kernels_sse2.mix_minus(acc + i, in ? in + i : NULL, out + i, len - i);
+}
+
+__attribute__((target("avx2"))) static int32_t
+avx2_dot_product(const SAMPLE *in, const int16_t *taps, int len)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i t = _mm256_loadu_si256((const __m256i *)(taps + i));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, t));
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    int32_t sum = 0;
+    for (int lane = 0; lane < 8; lane++)
+        sum += lanes[lane];
+    return sum + dsp_kernels_sse2.dot_product(in + i, taps + i, len - i);
+}
+
+const DspKernels dsp_kernels_avx2 = {
+    .name = "avx2",
+    .sum_squares = avx2_sum_squares,
+    .apply_gain = avx2_apply_gain,
+    .mix = avx2_mix,
+    .accumulate = avx2_accumulate,
+    .mix_minus = avx2_mix_minus,
+    .dot_product = avx2_dot_product,
+};
+
+#endif
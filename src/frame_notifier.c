@@ -0,0 +1,80 @@
+#include "frame_notifier.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+int frame_notifier_init(FrameNotifier *fn)
+{
+#ifdef __linux__
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1)
+        return -1;
+    fn->read_fd = fd;
+    fn->write_fd = fd;
+#else
+    int fds[2];
+    if (pipe(fds) == -1)
+        return -1;
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    fn->read_fd = fds[0];
+    fn->write_fd = fds[1];
+#endif
+    return 0;
+}
+
+void frame_notifier_destroy(FrameNotifier *fn)
+{
+    if (fn->write_fd != fn->read_fd)
+        close(fn->write_fd);
+    close(fn->read_fd);
+    fn->read_fd = -1;
+    fn->write_fd = -1;
+}
+
+void frame_notifier_signal(FrameNotifier *fn)
+{
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t ret = write(fn->write_fd, &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t ret = write(fn->write_fd, &one, sizeof(one));
+#endif
+    (void)ret;
+}
+
+void frame_notifier_drain(FrameNotifier *fn)
+{
+    char scratch[64];
+    while (read(fn->read_fd, scratch, sizeof(scratch)) > 0)
+    {
+    }
+}
+
+int frame_notifier_wait(FrameNotifier *fn, int timeout_ms)
+{
+    struct pollfd pfd = {.fd = fn->read_fd, .events = POLLIN};
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+    if (ret > 0)
+        frame_notifier_drain(fn);
+    return ret;
+}
+
+int frame_notifier_fd(const FrameNotifier *fn)
+{
+    return fn->read_fd;
+}
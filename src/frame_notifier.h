@@ -0,0 +1,22 @@
+#ifndef FRAME_NOTIFIER_H
+#define FRAME_NOTIFIER_H
+
+#include <stdint.h>
+
+/* Wakes a consumer thread from a real-time producer. signal() is a single
+ * non-blocking write(), safe to call from the audio callback. On Linux this
+ * is an eventfd; elsewhere a non-blocking pipe. */
+typedef struct
+{
+    int read_fd;
+    int write_fd;
+} FrameNotifier;
+
+int frame_notifier_init(FrameNotifier *fn);
+void frame_notifier_destroy(FrameNotifier *fn);
+void frame_notifier_signal(FrameNotifier *fn);
+int frame_notifier_wait(FrameNotifier *fn, int timeout_ms);
+int frame_notifier_fd(const FrameNotifier *fn);
+void frame_notifier_drain(FrameNotifier *fn);
+
+#endif
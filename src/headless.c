@@ -0,0 +1,485 @@
+#include "headless.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "call.h"
+#include "time_util.h"
+
+/* How often --latency-log and --metrics-log append a record without
+ * --stats. */
+#define LATENCY_LOG_INTERVAL_S (5.0)
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+static void on_first_audio(void *user_data)
+{
+    Call *call = (Call *)user_data;
+    printf("[INFO] Receiving audio %.1f ms after the call started.\n",
+           call->first_audio_ns / 1e6);
+}
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s --headless [options]\n"
+            "  --peer-ip IP           peer address (default 127.0.0.1)\n"
+            "  --peer-port PORT       peer port (default 6000)\n"
+            "  --local-port PORT      local port (default 5000)\n"
+            "  --codec NAME           send codec (default %s)\n"
+            "  --input SRC            pa | silence | tone[:HZ] | wav:PATH\n"
+            "                         | loop (the output fed back in)\n"
+            "  --output SINK          pa | null | wav:PATH\n"
+            "  --clock MODE           realtime | fast (file/tone/null only)\n"
+            "  --clock-skew PPM       run the realtime file clock this much\n"
+            "                         fast (negative: slow)\n"
+            "  --duration SECONDS     stop after this much audio\n"
+            "  --rate HZ              8000 | 16000 | 32000 | 44100 | 48000\n"
+            "                         (default %d)\n"
+            "  --frame-ms MS          audio frame, %.1f-%d ms (default %d\n"
+            "                         samples at %d Hz, otherwise 10 ms)\n"
+            "  --packet-frames N      frames per packet (default 1)\n"
+            "  --jitter-delay FRAMES  fixed jitter buffer delay, no adaptation\n"
+            "  --no-drift             do not resample playout to follow the\n"
+            "                         peer's clock\n"
+            "  --no-aec               bypass the echo canceller\n"
+            "  --aec-tail MS          echo canceller tail (default %d)\n"
+            "  --no-dtx               send every frame, even in silence\n"
+            "  --fec DEPTH            redundant frames per packet: auto | 0-%d\n"
+            "  --impair SPEC          impair received packets, e.g.\n"
+            "                         delay=40,jitter=10,dist=pareto,loss=2,\n"
+            "                         burst=3,reorder=1,dup=1,rate=256,seed=7\n"
+            "  --conference           multi-party call; others may call in\n"
+            "  --peer IP:PORT         conference participant (repeatable,\n"
+            "                         up to %d)\n"
+            "  --bridge               send each participant everyone else\n"
+            "  --speakers N           loudest participants mixed (default %d)\n"
+            "  --room N               join room N of a voip_relay at the peer\n"
+            "  --no-echo-suppress     leave the residual echo\n"
+            "  --no-denoise           bypass the noise suppressor\n"
+            "  --noise-suppress DB    most noise attenuation (default %d)\n"
+            "  --agc                  automatic gain control\n"
+            "  --no-vad               gate on the level alone\n"
+            "  --gain FACTOR          near-end gain (default 1.2)\n"
+            "  --gate RMS             noise gate threshold (default 150)\n"
+            "  --dsp-cpu CPU          pin the DSP thread\n"
+            "  --dsp-priority PRIO    SCHED_FIFO priority, 0 to disable\n"
+            "  --stats SECONDS        print RTP quality and latency at this\n"
+            "                         interval\n"
+            "  --latency-log PATH     append per-stage latency percentiles\n"
+            "                         as JSON lines every --stats seconds\n"
+            "                         (default 5)\n"
+            "  --metrics-log PATH     append counters and gauges as JSON\n"
+            "                         lines at the same interval\n"
+            "  --metrics-socket PATH  serve metrics in the Prometheus text\n"
+            "                         format on a Unix socket\n"
+            "  --latency-probe        send tone bursts and time their return\n"
+            "                         from a peer with --input loop\n"
+            "  --no-capture-time      do not send capture times to the peer\n"
+            "  --record PATH          record the call to a stereo WAV file\n"
+            "                         (near end left, far end right)\n"
+            "  --capture PATH         capture received packets to a pcap\n"
+            "                         file for voip_replay\n",
+            program, codec_at(0)->name, SAMPLE_RATE, AUDIO_FRAME_MS_MIN,
+            AUDIO_FRAME_MS_MAX, FRAMES_PER_BUFFER, SAMPLE_RATE,
+            TAIL_LENGTH_MS, RED_MAX_DEPTH, CONFERENCE_PEERS_MAX,
+            MIXER_DEFAULT_SPEAKERS, PREPROCESS_NOISE_SUPPRESS_DB);
+}
+
+int headless_main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        {"headless", no_argument, NULL, 'H'},
+        {"peer-ip", required_argument, NULL, 'i'},
+        {"peer-port", required_argument, NULL, 'p'},
+        {"local-port", required_argument, NULL, 'l'},
+        {"codec", required_argument, NULL, 'c'},
+        {"input", required_argument, NULL, 'I'},
+        {"output", required_argument, NULL, 'O'},
+        {"clock", required_argument, NULL, 'k'},
+        {"clock-skew", required_argument, NULL, 'K'},
+        {"duration", required_argument, NULL, 'd'},
+        {"rate", required_argument, NULL, 'z'},
+        {"frame-ms", required_argument, NULL, 'F'},
+        {"packet-frames", required_argument, NULL, 'N'},
+        {"jitter-delay", required_argument, NULL, 'j'},
+        {"no-drift", no_argument, NULL, 'D'},
+        {"no-aec", no_argument, NULL, 'a'},
+        {"aec-tail", required_argument, NULL, 'A'},
+        {"no-dtx", no_argument, NULL, 'x'},
+        {"fec", required_argument, NULL, 'f'},
+        {"impair", required_argument, NULL, 'm'},
+        {"conference", no_argument, NULL, 'n'},
+        {"peer", required_argument, NULL, 'e'},
+        {"bridge", no_argument, NULL, 'b'},
+        {"speakers", required_argument, NULL, 'S'},
+        {"room", required_argument, NULL, 'R'},
+        {"no-echo-suppress", no_argument, NULL, 'E'},
+        {"no-denoise", no_argument, NULL, 'Q'},
+        {"noise-suppress", required_argument, NULL, 'q'},
+        {"agc", no_argument, NULL, 'G'},
+        {"no-vad", no_argument, NULL, 'v'},
+        {"gain", required_argument, NULL, 'g'},
+        {"gate", required_argument, NULL, 't'},
+        {"dsp-cpu", required_argument, NULL, 'C'},
+        {"dsp-priority", required_argument, NULL, 'P'},
+        {"stats", required_argument, NULL, 's'},
+        {"latency-log", required_argument, NULL, 'L'},
+        {"metrics-log", required_argument, NULL, 'M'},
+        {"metrics-socket", required_argument, NULL, 'U'},
+        {"latency-probe", no_argument, NULL, 'B'},
+        {"no-capture-time", no_argument, NULL, 'T'},
+        {"record", required_argument, NULL, 'r'},
+        {"capture", required_argument, NULL, 'w'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    Call call;
+    memset(&call, 0, sizeof(call));
+    CallConfig *config = &call.config;
+    call_config_default(config);
+    snprintf(config->peer_ip, sizeof(config->peer_ip), "127.0.0.1");
+    config->peer_port = 6000;
+    config->local_port = 5000;
+    double duration = 0.0;
+    int sample_rate = SAMPLE_RATE;
+    double frame_ms = 0.0;
+    double stats_interval = 0.0;
+    const char *latency_log_path = NULL;
+    const char *metrics_log_path = NULL;
+    const char *metrics_socket_path = NULL;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'H':
+            break;
+        case 'i':
+            snprintf(config->peer_ip, sizeof(config->peer_ip), "%s", optarg);
+            break;
+        case 'p':
+            config->peer_port = atoi(optarg);
+            break;
+        case 'l':
+            config->local_port = atoi(optarg);
+            break;
+        case 'c':
+            config->codec = codec_find_by_name(optarg);
+            if (!config->codec)
+            {
+                fprintf(stderr, "Unknown codec '%s'. Available:", optarg);
+                for (int i = 0; i < codec_count(); i++)
+                    fprintf(stderr, " %s", codec_at(i)->name);
+                fprintf(stderr, "\n");
+                return 1;
+            }
+            break;
+        case 'I':
+            if (audio_backend_parse_source(&config->audio, optarg) == -1)
+            {
+                fprintf(stderr, "Invalid --input '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'O':
+            if (audio_backend_parse_sink(&config->audio, optarg) == -1)
+            {
+                fprintf(stderr, "Invalid --output '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'k':
+            if (strcmp(optarg, "realtime") == 0)
+                config->audio.clock = AUDIO_CLOCK_REALTIME;
+            else if (strcmp(optarg, "fast") == 0)
+                config->audio.clock = AUDIO_CLOCK_FAST;
+            else
+            {
+                fprintf(stderr, "Invalid --clock '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'K':
+            config->audio.clock_skew_ppm = atof(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'z':
+            sample_rate = atoi(optarg);
+            break;
+        case 'F':
+            frame_ms = atof(optarg);
+            break;
+        case 'N':
+            config->packet_frames = atoi(optarg);
+            break;
+        case 'j':
+            config->jb_config.initial_delay_frames = atoi(optarg);
+            config->jb_config.adaptive = false;
+            break;
+        case 'D':
+            config->jb_config.drift_compensation = false;
+            break;
+        case 'a':
+            config->aec_enabled = false;
+            break;
+        case 'A':
+            config->aec_tail_ms = atoi(optarg);
+            if (config->aec_tail_ms <= 0)
+            {
+                fprintf(stderr, "Invalid --aec-tail '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'x':
+            config->dtx_enabled = false;
+            break;
+        case 'm':
+            if (impair_config_parse(&config->impair, optarg) == -1)
+            {
+                fprintf(stderr, "Invalid --impair '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            config->conference = true;
+            break;
+        case 'e':
+        {
+            const char *colon = strrchr(optarg, ':');
+            int count = config->conference_peer_count;
+            if (count >= CONFERENCE_PEERS_MAX || !colon || colon == optarg ||
+                colon - optarg >= CALL_PEER_IP_MAX)
+            {
+                fprintf(stderr, "Invalid --peer '%s'\n", optarg);
+                return 1;
+            }
+            CallPeerAddress *peer = &config->conference_peers[count];
+            snprintf(peer->ip, sizeof(peer->ip), "%.*s",
+                     (int)(colon - optarg), optarg);
+            peer->port = atoi(colon + 1);
+            config->conference_peer_count++;
+            break;
+        }
+        case 'b':
+            config->conference_bridge = true;
+            break;
+        case 'S':
+            config->conference_speakers = atoi(optarg);
+            if (config->conference_speakers < 1 ||
+                config->conference_speakers > MIXER_INPUTS_MAX)
+            {
+                fprintf(stderr, "Invalid --speakers '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            config->relay_room = (uint32_t)strtoul(optarg, NULL, 10);
+            config->relay_join = true;
+            break;
+        case 'f':
+            if (strcmp(optarg, "auto") == 0)
+                config->fec_depth = RED_DEPTH_AUTO;
+            else
+                config->fec_depth = atoi(optarg);
+            if (config->fec_depth < RED_DEPTH_AUTO ||
+                config->fec_depth > RED_MAX_DEPTH)
+            {
+                fprintf(stderr, "Invalid --fec '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'E':
+            config->preprocess.echo_suppress = false;
+            break;
+        case 'Q':
+            config->preprocess.denoise = false;
+            break;
+        case 'q':
+            config->preprocess.noise_suppress_db = -abs(atoi(optarg));
+            break;
+        case 'G':
+            config->preprocess.agc = true;
+            break;
+        case 'v':
+            config->preprocess.vad = false;
+            break;
+        case 'g':
+            config->gain_factor = (float)atof(optarg);
+            break;
+        case 't':
+            config->noise_gate_threshold = (float)atof(optarg);
+            break;
+        case 'C':
+            config->dsp_cpu = atoi(optarg);
+            break;
+        case 'P':
+            config->dsp_rt_priority = atoi(optarg);
+            break;
+        case 's':
+            stats_interval = atof(optarg);
+            break;
+        case 'L':
+            latency_log_path = optarg;
+            break;
+        case 'M':
+            metrics_log_path = optarg;
+            break;
+        case 'U':
+            metrics_socket_path = optarg;
+            break;
+        case 'B':
+            config->latency_probe = true;
+            break;
+        case 'T':
+            config->capture_time = false;
+            break;
+        case 'r':
+            config->record_path = optarg;
+            break;
+        case 'w':
+            config->capture_path = optarg;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool portaudio = config->audio.source == AUDIO_SOURCE_PORTAUDIO;
+    if (portaudio && config->audio.clock == AUDIO_CLOCK_FAST)
+    {
+        fprintf(stderr, "--clock fast needs a file, tone or silence input\n");
+        return 1;
+    }
+    if (audio_backend_set_format(&config->audio, sample_rate, frame_ms) == -1)
+    {
+        fprintf(stderr, "Invalid --rate %d or --frame-ms %g\n", sample_rate,
+                frame_ms);
+        return 1;
+    }
+    if (duration > 0.0)
+        config->audio.max_frames =
+            (unsigned long long)(duration * config->audio.sample_rate);
+    FILE *latency_log = NULL;
+    if (latency_log_path)
+    {
+        latency_log = fopen(latency_log_path, "a");
+        if (!latency_log)
+        {
+            perror("fopen() of the latency log failed");
+            return 1;
+        }
+    }
+    FILE *metrics_file = NULL;
+    if (metrics_log_path)
+    {
+        metrics_file = fopen(metrics_log_path, "a");
+        if (!metrics_file)
+        {
+            perror("fopen() of the metrics log failed");
+            goto error_latency_log;
+        }
+    }
+    MetricsLog metrics_log;
+    metrics_log_init(&metrics_log, metrics_file);
+    MetricsServer metrics_server;
+    metrics_server.fd = -1;
+    if (metrics_socket_path &&
+        metrics_server_start(&metrics_server, &call.metrics,
+                             metrics_socket_path) == -1)
+        goto error_metrics_log;
+    double log_interval =
+        stats_interval > 0.0 ? stats_interval : LATENCY_LOG_INTERVAL_S;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    call.on_first_audio = on_first_audio;
+    call.user_data = &call;
+    if (call_engine_open(&call) == -1 || call_start(&call) == -1)
+    {
+        call_engine_close(&call);
+        goto error_metrics_server;
+    }
+    if (config->conference)
+        printf("[INFO] Headless conference on port %d started.\n",
+               config->local_port);
+    else
+        printf("[INFO] Headless call %d -> %s:%d started.\n",
+               config->local_port, config->peer_ip, config->peer_port);
+
+    uint64_t start_ns = monotonic_ns();
+    uint64_t next_stats_ns = start_ns + (uint64_t)(stats_interval * 1e9);
+    uint64_t next_log_ns = start_ns + (uint64_t)(log_interval * 1e9);
+    while (!stop_requested && !audio_backend_finished(&call.audio))
+    {
+        uint64_t now = monotonic_ns();
+        if (portaudio && duration > 0.0 && (now - start_ns) / 1e9 >= duration)
+            break;
+        if (stats_interval > 0.0 && now >= next_stats_ns)
+        {
+            call_print_quality(&call);
+            latency_print(&call.latency);
+            next_stats_ns += (uint64_t)(stats_interval * 1e9);
+        }
+        if ((latency_log || metrics_file) && now >= next_log_ns)
+        {
+            if (latency_log)
+                latency_write_json(&call.latency, latency_log,
+                                   (now - start_ns) / 1e9);
+            if (metrics_file)
+                metrics_log_write(&metrics_log, &call.metrics,
+                                  (now - start_ns) / 1e9);
+            next_log_ns += (uint64_t)(log_interval * 1e9);
+        }
+        usleep(10000);
+    }
+
+    call_stop(&call);
+    call_engine_close(&call);
+    metrics_server_stop(&metrics_server);
+    if (metrics_file)
+    {
+        metrics_log_write(&metrics_log, &call.metrics,
+                          (monotonic_ns() - start_ns) / 1e9);
+        fclose(metrics_file);
+    }
+    if (latency_log)
+    {
+        latency_write_json(&call.latency, latency_log,
+                           (monotonic_ns() - start_ns) / 1e9);
+        fclose(latency_log);
+    }
+    printf("[INFO] Call ended.\n");
+    return 0;
+
+error_metrics_server:
+    metrics_server_stop(&metrics_server);
+error_metrics_log:
+    if (metrics_file)
+        fclose(metrics_file);
+error_latency_log:
+    if (latency_log)
+        fclose(latency_log);
+    return 1;
+}
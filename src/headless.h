@@ -0,0 +1,6 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+int headless_main(int argc, char *argv[]);
+
+#endif
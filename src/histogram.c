@@ -0,0 +1,87 @@
+#include "histogram.h"
+
+#include <string.h>
+
+static int bucket_index(uint64_t value)
+{
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS)
+        return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    if (msb > HISTOGRAM_MAX_BITS)
+        return HISTOGRAM_BUCKETS - 1;
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) +
+           (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* The middle of a bucket. */
+static double bucket_value(int index)
+{
+    if (index < 2 * HISTOGRAM_SUB_BUCKETS)
+        return (double)index;
+    int shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t low = (uint64_t)(HISTOGRAM_SUB_BUCKETS +
+                              (index & (HISTOGRAM_SUB_BUCKETS - 1)))
+                   << shift;
+    return (double)low + (double)(1ull << shift) / 2.0;
+}
+
+void histogram_reset(Histogram *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+/* Only one thread records, so a load and a store replace the locked
+ * read-modify-write. */
+static inline void add_relaxed(_Atomic uint64_t *counter, uint64_t amount)
+{
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed) +
+                              amount,
+                          memory_order_relaxed);
+}
+
+void histogram_record(Histogram *histogram, uint64_t value)
+{
+    add_relaxed(&histogram->counts[bucket_index(value)], 1);
+    add_relaxed(&histogram->total, 1);
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed))
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+}
+
+void histogram_merge(Histogram *into, const Histogram *from)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        add_relaxed(&into->counts[i], atomic_load(&from->counts[i]));
+    add_relaxed(&into->total, atomic_load(&from->total));
+    uint64_t max = atomic_load(&from->max);
+    if (max > atomic_load(&into->max))
+        atomic_store(&into->max, max);
+}
+
+uint64_t histogram_count(const Histogram *histogram)
+{
+    return atomic_load_explicit(&histogram->total, memory_order_relaxed);
+}
+
+double histogram_percentile(const Histogram *histogram, double fraction)
+{
+    uint64_t total = histogram_count(histogram);
+    if (total == 0)
+        return 0.0;
+    uint64_t rank = (uint64_t)(fraction * (double)(total - 1));
+    uint64_t seen = 0;
+    double max = (double)atomic_load_explicit(&histogram->max,
+                                              memory_order_relaxed);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += atomic_load_explicit(&histogram->counts[i],
+                                     memory_order_relaxed);
+        if (seen > rank)
+        {
+            double value = bucket_value(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
@@ -0,0 +1,38 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Eight buckets per power of two: any recorded value, and so any
+ * percentile, is within 1/8 (12.5%) of the value reported for it. */
+#define HISTOGRAM_SUB_BITS (3)
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+/* Values up to 2^40 (18 minutes in ns); larger ones land in the last
+ * bucket. */
+#define HISTOGRAM_MAX_BITS (40)
+#define HISTOGRAM_BUCKETS                                                      \
+    ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_BUCKETS)
+
+/* A log-linear (HDR-style) histogram of non-negative values, usually
+ * nanoseconds. Recording is constant time and allocation free. One thread
+ * records; any thread may read at the same time and sees each count
+ * whole. */
+typedef struct
+{
+    _Atomic uint64_t counts[HISTOGRAM_BUCKETS];
+    _Atomic uint64_t total;
+    _Atomic uint64_t max;
+} Histogram;
+
+void histogram_reset(Histogram *histogram);
+void histogram_record(Histogram *histogram, uint64_t value);
+/* Adds the counts of from; neither may be recorded to meanwhile. */
+void histogram_merge(Histogram *into, const Histogram *from);
+uint64_t histogram_count(const Histogram *histogram);
+/* The value below which fraction (0-1) of the samples fall: the middle of
+ * its bucket, and never more than the largest value recorded. 0 if
+ * empty. */
+double histogram_percentile(const Histogram *histogram, double fraction);
+
+#endif
@@ -0,0 +1,325 @@
+#include "impair.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMPAIR_PARETO_SHAPE (3.0)
+
+void impair_config_default(ImpairConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->jitter_dist = IMPAIR_JITTER_UNIFORM;
+    config->burst_mean = 1.0;
+    config->reorder_hold_ms = IMPAIR_DEFAULT_REORDER_HOLD_MS;
+    config->queue_limit = IMPAIR_DEFAULT_QUEUE;
+    config->seed = 1;
+}
+
+static int parse_number(const char *value, double min, double *out)
+{
+    char *end;
+    double v = strtod(value, &end);
+    if (end == value || *end != '\0' || v < min)
+        return -1;
+    *out = v;
+    return 0;
+}
+
+int impair_config_parse(ImpairConfig *config, const char *spec)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+    char *save = NULL;
+    for (char *item = strtok_r(buffer, ",", &save); item;
+         item = strtok_r(NULL, ",", &save))
+    {
+        char *value = strchr(item, '=');
+        if (!value)
+            return -1;
+        *value++ = '\0';
+        double number = 0.0;
+        int result = 0;
+        if (strcmp(item, "dist") == 0)
+        {
+            if (strcmp(value, "uniform") == 0)
+                config->jitter_dist = IMPAIR_JITTER_UNIFORM;
+            else if (strcmp(value, "normal") == 0)
+                config->jitter_dist = IMPAIR_JITTER_NORMAL;
+            else if (strcmp(value, "pareto") == 0)
+                config->jitter_dist = IMPAIR_JITTER_PARETO;
+            else
+                result = -1;
+        }
+        else if (strcmp(item, "delay") == 0)
+            result = parse_number(value, 0.0, &config->delay_ms);
+        else if (strcmp(item, "jitter") == 0)
+            result = parse_number(value, 0.0, &config->jitter_ms);
+        else if (strcmp(item, "loss") == 0)
+            result = parse_number(value, 0.0, &config->loss_pct);
+        else if (strcmp(item, "burst") == 0)
+            result = parse_number(value, 1.0, &config->burst_mean);
+        else if (strcmp(item, "reorder") == 0)
+            result = parse_number(value, 0.0, &config->reorder_pct);
+        else if (strcmp(item, "hold") == 0)
+            result = parse_number(value, 0.0, &config->reorder_hold_ms);
+        else if (strcmp(item, "dup") == 0)
+            result = parse_number(value, 0.0, &config->duplicate_pct);
+        else if (strcmp(item, "rate") == 0)
+            result = parse_number(value, 0.0, &config->rate_kbps);
+        else if (strcmp(item, "queue") == 0)
+        {
+            result = parse_number(value, 1.0, &number);
+            config->queue_limit = (int)number;
+        }
+        else if (strcmp(item, "seed") == 0)
+        {
+            result = parse_number(value, 0.0, &number);
+            config->seed = (uint64_t)number;
+        }
+        else
+            result = -1;
+        if (result == -1)
+            return -1;
+    }
+    if (config->loss_pct >= 100.0)
+        return -1;
+    config->enabled = true;
+    return 0;
+}
+
+void impair_config_describe(const ImpairConfig *config, char *out,
+                            int capacity)
+{
+    static const char *dist_names[] = {"uniform", "normal", "pareto"};
+    snprintf(out, capacity,
+             "delay %.0f ms, jitter %.0f ms %s, loss %.1f%% (mean burst "
+             "%.1f), reorder %.1f%%, duplicate %.1f%%, rate %.0f kbit/s, "
+             "seed %llu",
+             config->delay_ms, config->jitter_ms,
+             dist_names[config->jitter_dist], config->loss_pct,
+             config->burst_mean, config->reorder_pct, config->duplicate_pct,
+             config->rate_kbps, (unsigned long long)config->seed);
+}
+
+int impair_init(Impairment *imp, const ImpairConfig *config)
+{
+    memset(imp, 0, sizeof(*imp));
+    imp->config = *config;
+    int limit = config->queue_limit > 0 ? config->queue_limit
+                                        : IMPAIR_DEFAULT_QUEUE;
+    imp->config.queue_limit = limit;
+    imp->pool = (ImpairPacket *)calloc(limit, sizeof(ImpairPacket));
+    imp->heap = (int *)calloc(limit, sizeof(int));
+    imp->free_slots = (int *)calloc(limit, sizeof(int));
+    if (!imp->pool || !imp->heap || !imp->free_slots)
+    {
+        impair_destroy(imp);
+        return -1;
+    }
+    for (int i = 0; i < limit; i++)
+        imp->free_slots[i] = limit - 1 - i;
+    imp->free_count = limit;
+    imp->rng = config->seed;
+    return 0;
+}
+
+void impair_destroy(Impairment *imp)
+{
+    free(imp->pool);
+    free(imp->heap);
+    free(imp->free_slots);
+    imp->pool = NULL;
+    imp->heap = NULL;
+    imp->free_slots = NULL;
+}
+
+/* splitmix64, mapped to (0, 1]. */
+static double next_uniform(Impairment *imp)
+{
+    uint64_t z = (imp->rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return ((z >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static double jitter_sample(const ImpairConfig *config, double u1, double u2)
+{
+    double j = config->jitter_ms;
+    switch (config->jitter_dist)
+    {
+    case IMPAIR_JITTER_NORMAL:
+        return j * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    case IMPAIR_JITTER_PARETO:
+        /* Delay spikes only: a Pareto tail shifted to start at zero, with
+         * mean j. */
+        return j * (IMPAIR_PARETO_SHAPE - 1.0) *
+               (pow(u1, -1.0 / IMPAIR_PARETO_SHAPE) - 1.0);
+    case IMPAIR_JITTER_UNIFORM:
+    default:
+        return j * (2.0 * u1 - 1.0);
+    }
+}
+
+static bool heap_less(const Impairment *imp, int a, int b)
+{
+    const ImpairPacket *pa = &imp->pool[imp->heap[a]];
+    const ImpairPacket *pb = &imp->pool[imp->heap[b]];
+    if (pa->release_ns != pb->release_ns)
+        return pa->release_ns < pb->release_ns;
+    return pa->order < pb->order;
+}
+
+static void heap_swap(Impairment *imp, int a, int b)
+{
+    int tmp = imp->heap[a];
+    imp->heap[a] = imp->heap[b];
+    imp->heap[b] = tmp;
+}
+
+static void enqueue(Impairment *imp, const uint8_t *data, int length,
+                    const struct sockaddr_in *from, uint64_t release_ns)
+{
+    if (imp->free_count == 0)
+    {
+        imp->stats.queue_drops++;
+        return;
+    }
+    int slot = imp->free_slots[--imp->free_count];
+    ImpairPacket *packet = &imp->pool[slot];
+    packet->release_ns = release_ns;
+    packet->order = imp->next_order++;
+    packet->length = length;
+    if (from)
+        packet->from = *from;
+    else
+        memset(&packet->from, 0, sizeof(packet->from));
+    memcpy(packet->data, data, length);
+
+    int i = imp->heap_size++;
+    imp->heap[i] = slot;
+    while (i > 0 && heap_less(imp, i, (i - 1) / 2))
+    {
+        heap_swap(imp, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void impair_submit(Impairment *imp, const uint8_t *data, int length,
+                   const struct sockaddr_in *from, uint64_t now_ns)
+{
+    const ImpairConfig *config = &imp->config;
+    double u_loss = next_uniform(imp);
+    double u_jitter1 = next_uniform(imp);
+    double u_jitter2 = next_uniform(imp);
+    double u_reorder = next_uniform(imp);
+    double u_dup = next_uniform(imp);
+    double u_dup_jitter1 = next_uniform(imp);
+    double u_dup_jitter2 = next_uniform(imp);
+
+    imp->stats.submitted++;
+    if (length <= 0 || length > IMPAIR_PACKET_MAX)
+        return;
+
+    double loss = config->loss_pct / 100.0;
+    bool lost;
+    if (config->burst_mean <= 1.0)
+    {
+        lost = u_loss <= loss;
+    }
+    else
+    {
+        double leave = 1.0 / config->burst_mean;
+        double enter = loss * leave / (1.0 - loss);
+        imp->burst_bad = u_loss <= (imp->burst_bad ? 1.0 - leave : enter);
+        lost = imp->burst_bad;
+    }
+    if (lost)
+    {
+        imp->stats.lost++;
+        return;
+    }
+
+    uint64_t depart_ns = now_ns;
+    if (config->rate_kbps > 0.0)
+    {
+        uint64_t tx_ns = (uint64_t)(length * 8.0 * 1e6 / config->rate_kbps);
+        if (imp->link_free_ns > depart_ns)
+            depart_ns = imp->link_free_ns;
+        depart_ns += tx_ns;
+        imp->link_free_ns = depart_ns;
+    }
+
+    double delay_ms = config->delay_ms +
+                      jitter_sample(config, u_jitter1, u_jitter2);
+    uint64_t release_ns =
+        depart_ns + (delay_ms > 0.0 ? (uint64_t)(delay_ms * 1e6) : 0);
+    if (u_reorder * 100.0 <= config->reorder_pct)
+    {
+        imp->stats.reordered++;
+        release_ns += (uint64_t)(config->reorder_hold_ms * 1e6);
+    }
+    else
+    {
+        if (release_ns < imp->last_release_ns)
+            release_ns = imp->last_release_ns;
+        imp->last_release_ns = release_ns;
+    }
+    enqueue(imp, data, length, from, release_ns);
+
+    if (u_dup * 100.0 <= config->duplicate_pct)
+    {
+        imp->stats.duplicated++;
+        double dup_ms = config->delay_ms +
+                        jitter_sample(config, u_dup_jitter1, u_dup_jitter2);
+        enqueue(imp, data, length, from,
+                depart_ns + (dup_ms > 0.0 ? (uint64_t)(dup_ms * 1e6) : 0));
+    }
+}
+
+int impair_pop(Impairment *imp, uint64_t now_ns, uint8_t *out, int capacity,
+               uint64_t *release_ns, struct sockaddr_in *from)
+{
+    if (imp->heap_size == 0)
+        return 0;
+    ImpairPacket *packet = &imp->pool[imp->heap[0]];
+    if (packet->release_ns > now_ns)
+        return 0;
+    int length = packet->length < capacity ? packet->length : capacity;
+    memcpy(out, packet->data, length);
+    *release_ns = packet->release_ns;
+    if (from)
+        *from = packet->from;
+    imp->free_slots[imp->free_count++] = imp->heap[0];
+    imp->stats.delivered++;
+
+    imp->heap[0] = imp->heap[--imp->heap_size];
+    int i = 0;
+    while (true)
+    {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+        if (left < imp->heap_size && heap_less(imp, left, smallest))
+            smallest = left;
+        if (right < imp->heap_size && heap_less(imp, right, smallest))
+            smallest = right;
+        if (smallest == i)
+            break;
+        heap_swap(imp, i, smallest);
+        i = smallest;
+    }
+    return length;
+}
+
+int impair_timeout_ms(const Impairment *imp, uint64_t now_ns)
+{
+    if (imp->heap_size == 0)
+        return -1;
+    uint64_t release_ns = imp->pool[imp->heap[0]].release_ns;
+    if (release_ns <= now_ns)
+        return 0;
+    return (int)((release_ns - now_ns + 999999) / 1000000);
+}
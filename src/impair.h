@@ -0,0 +1,102 @@
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IMPAIR_PACKET_MAX (1500)
+#define IMPAIR_DEFAULT_QUEUE (256)
+#define IMPAIR_DEFAULT_REORDER_HOLD_MS (20.0)
+
+typedef enum
+{
+    IMPAIR_JITTER_UNIFORM,
+    IMPAIR_JITTER_NORMAL,
+    IMPAIR_JITTER_PARETO,
+} ImpairJitter;
+
+/* Network conditions applied to a datagram stream. Loss with a mean burst
+ * above one packet follows a two-state Gilbert-Elliott model whose long-run
+ * rate is loss_pct. Jitter never reorders by itself; reorder_pct of the
+ * packets are instead held back by reorder_hold_ms so later ones overtake
+ * them. rate_kbps serializes packets onto a link of that speed. At most
+ * queue_limit packets are in flight; more are dropped. */
+typedef struct
+{
+    bool enabled;
+    double delay_ms;
+    double jitter_ms;
+    ImpairJitter jitter_dist;
+    double loss_pct;
+    double burst_mean;
+    double reorder_pct;
+    double reorder_hold_ms;
+    double duplicate_pct;
+    double rate_kbps;
+    int queue_limit;
+    uint64_t seed;
+} ImpairConfig;
+
+typedef struct
+{
+    uint64_t submitted;
+    uint64_t delivered;
+    uint64_t lost;
+    uint64_t queue_drops;
+    uint64_t reordered;
+    uint64_t duplicated;
+} ImpairStats;
+
+typedef struct
+{
+    uint64_t release_ns;
+    uint64_t order;
+    int length;
+    struct sockaddr_in from;
+    uint8_t data[IMPAIR_PACKET_MAX];
+} ImpairPacket;
+
+/* Packets wait in a min-heap ordered by release time, ties broken by
+ * submission order. All randomness comes from one seeded generator that
+ * draws a fixed number of values per packet, so the same input sequence
+ * always receives the same treatment. */
+typedef struct
+{
+    ImpairConfig config;
+    ImpairPacket *pool;
+    int *heap;
+    int *free_slots;
+    int heap_size;
+    int free_count;
+    uint64_t rng;
+    bool burst_bad;
+    uint64_t next_order;
+    uint64_t last_release_ns;
+    uint64_t link_free_ns;
+    ImpairStats stats;
+} Impairment;
+
+void impair_config_default(ImpairConfig *config);
+/* Parses a comma-separated list such as "delay=40,jitter=10,loss=2,burst=3"
+ * into config and enables it. Keys: delay, jitter (ms), dist (uniform,
+ * normal, pareto), loss, burst, reorder, hold (ms), dup, rate (kbit/s),
+ * queue and seed. Returns -1 on an unknown key or bad value. */
+int impair_config_parse(ImpairConfig *config, const char *spec);
+void impair_config_describe(const ImpairConfig *config, char *out,
+                            int capacity);
+
+int impair_init(Impairment *imp, const ImpairConfig *config);
+void impair_destroy(Impairment *imp);
+/* Offers a datagram received from from (which may be NULL) at now_ns. */
+void impair_submit(Impairment *imp, const uint8_t *data, int length,
+                   const struct sockaddr_in *from, uint64_t now_ns);
+/* Copies out the next datagram due by now_ns and returns its length, or 0
+ * if none is due. *release_ns is the time it was due and *from, unless
+ * NULL, its source. */
+int impair_pop(Impairment *imp, uint64_t now_ns, uint8_t *out, int capacity,
+               uint64_t *release_ns, struct sockaddr_in *from);
+/* Milliseconds until the next release (rounded up), or -1 if idle. */
+int impair_timeout_ms(const Impairment *imp, uint64_t now_ns);
+
+#endif
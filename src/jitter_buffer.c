@@ -0,0 +1,671 @@
+#include "jitter_buffer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp_kernels.h"
+#include "packet_pool.h"
+#include "time_scale.h"
+
+/* Drift control: depth is averaged over a few seconds, then a PI loop turns
+ * the excess over the target, in ms, into a playout rate correction in ppm.
+ * The integral settles on the clock difference within a minute or two. */
+#define JB_DRIFT_SMOOTHING_S (2.0)
+#define JB_DRIFT_KP (90.0)
+#define JB_DRIFT_KI (2.5)
+#define JB_DRIFT_MAX_PPM (1000.0)
+
+void jitter_buffer_config_default(JitterBufferConfig *config)
+{
+    config->slot_count = JB_DEFAULT_SLOTS;
+    config->frame_size = FRAMES_PER_BUFFER;
+    config->sample_rate = SAMPLE_RATE;
+    config->initial_delay_frames = 4;
+    config->min_delay_frames = 1;
+    config->max_delay_frames = JB_DEFAULT_SLOTS / 2;
+    config->delay_percentile = 0.95f;
+    config->low_energy_rms = 300.0f;
+    config->adaptive = true;
+    config->drift_compensation = true;
+}
+
+int jitter_buffer_init(JitterBuffer *jb, const JitterBufferConfig *config)
+{
+    memset(jb, 0, sizeof(*jb));
+    /* First, so that jitter_buffer_destroy() is valid on every failure. */
+    pthread_mutex_init(&jb->mutex, NULL);
+    jb->config = *config;
+    if (jb->config.slot_count < 2)
+        jb->config.slot_count = 2;
+    if (jb->config.frame_size > AUDIO_PACKET_SAMPLES_MAX)
+        jb->config.frame_size = AUDIO_PACKET_SAMPLES_MAX;
+    if (jb->config.max_delay_frames > jb->config.slot_count - 1)
+        jb->config.max_delay_frames = jb->config.slot_count - 1;
+    if (jb->config.min_delay_frames < 1)
+        jb->config.min_delay_frames = 1;
+    if (jb->config.min_delay_frames > jb->config.max_delay_frames)
+        jb->config.min_delay_frames = jb->config.max_delay_frames;
+
+    int slot_count = jb->config.slot_count;
+    int frame_size = jb->config.frame_size;
+    jb->slots = (AudioPacket *)calloc(slot_count, sizeof(AudioPacket));
+    jb->slot_seq = (uint32_t *)calloc(slot_count, sizeof(uint32_t));
+    jb->slot_filled = (bool *)calloc(slot_count, sizeof(bool));
+    jb->pcm_capacity = frame_size * 4;
+    jb->pcm = (SAMPLE *)calloc(jb->pcm_capacity, sizeof(SAMPLE));
+    jb->work = (SAMPLE *)calloc(frame_size * 2, sizeof(SAMPLE));
+    if (!jb->slots || !jb->slot_seq || !jb->slot_filled || !jb->pcm ||
+        !jb->work ||
+        plc_init(&jb->plc, jb->config.sample_rate, frame_size) == -1 ||
+        (jb->config.drift_compensation &&
+         resampler_init(&jb->resampler, frame_size * 2) == -1))
+    {
+        jitter_buffer_destroy(jb);
+        return -1;
+    }
+
+    jb->frame_ns = (int64_t)frame_size * 1000000000ll /
+                   jb->config.sample_rate;
+    comfort_noise_init(&jb->comfort_noise);
+    jb->target_delay_frames = jb->config.initial_delay_frames;
+    if (jb->target_delay_frames < jb->config.min_delay_frames)
+        jb->target_delay_frames = jb->config.min_delay_frames;
+    if (jb->target_delay_frames > jb->config.max_delay_frames)
+        jb->target_delay_frames = jb->config.max_delay_frames;
+    return 0;
+}
+
+void jitter_buffer_destroy(JitterBuffer *jb)
+{
+    for (int i = 0; jb->slots && i < jb->config.slot_count; i++)
+    {
+        if (jb->slots[i].buffer)
+            packet_buffer_release(jb->slots[i].buffer);
+    }
+    free(jb->slots);
+    free(jb->slot_seq);
+    free(jb->slot_filled);
+    free(jb->pcm);
+    free(jb->work);
+    plc_destroy(&jb->plc);
+    resampler_destroy(&jb->resampler);
+    codec_decoder_close(&jb->decoder);
+    jb->slots = NULL;
+    jb->slot_seq = NULL;
+    jb->slot_filled = NULL;
+    jb->pcm = NULL;
+    jb->work = NULL;
+    pthread_mutex_destroy(&jb->mutex);
+}
+
+void jitter_buffer_reset(JitterBuffer *jb)
+{
+    int slot_count = jb->config.slot_count;
+    for (int i = 0; i < slot_count; i++)
+    {
+        if (jb->slots[i].buffer)
+            packet_buffer_release(jb->slots[i].buffer);
+    }
+    memset(jb->slots, 0, slot_count * sizeof(AudioPacket));
+    memset(jb->slot_seq, 0, slot_count * sizeof(uint32_t));
+    memset(jb->slot_filled, 0, slot_count * sizeof(bool));
+    jb->next_seq_to_play = 0;
+    jb->max_seq_received = 0;
+    jb->base_seq = 0;
+    jb->ref_timestamp = 0;
+    jb->ref_index = 0;
+    jb->has_ref_timestamp = false;
+    jb->is_primed = false;
+    jb->in_dtx = false;
+    jb->redundancy_frames = 0;
+    jb->packets_since_redundancy = 0;
+    memset(jb->transit_window, 0, sizeof(jb->transit_window));
+    jb->transit_count = 0;
+    jb->transit_head = 0;
+    jb->last_transit = 0;
+    jb->has_last_transit = false;
+    jb->jitter_ns = 0.0;
+    jb->filtered_depth = 0.0;
+    jb->speech_energy = 0.0f;
+    jb->drift_depth = 0.0;
+    jb->drift_ppm = 0.0;
+    jb->pcm_len = 0;
+    plc_reset(&jb->plc);
+    if (jb->config.drift_compensation)
+        resampler_reset(&jb->resampler);
+    comfort_noise_init(&jb->comfort_noise);
+    codec_decoder_close(&jb->decoder);
+    memset(&jb->stats, 0, sizeof(jb->stats));
+    jb->target_delay_frames = jb->config.initial_delay_frames;
+    if (jb->target_delay_frames < jb->config.min_delay_frames)
+        jb->target_delay_frames = jb->config.min_delay_frames;
+    if (jb->target_delay_frames > jb->config.max_delay_frames)
+        jb->target_delay_frames = jb->config.max_delay_frames;
+}
+
+int jitter_buffer_set_frame_size(JitterBuffer *jb, int frame_size)
+{
+    if (frame_size > AUDIO_PACKET_SAMPLES_MAX)
+        frame_size = AUDIO_PACKET_SAMPLES_MAX;
+    pthread_mutex_lock(&jb->mutex);
+    if (frame_size == jb->config.frame_size)
+    {
+        pthread_mutex_unlock(&jb->mutex);
+        return 0;
+    }
+    SAMPLE *pcm = (SAMPLE *)calloc(frame_size * 4, sizeof(SAMPLE));
+    SAMPLE *work = (SAMPLE *)calloc(frame_size * 2, sizeof(SAMPLE));
+    PlcState plc;
+    Resampler resampler;
+    memset(&plc, 0, sizeof(plc));
+    memset(&resampler, 0, sizeof(resampler));
+    if (!pcm || !work ||
+        plc_init(&plc, jb->config.sample_rate, frame_size) == -1 ||
+        (jb->config.drift_compensation &&
+         resampler_init(&resampler, frame_size * 2) == -1))
+    {
+        free(pcm);
+        free(work);
+        plc_destroy(&plc);
+        pthread_mutex_unlock(&jb->mutex);
+        return -1;
+    }
+    free(jb->pcm);
+    free(jb->work);
+    plc_destroy(&jb->plc);
+    resampler_destroy(&jb->resampler);
+    jb->pcm = pcm;
+    jb->work = work;
+    jb->plc = plc;
+    jb->resampler = resampler;
+    jb->pcm_capacity = frame_size * 4;
+    jb->config.frame_size = frame_size;
+    jb->frame_ns = (int64_t)frame_size * 1000000000ll /
+                   jb->config.sample_rate;
+    jitter_buffer_reset(jb);
+    pthread_mutex_unlock(&jb->mutex);
+    return 0;
+}
+
+static int64_t select_kth(int64_t *values, int count, int k)
+{
+    int left = 0, right = count - 1;
+    while (left < right)
+    {
+        int64_t pivot = values[(left + right) / 2];
+        int i = left, j = right;
+        while (i <= j)
+        {
+            while (values[i] < pivot)
+                i++;
+            while (values[j] > pivot)
+                j--;
+            if (i <= j)
+            {
+                int64_t tmp = values[i];
+                values[i] = values[j];
+                values[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j)
+            right = j;
+        else if (k >= i)
+            left = i;
+        else
+            break;
+    }
+    return values[k];
+}
+
+static void update_delay_estimate(JitterBuffer *jb, uint32_t seq,
+                                  uint64_t arrival_ns)
+{
+    if (jb->stats.packets_received == 1)
+    {
+        jb->base_seq = seq;
+        jb->max_seq_received = seq;
+    }
+    int64_t relative_seq = (int32_t)(seq - jb->base_seq);
+    int64_t transit = (int64_t)arrival_ns - relative_seq * jb->frame_ns;
+
+    if (jb->has_last_transit)
+    {
+        double d = fabs((double)(transit - jb->last_transit));
+        jb->jitter_ns += (d - jb->jitter_ns) / 16.0;
+    }
+    jb->last_transit = transit;
+    jb->has_last_transit = true;
+
+    jb->transit_window[jb->transit_head] = transit;
+    jb->transit_head = (jb->transit_head + 1) % JB_DELAY_WINDOW;
+    if (jb->transit_count < JB_DELAY_WINDOW)
+        jb->transit_count++;
+    if (jb->transit_count < 8 || !jb->config.adaptive)
+        return;
+
+    int64_t min_transit = jb->transit_window[0];
+    for (int i = 1; i < jb->transit_count; i++)
+    {
+        if (jb->transit_window[i] < min_transit)
+            min_transit = jb->transit_window[i];
+    }
+    for (int i = 0; i < jb->transit_count; i++)
+        jb->delay_scratch[i] = jb->transit_window[i] - min_transit;
+
+    int k = (int)ceilf(jb->config.delay_percentile * jb->transit_count) - 1;
+    if (k < 0)
+        k = 0;
+    if (k >= jb->transit_count)
+        k = jb->transit_count - 1;
+    int64_t needed_ns = select_kth(jb->delay_scratch, jb->transit_count, k);
+
+    int target = (int)((needed_ns + jb->frame_ns - 1) / jb->frame_ns) + 1;
+    if (target < jb->redundancy_frames + 1)
+        target = jb->redundancy_frames + 1;
+    if (target < jb->config.min_delay_frames)
+        target = jb->config.min_delay_frames;
+    if (target > jb->config.max_delay_frames)
+        target = jb->config.max_delay_frames;
+    jb->target_delay_frames = target;
+}
+
+/* Lets go of the datagram behind a slot that is played, dropped or
+ * reused. */
+static void clear_slot(JitterBuffer *jb, uint32_t index)
+{
+    if (jb->slots[index].buffer)
+    {
+        packet_buffer_release(jb->slots[index].buffer);
+        jb->slots[index].buffer = NULL;
+    }
+    jb->slot_filled[index] = false;
+}
+
+/* Keeps the frame where it arrived, holding a reference to its datagram
+ * instead of copying the payload. */
+static void store_slot(JitterBuffer *jb, uint32_t index, uint32_t seq,
+                       const AudioPacket *packet)
+{
+    clear_slot(jb, index);
+    packet_buffer_hold(packet->buffer);
+    jb->slots[index] = *packet;
+    jb->slot_seq[index] = seq;
+    jb->slot_filled[index] = true;
+}
+
+static void drop_slots_before(JitterBuffer *jb, uint32_t new_next_seq)
+{
+    while ((int32_t)(new_next_seq - jb->next_seq_to_play) > 0)
+    {
+        uint32_t index = jb->next_seq_to_play % jb->config.slot_count;
+        if (jb->slot_filled[index] &&
+            jb->slot_seq[index] == jb->next_seq_to_play)
+            clear_slot(jb, index);
+        jb->stats.packets_lost++;
+        jb->next_seq_to_play++;
+    }
+}
+
+/* Maps an RTP timestamp to a frame index relative to the newest packet, so
+ * timestamp wrap-around is harmless. */
+static uint32_t frame_index(JitterBuffer *jb, uint32_t timestamp)
+{
+    if (!jb->has_ref_timestamp)
+    {
+        jb->has_ref_timestamp = true;
+        jb->ref_timestamp = timestamp;
+        jb->ref_index = 0;
+        return 0;
+    }
+    int32_t delta = (int32_t)(timestamp - jb->ref_timestamp);
+    int32_t frames = delta >= 0
+                         ? delta / jb->config.frame_size
+                         : -((-delta + jb->config.frame_size - 1) /
+                             jb->config.frame_size);
+    uint32_t index = jb->ref_index + (uint32_t)frames;
+    if (delta > 0)
+    {
+        jb->ref_timestamp = timestamp;
+        jb->ref_index = index;
+    }
+    return index;
+}
+
+/* A redundant copy is dropped quietly unless it fills a frame that has not
+ * arrived and has not been played yet. It is not a new arrival, so it
+ * leaves the delay and loss statistics alone. */
+static void put_redundant(JitterBuffer *jb, const AudioPacket *packet)
+{
+    if (jb->stats.packets_received == 0)
+        return;
+    uint32_t seq = frame_index(jb, packet->timestamp);
+    int32_t distance = (int32_t)(jb->max_seq_received - seq);
+    if (distance <= 0 || distance >= jb->config.slot_count)
+        return;
+    jb->packets_since_redundancy = 0;
+    if (distance > jb->redundancy_frames)
+        jb->redundancy_frames = distance;
+    if (jb->is_primed && (int32_t)(seq - jb->next_seq_to_play) < 0)
+        return;
+    uint32_t index = seq % jb->config.slot_count;
+    if (jb->slot_filled[index] && jb->slot_seq[index] == seq)
+        return;
+    store_slot(jb, index, seq, packet);
+}
+
+void jitter_buffer_put(JitterBuffer *jb, const AudioPacket *packet,
+                       uint64_t arrival_ns)
+{
+    if (packet->payload_size > AUDIO_PAYLOAD_MAX || !packet->buffer)
+        return;
+    pthread_mutex_lock(&jb->mutex);
+    if (packet->flags & AUDIO_PACKET_REDUNDANT)
+    {
+        put_redundant(jb, packet);
+        pthread_mutex_unlock(&jb->mutex);
+        return;
+    }
+    if (++jb->packets_since_redundancy > JB_DELAY_WINDOW)
+        jb->redundancy_frames = 0;
+    jb->stats.packets_received++;
+    uint32_t seq = frame_index(jb, packet->timestamp);
+    update_delay_estimate(jb, seq, arrival_ns);
+
+    if (jb->is_primed)
+    {
+        int32_t ahead = (int32_t)(seq - jb->next_seq_to_play);
+        if (ahead < 0)
+        {
+            jb->stats.packets_late++;
+            pthread_mutex_unlock(&jb->mutex);
+            return;
+        }
+        if (ahead >= jb->config.slot_count)
+            drop_slots_before(jb, seq - jb->config.slot_count + 1);
+    }
+
+    uint32_t index = seq % jb->config.slot_count;
+    if (jb->slot_filled[index] && jb->slot_seq[index] == seq)
+    {
+        jb->stats.packets_duplicate++;
+        pthread_mutex_unlock(&jb->mutex);
+        return;
+    }
+    store_slot(jb, index, seq, packet);
+    if ((int32_t)(seq - jb->max_seq_received) > 0)
+        jb->max_seq_received = seq;
+    pthread_mutex_unlock(&jb->mutex);
+}
+
+/* A call may open in silence, in which case only comfort noise packets
+ * arrive. Playout then starts at once, scheduled target_delay_frames behind
+ * the first of them. */
+static bool try_prime(JitterBuffer *jb)
+{
+    int filled_count = 0;
+    uint32_t lowest_seq = jb->max_seq_received;
+    int lowest_index = -1;
+    for (int i = 0; i < jb->config.slot_count; i++)
+    {
+        if (!jb->slot_filled[i])
+            continue;
+        filled_count++;
+        if (lowest_index < 0 || (int32_t)(jb->slot_seq[i] - lowest_seq) < 0)
+        {
+            lowest_seq = jb->slot_seq[i];
+            lowest_index = i;
+        }
+    }
+    if (filled_count < jb->target_delay_frames)
+    {
+        if (lowest_index < 0 ||
+            jb->slots[lowest_index].payload_type != PAYLOAD_CN)
+            return false;
+        lowest_seq -= jb->target_delay_frames - filled_count;
+        jb->in_dtx = true;
+    }
+    jb->next_seq_to_play = lowest_seq;
+    jb->filtered_depth = filled_count;
+    jb->drift_depth = filled_count;
+    jb->is_primed = true;
+    return true;
+}
+
+static double buffered_frames(const JitterBuffer *jb)
+{
+    int32_t packets = (int32_t)(jb->max_seq_received - jb->next_seq_to_play) + 1;
+    if (packets < 0)
+        packets = 0;
+    return packets + (double)jb->pcm_len / jb->config.frame_size;
+}
+
+static int adjust_time_scale(JitterBuffer *jb, SAMPLE *frame, int len)
+{
+    float energy = (float)dsp_sum_squares(frame, len) / len;
+
+    float floor_energy = jb->config.low_energy_rms * jb->config.low_energy_rms;
+    bool low_energy =
+        energy < floor_energy || energy < 0.25f * jb->speech_energy;
+    if (!low_energy)
+        jb->speech_energy += (energy - jb->speech_energy) * 0.05f;
+
+    if (!jb->config.adaptive)
+        return len;
+    double target = jb->target_delay_frames;
+    bool want_compress = jb->filtered_depth > target + 1.0;
+    bool want_expand = jb->filtered_depth < target - 0.5;
+    if (!want_compress && !want_expand)
+        return len;
+
+    int min_lag = jb->config.sample_rate / 400;
+    int max_lag = jb->config.sample_rate / 70;
+    float correlation;
+    int lag = time_scale_best_lag(frame, len, min_lag, max_lag, &correlation);
+    if (!low_energy && correlation < 0.9f)
+        return len;
+
+    int new_len;
+    if (want_compress)
+    {
+        new_len = time_scale_compress(frame, len, frame, lag);
+        jb->stats.samples_compressed += len - new_len;
+    }
+    else
+    {
+        new_len = time_scale_expand(frame, len, frame, lag);
+        jb->stats.samples_expanded += new_len - len;
+    }
+    jb->filtered_depth += (double)(new_len - len) / jb->config.frame_size;
+    return new_len;
+}
+
+/* Returns the playout rate for the next frame, in input samples per output
+ * sample. During DTX the depth says nothing about the sender's clock, so
+ * the estimate is held and applied as it is. While time scaling corrects
+ * a larger error, such as a jump in the target, the integral is left
+ * alone so that it only learns the drift. */
+static double drift_ratio(JitterBuffer *jb)
+{
+    if (jb->in_dtx)
+        return 1.0 + jb->drift_ppm * 1e-6;
+    double frame_s = (double)jb->frame_ns / 1e9;
+    double frame_ms = frame_s * 1000.0;
+    jb->drift_depth += (jb->filtered_depth - jb->drift_depth) * frame_s /
+                       JB_DRIFT_SMOOTHING_S;
+    /* Aim midway between the points where time scaling steps in. */
+    double excess = jb->drift_depth - (jb->target_delay_frames + 0.25);
+    if (!jb->config.adaptive || (excess < 0.75 && excess > -0.75))
+    {
+        jb->drift_ppm += JB_DRIFT_KI * excess * frame_ms * frame_s;
+        if (jb->drift_ppm > JB_DRIFT_MAX_PPM)
+            jb->drift_ppm = JB_DRIFT_MAX_PPM;
+        if (jb->drift_ppm < -JB_DRIFT_MAX_PPM)
+            jb->drift_ppm = -JB_DRIFT_MAX_PPM;
+    }
+    double ppm = jb->drift_ppm + JB_DRIFT_KP * excess * frame_ms;
+    if (ppm > JB_DRIFT_MAX_PPM)
+        ppm = JB_DRIFT_MAX_PPM;
+    if (ppm < -JB_DRIFT_MAX_PPM)
+        ppm = -JB_DRIFT_MAX_PPM;
+    return 1.0 + ppm * 1e-6;
+}
+
+static bool decode_packet(JitterBuffer *jb, const AudioPacket *packet,
+                          SAMPLE *frame)
+{
+    int frame_size = jb->config.frame_size;
+    if (!jb->decoder.codec ||
+        jb->decoder.codec->payload_type != packet->payload_type)
+    {
+        const Codec *codec = codec_find(packet->payload_type);
+        codec_decoder_close(&jb->decoder);
+        if (!codec || codec_decoder_open(&jb->decoder, codec,
+                                         jb->config.sample_rate,
+                                         frame_size) == -1)
+            return false;
+    }
+    int decoded = codec_decode(&jb->decoder, packet->payload,
+                               packet->payload_size, frame, frame_size);
+    if (decoded < 0)
+        return false;
+    if (decoded < frame_size)
+        memset(frame + decoded, 0, (frame_size - decoded) * sizeof(SAMPLE));
+    return true;
+}
+
+static void play_comfort_noise(JitterBuffer *jb, SAMPLE *frame, int len)
+{
+    comfort_noise_generate(&jb->comfort_noise, frame, len);
+    plc_good_frame(&jb->plc, frame, len);
+    jb->stats.frames_comfort_noise++;
+    jb->next_seq_to_play++;
+}
+
+static void fetch_frame(JitterBuffer *jb)
+{
+    int frame_size = jb->config.frame_size;
+    SAMPLE *frame = jb->work;
+    uint32_t index = jb->next_seq_to_play % jb->config.slot_count;
+    int len = frame_size;
+    bool have_packet =
+        jb->slot_filled[index] && jb->slot_seq[index] == jb->next_seq_to_play;
+
+    if (!jb->in_dtx)
+        jb->filtered_depth +=
+            (buffered_frames(jb) - jb->filtered_depth) * 0.125;
+
+    if (have_packet && jb->slots[index].payload_type == PAYLOAD_CN)
+    {
+        comfort_noise_set_payload(&jb->comfort_noise, jb->slots[index].payload,
+                                  jb->slots[index].payload_size);
+        clear_slot(jb, index);
+        jb->in_dtx = true;
+        play_comfort_noise(jb, frame, len);
+    }
+    else if (!have_packet && jb->in_dtx)
+    {
+        /* Nothing is sent during DTX, so the playout clock keeps running
+         * without waiting for packets. */
+        play_comfort_noise(jb, frame, len);
+    }
+    else if (have_packet)
+    {
+        jb->next_seq_to_play++;
+        if (jb->in_dtx)
+        {
+            jb->in_dtx = false;
+            jb->filtered_depth = buffered_frames(jb);
+            jb->drift_depth = jb->filtered_depth;
+        }
+        if (decode_packet(jb, &jb->slots[index], frame))
+        {
+            if (jb->slots[index].flags & AUDIO_PACKET_REDUNDANT)
+                jb->stats.frames_recovered++;
+            plc_good_frame(&jb->plc, frame, len);
+            len = adjust_time_scale(jb, frame, len);
+        }
+        else
+        {
+            jb->stats.decode_errors++;
+            jb->stats.frames_concealed++;
+            plc_conceal(&jb->plc, frame, frame_size);
+        }
+        clear_slot(jb, index);
+    }
+    else if ((int32_t)(jb->max_seq_received - jb->next_seq_to_play) > 0)
+    {
+        plc_conceal(&jb->plc, frame, frame_size);
+        jb->stats.packets_lost++;
+        jb->stats.frames_concealed++;
+        jb->next_seq_to_play++;
+    }
+    else
+    {
+        plc_conceal(&jb->plc, frame, frame_size);
+        jb->stats.underruns++;
+        jb->stats.frames_concealed++;
+    }
+
+    if (jb->config.drift_compensation)
+    {
+        jb->pcm_len += resampler_process(
+            &jb->resampler, frame, len, jb->pcm + jb->pcm_len,
+            jb->pcm_capacity - jb->pcm_len, drift_ratio(jb));
+        return;
+    }
+    if (jb->pcm_len + len > jb->pcm_capacity)
+        len = jb->pcm_capacity - jb->pcm_len;
+    memcpy(jb->pcm + jb->pcm_len, frame, len * sizeof(SAMPLE));
+    jb->pcm_len += len;
+}
+
+void jitter_buffer_get(JitterBuffer *jb, SAMPLE *out_buffer, int frames)
+{
+    pthread_mutex_lock(&jb->mutex);
+    if (!jb->is_primed && !try_prime(jb))
+    {
+        memset(out_buffer, 0, frames * sizeof(SAMPLE));
+        pthread_mutex_unlock(&jb->mutex);
+        return;
+    }
+    while (frames > 0)
+    {
+        int chunk = frames < jb->config.frame_size ? frames
+                                                   : jb->config.frame_size;
+        while (jb->pcm_len < chunk)
+            fetch_frame(jb);
+        memcpy(out_buffer, jb->pcm, chunk * sizeof(SAMPLE));
+        jb->pcm_len -= chunk;
+        memmove(jb->pcm, jb->pcm + chunk, jb->pcm_len * sizeof(SAMPLE));
+        out_buffer += chunk;
+        frames -= chunk;
+    }
+    pthread_mutex_unlock(&jb->mutex);
+}
+
+bool jitter_buffer_is_primed(JitterBuffer *jb)
+{
+    pthread_mutex_lock(&jb->mutex);
+    bool primed = jb->is_primed;
+    pthread_mutex_unlock(&jb->mutex);
+    return primed;
+}
+
+void jitter_buffer_get_stats(JitterBuffer *jb, JitterBufferStats *stats)
+{
+    pthread_mutex_lock(&jb->mutex);
+    *stats = jb->stats;
+    double frame_ms = (double)jb->frame_ns / 1e6;
+    stats->current_delay_ms = jb->is_primed ? buffered_frames(jb) * frame_ms : 0.0;
+    stats->target_delay_ms = jb->target_delay_frames * frame_ms;
+    stats->jitter_ms = jb->jitter_ns / 1e6;
+    stats->drift_ppm = jb->drift_ppm;
+    stats->late_loss_rate =
+        stats->packets_received
+            ? (double)stats->packets_late / (double)stats->packets_received
+            : 0.0;
+    pthread_mutex_unlock(&jb->mutex);
+}
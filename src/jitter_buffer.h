@@ -0,0 +1,126 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_packet.h"
+#include "codec.h"
+#include "comfort_noise.h"
+#include "plc.h"
+#include "resampler.h"
+
+#define JB_DEFAULT_SLOTS (64)
+#define JB_DELAY_WINDOW (256)
+
+typedef struct
+{
+    int slot_count;
+    int frame_size;
+    int sample_rate;
+    int initial_delay_frames;
+    int min_delay_frames;
+    int max_delay_frames;
+    float delay_percentile;
+    float low_energy_rms;
+    bool adaptive;
+    bool drift_compensation;
+} JitterBufferConfig;
+
+typedef struct
+{
+    double current_delay_ms;
+    double target_delay_ms;
+    double jitter_ms;
+    double late_loss_rate;
+    uint64_t packets_received;
+    uint64_t packets_late;
+    uint64_t packets_duplicate;
+    uint64_t packets_lost;
+    uint64_t underruns;
+    uint64_t frames_concealed;
+    uint64_t frames_comfort_noise;
+    uint64_t frames_recovered;
+    uint64_t decode_errors;
+    uint64_t samples_compressed;
+    uint64_t samples_expanded;
+    double drift_ppm;
+} JitterBufferStats;
+
+/* Packets are ordered by frame index, derived from the RTP timestamp, so a
+ * DTX pause keeps its place on the playout timeline. After a comfort noise
+ * packet, missing frames are filled with comfort noise instead of being
+ * concealed and counted as lost. The *_seq fields hold frame indices.
+ * Redundant copies only fill frames that are still missing; while they
+ * arrive, the target delay is held high enough for them to be in time.
+ * A slot refers to its frame's payload in the datagram buffer it was
+ * received into and holds a reference to it until the frame is played or
+ * dropped, so packets are neither copied in nor out.
+ * The sender's sound card clock never quite matches ours, so packets
+ * arrive slightly faster or slower than frames are played. With drift
+ * compensation, a slow control loop on the buffered depth estimates the
+ * difference (drift_ppm) and every frame is resampled by it on its way to
+ * playout, holding the depth at the target for as long as the call lasts
+ * instead of letting it creep towards overflow or underrun. */
+typedef struct
+{
+    JitterBufferConfig config;
+    AudioPacket *slots;
+    uint32_t *slot_seq;
+    bool *slot_filled;
+    uint32_t next_seq_to_play;
+    uint32_t max_seq_received;
+    uint32_t base_seq;
+    uint32_t ref_timestamp;
+    uint32_t ref_index;
+    bool has_ref_timestamp;
+    bool is_primed;
+    bool in_dtx;
+    int redundancy_frames;
+    int packets_since_redundancy;
+    int64_t frame_ns;
+
+    int64_t transit_window[JB_DELAY_WINDOW];
+    int64_t delay_scratch[JB_DELAY_WINDOW];
+    int transit_count;
+    int transit_head;
+    int64_t last_transit;
+    bool has_last_transit;
+    double jitter_ns;
+    int target_delay_frames;
+    double filtered_depth;
+    float speech_energy;
+    double drift_depth;
+    double drift_ppm;
+
+    SAMPLE *pcm;
+    int pcm_len;
+    int pcm_capacity;
+    SAMPLE *work;
+    Resampler resampler;
+    PlcState plc;
+    ComfortNoise comfort_noise;
+    CodecDecoder decoder;
+
+    JitterBufferStats stats;
+    pthread_mutex_t mutex;
+} JitterBuffer;
+
+void jitter_buffer_config_default(JitterBufferConfig *config);
+int jitter_buffer_init(JitterBuffer *jb, const JitterBufferConfig *config);
+void jitter_buffer_destroy(JitterBuffer *jb);
+/* Empties the buffer for a new stream, releasing every held packet. */
+void jitter_buffer_reset(JitterBuffer *jb);
+/* Switches to packets of frame_size samples, as the sender announced,
+ * emptying the buffer. */
+int jitter_buffer_set_frame_size(JitterBuffer *jb, int frame_size);
+/* packet->payload must lie in packet->buffer, which is held for as long
+ * as the frame is kept. */
+void jitter_buffer_put(JitterBuffer *jb, const AudioPacket *packet,
+                       uint64_t arrival_ns);
+void jitter_buffer_get(JitterBuffer *jb, SAMPLE *out_buffer, int frames);
+bool jitter_buffer_is_primed(JitterBuffer *jb);
+void jitter_buffer_get_stats(JitterBuffer *jb, JitterBufferStats *stats);
+
+#endif
@@ -0,0 +1,208 @@
+#include "latency.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Until the round trip is known, a one-way delay beyond this means the two
+ * hosts' clocks are apart. */
+#define LATENCY_NETWORK_MAX_NS (10000000000ull)
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {
+    "input",   "capture", "send",         "network",  "jitter",
+    "playout", "output",  "mouth_to_ear", "loopback",
+};
+
+void latency_init(Latency *latency, bool probe, int sample_rate)
+{
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+        histogram_reset(&latency->stages[i]);
+    atomic_store(&latency->last_sender_ns, 0);
+    atomic_store(&latency->last_network_ns, 0);
+    atomic_store(&latency->last_jitter_ns, 0);
+    memset(&latency->probe, 0, sizeof(latency->probe));
+    latency->probe.enabled = probe;
+    latency->probe.sample_rate = sample_rate;
+}
+
+void latency_trace_reset(LatencyTrace *trace, size_t queued)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->write_position = queued;
+}
+
+void latency_trace_put(LatencyTrace *trace, uint64_t capture_ns,
+                       uint64_t queued_ns, size_t written)
+{
+    if (written == 0)
+        return;
+    unsigned head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&trace->tail, memory_order_acquire);
+    if (head - tail < LATENCY_TRACE_SIZE)
+    {
+        LatencyStamp *stamp = &trace->stamps[head % LATENCY_TRACE_SIZE];
+        stamp->position = trace->write_position;
+        stamp->capture_ns = capture_ns;
+        stamp->queued_ns = queued_ns;
+        atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+    }
+    trace->write_position += written;
+}
+
+bool latency_trace_take(LatencyTrace *trace, size_t read, LatencyStamp *stamp)
+{
+    unsigned tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    uint64_t start = trace->read_position;
+    bool found = false;
+    trace->read_position += read;
+    for (; tail != head; tail++)
+    {
+        const LatencyStamp *next = &trace->stamps[tail % LATENCY_TRACE_SIZE];
+        if (next->position >= start + read)
+            break;
+        if (next->position >= start && !found)
+        {
+            *stamp = *next;
+            found = true;
+        }
+    }
+    atomic_store_explicit(&trace->tail, tail, memory_order_release);
+    return found;
+}
+
+void latency_on_packet(Latency *latency, uint64_t sent_wall_ns,
+                       uint32_t sender_delay_us, uint64_t arrival_wall_ns,
+                       uint64_t rtt_ns)
+{
+    /* No one-way delay is longer than the round trip. */
+    uint64_t limit_ns = rtt_ns > 0 ? rtt_ns : LATENCY_NETWORK_MAX_NS;
+    uint64_t network_ns = rtt_ns / 2;
+    if (arrival_wall_ns >= sent_wall_ns &&
+        arrival_wall_ns - sent_wall_ns <= limit_ns)
+        network_ns = arrival_wall_ns - sent_wall_ns;
+    if (network_ns > 0)
+        latency_record(latency, LATENCY_NETWORK, network_ns);
+    atomic_store_explicit(&latency->last_network_ns, network_ns,
+                          memory_order_relaxed);
+    atomic_store_explicit(&latency->last_sender_ns,
+                          (uint64_t)sender_delay_us * 1000ull,
+                          memory_order_relaxed);
+}
+
+void latency_on_played(Latency *latency, uint64_t playout_ns,
+                       uint64_t output_ns)
+{
+    latency_record(latency, LATENCY_PLAYOUT_QUEUE, playout_ns);
+    latency_record(latency, LATENCY_OUTPUT, output_ns);
+    uint64_t sender_ns =
+        atomic_load_explicit(&latency->last_sender_ns, memory_order_relaxed);
+    if (sender_ns == 0)
+        return;
+    latency_record(
+        latency, LATENCY_MOUTH_TO_EAR,
+        sender_ns +
+            atomic_load_explicit(&latency->last_network_ns,
+                                 memory_order_relaxed) +
+            atomic_load_explicit(&latency->last_jitter_ns,
+                                 memory_order_relaxed) +
+            playout_ns + output_ns);
+}
+
+void latency_probe_emit(Latency *latency, SAMPLE *in, int frames,
+                        double adc_time)
+{
+    LatencyProbe *probe = &latency->probe;
+    int rate = probe->sample_rate;
+    uint64_t interval = (uint64_t)rate * LATENCY_PROBE_INTERVAL_MS / 1000;
+    uint64_t burst = (uint64_t)rate * LATENCY_PROBE_BURST_MS / 1000;
+    double step = 2.0 * M_PI * LATENCY_PROBE_HZ / rate;
+    for (int i = 0; i < frames; i++, probe->samples++)
+    {
+        uint64_t offset = probe->samples % interval;
+        if (offset == 0)
+        {
+            probe->waiting = true;
+            probe->sent_time = adc_time + (double)i / rate;
+            probe->phase = 0.0;
+            probe->sent++;
+        }
+        if (offset < burst)
+        {
+            in[i] = (SAMPLE)lrint(LATENCY_PROBE_AMPLITUDE * sin(probe->phase));
+            probe->phase += step;
+        }
+        else
+        {
+            in[i] = 0;
+        }
+    }
+}
+
+void latency_probe_detect(Latency *latency, const SAMPLE *out, int frames,
+                          double dac_time)
+{
+    LatencyProbe *probe = &latency->probe;
+    if (!probe->waiting)
+        return;
+    for (int i = 0; i < frames; i++)
+    {
+        if (abs(out[i]) < LATENCY_PROBE_THRESHOLD)
+            continue;
+        double round_trip = dac_time + (double)i / probe->sample_rate -
+                            probe->sent_time;
+        if (round_trip > 0.0)
+            latency_record(latency, LATENCY_LOOPBACK,
+                           (uint64_t)(round_trip * 1e9));
+        probe->waiting = false;
+        return;
+    }
+}
+
+static double percentile_ms(Latency *latency, LatencyStage stage,
+                            double fraction)
+{
+    return histogram_percentile(&latency->stages[stage], fraction) / 1e6;
+}
+
+void latency_print(Latency *latency)
+{
+    printf("[LATENCY] ");
+    if (histogram_count(&latency->stages[LATENCY_MOUTH_TO_EAR]) > 0)
+        printf("mouth-to-ear p50 %.1f p99 %.1f ms; ",
+               percentile_ms(latency, LATENCY_MOUTH_TO_EAR, 0.50),
+               percentile_ms(latency, LATENCY_MOUTH_TO_EAR, 0.99));
+    printf("median");
+    for (int i = 0; i < LATENCY_MOUTH_TO_EAR; i++)
+        printf(" %s %.2f", stage_names[i], percentile_ms(latency, i, 0.50));
+    printf(" ms\n");
+    LatencyProbe *probe = &latency->probe;
+    if (probe->enabled)
+        printf("[LATENCY] loopback round trip p50 %.1f p99 %.1f ms, %llu of "
+               "%llu probes returned\n",
+               percentile_ms(latency, LATENCY_LOOPBACK, 0.50),
+               percentile_ms(latency, LATENCY_LOOPBACK, 0.99),
+               (unsigned long long)histogram_count(
+                   &latency->stages[LATENCY_LOOPBACK]),
+               (unsigned long long)probe->sent);
+}
+
+void latency_write_json(Latency *latency, FILE *file, double elapsed_s)
+{
+    fprintf(file, "{\"elapsed_s\":%.3f", elapsed_s);
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        Histogram *stage = &latency->stages[i];
+        fprintf(file,
+                ",\"%s\":{\"count\":%llu,\"p50_ms\":%.3f,\"p90_ms\":%.3f,"
+                "\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f}",
+                stage_names[i], (unsigned long long)histogram_count(stage),
+                percentile_ms(latency, i, 0.50),
+                percentile_ms(latency, i, 0.90),
+                percentile_ms(latency, i, 0.99),
+                percentile_ms(latency, i, 0.999),
+                atomic_load(&stage->max) / 1e6);
+    }
+    fprintf(file, "}\n");
+    fflush(file);
+}
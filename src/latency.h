@@ -0,0 +1,141 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "audio_config.h"
+#include "histogram.h"
+
+/* Frames in flight through one queue; a power of two. */
+#define LATENCY_TRACE_SIZE (64)
+/* The loopback probe sends a tone burst this often and listens for it to
+ * come back. */
+#define LATENCY_PROBE_INTERVAL_MS (1000)
+#define LATENCY_PROBE_BURST_MS (20)
+#define LATENCY_PROBE_HZ (1000.0)
+#define LATENCY_PROBE_AMPLITUDE (16000.0)
+#define LATENCY_PROBE_THRESHOLD (4000)
+
+/* The stages a frame passes from the peer's microphone to our speaker, in
+ * order. The first three are measured on our own send path and reported
+ * to the peer with each packet; mouth-to-ear adds the peer's send path to
+ * our receive path. */
+typedef enum
+{
+    LATENCY_INPUT,
+    LATENCY_CAPTURE_QUEUE,
+    LATENCY_SEND_QUEUE,
+    LATENCY_NETWORK,
+    LATENCY_JITTER_BUFFER,
+    LATENCY_PLAYOUT_QUEUE,
+    LATENCY_OUTPUT,
+    LATENCY_MOUTH_TO_EAR,
+    LATENCY_LOOPBACK,
+    LATENCY_STAGE_COUNT,
+} LatencyStage;
+
+/* When a frame was captured (ADC, monotonic ns) and when it entered the
+ * queue it is in. */
+typedef struct
+{
+    uint64_t position;
+    uint64_t capture_ns;
+    uint64_t queued_ns;
+} LatencyStamp;
+
+/* Stamps travelling beside the samples of one single-producer,
+ * single-consumer ring. Each stamp is tied to the sample position of its
+ * frame, so a frame the ring dropped leaves a stamp that is skipped rather
+ * than one that shifts every later frame. */
+typedef struct
+{
+    LatencyStamp stamps[LATENCY_TRACE_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+    uint64_t write_position;
+    uint64_t read_position;
+} LatencyTrace;
+
+/* Round trips measured with the loopback probe, on the audio callback's
+ * own clock. */
+typedef struct
+{
+    bool enabled;
+    int sample_rate;
+    uint64_t samples;
+    double phase;
+    bool waiting;
+    double sent_time;
+    uint64_t sent;
+} LatencyProbe;
+
+/* Per-stage histograms in ns. Each stage is recorded by one thread; any
+ * thread may print them. The last* fields carry the peer's send path and
+ * the current network and jitter buffer delay to the audio callback. A
+ * frame is not followed through the jitter buffer, so mouth-to-ear is a
+ * composite: the played frame's own playout and output delay plus the
+ * latest of the others, and its percentiles are an estimate. */
+typedef struct
+{
+    Histogram stages[LATENCY_STAGE_COUNT];
+    _Atomic uint64_t last_sender_ns;
+    _Atomic uint64_t last_network_ns;
+    _Atomic uint64_t last_jitter_ns;
+    LatencyProbe probe;
+} Latency;
+
+void latency_init(Latency *latency, bool probe, int sample_rate);
+static inline void latency_record(Latency *latency, LatencyStage stage,
+                                  uint64_t ns)
+{
+    histogram_record(&latency->stages[stage], ns);
+}
+/* The interval between two monotonic times, or 0 if end is earlier. */
+static inline uint64_t latency_since(uint64_t start_ns, uint64_t end_ns)
+{
+    return end_ns > start_ns ? end_ns - start_ns : 0;
+}
+
+/* Starts a trace for a ring that already holds queued unstamped
+ * samples. */
+void latency_trace_reset(LatencyTrace *trace, size_t queued);
+/* Producer: stamps the frame whose written samples were just queued. */
+void latency_trace_put(LatencyTrace *trace, uint64_t capture_ns,
+                       uint64_t queued_ns, size_t written);
+/* Consumer: advances past read samples; true if the frame they started
+ * with was stamped. */
+bool latency_trace_take(LatencyTrace *trace, size_t read,
+                        LatencyStamp *stamp);
+
+/* Records a packet from the peer that carried its capture time: the
+ * one-way network delay by the two hosts' clocks, and the delay of the
+ * peer's send path. Once the RTCP round trip is known (rtt_ns, 0 until
+ * then), a one-way delay outside it shows that the clocks disagree, and
+ * half the round trip is recorded instead. */
+void latency_on_packet(Latency *latency, uint64_t sent_wall_ns,
+                       uint32_t sender_delay_us, uint64_t arrival_wall_ns,
+                       uint64_t rtt_ns);
+/* Records one played frame: its time in the playout queue and the output
+ * device, and the composite mouth-to-ear delay. */
+void latency_on_played(Latency *latency, uint64_t playout_ns,
+                       uint64_t output_ns);
+
+/* Replaces the microphone with the probe's bursts. adc_time is the
+ * backend time of in[0]. */
+void latency_probe_emit(Latency *latency, SAMPLE *in, int frames,
+                        double adc_time);
+/* Looks for a burst that came back in out, played from dac_time on. */
+void latency_probe_detect(Latency *latency, const SAMPLE *out, int frames,
+                          double dac_time);
+
+/* One "[LATENCY]" line of median stage delays and the mouth-to-ear and
+ * loopback percentiles. */
+void latency_print(Latency *latency);
+/* One JSON object per line with the percentiles of every stage. */
+void latency_write_json(Latency *latency, FILE *file, double elapsed_s);
+
+#endif
@@ -0,0 +1,271 @@
+#include "metrics.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* A metric's JSON key, and its Prometheus family and label. Entries of one
+ * family are adjacent. */
+typedef struct
+{
+    const char *key;
+    const char *family;
+    const char *label;
+    const char *help;
+} MetricInfo;
+
+static const MetricInfo counter_info[METRIC_COUNTER_COUNT] = {
+    {"audio_callbacks", "voip_audio_callbacks_total", NULL,
+     "Audio callbacks run."},
+    {"input_underflows", "voip_audio_xruns_total", "kind=\"input_underflow\"",
+     "Over- and underflows the audio device reported."},
+    {"input_overflows", "voip_audio_xruns_total", "kind=\"input_overflow\"",
+     NULL},
+    {"output_underflows", "voip_audio_xruns_total",
+     "kind=\"output_underflow\"", NULL},
+    {"output_overflows", "voip_audio_xruns_total", "kind=\"output_overflow\"",
+     NULL},
+    {"playout_underruns", "voip_playout_underruns_total", NULL,
+     "Callbacks that found less than a frame to play."},
+    {"capture_overruns", "voip_capture_overruns_total", NULL,
+     "Callbacks whose microphone frame did not fit the capture ring."},
+    {"packets_sent", "voip_packets_sent_total", NULL, "Datagrams sent."},
+    {"bytes_sent", "voip_bytes_sent_total", NULL,
+     "UDP payload bytes sent."},
+    {"packets_received", "voip_packets_received_total", NULL,
+     "Datagrams received."},
+    {"bytes_received", "voip_bytes_received_total", NULL,
+     "UDP payload bytes received."},
+    {"packets_late", "voip_packets_late_total", NULL,
+     "Media packets that arrived after their turn to play."},
+    {"packets_duplicate", "voip_packets_duplicate_total", NULL,
+     "Media packets that arrived twice."},
+    {"packets_lost", "voip_packets_lost_total", NULL,
+     "Media packets that never arrived."},
+    {"jitter_underruns", "voip_jitter_underruns_total", NULL,
+     "Frames the jitter buffer had nothing to play for."},
+    {"frames_concealed", "voip_frames_concealed_total", NULL,
+     "Frames filled in by packet loss concealment."},
+};
+
+static const MetricInfo gauge_info[METRIC_GAUGE_COUNT] = {
+    {"jitter_delay_ms", "voip_jitter_delay_ms", NULL,
+     "Audio held in the jitter buffer."},
+    {"jitter_target_ms", "voip_jitter_target_delay_ms", NULL,
+     "The delay the jitter buffer aims for."},
+    {"jitter_ms", "voip_jitter_ms", NULL,
+     "Interarrival jitter of the received stream."},
+    {"clock_drift_ppm", "voip_clock_drift_ppm", NULL,
+     "The peer's clock against ours."},
+    {"mic_level", "voip_mic_level_rms", NULL,
+     "RMS level of the last processed microphone frame."},
+};
+
+/* The counters the log also reports as a rate per second. */
+static const MetricCounter rate_counters[] = {
+    METRIC_PACKETS_SENT,
+    METRIC_BYTES_SENT,
+    METRIC_PACKETS_RECEIVED,
+    METRIC_BYTES_RECEIVED,
+};
+
+void metrics_reset(Metrics *metrics)
+{
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++)
+        atomic_store(&metrics->counters[i], 0);
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++)
+        atomic_store(&metrics->gauges[i], 0.0);
+}
+
+/* Appends one sample, preceded by its family's HELP and TYPE lines when it
+ * opens the family. */
+static int format_sample(char *out, int capacity, const MetricInfo *info,
+                         const MetricInfo *previous, const char *type,
+                         const char *value)
+{
+    int length = 0;
+    if (!previous || strcmp(previous->family, info->family) != 0)
+        length += snprintf(out, capacity, "# HELP %s %s\n# TYPE %s %s\n",
+                           info->family, info->help, info->family, type);
+    if (length >= capacity)
+        return length;
+    if (info->label)
+        length += snprintf(out + length, capacity - length, "%s{%s} %s\n",
+                           info->family, info->label, value);
+    else
+        length += snprintf(out + length, capacity - length, "%s %s\n",
+                           info->family, value);
+    return length;
+}
+
+int metrics_format_prometheus(const Metrics *metrics, char *out,
+                              int capacity)
+{
+    int length = 0;
+    char value[32];
+    for (int i = 0; i < METRIC_COUNTER_COUNT && length < capacity; i++)
+    {
+        snprintf(value, sizeof(value), "%llu",
+                 (unsigned long long)metrics_counter(metrics, i));
+        length += format_sample(out + length, capacity - length,
+                                &counter_info[i],
+                                i > 0 ? &counter_info[i - 1] : NULL,
+                                "counter", value);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT && length < capacity; i++)
+    {
+        snprintf(value, sizeof(value), "%.3f", metrics_gauge(metrics, i));
+        length += format_sample(out + length, capacity - length,
+                                &gauge_info[i], NULL, "gauge", value);
+    }
+    return length < capacity ? length : capacity - 1;
+}
+
+void metrics_log_init(MetricsLog *log, FILE *file)
+{
+    memset(log, 0, sizeof(*log));
+    log->file = file;
+}
+
+void metrics_log_write(MetricsLog *log, const Metrics *metrics,
+                       double elapsed_s)
+{
+    uint64_t now[METRIC_COUNTER_COUNT];
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++)
+        now[i] = metrics_counter(metrics, i);
+    fprintf(log->file, "{\"elapsed_s\":%.3f", elapsed_s);
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++)
+        fprintf(log->file, ",\"%s\":%llu", counter_info[i].key,
+                (unsigned long long)now[i]);
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++)
+        fprintf(log->file, ",\"%s\":%.3f", gauge_info[i].key,
+                metrics_gauge(metrics, i));
+    /* A counter below its last value was reset by a new call. */
+    double interval = elapsed_s - log->last_s;
+    for (size_t i = 0; i < sizeof(rate_counters) / sizeof(rate_counters[0]);
+         i++)
+    {
+        MetricCounter counter = rate_counters[i];
+        uint64_t delta = now[counter] >= log->last[counter]
+                             ? now[counter] - log->last[counter]
+                             : now[counter];
+        fprintf(log->file, ",\"%s_per_s\":%.1f", counter_info[counter].key,
+                interval > 0.0 ? delta / interval : 0.0);
+    }
+    fprintf(log->file, "}\n");
+    fflush(log->file);
+    memcpy(log->last, now, sizeof(now));
+    log->last_s = elapsed_s;
+}
+
+/* Answers one connection: whatever request it carries is read and
+ * ignored, and the reply is a complete HTTP response. */
+static void serve_client(MetricsServer *server, int client)
+{
+    char request[1024];
+    char body[METRICS_TEXT_MAX];
+    char header[128];
+    struct pollfd pfd = {client, POLLIN, 0};
+    if (poll(&pfd, 1, METRICS_POLL_MS) > 0)
+        recv(client, request, sizeof(request), MSG_DONTWAIT);
+    int length = metrics_format_prometheus(server->metrics, body,
+                                           sizeof(body));
+    int header_length =
+        snprintf(header, sizeof(header),
+                 "HTTP/1.0 200 OK\r\nContent-Type: text/plain; "
+                 "version=0.0.4\r\nContent-Length: %d\r\n\r\n",
+                 length);
+    if (send(client, header, header_length, MSG_NOSIGNAL) == header_length)
+        send(client, body, length, MSG_NOSIGNAL);
+    close(client);
+}
+
+static void *server_thread_func(void *data)
+{
+    MetricsServer *server = (MetricsServer *)data;
+    struct pollfd pfd = {server->fd, POLLIN, 0};
+    while (atomic_load(&server->running))
+    {
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0)
+            continue;
+        int client = accept(server->fd, NULL, NULL);
+        if (client >= 0)
+            serve_client(server, client);
+    }
+    return NULL;
+}
+
+int metrics_server_start(MetricsServer *server, const Metrics *metrics,
+                         const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    memset(server, 0, sizeof(*server));
+    server->metrics = metrics;
+    server->fd = -1;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "[METRICS] Socket path '%s' is too long\n", path);
+        return -1;
+    }
+    snprintf(server->path, sizeof(server->path), "%s", path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+    /* Only a socket left by an earlier run is replaced. */
+    bool stale = lstat(path, &st) == 0;
+    if (stale && !S_ISSOCK(st.st_mode))
+    {
+        fprintf(stderr, "[METRICS] '%s' exists and is not a socket\n", path);
+        return -1;
+    }
+
+    server->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->fd == -1)
+    {
+        perror("socket() failed");
+        return -1;
+    }
+    if (stale)
+        unlink(path);
+    if (bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        perror("bind() of the metrics socket failed");
+        goto error_socket;
+    }
+    if (listen(server->fd, 8) == -1)
+    {
+        perror("listen() failed");
+        goto error_bound;
+    }
+    atomic_store(&server->running, true);
+    if (pthread_create(&server->tid, NULL, server_thread_func, server) != 0)
+    {
+        perror("pthread_create() failed");
+        goto error_bound;
+    }
+    printf("[METRICS] Serving metrics on %s.\n", path);
+    return 0;
+
+error_bound:
+    unlink(path);
+error_socket:
+    close(server->fd);
+    server->fd = -1;
+    return -1;
+}
+
+void metrics_server_stop(MetricsServer *server)
+{
+    if (server->fd < 0)
+        return;
+    atomic_store(&server->running, false);
+    pthread_join(server->tid, NULL);
+    close(server->fd);
+    unlink(server->path);
+    server->fd = -1;
+}
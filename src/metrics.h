@@ -0,0 +1,132 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Room for one Prometheus exposition of every metric. */
+#define METRICS_TEXT_MAX (8192)
+/* The exporter's socket checks for the end this often, in ms. */
+#define METRICS_POLL_MS (200)
+
+/* Counters only ever grow during a call. */
+typedef enum
+{
+    METRIC_AUDIO_CALLBACKS,
+    METRIC_INPUT_UNDERFLOWS,
+    METRIC_INPUT_OVERFLOWS,
+    METRIC_OUTPUT_UNDERFLOWS,
+    METRIC_OUTPUT_OVERFLOWS,
+    METRIC_PLAYOUT_UNDERRUNS,
+    METRIC_CAPTURE_OVERRUNS,
+    METRIC_PACKETS_SENT,
+    METRIC_BYTES_SENT,
+    METRIC_PACKETS_RECEIVED,
+    METRIC_BYTES_RECEIVED,
+    METRIC_PACKETS_LATE,
+    METRIC_PACKETS_DUPLICATE,
+    METRIC_PACKETS_LOST,
+    METRIC_JITTER_UNDERRUNS,
+    METRIC_FRAMES_CONCEALED,
+    METRIC_COUNTER_COUNT,
+} MetricCounter;
+
+/* Gauges hold the latest value. */
+typedef enum
+{
+    METRIC_JITTER_DELAY_MS,
+    METRIC_JITTER_TARGET_MS,
+    METRIC_JITTER_MS,
+    METRIC_CLOCK_DRIFT_PPM,
+    METRIC_MIC_LEVEL,
+    METRIC_GAUGE_COUNT,
+} MetricGauge;
+
+/* The registry of a call's metrics. Any thread updates them with relaxed
+ * atomics and never waits; a counter with a single writer may also be
+ * published whole from a snapshot the writer already keeps. Readers see
+ * each value whole but not the set as of one instant. */
+typedef struct
+{
+    atomic_uint_fast64_t counters[METRIC_COUNTER_COUNT];
+    _Atomic double gauges[METRIC_GAUGE_COUNT];
+} Metrics;
+
+/* Appends the metrics to a file as JSON lines, with the send and receive
+ * rates since the previous line. */
+typedef struct
+{
+    FILE *file;
+    uint64_t last[METRIC_COUNTER_COUNT];
+    double last_s;
+} MetricsLog;
+
+/* Serves the metrics in the Prometheus text format on a Unix socket, as a
+ * reply to whatever is sent on each connection, so that
+ * curl --unix-socket PATH http://localhost/metrics or a local agent can
+ * scrape them. */
+typedef struct
+{
+    const Metrics *metrics;
+    int fd;
+    char path[108];
+    pthread_t tid;
+    atomic_bool running;
+} MetricsServer;
+
+void metrics_reset(Metrics *metrics);
+
+static inline void metrics_add(Metrics *metrics, MetricCounter counter,
+                               uint64_t n)
+{
+    atomic_fetch_add_explicit(&metrics->counters[counter], n,
+                              memory_order_relaxed);
+}
+
+/* Publishes a counter its only writer keeps itself. */
+static inline void metrics_store(Metrics *metrics, MetricCounter counter,
+                                 uint64_t value)
+{
+    atomic_store_explicit(&metrics->counters[counter], value,
+                          memory_order_relaxed);
+}
+
+static inline void metrics_set(Metrics *metrics, MetricGauge gauge,
+                               double value)
+{
+    atomic_store_explicit(&metrics->gauges[gauge], value,
+                          memory_order_relaxed);
+}
+
+static inline uint64_t metrics_counter(const Metrics *metrics,
+                                       MetricCounter counter)
+{
+    return atomic_load_explicit(&metrics->counters[counter],
+                                memory_order_relaxed);
+}
+
+static inline double metrics_gauge(const Metrics *metrics, MetricGauge gauge)
+{
+    return atomic_load_explicit(&metrics->gauges[gauge],
+                                memory_order_relaxed);
+}
+
+/* Formats every metric in the Prometheus text exposition format; returns
+ * the length. */
+int metrics_format_prometheus(const Metrics *metrics, char *out,
+                              int capacity);
+
+void metrics_log_init(MetricsLog *log, FILE *file);
+void metrics_log_write(MetricsLog *log, const Metrics *metrics,
+                       double elapsed_s);
+
+/* Listens on path, replacing a stale socket left there; fails if anything
+ * else is there. */
+int metrics_server_start(MetricsServer *server, const Metrics *metrics,
+                         const char *path);
+void metrics_server_stop(MetricsServer *server);
+
+#endif
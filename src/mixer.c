@@ -0,0 +1,94 @@
+#include "mixer.h"
+
+#include <string.h>
+
+#include "dsp_kernels.h"
+
+/* Levels rise at once and fall by this factor per frame (about 100 ms at
+ * 512 samples), so a talker is not dropped between syllables. */
+#define MIXER_LEVEL_RELEASE (0.9f)
+/* A mixed input keeps its slot until a contender is this much louder,
+ * which stops two similar talkers from swapping every frame. */
+#define MIXER_HOLD_RATIO (1.5f)
+
+void mixer_init(Mixer *mixer, int frames, int speakers_max, float floor_rms)
+{
+    memset(mixer, 0, sizeof(*mixer));
+    mixer->frames = frames;
+    mixer->speakers_max =
+        speakers_max < MIXER_INPUTS_MAX ? speakers_max : MIXER_INPUTS_MAX;
+    mixer->floor_rms = floor_rms;
+}
+
+static void select_speakers(Mixer *mixer, int count)
+{
+    float scores[MIXER_INPUTS_MAX];
+    for (int i = 0; i < count; i++)
+    {
+        scores[i] = mixer->levels[i];
+        if (mixer->selected[i])
+            scores[i] *= MIXER_HOLD_RATIO;
+        mixer->selected[i] = false;
+    }
+    for (int n = 0; n < mixer->speakers_max; n++)
+    {
+        int best = -1;
+        for (int i = 0; i < count; i++)
+        {
+            if (!mixer->selected[i] && mixer->levels[i] >= mixer->floor_rms &&
+                (best < 0 || scores[i] > scores[best]))
+                best = i;
+        }
+        if (best < 0)
+            break;
+        mixer->selected[best] = true;
+    }
+}
+
+int mixer_mix(Mixer *mixer, const SAMPLE *const *inputs, int count,
+              SAMPLE *out)
+{
+    if (count > MIXER_INPUTS_MAX)
+        count = MIXER_INPUTS_MAX;
+    for (int i = 0; i < count; i++)
+    {
+        float rms = dsp_rms(inputs[i], mixer->frames);
+        float released = mixer->levels[i] * MIXER_LEVEL_RELEASE;
+        mixer->levels[i] = rms > released ? rms : released;
+    }
+    for (int i = count; i < MIXER_INPUTS_MAX; i++)
+    {
+        mixer->levels[i] = 0.0f;
+        mixer->selected[i] = false;
+    }
+    select_speakers(mixer, count);
+    mixer->mixes++;
+
+    int mixed = 0;
+    memset(mixer->sum, 0, mixer->frames * sizeof(int32_t));
+    for (int i = 0; i < count; i++)
+    {
+        if (!mixer->selected[i])
+            continue;
+        dsp_accumulate(mixer->sum, inputs[i], mixer->frames);
+        mixer->frames_mixed[i]++;
+        mixed++;
+    }
+    dsp_mix_minus(mixer->sum, NULL, out, mixer->frames);
+    return mixed;
+}
+
+void mixer_set_local(Mixer *mixer, const SAMPLE *local)
+{
+    memcpy(mixer->send_sum, mixer->sum, mixer->frames * sizeof(int32_t));
+    if (local)
+        dsp_accumulate(mixer->send_sum, local, mixer->frames);
+}
+
+void mixer_mix_minus(const Mixer *mixer, int index, const SAMPLE *input,
+                     SAMPLE *out)
+{
+    bool mixed = index >= 0 && index < MIXER_INPUTS_MAX &&
+                 mixer->selected[index];
+    dsp_mix_minus(mixer->send_sum, mixed ? input : NULL, out, mixer->frames);
+}
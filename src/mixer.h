@@ -0,0 +1,44 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_config.h"
+
+#define MIXER_INPUTS_MAX (8)
+#define MIXER_DEFAULT_SPEAKERS (3)
+
+/* N-way conference mixer. Only the speakers_max loudest inputs are summed,
+ * so the mixing cost stays flat however many participants there are, and
+ * an input below floor_rms is never mixed. The sum stays in 32 bits, which
+ * makes each participant's mix-minus (the mix without its own voice) a
+ * single subtraction instead of a separate mix. */
+typedef struct
+{
+    int frames;
+    int speakers_max;
+    float floor_rms;
+    float levels[MIXER_INPUTS_MAX];
+    bool selected[MIXER_INPUTS_MAX];
+    int32_t sum[AUDIO_FRAME_MAX];
+    int32_t send_sum[AUDIO_FRAME_MAX];
+    uint64_t mixes;
+    uint64_t frames_mixed[MIXER_INPUTS_MAX];
+} Mixer;
+
+/* frames is at most AUDIO_FRAME_MAX. */
+void mixer_init(Mixer *mixer, int frames, int speakers_max, float floor_rms);
+/* Tracks the level of each input, picks the loudest and writes their sum
+ * to out. Returns the number of inputs mixed. */
+int mixer_mix(Mixer *mixer, const SAMPLE *const *inputs, int count,
+              SAMPLE *out);
+/* Sets the local input (NULL for none) that every mix-minus of the last
+ * mix carries on top of the remote speakers. */
+void mixer_set_local(Mixer *mixer, const SAMPLE *local);
+/* Writes what input index should hear: the last mix and the local input,
+ * minus input itself if it was mixed. */
+void mixer_mix_minus(const Mixer *mixer, int index, const SAMPLE *input,
+                     SAMPLE *out);
+
+#endif
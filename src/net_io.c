@@ -0,0 +1,346 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "net_io.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "time_util.h"
+
+struct NetScratch
+{
+#ifdef __linux__
+    struct mmsghdr rx_msgs[NET_BATCH_MAX];
+    struct iovec rx_iov[NET_BATCH_MAX];
+    struct sockaddr_in rx_addr[NET_BATCH_MAX];
+    uint8_t rx_control[NET_BATCH_MAX][NET_CONTROL_SIZE];
+    struct mmsghdr tx_msgs[NET_BATCH_MAX];
+    struct iovec tx_iov[NET_BATCH_MAX];
+#else
+    uint8_t rx_control[NET_CONTROL_SIZE];
+#endif
+};
+
+static int socket_open(NetSocket *ns, int local_port, bool shared)
+{
+    memset(ns, 0, sizeof(*ns));
+    ns->scratch = (struct NetScratch *)calloc(1, sizeof(struct NetScratch));
+    ns->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ns->fd == -1 || !ns->scratch)
+    {
+        perror("socket() failed");
+        net_socket_close(ns);
+        return -1;
+    }
+    fcntl(ns->fd, F_SETFL, fcntl(ns->fd, F_GETFL) | O_NONBLOCK);
+    fcntl(ns->fd, F_SETFD, FD_CLOEXEC);
+
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    local_addr.sin_port = htons(local_port);
+    int on = 1;
+#ifdef SO_REUSEPORT
+    if (shared &&
+        setsockopt(ns->fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+    {
+        perror("setsockopt(SO_REUSEPORT) failed");
+        net_socket_close(ns);
+        return -1;
+    }
+#endif
+    if (bind(ns->fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) == -1)
+    {
+        perror("bind() failed");
+        net_socket_close(ns);
+        return -1;
+    }
+
+#ifdef SO_TIMESTAMPNS
+    if (setsockopt(ns->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == -1)
+        perror("setsockopt(SO_TIMESTAMPNS) failed");
+#else
+    if (setsockopt(ns->fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)) == -1)
+        perror("setsockopt(SO_TIMESTAMP) failed");
+#endif
+    return 0;
+}
+
+int net_socket_open(NetSocket *ns, int local_port)
+{
+    return socket_open(ns, local_port, false);
+}
+
+int net_socket_open_shared(NetSocket *ns, int local_port)
+{
+    return socket_open(ns, local_port, true);
+}
+
+int net_socket_local_port(const NetSocket *ns)
+{
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    if (getsockname(ns->fd, (struct sockaddr *)&addr, &length) == -1)
+        return -1;
+    return ntohs(addr.sin_port);
+}
+
+void net_socket_close(NetSocket *ns)
+{
+    if (ns->fd != -1)
+        close(ns->fd);
+    ns->fd = -1;
+    free(ns->scratch);
+    ns->scratch = NULL;
+}
+
+static int64_t realtime_to_monotonic_offset(void)
+{
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    uint64_t mono = monotonic_ns();
+    return (int64_t)mono -
+           (int64_t)((uint64_t)real.tv_sec * 1000000000ull + real.tv_nsec);
+}
+
+static uint64_t kernel_timestamp(struct msghdr *msg, int64_t offset,
+                                 uint64_t fallback)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg;
+         cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+#ifdef SCM_TIMESTAMPNS
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec + offset;
+        }
+#endif
+#ifdef SCM_TIMESTAMP
+        if (cmsg->cmsg_type == SCM_TIMESTAMP)
+        {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            return (uint64_t)tv.tv_sec * 1000000000ull +
+                   (uint64_t)tv.tv_usec * 1000ull + offset;
+        }
+#endif
+    }
+    return fallback;
+}
+
+int net_recv_batch(NetSocket *ns, void *const *buffers, size_t buffer_size,
+                   NetDatagramInfo *info, int max)
+{
+    struct NetScratch *sc = ns->scratch;
+    if (max > NET_BATCH_MAX)
+        max = NET_BATCH_MAX;
+#ifdef __linux__
+    for (int i = 0; i < max; i++)
+    {
+        sc->rx_iov[i].iov_base = buffers[i];
+        sc->rx_iov[i].iov_len = buffer_size;
+        struct msghdr *msg = &sc->rx_msgs[i].msg_hdr;
+        memset(msg, 0, sizeof(*msg));
+        msg->msg_name = &sc->rx_addr[i];
+        msg->msg_namelen = sizeof(sc->rx_addr[i]);
+        msg->msg_iov = &sc->rx_iov[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = sc->rx_control[i];
+        msg->msg_controllen = NET_CONTROL_SIZE;
+    }
+    int count = recvmmsg(ns->fd, sc->rx_msgs, max, MSG_DONTWAIT, NULL);
+    ns->recv_calls++;
+    if (count == -1)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                   ? 0
+                   : -1;
+    int64_t offset = realtime_to_monotonic_offset();
+    uint64_t now = monotonic_ns();
+    for (int i = 0; i < count; i++)
+    {
+        info[i].length = (int)sc->rx_msgs[i].msg_len;
+        info[i].addr = sc->rx_addr[i];
+        info[i].timestamp_ns =
+            kernel_timestamp(&sc->rx_msgs[i].msg_hdr, offset, now);
+    }
+#else
+    int count = 0;
+    int64_t offset = realtime_to_monotonic_offset();
+    while (count < max)
+    {
+        struct iovec iov = {buffers[count], buffer_size};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &info[count].addr;
+        msg.msg_namelen = sizeof(info[count].addr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = sc->rx_control;
+        msg.msg_controllen = NET_CONTROL_SIZE;
+        ssize_t bytes = recvmsg(ns->fd, &msg, MSG_DONTWAIT);
+        ns->recv_calls++;
+        if (bytes < 0)
+        {
+            if (count == 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                errno != EINTR)
+                return -1;
+            break;
+        }
+        info[count].length = (int)bytes;
+        info[count].timestamp_ns =
+            kernel_timestamp(&msg, offset, monotonic_ns());
+        count++;
+    }
+#endif
+    ns->packets_received += count;
+    return count;
+}
+
+int net_send_batch(NetSocket *ns, const void *const *buffers,
+                   const size_t *lengths, const struct sockaddr_in *addr,
+                   int count)
+{
+    int sent = 0;
+#ifdef __linux__
+    struct NetScratch *sc = ns->scratch;
+    while (sent < count)
+    {
+        int chunk = count - sent;
+        if (chunk > NET_BATCH_MAX)
+            chunk = NET_BATCH_MAX;
+        for (int i = 0; i < chunk; i++)
+        {
+            sc->tx_iov[i].iov_base = (void *)buffers[sent + i];
+            sc->tx_iov[i].iov_len = lengths[sent + i];
+            struct msghdr *msg = &sc->tx_msgs[i].msg_hdr;
+            memset(msg, 0, sizeof(*msg));
+            msg->msg_name = (void *)&addr[sent + i];
+            msg->msg_namelen = sizeof(addr[sent + i]);
+            msg->msg_iov = &sc->tx_iov[i];
+            msg->msg_iovlen = 1;
+        }
+        int result = sendmmsg(ns->fd, sc->tx_msgs, chunk, MSG_DONTWAIT);
+        ns->send_calls++;
+        if (result <= 0)
+        {
+            if (result == -1 && errno == EINTR)
+                continue;
+            /* A full socket buffer drops the rest of this batch, as a lost
+             * datagram would. */
+            if (result == -1 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                sent == 0)
+                return -1;
+            break;
+        }
+        sent += result;
+    }
+#else
+    for (; sent < count; sent++)
+    {
+        ssize_t result = sendto(ns->fd, buffers[sent], lengths[sent], 0,
+                                (const struct sockaddr *)&addr[sent],
+                                sizeof(addr[sent]));
+        ns->send_calls++;
+        if (result == -1)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && sent == 0)
+                return -1;
+            break;
+        }
+    }
+#endif
+    ns->packets_sent += sent;
+    return sent;
+}
+
+int net_wait_readable(NetSocket *ns, int timeout_ms)
+{
+    struct pollfd pfd = {ns->fd, POLLIN, 0};
+    return poll(&pfd, 1, timeout_ms);
+}
+
+int net_poller_init(NetPoller *poller)
+{
+#ifdef __linux__
+    poller->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return poller->epoll_fd == -1 ? -1 : 0;
+#else
+    poller->count = 0;
+    return 0;
+#endif
+}
+
+void net_poller_destroy(NetPoller *poller)
+{
+#ifdef __linux__
+    if (poller->epoll_fd != -1)
+        close(poller->epoll_fd);
+    poller->epoll_fd = -1;
+#else
+    poller->count = 0;
+#endif
+}
+
+int net_poller_add(NetPoller *poller, int fd)
+{
+#ifdef __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(poller->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+#else
+    if (poller->count >= NET_POLLER_MAX)
+        return -1;
+    poller->fds[poller->count].fd = fd;
+    poller->fds[poller->count].events = POLLIN;
+    poller->count++;
+    return 0;
+#endif
+}
+
+int net_poller_wait(NetPoller *poller, int *ready_fds, int max,
+                    int timeout_ms)
+{
+#ifdef __linux__
+    struct epoll_event events[NET_POLLER_MAX];
+    if (max > NET_POLLER_MAX)
+        max = NET_POLLER_MAX;
+    int count = epoll_wait(poller->epoll_fd, events, max, timeout_ms);
+    if (count <= 0)
+        return count == -1 && errno == EINTR ? 0 : count;
+    for (int i = 0; i < count; i++)
+        ready_fds[i] = events[i].data.fd;
+    return count;
+#else
+    int result = poll(poller->fds, poller->count, timeout_ms);
+    if (result <= 0)
+        return result == -1 && errno == EINTR ? 0 : result;
+    int count = 0;
+    for (int i = 0; i < poller->count && count < max; i++)
+    {
+        if (poller->fds[i].revents & (POLLIN | POLLERR | POLLHUP))
+            ready_fds[count++] = poller->fds[i].fd;
+    }
+    return count;
+#endif
+}
@@ -0,0 +1,75 @@
+#ifndef NET_IO_H
+#define NET_IO_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define NET_BATCH_MAX (16)
+#define NET_POLLER_MAX (8)
+#define NET_CONTROL_SIZE (64)
+
+#ifndef __linux__
+#include <poll.h>
+#endif
+
+typedef struct
+{
+    int length;
+    uint64_t timestamp_ns;
+    struct sockaddr_in addr;
+} NetDatagramInfo;
+
+/* A non-blocking UDP socket with batched I/O: recvmmsg/sendmmsg on Linux, a
+ * recvmsg/sendto loop elsewhere. Receive and send keep separate scratch
+ * state, so one thread may receive while another sends. */
+typedef struct
+{
+    int fd;
+    uint64_t recv_calls;
+    uint64_t packets_received;
+    uint64_t send_calls;
+    uint64_t packets_sent;
+    struct NetScratch *scratch;
+} NetSocket;
+
+/* Waits on a handful of descriptors: epoll on Linux, poll elsewhere. */
+typedef struct
+{
+#ifdef __linux__
+    int epoll_fd;
+#else
+    struct pollfd fds[NET_POLLER_MAX];
+    int count;
+#endif
+} NetPoller;
+
+int net_socket_open(NetSocket *ns, int local_port);
+/* Like net_socket_open, but several sockets may bind the same port
+ * (SO_REUSEPORT); the kernel spreads incoming datagrams over them by a hash
+ * of the source and destination, so one sender always reaches the same
+ * socket. */
+int net_socket_open_shared(NetSocket *ns, int local_port);
+/* The port the socket is bound to (after binding port 0), or -1. */
+int net_socket_local_port(const NetSocket *ns);
+void net_socket_close(NetSocket *ns);
+/* Receives up to max datagrams without blocking. Timestamps are the kernel
+ * receive time (SO_TIMESTAMPNS) converted to the CLOCK_MONOTONIC timebase.
+ * Returns the count, 0 if nothing is queued, -1 on error. */
+int net_recv_batch(NetSocket *ns, void *const *buffers, size_t buffer_size,
+                   NetDatagramInfo *info, int max);
+/* Returns the number of datagrams handed to the kernel, -1 on error. */
+int net_send_batch(NetSocket *ns, const void *const *buffers,
+                   const size_t *lengths, const struct sockaddr_in *addr,
+                   int count);
+int net_wait_readable(NetSocket *ns, int timeout_ms);
+
+int net_poller_init(NetPoller *poller);
+void net_poller_destroy(NetPoller *poller);
+int net_poller_add(NetPoller *poller, int fd);
+/* Stores up to max ready descriptors in ready_fds; returns their count. */
+int net_poller_wait(NetPoller *poller, int *ready_fds, int max,
+                    int timeout_ms);
+
+#endif
@@ -0,0 +1,67 @@
+#include "packet_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void push_free(PacketPool *pool, PacketBuffer *buffer)
+{
+    int index = (int)(buffer - pool->buffers);
+    int head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    do
+    {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &pool->free_head, &head, index, memory_order_release,
+        memory_order_relaxed));
+}
+
+int packet_pool_init(PacketPool *pool, int count)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->buffers = (PacketBuffer *)aligned_alloc(
+        PACKET_POOL_CACHE_LINE, (size_t)count * sizeof(PacketBuffer));
+    if (!pool->buffers)
+        return -1;
+    pool->count = count;
+    atomic_init(&pool->free_head, -1);
+    atomic_init(&pool->exhausted, 0);
+    for (int i = count - 1; i >= 0; i--)
+    {
+        pool->buffers[i].pool = pool;
+        atomic_init(&pool->buffers[i].refs, 0);
+        push_free(pool, &pool->buffers[i]);
+    }
+    return 0;
+}
+
+void packet_pool_destroy(PacketPool *pool)
+{
+    free(pool->buffers);
+    pool->buffers = NULL;
+    pool->count = 0;
+}
+
+PacketBuffer *packet_pool_acquire(PacketPool *pool)
+{
+    int head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    while (head >= 0 &&
+           !atomic_compare_exchange_weak_explicit(
+               &pool->free_head, &head, pool->buffers[head].next,
+               memory_order_acquire, memory_order_acquire))
+        ;
+    if (head < 0)
+    {
+        atomic_fetch_add_explicit(&pool->exhausted, 1, memory_order_relaxed);
+        return NULL;
+    }
+    PacketBuffer *buffer = &pool->buffers[head];
+    atomic_store_explicit(&buffer->refs, 1, memory_order_relaxed);
+    return buffer;
+}
+
+void packet_buffer_release(PacketBuffer *buffer)
+{
+    if (atomic_fetch_sub_explicit(&buffer->refs, 1, memory_order_acq_rel) ==
+        1)
+        push_free(buffer->pool, buffer);
+}
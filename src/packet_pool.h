@@ -0,0 +1,53 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "rtp.h"
+
+#define PACKET_POOL_CACHE_LINE (64)
+/* Room for the largest datagram, in whole cache lines. */
+#define PACKET_BUFFER_SIZE                                                     \
+    ((RTP_PACKET_MAX + PACKET_POOL_CACHE_LINE - 1) / PACKET_POOL_CACHE_LINE *  \
+     PACKET_POOL_CACHE_LINE)
+
+struct PacketPool;
+
+/* One received datagram, starting on a cache line. Every frame unpacked
+ * from it (the primary and any redundant copies) points into data and
+ * holds a reference; the last release returns it to its pool. */
+typedef struct PacketBuffer
+{
+    alignas(PACKET_POOL_CACHE_LINE) uint8_t data[PACKET_BUFFER_SIZE];
+    struct PacketPool *pool;
+    atomic_int refs;
+    int next;
+} PacketBuffer;
+
+/* A fixed set of datagram buffers, allocated once, so the receive path
+ * reads straight into the storage the jitter buffer keeps and decodes
+ * from. Free buffers form a lock-free stack. One thread acquires; any
+ * thread may release. With a single popper a node cannot leave and come
+ * back while a pop is in progress, so the stack needs no ABA tag. */
+typedef struct PacketPool
+{
+    PacketBuffer *buffers;
+    int count;
+    atomic_int free_head;
+    _Atomic uint64_t exhausted;
+} PacketPool;
+
+int packet_pool_init(PacketPool *pool, int count);
+void packet_pool_destroy(PacketPool *pool);
+/* A buffer holding one reference, or NULL if every buffer is in use. */
+PacketBuffer *packet_pool_acquire(PacketPool *pool);
+
+static inline void packet_buffer_hold(PacketBuffer *buffer)
+{
+    atomic_fetch_add_explicit(&buffer->refs, 1, memory_order_relaxed);
+}
+void packet_buffer_release(PacketBuffer *buffer);
+
+#endif
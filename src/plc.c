@@ -0,0 +1,173 @@
+#include "plc.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+int plc_init(PlcState *plc, int sample_rate, int frame_size)
+{
+    memset(plc, 0, sizeof(*plc));
+    plc->sample_rate = sample_rate;
+    plc->frame_size = frame_size;
+    plc->min_lag = sample_rate / 400;
+    plc->max_lag = sample_rate / 66;
+    plc->overlap_len = sample_rate / 250;
+    plc->fade_start = sample_rate / 100;
+    plc->fade_len = sample_rate / 20;
+    plc->history_len = plc->max_lag * 3;
+    if (plc->history_len < frame_size)
+        plc->history_len = frame_size;
+    plc->history = (SAMPLE *)calloc(plc->history_len, sizeof(SAMPLE));
+    plc->period = (SAMPLE *)calloc(plc->max_lag, sizeof(SAMPLE));
+    if (!plc->history || !plc->period)
+    {
+        plc_destroy(plc);
+        return -1;
+    }
+    return 0;
+}
+
+void plc_destroy(PlcState *plc)
+{
+    free(plc->history);
+    free(plc->period);
+    plc->history = NULL;
+    plc->period = NULL;
+}
+
+void plc_reset(PlcState *plc)
+{
+    memset(plc->history, 0, plc->history_len * sizeof(SAMPLE));
+    plc->in_loss = false;
+    plc->concealed_samples = 0;
+    plc->phase = 0;
+}
+
+static void push_history(PlcState *plc, const SAMPLE *samples, int len)
+{
+    if (len >= plc->history_len)
+    {
+        memcpy(plc->history, samples + len - plc->history_len,
+               plc->history_len * sizeof(SAMPLE));
+        return;
+    }
+    memmove(plc->history, plc->history + len,
+            (plc->history_len - len) * sizeof(SAMPLE));
+    memcpy(plc->history + plc->history_len - len, samples,
+           len * sizeof(SAMPLE));
+}
+
+static float lag_score(const SAMPLE *tail, int window, int lag, int step)
+{
+    float cross = 0.0f, energy = 0.0f;
+    for (int i = 0; i < window; i += step)
+    {
+        float x = (float)tail[i];
+        float y = (float)tail[i - lag];
+        cross += x * y;
+        energy += y * y;
+    }
+    if (energy <= 0.0f)
+        return 0.0f;
+    return cross / sqrtf(energy);
+}
+
+static int find_pitch_lag(const PlcState *plc)
+{
+    int window = plc->max_lag;
+    const SAMPLE *tail = plc->history + plc->history_len - window;
+    int best_lag = plc->max_lag;
+    float best_score = -INFINITY;
+    for (int lag = plc->min_lag; lag <= plc->max_lag; lag += 4)
+    {
+        float score = lag_score(tail, window, lag, 4);
+        if (score > best_score)
+        {
+            best_score = score;
+            best_lag = lag;
+        }
+    }
+    /* The refinement compares full-resolution scores only, starting from
+     * the coarse lag's. */
+    int coarse = best_lag;
+    best_score = lag_score(tail, window, coarse, 1);
+    for (int lag = coarse - 3; lag <= coarse + 3; lag++)
+    {
+        if (lag == coarse || lag < plc->min_lag || lag > plc->max_lag)
+            continue;
+        float score = lag_score(tail, window, lag, 1);
+        if (score > best_score)
+        {
+            best_score = score;
+            best_lag = lag;
+        }
+    }
+    return best_lag;
+}
+
+static void begin_loss(PlcState *plc)
+{
+    int lag = find_pitch_lag(plc);
+    plc->pitch_lag = lag;
+    memcpy(plc->period, plc->history + plc->history_len - lag,
+           lag * sizeof(SAMPLE));
+
+    int overlap = plc->overlap_len < lag / 2 ? plc->overlap_len : lag / 2;
+    const SAMPLE *before = plc->history + plc->history_len - lag - overlap;
+    for (int i = 0; i < overlap; i++)
+    {
+        float w = (float)(i + 1) / (float)(overlap + 1);
+        int idx = lag - overlap + i;
+        plc->period[idx] = (SAMPLE)lrintf((1.0f - w) * (float)plc->period[idx] +
+                                          w * (float)before[i]);
+    }
+    plc->phase = 0;
+    plc->concealed_samples = 0;
+    plc->in_loss = true;
+}
+
+static float conceal_gain(const PlcState *plc, int n)
+{
+    if (n < plc->fade_start)
+        return 1.0f;
+    float gain = 1.0f - (float)(n - plc->fade_start) / (float)plc->fade_len;
+    return gain > 0.0f ? gain : 0.0f;
+}
+
+static void synthesize(PlcState *plc, SAMPLE *out, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        float g = conceal_gain(plc, plc->concealed_samples + i);
+        out[i] = (SAMPLE)lrintf(g * (float)plc->period[plc->phase]);
+        if (++plc->phase >= plc->pitch_lag)
+            plc->phase = 0;
+    }
+    plc->concealed_samples += len;
+}
+
+void plc_conceal(PlcState *plc, SAMPLE *out, int len)
+{
+    if (!plc->in_loss)
+        begin_loss(plc);
+    synthesize(plc, out, len);
+    push_history(plc, out, len);
+}
+
+void plc_good_frame(PlcState *plc, SAMPLE *frame, int len)
+{
+    if (plc->in_loss)
+    {
+        int overlap = plc->overlap_len < len ? plc->overlap_len : len;
+        SAMPLE continuation[overlap];
+        synthesize(plc, continuation, overlap);
+        for (int i = 0; i < overlap; i++)
+        {
+            float w = (float)(i + 1) / (float)(overlap + 1);
+            frame[i] = (SAMPLE)lrintf((1.0f - w) * (float)continuation[i] +
+                                      w * (float)frame[i]);
+        }
+        plc->in_loss = false;
+    }
+    push_history(plc, frame, len);
+}
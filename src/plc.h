@@ -0,0 +1,37 @@
+#ifndef PLC_H
+#define PLC_H
+
+#include <stdbool.h>
+
+#include "audio_config.h"
+
+/* Packet loss concealment by pitch-period waveform repetition (in the
+ * spirit of G.711 Appendix I). The jitter buffer feeds every real frame
+ * through plc_good_frame() and asks plc_conceal() for a frame whenever the
+ * expected packet is missing. */
+typedef struct
+{
+    int sample_rate;
+    int frame_size;
+    int min_lag;
+    int max_lag;
+    int overlap_len;
+    int fade_start;
+    int fade_len;
+
+    SAMPLE *history;
+    int history_len;
+    SAMPLE *period;
+    int pitch_lag;
+    int phase;
+    int concealed_samples;
+    bool in_loss;
+} PlcState;
+
+int plc_init(PlcState *plc, int sample_rate, int frame_size);
+void plc_destroy(PlcState *plc);
+void plc_reset(PlcState *plc);
+void plc_good_frame(PlcState *plc, SAMPLE *frame, int len);
+void plc_conceal(PlcState *plc, SAMPLE *out, int len);
+
+#endif
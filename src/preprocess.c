@@ -0,0 +1,187 @@
+#include "preprocess.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dsp_kernels.h"
+#include "time_util.h"
+
+static const char *stage_names[PREPROCESS_STAGE_COUNT] = {
+    "aec",
+    "speex",
+    "gate",
+    "gain",
+};
+
+void preprocess_config_default(PreprocessConfig *config)
+{
+    config->echo_suppress = true;
+    config->denoise = true;
+    config->noise_suppress_db = PREPROCESS_NOISE_SUPPRESS_DB;
+    config->agc = false;
+    config->agc_level = PREPROCESS_AGC_LEVEL;
+    config->vad = true;
+}
+
+static void reset_stats(PreprocessStats *stats)
+{
+    atomic_store(&stats->frames, 0);
+    atomic_store(&stats->speech_frames, 0);
+    atomic_store(&stats->gated_frames, 0);
+    for (int i = 0; i < PREPROCESS_STAGE_COUNT; i++)
+    {
+        atomic_store(&stats->stages[i].total_ns, 0);
+        atomic_store(&stats->stages[i].max_ns, 0);
+    }
+}
+
+/* Charges the time since *start to a stage and restarts the clock. */
+static void stage_done(Preprocess *pp, PreprocessStage stage, uint64_t *start)
+{
+    PreprocessTiming *timing = &pp->stats.stages[stage];
+    uint64_t now = monotonic_ns();
+    uint64_t ns = now - *start;
+    atomic_fetch_add_explicit(&timing->total_ns, ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&timing->max_ns, memory_order_relaxed))
+        atomic_store_explicit(&timing->max_ns, ns, memory_order_relaxed);
+    *start = now;
+}
+
+int preprocess_init(Preprocess *pp, int sample_rate, int frame_size,
+                    SpeexEchoState *echo_state)
+{
+    memset(pp, 0, sizeof(*pp));
+    pp->state = speex_preprocess_state_init(frame_size, sample_rate);
+    if (!pp->state)
+        return -1;
+    pp->echo_state = echo_state;
+    pp->frame_size = frame_size;
+    PreprocessConfig config;
+    preprocess_config_default(&config);
+    preprocess_configure(pp, &config);
+    return 0;
+}
+
+void preprocess_destroy(Preprocess *pp)
+{
+    if (pp->state)
+        speex_preprocess_state_destroy(pp->state);
+    pp->state = NULL;
+}
+
+void preprocess_configure(Preprocess *pp, const PreprocessConfig *config)
+{
+    pp->config = *config;
+    pp->config.echo_suppress =
+        config->echo_suppress && config->denoise && pp->echo_state;
+    int denoise = config->denoise;
+    int agc = config->agc;
+    int vad = config->vad;
+    int noise_suppress = config->noise_suppress_db;
+    float agc_level = config->agc_level;
+    speex_preprocess_ctl(pp->state, SPEEX_PREPROCESS_SET_DENOISE, &denoise);
+    speex_preprocess_ctl(pp->state, SPEEX_PREPROCESS_SET_NOISE_SUPPRESS,
+                         &noise_suppress);
+    speex_preprocess_ctl(pp->state, SPEEX_PREPROCESS_SET_AGC, &agc);
+    speex_preprocess_ctl(pp->state, SPEEX_PREPROCESS_SET_AGC_LEVEL,
+                         &agc_level);
+    speex_preprocess_ctl(pp->state, SPEEX_PREPROCESS_SET_VAD, &vad);
+    speex_preprocess_ctl(pp->state, SPEEX_PREPROCESS_SET_ECHO_STATE,
+                         pp->config.echo_suppress ? pp->echo_state : NULL);
+    pp->speex_enabled = config->denoise || config->agc || config->vad;
+    reset_stats(&pp->stats);
+}
+
+float preprocess_frame(Preprocess *pp, const SAMPLE *mic, SAMPLE *near_end,
+                       SAMPLE *out, float gain, float gate_rms)
+{
+    int frames = pp->frame_size;
+    uint64_t start = monotonic_ns();
+
+    if (pp->echo_state)
+        speex_echo_capture(pp->echo_state, mic, near_end);
+    else
+        memcpy(near_end, mic, frames * sizeof(SAMPLE));
+    stage_done(pp, PREPROCESS_AEC, &start);
+
+    bool speech = true;
+    if (pp->speex_enabled)
+    {
+        /* Without the VAD the return value is always 1. */
+        speech = speex_preprocess_run(pp->state, near_end) != 0;
+        stage_done(pp, PREPROCESS_SPEEX, &start);
+    }
+
+    float rms = dsp_rms(near_end, frames);
+    bool open = gate_rms < 0.0f || (speech && rms > gate_rms);
+    if (!open)
+        memset(out, 0, frames * sizeof(SAMPLE));
+    stage_done(pp, PREPROCESS_GATE, &start);
+
+    if (open)
+    {
+        dsp_apply_gain(near_end, out, frames, gain);
+        stage_done(pp, PREPROCESS_GAIN, &start);
+    }
+
+    atomic_fetch_add_explicit(&pp->stats.frames, 1, memory_order_relaxed);
+    if (speech)
+        atomic_fetch_add_explicit(&pp->stats.speech_frames, 1,
+                                  memory_order_relaxed);
+    if (!open)
+        atomic_fetch_add_explicit(&pp->stats.gated_frames, 1,
+                                  memory_order_relaxed);
+    return rms;
+}
+
+void preprocess_describe(const Preprocess *pp, char *out, int capacity)
+{
+    const PreprocessConfig *config = &pp->config;
+    char denoise[32];
+    char agc[32];
+    if (config->denoise)
+        snprintf(denoise, sizeof(denoise), "%d dB", config->noise_suppress_db);
+    else
+        snprintf(denoise, sizeof(denoise), "off");
+    if (config->agc)
+        snprintf(agc, sizeof(agc), "to %.0f RMS", config->agc_level);
+    else
+        snprintf(agc, sizeof(agc), "off");
+    snprintf(out, capacity,
+             "echo canceller %s, echo suppression %s, noise suppression %s, "
+             "AGC %s, VAD %s",
+             pp->echo_state ? "on" : "off",
+             config->echo_suppress ? "on" : "off", denoise, agc,
+             config->vad ? "on" : "off");
+}
+
+void preprocess_print_stats(const Preprocess *pp, int sample_rate)
+{
+    const PreprocessStats *stats = &pp->stats;
+    uint64_t frames = atomic_load(&stats->frames);
+    double frame_us = 1e6 * pp->frame_size / sample_rate;
+    double total_us = 0.0;
+    char line[512];
+    int length = 0;
+
+    for (int i = 0; i < PREPROCESS_STAGE_COUNT; i++)
+    {
+        const PreprocessTiming *timing = &stats->stages[i];
+        if (i == PREPROCESS_AEC && !pp->echo_state)
+            continue;
+        if (i == PREPROCESS_SPEEX && !pp->speex_enabled)
+            continue;
+        double avg_us =
+            frames ? atomic_load(&timing->total_ns) / 1e3 / frames : 0.0;
+        total_us += avg_us;
+        length += snprintf(line + length, sizeof(line) - length,
+                           "%s %.1f us (worst %.1f), ", stage_names[i],
+                           avg_us, atomic_load(&timing->max_ns) / 1e3);
+    }
+    printf("[PREPROCESS] per frame: %s%.1f us in all (%.1f%% of a frame); "
+           "speech %.1f%%, gated %.1f%% of %llu frames\n",
+           line, total_us, 100.0 * total_us / frame_us,
+           frames ? 100.0 * atomic_load(&stats->speech_frames) / frames : 0.0,
+           frames ? 100.0 * atomic_load(&stats->gated_frames) / frames : 0.0,
+           (unsigned long long)frames);
+}
@@ -0,0 +1,94 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <speex/speex_echo.h>
+#include <speex/speex_preprocess.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_config.h"
+
+#define PREPROCESS_NOISE_SUPPRESS_DB (-15)
+#define PREPROCESS_AGC_LEVEL (8000.0f)
+
+/* The stages of the near-end chain, in order. The speex preprocessor does
+ * residual echo suppression, noise suppression, AGC and VAD in one pass
+ * over one spectrum, so they are timed together. */
+typedef enum
+{
+    PREPROCESS_AEC,
+    PREPROCESS_SPEEX,
+    PREPROCESS_GATE,
+    PREPROCESS_GAIN,
+    PREPROCESS_STAGE_COUNT,
+} PreprocessStage;
+
+/* Residual echo is suppressed through the noise suppressor, so it needs
+ * denoise as well as the echo canceller. noise_suppress_db is the most
+ * the noise is attenuated by (negative); agc_level the RMS amplitude the
+ * AGC aims for. */
+typedef struct
+{
+    bool echo_suppress;
+    bool denoise;
+    int noise_suppress_db;
+    bool agc;
+    float agc_level;
+    bool vad;
+} PreprocessConfig;
+
+/* Time spent in one stage. */
+typedef struct
+{
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+} PreprocessTiming;
+
+/* Written only by the thread running the chain, read from any thread. */
+typedef struct
+{
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t speech_frames;
+    atomic_uint_fast64_t gated_frames;
+    PreprocessTiming stages[PREPROCESS_STAGE_COUNT];
+} PreprocessStats;
+
+/* The near-end chain of the DSP thread: echo cancellation, the speex
+ * preprocessor, a noise gate and a fixed gain. Each stage can be bypassed;
+ * the preprocessor is skipped altogether when none of its features is on.
+ * The gate closes on frames the VAD does not take for speech and on frames
+ * quieter than a floor, which without the VAD makes it the plain RMS gate.
+ * Every stage is timed, so the chain can be fitted to a CPU budget. */
+typedef struct
+{
+    SpeexPreprocessState *state;
+    SpeexEchoState *echo_state;
+    PreprocessConfig config;
+    bool speex_enabled;
+    int frame_size;
+    PreprocessStats stats;
+} Preprocess;
+
+void preprocess_config_default(PreprocessConfig *config);
+/* echo_state is the canceller run on each frame, or NULL without one. */
+int preprocess_init(Preprocess *pp, int sample_rate, int frame_size,
+                    SpeexEchoState *echo_state);
+void preprocess_destroy(Preprocess *pp);
+/* Switches stages on or off and clears the statistics; not while a frame
+ * is being processed. What the preprocessor has learned of the noise is
+ * kept. */
+void preprocess_configure(Preprocess *pp, const PreprocessConfig *config);
+/* Runs one frame of frame_size samples through the chain. near_end gets
+ * the frame after echo cancellation and the preprocessor, out the frame to
+ * send: near_end times gain, or silence while the gate is closed. A
+ * negative gate_rms keeps the gate open. Returns the RMS level of
+ * near_end. */
+float preprocess_frame(Preprocess *pp, const SAMPLE *mic, SAMPLE *near_end,
+                       SAMPLE *out, float gain, float gate_rms);
+/* Describes the enabled stages, e.g. for a log line. */
+void preprocess_describe(const Preprocess *pp, char *out, int capacity);
+/* Prints the time per frame of each stage as a "[PREPROCESS]" line. */
+void preprocess_print_stats(const Preprocess *pp, int sample_rate);
+
+#endif
@@ -0,0 +1,139 @@
+#include "recorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "time_util.h"
+
+#define RECORDER_CHANNELS (2)
+#define RECORDER_FRAME_MAX (AUDIO_FRAME_MAX * 4)
+
+/* Moves every whole chunk, or with all set everything, from the ring to the
+ * file. */
+static void write_queued(Recorder *recorder, SAMPLE *chunk, bool all)
+{
+    size_t chunk_samples = (size_t)recorder->chunk_frames * RECORDER_CHANNELS;
+    for (;;)
+    {
+        size_t available = rb_available_read(&recorder->ring);
+        if (available == 0 || (!all && available < chunk_samples))
+            return;
+        size_t samples = available < chunk_samples ? available : chunk_samples;
+        rb_read(&recorder->ring, chunk, samples);
+        uint64_t start = monotonic_ns();
+        if (wav_writer_write(&recorder->writer, chunk,
+                             (int)(samples / RECORDER_CHANNELS)) == -1)
+            atomic_fetch_add(&recorder->write_errors, 1);
+        uint64_t elapsed = monotonic_ns() - start;
+        if (elapsed > atomic_load(&recorder->max_write_ns))
+            atomic_store(&recorder->max_write_ns, elapsed);
+    }
+}
+
+static void *writer_thread_func(void *data)
+{
+    Recorder *recorder = (Recorder *)data;
+    SAMPLE *chunk = (SAMPLE *)malloc((size_t)recorder->chunk_frames *
+                                     RECORDER_CHANNELS * sizeof(SAMPLE));
+    if (!chunk)
+        return NULL;
+    while (atomic_load(&recorder->running))
+    {
+        frame_notifier_wait(&recorder->notifier, RECORDER_CHUNK_MS);
+        write_queued(recorder, chunk, false);
+    }
+    write_queued(recorder, chunk, true);
+    free(chunk);
+    return NULL;
+}
+
+int recorder_start(Recorder *recorder, const char *path, int sample_rate)
+{
+    recorder->chunk_frames = sample_rate * RECORDER_CHUNK_MS / 1000;
+    recorder->pending_frames = 0;
+    atomic_store(&recorder->frames_dropped, 0);
+    atomic_store(&recorder->write_errors, 0);
+    atomic_store(&recorder->max_write_ns, 0);
+    if (wav_writer_open(&recorder->writer, path, sample_rate,
+                        RECORDER_CHANNELS) == -1)
+    {
+        fprintf(stderr, "Cannot create recording '%s'\n", path);
+        return -1;
+    }
+    if (frame_notifier_init(&recorder->notifier) == -1)
+    {
+        perror("frame_notifier_init() failed");
+        goto error_writer;
+    }
+    if (rb_init(&recorder->ring, (size_t)sample_rate * RECORDER_BUFFER_MS /
+                                     1000 * RECORDER_CHANNELS) == -1)
+    {
+        fprintf(stderr, "Cannot allocate the recording buffer\n");
+        goto error_notifier;
+    }
+    atomic_store(&recorder->running, true);
+    if (pthread_create(&recorder->tid, NULL, writer_thread_func, recorder) !=
+        0)
+    {
+        perror("pthread_create() failed");
+        goto error_ring;
+    }
+    printf("[RECORD] Recording to %s (near end left, far end right).\n",
+           path);
+    return 0;
+
+error_ring:
+    atomic_store(&recorder->running, false);
+    rb_destroy(&recorder->ring);
+error_notifier:
+    frame_notifier_destroy(&recorder->notifier);
+error_writer:
+    wav_writer_close(&recorder->writer);
+    return -1;
+}
+
+void recorder_write(Recorder *recorder, const SAMPLE *near_end,
+                    const SAMPLE *far_end, int frames)
+{
+    SAMPLE stereo[RECORDER_FRAME_MAX * RECORDER_CHANNELS];
+    if (frames > RECORDER_FRAME_MAX)
+        frames = RECORDER_FRAME_MAX;
+    if (rb_available_write(&recorder->ring) <
+        (size_t)frames * RECORDER_CHANNELS)
+    {
+        atomic_fetch_add_explicit(&recorder->frames_dropped, frames,
+                                  memory_order_relaxed);
+        return;
+    }
+    for (int i = 0; i < frames; i++)
+    {
+        stereo[2 * i] = near_end[i];
+        stereo[2 * i + 1] = far_end[i];
+    }
+    rb_write(&recorder->ring, stereo, (size_t)frames * RECORDER_CHANNELS);
+    /* One wakeup per chunk keeps the eventfd write off most frames. */
+    recorder->pending_frames += frames;
+    if (recorder->pending_frames >= recorder->chunk_frames)
+    {
+        recorder->pending_frames = 0;
+        frame_notifier_signal(&recorder->notifier);
+    }
+}
+
+void recorder_stop(Recorder *recorder)
+{
+    atomic_store(&recorder->running, false);
+    frame_notifier_signal(&recorder->notifier);
+    pthread_join(recorder->tid, NULL);
+    uint32_t frames = recorder->writer.frames_written;
+    int sample_rate = recorder->writer.sample_rate;
+    wav_writer_close(&recorder->writer);
+    rb_destroy(&recorder->ring);
+    frame_notifier_destroy(&recorder->notifier);
+    printf("[RECORD] %.1f s written, %llu frames dropped, %llu write errors, "
+           "longest write %.1f ms\n",
+           (double)frames / sample_rate,
+           (unsigned long long)atomic_load(&recorder->frames_dropped),
+           (unsigned long long)atomic_load(&recorder->write_errors),
+           atomic_load(&recorder->max_write_ns) / 1e6);
+}
@@ -0,0 +1,46 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_config.h"
+#include "frame_notifier.h"
+#include "ring_buffer.h"
+#include "wav_file.h"
+
+/* Audio the writer may fall behind by before frames are dropped. */
+#define RECORDER_BUFFER_MS (2000)
+/* The writer is woken, and writes to the file, in chunks this long. */
+#define RECORDER_CHUNK_MS (250)
+
+/* Records a call to a stereo WAV file, near end left and far end right.
+ * The DSP thread interleaves each frame into a ring and never waits; a
+ * writer thread empties the ring to disk in large chunks. If the disk
+ * stalls for longer than the ring holds, whole frames are dropped and
+ * counted rather than delaying the call. */
+typedef struct
+{
+    RingBuffer ring;
+    FrameNotifier notifier;
+    WavWriter writer;
+    pthread_t tid;
+    atomic_bool running;
+    int chunk_frames;
+    int pending_frames;
+    _Atomic uint64_t frames_dropped;
+    _Atomic uint64_t write_errors;
+    _Atomic uint64_t max_write_ns;
+} Recorder;
+
+int recorder_start(Recorder *recorder, const char *path, int sample_rate);
+/* DSP thread: queues one frame of each side. */
+void recorder_write(Recorder *recorder, const SAMPLE *near_end,
+                    const SAMPLE *far_end, int frames);
+/* Writes what is still queued, closes the file and prints a "[RECORD]"
+ * line. */
+void recorder_stop(Recorder *recorder);
+
+#endif
@@ -0,0 +1,137 @@
+#include "red.h"
+
+#include <string.h>
+
+#define RED_HEADER_SIZE (4)
+#define RED_PRIMARY_HEADER_SIZE (1)
+#define RED_FOLLOW_BIT (0x80)
+
+void red_encoder_init(RedEncoder *red)
+{
+    memset(red, 0, sizeof(*red));
+}
+
+void red_encoder_reset(RedEncoder *red)
+{
+    red->count = 0;
+    red->head = 0;
+}
+
+static void remember(RedEncoder *red, uint8_t payload_type,
+                     uint32_t timestamp, const uint8_t *payload, int length)
+{
+    RedFrame *frame = &red->history[red->head];
+    frame->payload_type = payload_type;
+    frame->timestamp = timestamp;
+    frame->length = length;
+    memcpy(frame->data, payload, length);
+    red->head = (red->head + 1) % RED_MAX_DEPTH;
+    if (red->count < RED_MAX_DEPTH)
+        red->count++;
+}
+
+int red_encoder_pack(RedEncoder *red, int depth, uint8_t payload_type,
+                     uint32_t timestamp, const uint8_t *payload, int length,
+                     uint8_t *out, int capacity)
+{
+    if (capacity > RED_PAYLOAD_MAX)
+        capacity = RED_PAYLOAD_MAX;
+    if (depth > red->count)
+        depth = red->count;
+
+    /* Take the newest frames that fit, then write them oldest first. */
+    const RedFrame *chosen[RED_MAX_DEPTH];
+    int chosen_count = 0;
+    int size = RED_PRIMARY_HEADER_SIZE + length;
+    for (int i = 0; i < depth; i++)
+    {
+        int index = (red->head - 1 - i + RED_MAX_DEPTH) % RED_MAX_DEPTH;
+        const RedFrame *frame = &red->history[index];
+        uint32_t offset = timestamp - frame->timestamp;
+        if (offset == 0 || offset > RED_OFFSET_MAX ||
+            frame->length > RED_BLOCK_MAX ||
+            size + RED_HEADER_SIZE + frame->length > capacity)
+            break;
+        size += RED_HEADER_SIZE + frame->length;
+        chosen[chosen_count++] = frame;
+    }
+    if (chosen_count == 0)
+    {
+        remember(red, payload_type, timestamp, payload, length);
+        return 0;
+    }
+
+    uint8_t *header = out;
+    uint8_t *data = out + chosen_count * RED_HEADER_SIZE +
+                    RED_PRIMARY_HEADER_SIZE;
+    for (int i = chosen_count - 1; i >= 0; i--)
+    {
+        const RedFrame *frame = chosen[i];
+        uint32_t offset = timestamp - frame->timestamp;
+        header[0] = RED_FOLLOW_BIT | (frame->payload_type & 0x7f);
+        header[1] = (uint8_t)(offset >> 6);
+        header[2] = (uint8_t)(((offset & 0x3f) << 2) | (frame->length >> 8));
+        header[3] = (uint8_t)frame->length;
+        header += RED_HEADER_SIZE;
+        memcpy(data, frame->data, frame->length);
+        data += frame->length;
+    }
+    header[0] = payload_type & 0x7f;
+    memcpy(data, payload, length);
+    remember(red, payload_type, timestamp, payload, length);
+    return size;
+}
+
+static uint32_t header_offset(const uint8_t *header)
+{
+    return ((uint32_t)header[1] << 6) | (header[2] >> 2);
+}
+
+static int header_length(const uint8_t *header)
+{
+    return ((header[2] & 0x03) << 8) | header[3];
+}
+
+int red_parse(const uint8_t *payload, int length, uint32_t timestamp,
+              RedBlock *blocks, int max)
+{
+    /* The headers list the redundant blocks oldest first and end with the
+     * one-byte primary header; the data blocks follow in the same order. */
+    int redundant = 0;
+    int pos = 0;
+    int data_size = 0;
+    while (pos < length && (payload[pos] & RED_FOLLOW_BIT))
+    {
+        if (pos + RED_HEADER_SIZE > length)
+            return -1;
+        data_size += header_length(payload + pos);
+        pos += RED_HEADER_SIZE;
+        redundant++;
+    }
+    if (pos + RED_PRIMARY_HEADER_SIZE + data_size > length || max < 1)
+        return -1;
+
+    const uint8_t *data = payload + pos + RED_PRIMARY_HEADER_SIZE;
+    blocks[0].payload_type = payload[pos] & 0x7f;
+    blocks[0].timestamp = timestamp;
+    blocks[0].data = data + data_size;
+    blocks[0].length = length - pos - RED_PRIMARY_HEADER_SIZE - data_size;
+
+    /* Keep the newest max - 1 redundant blocks. */
+    int keep = redundant < max - 1 ? redundant : max - 1;
+    for (int i = 0; i < redundant; i++)
+    {
+        const uint8_t *header = payload + i * RED_HEADER_SIZE;
+        int block_length = header_length(header);
+        int slot = redundant - i;
+        if (slot <= keep)
+        {
+            blocks[slot].payload_type = header[0] & 0x7f;
+            blocks[slot].timestamp = timestamp - header_offset(header);
+            blocks[slot].data = data;
+            blocks[slot].length = block_length;
+        }
+        data += block_length;
+    }
+    return keep + 1;
+}
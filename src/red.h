@@ -0,0 +1,59 @@
+#ifndef RED_H
+#define RED_H
+
+#include <stdint.h>
+
+#include "audio_packet.h"
+
+#define RED_MAX_DEPTH (2)
+#define RED_MAX_BLOCKS (RED_MAX_DEPTH + 1)
+/* A redundant packet is kept below a 1500 byte MTU with IP, UDP and RTP
+ * headers; blocks that do not fit are left out. */
+#define RED_PAYLOAD_MAX (1400)
+#define RED_BLOCK_MAX (1023)
+#define RED_OFFSET_MAX (16383)
+#define RED_DEPTH_AUTO (-1)
+
+/* One block of an RFC 2198 payload. data points into the packet. */
+typedef struct
+{
+    uint8_t payload_type;
+    uint32_t timestamp;
+    const uint8_t *data;
+    int length;
+} RedBlock;
+
+typedef struct
+{
+    uint8_t payload_type;
+    uint32_t timestamp;
+    int length;
+    uint8_t data[AUDIO_PAYLOAD_MAX];
+} RedFrame;
+
+/* Sender side of RFC 2198 redundancy: every packet repeats up to depth of
+ * the frames sent before it, so a burst of that many lost packets can be
+ * rebuilt from the one that follows. */
+typedef struct
+{
+    RedFrame history[RED_MAX_DEPTH];
+    int count;
+    int head;
+} RedEncoder;
+
+void red_encoder_init(RedEncoder *red);
+/* Forgets the history, e.g. when transmission pauses for DTX. */
+void red_encoder_reset(RedEncoder *red);
+/* Records the primary frame and, if any earlier frames fit alongside it,
+ * writes a redundant payload to out and returns its length. Returns 0 when
+ * the primary should be sent on its own. */
+int red_encoder_pack(RedEncoder *red, int depth, uint8_t payload_type,
+                     uint32_t timestamp, const uint8_t *payload, int length,
+                     uint8_t *out, int capacity);
+/* Splits a redundant payload carried with the given RTP timestamp. The
+ * primary block comes first, followed by redundant blocks from newest to
+ * oldest; at most max blocks are returned. Returns -1 if malformed. */
+int red_parse(const uint8_t *payload, int length, uint32_t timestamp,
+              RedBlock *blocks, int max);
+
+#endif
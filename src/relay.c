@@ -0,0 +1,601 @@
+#include "relay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rt_thread.h"
+#include "rtp.h"
+#include "time_util.h"
+
+#define RTCP_APP (204)
+#define RELAY_APP_NAME "RLAY"
+#define RELAY_WAIT_MS (100)
+#define RELAY_SOCKET_BUFFER (4 << 20)
+/* Each datagram of a batch may go to every other member of its room. */
+#define RELAY_TX_MAX (NET_BATCH_MAX * (RELAY_ROOM_MEMBERS_MAX - 1))
+/* Marks an endpoint slot whose address has left. */
+#define TABLE_TOMBSTONE (~0ull)
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+size_t relay_build_join(uint8_t *buffer, size_t capacity, uint32_t ssrc,
+                        uint32_t room)
+{
+    if (capacity < RELAY_JOIN_SIZE)
+        return 0;
+    buffer[0] = RTP_VERSION << 6;
+    buffer[1] = RTCP_APP;
+    buffer[2] = 0;
+    buffer[3] = RELAY_JOIN_SIZE / 4 - 1;
+    put_u32(buffer + 4, ssrc);
+    memcpy(buffer + 8, RELAY_APP_NAME, 4);
+    put_u32(buffer + 12, room);
+    return RELAY_JOIN_SIZE;
+}
+
+bool relay_parse_join(const uint8_t *buffer, size_t length, uint32_t *room)
+{
+    size_t offset = 0;
+    while (offset + 8 <= length)
+    {
+        const uint8_t *packet = buffer + offset;
+        size_t packet_length =
+            4 * ((size_t)((packet[2] << 8) | packet[3]) + 1);
+        if ((packet[0] >> 6) != RTP_VERSION || packet[1] < 200 ||
+            packet[1] > RTCP_APP || offset + packet_length > length)
+            return false;
+        if (packet[1] == RTCP_APP && packet_length >= RELAY_JOIN_SIZE &&
+            memcmp(packet + 8, RELAY_APP_NAME, 4) == 0)
+        {
+            *room = get_u32(packet + 12);
+            return true;
+        }
+        offset += packet_length;
+    }
+    return false;
+}
+
+void relay_config_default(RelayConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->port = RELAY_DEFAULT_PORT;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config->workers = cpus < 1                   ? 1
+                      : cpus > RELAY_WORKERS_MAX ? RELAY_WORKERS_MAX
+                                                 : (int)cpus;
+    config->rooms = RELAY_DEFAULT_ROOMS;
+    config->member_timeout_ms = RELAY_MEMBER_TIMEOUT_MS;
+    config->pin_workers = true;
+}
+
+static uint32_t hash_key(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+/* Never 0, which marks a free slot, nor TABLE_TOMBSTONE. */
+static uint64_t address_key(const struct sockaddr_in *addr)
+{
+    return (1ull << 48) | ((uint64_t)addr->sin_addr.s_addr << 16) |
+           addr->sin_port;
+}
+
+static void key_address(uint64_t key, struct sockaddr_in *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = (uint32_t)(key >> 16);
+    addr->sin_port = (uint16_t)key;
+}
+
+static uint32_t table_size(int entries)
+{
+    uint32_t size = 64;
+    while (size < (uint32_t)entries * 2)
+        size *= 2;
+    return size;
+}
+
+static int table_init(RelayTable *table, int rooms, int member_timeout_ms)
+{
+    /* Every place in every room may hold an address, and the endpoint
+     * table stays at most half full. */
+    uint32_t room_slots = table_size(rooms);
+    uint32_t endpoint_slots =
+        table_size((int)room_slots * RELAY_ROOM_MEMBERS_MAX);
+    pthread_mutex_init(&table->lock, NULL);
+    table->rooms = (RelayRoom *)calloc(room_slots, sizeof(RelayRoom));
+    table->endpoints =
+        (RelayEndpoint *)calloc(endpoint_slots, sizeof(RelayEndpoint));
+    table->room_mask = room_slots - 1;
+    table->endpoint_mask = endpoint_slots - 1;
+    table->member_timeout_ns = (uint64_t)member_timeout_ms * 1000000ull;
+    return table->rooms && table->endpoints ? 0 : -1;
+}
+
+static void table_destroy(RelayTable *table)
+{
+    free(table->rooms);
+    free(table->endpoints);
+    table->rooms = NULL;
+    table->endpoints = NULL;
+    pthread_mutex_destroy(&table->lock);
+}
+
+/* Workers stamp their own clock readings, so a member may have been seen
+ * after now. */
+static bool timed_out(const RelayTable *table, uint64_t seen, uint64_t now)
+{
+    return now > seen && now - seen > table->member_timeout_ns;
+}
+
+/* Returns the member reference of an address, 0 if it has not joined. */
+static uint32_t table_find_endpoint(RelayTable *table, uint64_t key)
+{
+    uint32_t slot = hash_key(key) & table->endpoint_mask;
+    for (uint32_t i = 0; i <= table->endpoint_mask; i++)
+    {
+        RelayEndpoint *endpoint = &table->endpoints[slot];
+        uint64_t current = atomic_load_explicit(&endpoint->key,
+                                                memory_order_acquire);
+        if (current == key)
+            return atomic_load_explicit(&endpoint->ref, memory_order_acquire);
+        if (current == 0)
+            return 0;
+        slot = (slot + 1) & table->endpoint_mask;
+    }
+    return 0;
+}
+
+/* Under the lock. The address goes in the first tombstone on its way, if
+ * there is one. */
+static int table_add_endpoint(RelayTable *table, uint64_t key, uint32_t ref)
+{
+    uint32_t slot = hash_key(key) & table->endpoint_mask;
+    RelayEndpoint *free_endpoint = NULL;
+    for (uint32_t i = 0; i <= table->endpoint_mask; i++)
+    {
+        RelayEndpoint *endpoint = &table->endpoints[slot];
+        uint64_t current = atomic_load_explicit(&endpoint->key,
+                                                memory_order_relaxed);
+        if (current == key)
+        {
+            atomic_store_explicit(&endpoint->ref, ref, memory_order_release);
+            return 0;
+        }
+        if (current == 0 || current == TABLE_TOMBSTONE)
+        {
+            if (!free_endpoint)
+                free_endpoint = endpoint;
+            if (current == 0)
+                break;
+        }
+        slot = (slot + 1) & table->endpoint_mask;
+    }
+    if (!free_endpoint)
+        return -1;
+    atomic_store_explicit(&free_endpoint->ref, ref, memory_order_relaxed);
+    atomic_store_explicit(&free_endpoint->key, key, memory_order_release);
+    return 0;
+}
+
+/* Under the lock: leaves a tombstone, so that the addresses behind it are
+ * still found. No lookup goes on past an empty slot, so a run of
+ * tombstones that ends in one is emptied. */
+static void table_remove_endpoint(RelayTable *table, uint64_t key,
+                                  uint32_t ref)
+{
+    uint32_t mask = table->endpoint_mask;
+    uint32_t slot = hash_key(key) & mask;
+    for (uint32_t i = 0; i <= mask; i++, slot = (slot + 1) & mask)
+    {
+        RelayEndpoint *endpoint = &table->endpoints[slot];
+        uint64_t current = atomic_load_explicit(&endpoint->key,
+                                                memory_order_relaxed);
+        if (current == 0)
+            return;
+        if (current != key)
+            continue;
+        if (atomic_load_explicit(&endpoint->ref, memory_order_relaxed) != ref)
+            return;
+        atomic_store_explicit(&endpoint->key, TABLE_TOMBSTONE,
+                              memory_order_release);
+        if (atomic_load_explicit(&table->endpoints[(slot + 1) & mask].key,
+                                 memory_order_relaxed) != 0)
+            return;
+        for (uint32_t j = 0; j <= mask; j++, slot = (slot - 1) & mask)
+        {
+            endpoint = &table->endpoints[slot];
+            if (atomic_load_explicit(&endpoint->key, memory_order_relaxed) !=
+                TABLE_TOMBSTONE)
+                return;
+            atomic_store_explicit(&endpoint->key, 0, memory_order_release);
+        }
+        return;
+    }
+}
+
+static uint32_t member_ref(const RelayTable *table, const RelayRoom *room,
+                           int index)
+{
+    return (uint32_t)(room - table->rooms) * RELAY_ROOM_MEMBERS_MAX + index +
+           1;
+}
+
+/* Returns the member an address has joined as, or NULL. The reference in
+ * the endpoint table may be to a place that has since been given to
+ * another address. */
+static RelayMember *table_find_member(RelayTable *table, uint64_t key,
+                                      RelayRoom **room, int *index)
+{
+    uint32_t ref = table_find_endpoint(table, key);
+    if (ref == 0)
+        return NULL;
+    *room = &table->rooms[(ref - 1) / RELAY_ROOM_MEMBERS_MAX];
+    *index = (ref - 1) % RELAY_ROOM_MEMBERS_MAX;
+    RelayMember *member = &(*room)->member[*index];
+    if (atomic_load_explicit(&member->key, memory_order_acquire) != key)
+        return NULL;
+    return member;
+}
+
+/* Under the lock: frees a member's place if it is free already or its
+ * member has timed out. The compare-and-swap on the time seen loses to the
+ * member's worker if the member is heard from meanwhile. */
+static bool take_member(RelayWorker *worker, RelayRoom *room, int index,
+                        uint64_t now)
+{
+    RelayTable *table = &worker->relay->table;
+    RelayMember *member = &room->member[index];
+    uint64_t key = atomic_load_explicit(&member->key, memory_order_relaxed);
+    if (key == 0)
+        return true;
+    uint64_t seen =
+        atomic_load_explicit(&member->last_seen_ns, memory_order_relaxed);
+    if (!timed_out(table, seen, now) ||
+        !atomic_compare_exchange_strong(&member->last_seen_ns, &seen, now))
+        return false;
+    atomic_store_explicit(&member->key, 0, memory_order_release);
+    table_remove_endpoint(table, key, member_ref(table, room, index));
+    atomic_fetch_add_explicit(&worker->stats.reclaimed, 1,
+                              memory_order_relaxed);
+    return true;
+}
+
+/* Under the lock: frees every place in a room none of whose members is
+ * live. Returns false if one is. */
+static bool release_room(RelayWorker *worker, RelayRoom *room, uint64_t now)
+{
+    for (int i = 0; i < RELAY_ROOM_MEMBERS_MAX; i++)
+    {
+        if (!take_member(worker, room, i, now))
+            return false;
+    }
+    return true;
+}
+
+/* Under the lock: the room with this number or, if there is none, a new
+ * one in the first empty slot on its way or in place of the first room on
+ * its way whose members have all timed out. */
+static RelayRoom *table_room(RelayWorker *worker, uint32_t number,
+                             uint64_t now)
+{
+    RelayTable *table = &worker->relay->table;
+    uint64_t key = (uint64_t)number + 1;
+    uint32_t slot = hash_key(key) & table->room_mask;
+    RelayRoom *free_room = NULL;
+    for (uint32_t i = 0; i <= table->room_mask; i++)
+    {
+        RelayRoom *room = &table->rooms[slot];
+        uint64_t current = atomic_load_explicit(&room->key,
+                                                memory_order_relaxed);
+        if (current == key)
+            return room;
+        if (current == 0)
+        {
+            if (!free_room)
+                free_room = room;
+            break;
+        }
+        if (!free_room && release_room(worker, room, now))
+            free_room = room;
+        slot = (slot + 1) & table->room_mask;
+    }
+    if (free_room)
+        atomic_store_explicit(&free_room->key, key, memory_order_release);
+    return free_room;
+}
+
+static void handle_join(RelayWorker *worker, const struct sockaddr_in *from,
+                        uint32_t number, uint64_t now)
+{
+    RelayTable *table = &worker->relay->table;
+    RelayWorkerStats *stats = &worker->stats;
+    uint64_t key = address_key(from);
+    RelayRoom *room;
+    int index;
+    RelayMember *member = table_find_member(table, key, &room, &index);
+    if (member && atomic_load_explicit(&room->key, memory_order_relaxed) ==
+                      (uint64_t)number + 1)
+    {
+        /* A repeated join only refreshes the member. */
+        atomic_store_explicit(&member->last_seen_ns, now,
+                              memory_order_relaxed);
+        return;
+    }
+
+    /* Moving to another room needs a new address, unless the old member
+     * has timed out: the port may have been given to a new client. */
+    int result = -1;
+    pthread_mutex_lock(&table->lock);
+    if (member && !take_member(worker, room, index, now))
+        room = NULL;
+    else
+        room = table_room(worker, number, now);
+    for (index = 0; room && index < RELAY_ROOM_MEMBERS_MAX; index++)
+    {
+        if (!take_member(worker, room, index, now))
+            continue;
+        member = &room->member[index];
+        atomic_store_explicit(&member->last_seen_ns, now,
+                              memory_order_relaxed);
+        result = table_add_endpoint(table, key,
+                                    member_ref(table, room, index));
+        if (result == 0)
+            atomic_store_explicit(&member->key, key, memory_order_release);
+        break;
+    }
+    pthread_mutex_unlock(&table->lock);
+    if (result == -1)
+    {
+        atomic_fetch_add_explicit(&stats->rejected, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&stats->joins, 1, memory_order_relaxed);
+}
+
+typedef struct
+{
+    const void *buffers[RELAY_TX_MAX];
+    size_t lengths[RELAY_TX_MAX];
+    struct sockaddr_in addrs[RELAY_TX_MAX];
+    int count;
+} RelayBatch;
+
+/* Queues a datagram to every other live member of the sender's room.
+ * Returns false if the sender is unknown. */
+static bool queue_forward(RelayWorker *worker, RelayBatch *batch,
+                          const uint8_t *datagram, int length,
+                          const struct sockaddr_in *from, uint64_t now)
+{
+    RelayTable *table = &worker->relay->table;
+    RelayRoom *room;
+    int self;
+    RelayMember *sender =
+        table_find_member(table, address_key(from), &room, &self);
+    if (!sender)
+        return false;
+    atomic_store_explicit(&sender->last_seen_ns, now, memory_order_relaxed);
+    for (int i = 0; i < RELAY_ROOM_MEMBERS_MAX; i++)
+    {
+        RelayMember *member = &room->member[i];
+        uint64_t key = atomic_load_explicit(&member->key, memory_order_acquire);
+        if (i == self || key == 0 ||
+            timed_out(table,
+                      atomic_load_explicit(&member->last_seen_ns,
+                                           memory_order_relaxed),
+                      now))
+            continue;
+        batch->buffers[batch->count] = datagram;
+        batch->lengths[batch->count] = (size_t)length;
+        key_address(key, &batch->addrs[batch->count]);
+        batch->count++;
+    }
+    return true;
+}
+
+/* Forwards one received batch with as few sendmmsg() calls as the fan-out
+ * allows; the datagrams are sent from the receive buffers. */
+static void forward_batch(RelayWorker *worker,
+                          uint8_t (*datagrams)[RELAY_PACKET_MAX],
+                          const NetDatagramInfo *info, int count)
+{
+    RelayWorkerStats *stats = &worker->stats;
+    RelayBatch batch;
+    bool forwarded[NET_BATCH_MAX];
+    uint64_t unknown = 0;
+    uint64_t now = monotonic_ns();
+    batch.count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t room;
+        forwarded[i] = false;
+        if (relay_parse_join(datagrams[i], info[i].length, &room))
+        {
+            handle_join(worker, &info[i].addr, room, now);
+            continue;
+        }
+        if (queue_forward(worker, &batch, datagrams[i], info[i].length,
+                          &info[i].addr, now))
+            forwarded[i] = true;
+        else
+            unknown++;
+    }
+    int sent = batch.count > 0 ? net_send_batch(&worker->net, batch.buffers,
+                                                batch.lengths, batch.addrs,
+                                                batch.count)
+                               : 0;
+    uint64_t done = monotonic_ns();
+    for (int i = 0; i < count; i++)
+    {
+        if (forwarded[i])
+            histogram_record(&stats->latency, done - info[i].timestamp_ns);
+    }
+    atomic_fetch_add_explicit(&stats->packets_in, count, memory_order_relaxed);
+    if (sent > 0)
+        atomic_fetch_add_explicit(&stats->packets_out, sent,
+                                  memory_order_relaxed);
+    if (unknown > 0)
+        atomic_fetch_add_explicit(&stats->unknown, unknown,
+                                  memory_order_relaxed);
+}
+
+static void *worker_func(void *data)
+{
+    RelayWorker *worker = (RelayWorker *)data;
+    Relay *relay = worker->relay;
+    uint8_t datagrams[NET_BATCH_MAX][RELAY_PACKET_MAX];
+    void *buffers[NET_BATCH_MAX];
+    NetDatagramInfo info[NET_BATCH_MAX];
+    NetPoller poller;
+    for (int i = 0; i < NET_BATCH_MAX; i++)
+        buffers[i] = datagrams[i];
+
+    if (net_poller_init(&poller) == -1)
+    {
+        perror("net_poller_init() failed");
+        return NULL;
+    }
+    net_poller_add(&poller, worker->net.fd);
+    while (atomic_load(&relay->is_running))
+    {
+        int ready;
+        if (net_poller_wait(&poller, &ready, 1, RELAY_WAIT_MS) <= 0)
+            continue;
+        int count;
+        do
+        {
+            count = net_recv_batch(&worker->net, buffers, RELAY_PACKET_MAX,
+                                   info, NET_BATCH_MAX);
+            if (count > 0)
+                forward_batch(worker, datagrams, info, count);
+        } while (count == NET_BATCH_MAX);
+    }
+    net_poller_destroy(&poller);
+    return NULL;
+}
+
+int relay_start(Relay *relay, const RelayConfig *config)
+{
+    memset(relay, 0, sizeof(*relay));
+    relay->config = *config;
+    RelayConfig *cfg = &relay->config;
+    if (cfg->workers < 1)
+        cfg->workers = 1;
+    if (cfg->workers > RELAY_WORKERS_MAX)
+        cfg->workers = RELAY_WORKERS_MAX;
+    if (cfg->rooms < 1)
+        cfg->rooms = RELAY_DEFAULT_ROOMS;
+    if (cfg->member_timeout_ms < 1)
+        cfg->member_timeout_ms = RELAY_MEMBER_TIMEOUT_MS;
+    atomic_init(&relay->is_running, true);
+
+    int opened = 0;
+    if (table_init(&relay->table, cfg->rooms, cfg->member_timeout_ms) == -1)
+    {
+        fprintf(stderr, "Cannot allocate the room table\n");
+        goto error_table;
+    }
+    relay->workers = (RelayWorker *)calloc(cfg->workers, sizeof(RelayWorker));
+    if (!relay->workers)
+        goto error_table;
+
+    /* Every socket joins the port group before any worker runs, so the
+     * kernel's spread of senders does not change under the workers. */
+    relay->port = cfg->port;
+    for (; opened < cfg->workers; opened++)
+    {
+        RelayWorker *worker = &relay->workers[opened];
+        worker->relay = relay;
+        worker->index = opened;
+        if (net_socket_open_shared(&worker->net, relay->port) == -1)
+            goto error_sockets;
+        int size = RELAY_SOCKET_BUFFER;
+        setsockopt(worker->net.fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(worker->net.fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        if (relay->port == 0)
+            relay->port = net_socket_local_port(&worker->net);
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; i < cfg->workers; i++)
+    {
+        RelayWorker *worker = &relay->workers[i];
+        if (pthread_create(&worker->tid, NULL, worker_func, worker) != 0)
+        {
+            perror("pthread_create() failed");
+            atomic_store(&relay->is_running, false);
+            for (int j = 0; j < i; j++)
+                pthread_join(relay->workers[j].tid, NULL);
+            goto error_sockets;
+        }
+        if (cfg->pin_workers && cpus > 1)
+            rt_thread_pin_cpu(worker->tid, (int)(i % cpus));
+    }
+    printf("[RELAY] Listening on UDP port %d with %d workers, %d rooms.\n",
+           relay->port, cfg->workers, cfg->rooms);
+    return 0;
+
+error_sockets:
+    for (int i = 0; i < opened; i++)
+        net_socket_close(&relay->workers[i].net);
+    free(relay->workers);
+    relay->workers = NULL;
+error_table:
+    table_destroy(&relay->table);
+    return -1;
+}
+
+void relay_stop(Relay *relay)
+{
+    if (!relay->workers || !atomic_exchange(&relay->is_running, false))
+        return;
+    for (int i = 0; i < relay->config.workers; i++)
+        pthread_join(relay->workers[i].tid, NULL);
+    for (int i = 0; i < relay->config.workers; i++)
+        net_socket_close(&relay->workers[i].net);
+}
+
+void relay_destroy(Relay *relay)
+{
+    relay_stop(relay);
+    free(relay->workers);
+    relay->workers = NULL;
+    table_destroy(&relay->table);
+}
+
+void relay_total_stats(Relay *relay, RelayWorkerStats *total)
+{
+    memset(total, 0, sizeof(*total));
+    for (int i = 0; relay->workers && i < relay->config.workers; i++)
+    {
+        RelayWorkerStats *stats = &relay->workers[i].stats;
+        total->packets_in += atomic_load(&stats->packets_in);
+        total->packets_out += atomic_load(&stats->packets_out);
+        total->joins += atomic_load(&stats->joins);
+        total->unknown += atomic_load(&stats->unknown);
+        total->rejected += atomic_load(&stats->rejected);
+        total->reclaimed += atomic_load(&stats->reclaimed);
+        if (!atomic_load(&relay->is_running))
+            histogram_merge(&total->latency, &stats->latency);
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "net_io.h"
+
+#define RELAY_DEFAULT_PORT (7000)
+#define RELAY_DEFAULT_ROOMS (4096)
+#define RELAY_WORKERS_MAX (64)
+#define RELAY_ROOM_MEMBERS_MAX (8)
+#define RELAY_PACKET_MAX (1500)
+/* A member that has sent nothing for this long is no longer forwarded to
+ * until it sends again, and its place may be given to a new member. */
+#define RELAY_MEMBER_TIMEOUT_MS (30000)
+/* Clients repeat their join this often; it also keeps NAT bindings open. */
+#define RELAY_JOIN_INTERVAL_MS (1000)
+#define RELAY_JOIN_SIZE (16)
+
+/* Joining a room: an RTCP APP packet (RFC 3550 6.7) named "RLAY" whose data
+ * is the room number. It may lead or follow other RTCP packets in a
+ * compound packet. */
+size_t relay_build_join(uint8_t *buffer, size_t capacity, uint32_t ssrc,
+                        uint32_t room);
+/* Returns true and stores the room if buffer carries a join. */
+bool relay_parse_join(const uint8_t *buffer, size_t length, uint32_t *room);
+
+typedef struct
+{
+    int port;
+    int workers;
+    int rooms;
+    int member_timeout_ms;
+    bool pin_workers;
+} RelayConfig;
+
+/* The member's address is held as its endpoint key, 0 while the place is
+ * free, so a reader never sees half of an address that is being
+ * replaced. */
+typedef struct
+{
+    _Atomic uint64_t key;
+    _Atomic uint64_t last_seen_ns;
+} RelayMember;
+
+/* A call: two peers, or up to RELAY_ROOM_MEMBERS_MAX conference members.
+ * Every datagram a member sends goes to all other members. */
+typedef struct
+{
+    _Atomic uint64_t key;
+    RelayMember member[RELAY_ROOM_MEMBERS_MAX];
+} RelayRoom;
+
+typedef struct
+{
+    _Atomic uint64_t key;
+    atomic_uint ref;
+} RelayEndpoint;
+
+/* Rooms and the address of every member, shared by all workers. Both are
+ * open-addressed hash tables sized at start. Forwarding and repeated joins
+ * take no lock. A join that adds a member takes the lock; it may give the
+ * member a place whose member timed out (a compare-and-swap on its last
+ * time seen, against a refresh by the member's worker), hand back a room
+ * whose members have all timed out, and leave a tombstone where an address
+ * was. Entries are published with release stores, and a reader checks that
+ * the member it reaches still has its address, so a place reused under it
+ * is noticed. */
+typedef struct
+{
+    RelayRoom *rooms;
+    uint32_t room_mask;
+    RelayEndpoint *endpoints;
+    uint32_t endpoint_mask;
+    uint64_t member_timeout_ns;
+    pthread_mutex_t lock;
+} RelayTable;
+
+/* Worker counters are written by the worker alone; the latency histogram
+ * may only be read once the relay has stopped. */
+typedef struct
+{
+    _Atomic uint64_t packets_in;
+    _Atomic uint64_t packets_out;
+    _Atomic uint64_t joins;
+    _Atomic uint64_t unknown;
+    _Atomic uint64_t rejected;
+    _Atomic uint64_t reclaimed;
+    Histogram latency;
+} RelayWorkerStats;
+
+struct Relay;
+
+typedef struct
+{
+    struct Relay *relay;
+    int index;
+    NetSocket net;
+    pthread_t tid;
+    RelayWorkerStats stats;
+} RelayWorker;
+
+/* A UDP forwarder for many calls at once. Each worker thread has its own
+ * socket on the shared port (SO_REUSEPORT), its own epoll loop and batched
+ * recvmmsg/sendmmsg; the kernel keeps every sender on one worker, so the
+ * workers share nothing but the lock-free room table. */
+typedef struct Relay
+{
+    RelayConfig config;
+    int port;
+    RelayTable table;
+    RelayWorker *workers;
+    atomic_bool is_running;
+} Relay;
+
+void relay_config_default(RelayConfig *config);
+/* Opens the sockets and starts the workers. With port 0 the kernel picks
+ * the port, which is then in relay->port. */
+int relay_start(Relay *relay, const RelayConfig *config);
+/* Stops and joins the workers and closes the sockets; the statistics stay
+ * readable until relay_destroy(). */
+void relay_stop(Relay *relay);
+void relay_destroy(Relay *relay);
+/* Sums the counters of every worker, and the latency histograms once the
+ * relay has stopped. */
+void relay_total_stats(Relay *relay, RelayWorkerStats *total);
+
+#endif
@@ -0,0 +1,302 @@
+#include "relay_load.h"
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "codec.h"
+#include "net_io.h"
+#include "rtp.h"
+#include "time_util.h"
+
+/* Media starts this long after the first joins, so every member is known
+ * to the relay, and stops this long before the end so the last packets can
+ * still arrive. */
+#define RELAY_LOAD_WARMUP_MS (200)
+#define RELAY_LOAD_DRAIN_MS (200)
+#define RELAY_LOAD_CLOCK_RATE (8000)
+
+typedef struct
+{
+    NetSocket net;
+    uint32_t ssrc;
+    uint32_t room;
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint64_t next_send_ns;
+} LoadEndpoint;
+
+typedef struct
+{
+    const RelayLoadConfig *config;
+    LoadEndpoint *endpoints;
+    int count;
+    uint64_t media_ns;
+    uint64_t stop_send_ns;
+    uint64_t end_ns;
+    RelayLoadStats stats;
+    pthread_t tid;
+} LoadThread;
+
+void relay_load_config_default(RelayLoadConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->relay.sin_family = AF_INET;
+    config->relay.sin_port = htons(RELAY_DEFAULT_PORT);
+    config->relay.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    config->calls = 500;
+    config->members = 2;
+    config->threads = 1;
+    config->ptime_ms = RELAY_LOAD_DEFAULT_PTIME_MS;
+    config->payload_bytes = RELAY_LOAD_DEFAULT_PAYLOAD;
+    config->duration_s = 10.0;
+    config->first_room = 1;
+}
+
+static void send_join(LoadEndpoint *endpoint, const struct sockaddr_in *relay)
+{
+    uint8_t join[RELAY_JOIN_SIZE];
+    size_t length =
+        relay_build_join(join, sizeof(join), endpoint->ssrc, endpoint->room);
+    const void *buffer = join;
+    net_send_batch(&endpoint->net, &buffer, &length, relay, 1);
+}
+
+/* The payload starts with the send time, in the monotonic timebase the
+ * receiver's kernel timestamps are converted to. */
+static void send_media(LoadThread *thread, LoadEndpoint *endpoint)
+{
+    const RelayLoadConfig *config = thread->config;
+    uint8_t datagram[RELAY_PACKET_MAX];
+    RtpHeader header = {endpoint->sequence++, endpoint->timestamp,
+                        endpoint->ssrc, PAYLOAD_PCMU, false};
+    endpoint->timestamp += config->ptime_ms * (RELAY_LOAD_CLOCK_RATE / 1000);
+    size_t length = rtp_write_header(datagram, &header);
+    memset(datagram + length, 0xff, config->payload_bytes);
+    uint64_t now = monotonic_ns();
+    memcpy(datagram + length, &now, sizeof(now));
+    length += config->payload_bytes;
+
+    const void *buffer = datagram;
+    if (net_send_batch(&endpoint->net, &buffer, &length, &config->relay, 1) ==
+        1)
+    {
+        thread->stats.packets_sent++;
+        thread->stats.packets_expected += config->members - 1;
+    }
+    else
+    {
+        thread->stats.send_failures++;
+    }
+}
+
+static void receive_media(LoadThread *thread, LoadEndpoint *endpoint,
+                          uint8_t (*datagrams)[RELAY_PACKET_MAX])
+{
+    void *buffers[NET_BATCH_MAX];
+    NetDatagramInfo info[NET_BATCH_MAX];
+    for (int i = 0; i < NET_BATCH_MAX; i++)
+        buffers[i] = datagrams[i];
+    int count;
+    do
+    {
+        count = net_recv_batch(&endpoint->net, buffers, RELAY_PACKET_MAX, info,
+                               NET_BATCH_MAX);
+        for (int i = 0; i < count; i++)
+        {
+            RtpHeader header;
+            size_t offset;
+            uint64_t sent_ns;
+            if (rtp_is_rtcp(datagrams[i], info[i].length) ||
+                rtp_parse_header(datagrams[i], info[i].length, &header,
+                                 &offset) < (int)sizeof(sent_ns))
+                continue;
+            memcpy(&sent_ns, datagrams[i] + offset, sizeof(sent_ns));
+            thread->stats.packets_received++;
+            if (info[i].timestamp_ns > sent_ns)
+                histogram_record(&thread->stats.latency,
+                                  info[i].timestamp_ns - sent_ns);
+        }
+    } while (count == NET_BATCH_MAX);
+}
+
+static void *load_thread_func(void *data)
+{
+    LoadThread *thread = (LoadThread *)data;
+    const RelayLoadConfig *config = thread->config;
+    uint8_t datagrams[NET_BATCH_MAX][RELAY_PACKET_MAX];
+    uint64_t ptime_ns = (uint64_t)config->ptime_ms * 1000000ull;
+    uint64_t next_join_ns = 0;
+    NetPoller poller;
+
+    if (net_poller_init(&poller) == -1)
+    {
+        perror("net_poller_init() failed");
+        return NULL;
+    }
+    int max_fd = 0;
+    for (int i = 0; i < thread->count; i++)
+    {
+        int fd = thread->endpoints[i].net.fd;
+        net_poller_add(&poller, fd);
+        if (fd > max_fd)
+            max_fd = fd;
+    }
+    LoadEndpoint **by_fd =
+        (LoadEndpoint **)calloc(max_fd + 1, sizeof(LoadEndpoint *));
+    if (!by_fd)
+    {
+        net_poller_destroy(&poller);
+        return NULL;
+    }
+    for (int i = 0; i < thread->count; i++)
+        by_fd[thread->endpoints[i].net.fd] = &thread->endpoints[i];
+
+    for (uint64_t now = monotonic_ns(); now < thread->end_ns;
+         now = monotonic_ns())
+    {
+        if (now >= next_join_ns)
+        {
+            for (int i = 0; i < thread->count; i++)
+                send_join(&thread->endpoints[i], &config->relay);
+            next_join_ns = now + (uint64_t)RELAY_JOIN_INTERVAL_MS * 1000000ull;
+        }
+        for (int i = 0; now >= thread->media_ns && now < thread->stop_send_ns &&
+                        i < thread->count;
+             i++)
+        {
+            LoadEndpoint *endpoint = &thread->endpoints[i];
+            if (endpoint->next_send_ns > now)
+                continue;
+            send_media(thread, endpoint);
+            /* A thread that falls behind skips slots rather than sending
+             * bursts; the shortfall shows in the sent rate. */
+            endpoint->next_send_ns += ptime_ns;
+            if (endpoint->next_send_ns < now)
+                endpoint->next_send_ns = now + ptime_ns;
+        }
+
+        int ready[NET_POLLER_MAX];
+        int count;
+        int timeout_ms = 1;
+        do
+        {
+            count = net_poller_wait(&poller, ready, NET_POLLER_MAX, timeout_ms);
+            for (int i = 0; i < count; i++)
+                receive_media(thread, by_fd[ready[i]], datagrams);
+            timeout_ms = 0;
+        } while (count == NET_POLLER_MAX);
+    }
+    free(by_fd);
+    net_poller_destroy(&poller);
+    return NULL;
+}
+
+/* Every simulated member needs its own socket. */
+static void raise_file_limit(int needed)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1 ||
+        limit.rlim_cur >= (rlim_t)needed)
+        return;
+    limit.rlim_cur = limit.rlim_max != RLIM_INFINITY &&
+                             limit.rlim_max < (rlim_t)needed
+                         ? limit.rlim_max
+                         : (rlim_t)needed;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1)
+        perror("setrlimit(RLIMIT_NOFILE) failed");
+}
+
+int relay_load_run(const RelayLoadConfig *config, RelayLoadStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    int members = config->members < 2 ? 2 : config->members;
+    if (members > RELAY_ROOM_MEMBERS_MAX)
+        members = RELAY_ROOM_MEMBERS_MAX;
+    int total = config->calls * members;
+    int thread_count = config->threads < 1 ? 1 : config->threads;
+    if (thread_count > RELAY_LOAD_THREADS_MAX)
+        thread_count = RELAY_LOAD_THREADS_MAX;
+    if (thread_count > total)
+        thread_count = total;
+    if (total <= 0 || config->ptime_ms <= 0 ||
+        config->payload_bytes < (int)sizeof(uint64_t) ||
+        RTP_HEADER_SIZE + config->payload_bytes > RELAY_PACKET_MAX)
+    {
+        fprintf(stderr, "Invalid relay load configuration\n");
+        return -1;
+    }
+    RelayLoadConfig run = *config;
+    run.members = members;
+    raise_file_limit(total + 64);
+
+    int result = -1;
+    int opened = 0;
+    int started = 0;
+    LoadEndpoint *endpoints =
+        (LoadEndpoint *)calloc(total, sizeof(LoadEndpoint));
+    LoadThread *threads =
+        (LoadThread *)calloc(thread_count, sizeof(LoadThread));
+    if (!endpoints || !threads)
+        goto cleanup;
+    for (; opened < total; opened++)
+    {
+        LoadEndpoint *endpoint = &endpoints[opened];
+        if (net_socket_open(&endpoint->net, 0) == -1)
+        {
+            fprintf(stderr, "Cannot open socket %d of %d\n", opened + 1,
+                    total);
+            goto cleanup;
+        }
+        endpoint->ssrc = 0x10000000u + (uint32_t)opened;
+        endpoint->room = config->first_room + (uint32_t)(opened / members);
+    }
+
+    uint64_t ptime_ns = (uint64_t)config->ptime_ms * 1000000ull;
+    uint64_t start = monotonic_ns();
+    uint64_t media_ns = start + (uint64_t)RELAY_LOAD_WARMUP_MS * 1000000ull;
+    uint64_t stop_send_ns = media_ns + (uint64_t)(config->duration_s * 1e9);
+    for (int i = 0; i < total; i++)
+        endpoints[i].next_send_ns =
+            media_ns + ptime_ns * (uint64_t)i / (uint64_t)total;
+    for (; started < thread_count; started++)
+    {
+        LoadThread *thread = &threads[started];
+        int first = (int)((int64_t)total * started / thread_count);
+        int last = (int)((int64_t)total * (started + 1) / thread_count);
+        thread->config = &run;
+        thread->endpoints = &endpoints[first];
+        thread->count = last - first;
+        thread->media_ns = media_ns;
+        thread->stop_send_ns = stop_send_ns;
+        thread->end_ns =
+            stop_send_ns + (uint64_t)RELAY_LOAD_DRAIN_MS * 1000000ull;
+        if (pthread_create(&thread->tid, NULL, load_thread_func, thread) != 0)
+        {
+            perror("pthread_create() failed");
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i].tid, NULL);
+        stats->packets_sent += threads[i].stats.packets_sent;
+        stats->packets_expected += threads[i].stats.packets_expected;
+        stats->packets_received += threads[i].stats.packets_received;
+        stats->send_failures += threads[i].stats.send_failures;
+        histogram_merge(&stats->latency, &threads[i].stats.latency);
+    }
+    stats->seconds = config->duration_s;
+    if (started == thread_count)
+        result = 0;
+
+cleanup:
+    for (int i = 0; i < opened; i++)
+        net_socket_close(&endpoints[i].net);
+    free(endpoints);
+    free(threads);
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef RELAY_LOAD_H
+#define RELAY_LOAD_H
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include "relay.h"
+
+#define RELAY_LOAD_DEFAULT_PTIME_MS (20)
+/* A 20 ms G.711 frame. */
+#define RELAY_LOAD_DEFAULT_PAYLOAD (160)
+#define RELAY_LOAD_THREADS_MAX (64)
+
+/* Simulated calls through a relay: every member of every call has its own
+ * UDP socket, joins its room and sends one RTP packet per ptime carrying
+ * its send time, which the other members turn into an end-to-end
+ * latency. */
+typedef struct
+{
+    struct sockaddr_in relay;
+    int calls;
+    int members;
+    int threads;
+    int ptime_ms;
+    int payload_bytes;
+    double duration_s;
+    uint32_t first_room;
+} RelayLoadConfig;
+
+typedef struct
+{
+    uint64_t packets_sent;
+    uint64_t packets_expected;
+    uint64_t packets_received;
+    uint64_t send_failures;
+    double seconds;
+    Histogram latency;
+} RelayLoadStats;
+
+void relay_load_config_default(RelayLoadConfig *config);
+/* Runs the calls for config->duration_s and sums what every thread saw.
+ * Returns -1 if the sockets or threads could not be set up. */
+int relay_load_run(const RelayLoadConfig *config, RelayLoadStats *stats);
+
+#endif
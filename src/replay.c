@@ -0,0 +1,168 @@
+#include "replay.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "packet_pool.h"
+#include "time_util.h"
+#include "unpack.h"
+
+#define REPLAY_CHECKSUM_BASIS (1469598103934665603ull)
+#define REPLAY_CHECKSUM_PRIME (1099511628211ull)
+
+typedef struct
+{
+    JitterBuffer jb;
+    WavWriter *output;
+    ReplayStats *stats;
+    int frame_size;
+} ReplayPlayer;
+
+static void play_frame(ReplayPlayer *player)
+{
+    SAMPLE out[AUDIO_FRAME_MAX];
+    jitter_buffer_get(&player->jb, out, player->frame_size);
+    for (int i = 0; i < player->frame_size; i++)
+        player->stats->checksum = (player->stats->checksum ^ (uint16_t)out[i]) *
+                                  REPLAY_CHECKSUM_PRIME;
+    if (player->output)
+        wav_writer_write(player->output, out, player->frame_size);
+    player->stats->frames_played++;
+}
+
+/* Follows the packet size the sender announces, as the call does. */
+static void follow_format(ReplayPlayer *player, RtpSession *rtp)
+{
+    int rate, packet_samples;
+    if (!rtp_session_take_format(rtp, &rate, &packet_samples))
+        return;
+    if (rate != player->jb.config.sample_rate)
+    {
+        fprintf(stderr, "[REPLAY] The stream is %d Hz audio, but the replay "
+                        "runs at %d Hz\n",
+                rate, player->jb.config.sample_rate);
+        return;
+    }
+    if (packet_samples > 0 && packet_samples <= AUDIO_PACKET_SAMPLES_MAX &&
+        jitter_buffer_set_frame_size(&player->jb, packet_samples) == 0)
+        printf("[REPLAY] Stream sends %.1f ms packets (%d samples).\n",
+               1000.0 * packet_samples / rate, packet_samples);
+}
+
+void replay_config_default(ReplayConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    jitter_buffer_config_default(&config->jb_config);
+    config->frame_size = FRAMES_PER_BUFFER;
+}
+
+int replay_run(const ReplayConfig *config, CaptureReader *reader,
+               WavWriter *output, ReplayStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->checksum = REPLAY_CHECKSUM_BASIS;
+    stats->ssrc = config->ssrc;
+    int rate = config->jb_config.sample_rate;
+    ReplayPlayer player;
+    player.output = output;
+    player.stats = stats;
+    player.frame_size = config->frame_size;
+    if (player.frame_size <= 0 || player.frame_size > AUDIO_FRAME_MAX ||
+        jitter_buffer_init(&player.jb, &config->jb_config) == -1)
+    {
+        fprintf(stderr, "jitter_buffer_init() failed\n");
+        return -1;
+    }
+    PacketPool pool;
+    if (packet_pool_init(&pool, config->jb_config.slot_count + 1) == -1)
+    {
+        fprintf(stderr, "packet_pool_init() failed\n");
+        jitter_buffer_destroy(&player.jb);
+        return -1;
+    }
+    RtpSession rtp;
+    rtp_session_init(&rtp, rate, config->jb_config.frame_size);
+
+    /* The same frame period as the lockstep call's virtual clock. */
+    uint64_t frame_ns = (uint64_t)player.frame_size * 1000000000ull / rate;
+    uint64_t start_ns = 0;
+    bool started = false;
+    int result = 0;
+    uint64_t wall_start = monotonic_ns();
+    for (;;)
+    {
+        PacketBuffer *buffer = packet_pool_acquire(&pool);
+        if (!buffer)
+        {
+            /* Every buffer is held by a frame waiting to be played. */
+            play_frame(&player);
+            continue;
+        }
+        CapturedDatagram info;
+        int length = capture_reader_next(reader, buffer->data,
+                                         PACKET_BUFFER_SIZE, &info);
+        if (length <= 0)
+        {
+            packet_buffer_release(buffer);
+            result = length;
+            break;
+        }
+        stats->datagrams++;
+        uint32_t ssrc = rtp_sender_ssrc(buffer->data, length);
+        bool media = unpack_is_media(buffer->data, length);
+        if ((config->port != 0 && info.to_port != config->port) ||
+            (stats->ssrc != 0 && ssrc != stats->ssrc) ||
+            (!media && !rtp_is_rtcp(buffer->data, length)))
+        {
+            stats->skipped++;
+            packet_buffer_release(buffer);
+            continue;
+        }
+        if (!media)
+        {
+            stats->rtcp_packets++;
+            AudioPacket packets[RED_MAX_BLOCKS];
+            unpack_datagram(&rtp, buffer, length, info.time_ns, info.time_ns,
+                            packets);
+            follow_format(&player, &rtp);
+            packet_buffer_release(buffer);
+            continue;
+        }
+        if (stats->ssrc == 0)
+            stats->ssrc = ssrc;
+        if (!started)
+        {
+            start_ns = info.time_ns;
+            started = true;
+        }
+        while (start_ns + stats->frames_played * frame_ns < info.time_ns)
+            play_frame(&player);
+        AudioPacket packets[RED_MAX_BLOCKS];
+        int frames = unpack_datagram(&rtp, buffer, length, info.time_ns,
+                                     info.time_ns, packets);
+        for (int i = 0; i < frames; i++)
+            jitter_buffer_put(&player.jb, &packets[i], info.time_ns);
+        packet_buffer_release(buffer);
+        stats->media_packets++;
+    }
+
+    JitterBufferStats jb_stats;
+    jitter_buffer_get_stats(&player.jb, &jb_stats);
+    int tail = (int)ceil(jb_stats.current_delay_ms * rate / 1000.0 /
+                         player.frame_size);
+    for (int i = 0; i < tail; i++)
+        play_frame(&player);
+    stats->elapsed_seconds = (monotonic_ns() - wall_start) / 1e9;
+    stats->audio_seconds =
+        (double)stats->frames_played * player.frame_size / rate;
+    jitter_buffer_get_stats(&player.jb, &stats->jb);
+    rtp_session_get_stats(&rtp, &stats->rtp);
+    rtp_session_destroy(&rtp);
+    jitter_buffer_destroy(&player.jb);
+    packet_pool_destroy(&pool);
+    if (result < 0)
+        fprintf(stderr, "The capture is damaged after %llu datagrams\n",
+                (unsigned long long)stats->datagrams);
+    return result;
+}
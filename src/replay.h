@@ -0,0 +1,51 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+#include "capture.h"
+#include "jitter_buffer.h"
+#include "rtp.h"
+#include "wav_file.h"
+
+typedef struct
+{
+    /* sample_rate is the rate of the stream; frame_size its packet size
+     * until the sender announces one. */
+    JitterBufferConfig jb_config;
+    /* Samples played per frame, as the receiving phone's DSP thread did. */
+    int frame_size;
+    /* The stream to replay; 0 takes the first one heard. */
+    uint32_t ssrc;
+    /* Only datagrams sent to this port, or to any with 0. */
+    int port;
+} ReplayConfig;
+
+typedef struct
+{
+    uint32_t ssrc;
+    uint64_t datagrams;
+    uint64_t media_packets;
+    uint64_t rtcp_packets;
+    uint64_t skipped;
+    uint64_t frames_played;
+    double audio_seconds;
+    double elapsed_seconds;
+    /* FNV-1a over every sample played, to compare runs at a glance. */
+    uint64_t checksum;
+    JitterBufferStats jb;
+    RtpStats rtp;
+} ReplayStats;
+
+void replay_config_default(ReplayConfig *config);
+/* Feeds a capture through the receive path and a jitter buffer on a
+ * virtual clock, as fast as it can. The clock starts with the first media
+ * packet and plays one frame whenever it passes the next frame time, then
+ * hands over each packet at its captured arrival time, the order the
+ * lockstep call uses; RTCP is processed where it was captured and only
+ * changes the stream format. Once the capture ends, what is still buffered
+ * is played out. Every frame played goes to output unless it is NULL. */
+int replay_run(const ReplayConfig *config, CaptureReader *reader,
+               WavWriter *output, ReplayStats *stats);
+
+#endif
@@ -0,0 +1,133 @@
+#include "resampler.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp_kernels.h"
+
+#define RESAMPLER_ONE (16384)
+#define RESAMPLER_KAISER_BETA (8.0)
+
+/* One extra phase, a whole sample on, so every fractional position has a
+ * phase on either side. */
+static int16_t filter[RESAMPLER_PHASES + 1][RESAMPLER_TAPS];
+static pthread_once_t filter_once = PTHREAD_ONCE_INIT;
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+/* The cutoff is at Nyquist, so the sinc is zero at every other whole
+ * sample and phase 0 is a plain delay. Each phase is scaled to unity gain
+ * at DC after rounding. */
+static void build_filter(void)
+{
+    double half = RESAMPLER_TAPS / 2;
+    for (int p = 0; p <= RESAMPLER_PHASES; p++)
+    {
+        double frac = (double)p / RESAMPLER_PHASES;
+        double taps[RESAMPLER_TAPS];
+        double sum = 0.0;
+        for (int j = 0; j < RESAMPLER_TAPS; j++)
+        {
+            double t = j - (half - 1) - frac;
+            double sinc = t == 0.0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            double r = t / half;
+            double window = r * r < 1.0
+                                ? bessel_i0(RESAMPLER_KAISER_BETA *
+                                            sqrt(1.0 - r * r)) /
+                                      bessel_i0(RESAMPLER_KAISER_BETA)
+                                : 0.0;
+            taps[j] = sinc * window;
+            sum += taps[j];
+        }
+        int total = 0, peak = 0;
+        for (int j = 0; j < RESAMPLER_TAPS; j++)
+        {
+            filter[p][j] = (int16_t)lrint(taps[j] / sum * RESAMPLER_ONE);
+            total += filter[p][j];
+            if (filter[p][j] > filter[p][peak])
+                peak = j;
+        }
+        filter[p][peak] += RESAMPLER_ONE - total;
+    }
+}
+
+int resampler_init(Resampler *rs, int max_input)
+{
+    pthread_once(&filter_once, build_filter);
+    rs->capacity = RESAMPLER_TAPS + max_input * 2;
+    rs->history = (SAMPLE *)malloc(rs->capacity * sizeof(SAMPLE));
+    if (!rs->history)
+        return -1;
+    resampler_reset(rs);
+    return 0;
+}
+
+void resampler_destroy(Resampler *rs)
+{
+    free(rs->history);
+    rs->history = NULL;
+}
+
+/* Starts over from silence, RESAMPLER_DELAY - 1 samples of it ahead of the
+ * first output position. */
+void resampler_reset(Resampler *rs)
+{
+    rs->length = RESAMPLER_DELAY - 1;
+    memset(rs->history, 0, rs->length * sizeof(SAMPLE));
+    rs->position = 0.0;
+}
+
+int resampler_process(Resampler *rs, const SAMPLE *in, int in_len,
+                      SAMPLE *out, int out_capacity, double ratio)
+{
+    if (in_len > rs->capacity - rs->length)
+        in_len = rs->capacity - rs->length;
+    memcpy(rs->history + rs->length, in, in_len * sizeof(SAMPLE));
+    rs->length += in_len;
+
+    int count = 0;
+    while (count < out_capacity)
+    {
+        int base = (int)rs->position;
+        if (base + RESAMPLER_TAPS > rs->length)
+            break;
+        double phase_position = (rs->position - base) * RESAMPLER_PHASES;
+        int phase = (int)phase_position;
+        int64_t weight = (int64_t)((phase_position - phase) * 65536.0);
+        const SAMPLE *window = rs->history + base;
+        int64_t a = dsp_dot_product(window, filter[phase], RESAMPLER_TAPS);
+        int64_t b =
+            dsp_dot_product(window, filter[phase + 1], RESAMPLER_TAPS);
+        /* Q14 taps times a Q16 weight: round away the 30 fraction bits. */
+        int64_t y = (a * (65536 - weight) + b * weight + (1ll << 29)) >> 30;
+        if (y > 32767)
+            y = 32767;
+        if (y < -32768)
+            y = -32768;
+        out[count++] = (SAMPLE)y;
+        rs->position += ratio;
+    }
+
+    int consumed = (int)rs->position;
+    if (consumed > rs->length)
+        consumed = rs->length;
+    rs->length -= consumed;
+    memmove(rs->history, rs->history + consumed,
+            rs->length * sizeof(SAMPLE));
+    rs->position -= consumed;
+    return count;
+}
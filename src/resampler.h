@@ -0,0 +1,36 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "audio_config.h"
+
+#define RESAMPLER_TAPS (32)
+#define RESAMPLER_PHASES (128)
+/* Output lags input by this many samples. */
+#define RESAMPLER_DELAY (RESAMPLER_TAPS / 2)
+
+/* Streaming fractional resampler for small, slowly changing rate
+ * corrections. Each output sample is a 32-tap Kaiser-windowed sinc
+ * interpolation, with the fractional position resolved to one of 128
+ * precomputed filter phases and linearly interpolated between the two
+ * nearest. The taps are Q14 integers, so the work is two dsp_dot_product()
+ * calls per sample. At a ratio of exactly 1 the output is the input,
+ * delayed by RESAMPLER_DELAY samples. */
+typedef struct
+{
+    SAMPLE *history;
+    int capacity;
+    int length;
+    double position;
+} Resampler;
+
+/* max_input is the most samples a single resampler_process() call adds. */
+int resampler_init(Resampler *rs, int max_input);
+void resampler_destroy(Resampler *rs);
+void resampler_reset(Resampler *rs);
+/* Appends in and produces output samples, each ratio input samples after
+ * the last, until the input runs out or out is full. Returns the number
+ * written: about in_len / ratio. */
+int resampler_process(Resampler *rs, const SAMPLE *in, int in_len,
+                      SAMPLE *out, int out_capacity, double ratio);
+
+#endif
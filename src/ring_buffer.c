@@ -0,0 +1,91 @@
+#include "ring_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static size_t next_power_of_two(size_t n)
+{
+    size_t size = 1;
+    while (size < n)
+        size <<= 1;
+    return size;
+}
+
+int rb_init(RingBuffer *rb, size_t min_size)
+{
+    rb->size = next_power_of_two(min_size);
+    rb->mask = rb->size - 1;
+    rb->buffer = (SAMPLE *)calloc(rb->size, sizeof(SAMPLE));
+    atomic_init(&rb->write_pos, 0);
+    atomic_init(&rb->read_pos, 0);
+    return rb->buffer ? 0 : -1;
+}
+
+void rb_destroy(RingBuffer *rb)
+{
+    free(rb->buffer);
+    rb->buffer = NULL;
+}
+
+void rb_clear(RingBuffer *rb)
+{
+    atomic_store(&rb->read_pos, atomic_load(&rb->write_pos));
+}
+
+size_t rb_available_read(RingBuffer *rb)
+{
+    size_t write_pos = atomic_load_explicit(&rb->write_pos, memory_order_acquire);
+    size_t read_pos = atomic_load_explicit(&rb->read_pos, memory_order_relaxed);
+    return write_pos - read_pos;
+}
+
+size_t rb_available_write(RingBuffer *rb)
+{
+    size_t read_pos = atomic_load_explicit(&rb->read_pos, memory_order_acquire);
+    size_t write_pos = atomic_load_explicit(&rb->write_pos, memory_order_relaxed);
+    return rb->size - (write_pos - read_pos);
+}
+
+size_t rb_write(RingBuffer *rb, const SAMPLE *data, size_t count)
+{
+    size_t write_pos = atomic_load_explicit(&rb->write_pos, memory_order_relaxed);
+    size_t read_pos = atomic_load_explicit(&rb->read_pos, memory_order_acquire);
+    size_t free_space = rb->size - (write_pos - read_pos);
+    if (count > free_space)
+        count = free_space;
+    if (count == 0)
+        return 0;
+
+    size_t start = write_pos & rb->mask;
+    size_t first = rb->size - start;
+    if (first > count)
+        first = count;
+    memcpy(rb->buffer + start, data, first * sizeof(SAMPLE));
+    memcpy(rb->buffer, data + first, (count - first) * sizeof(SAMPLE));
+
+    atomic_store_explicit(&rb->write_pos, write_pos + count,
+                          memory_order_release);
+    return count;
+}
+
+size_t rb_read(RingBuffer *rb, SAMPLE *data, size_t count)
+{
+    size_t read_pos = atomic_load_explicit(&rb->read_pos, memory_order_relaxed);
+    size_t write_pos = atomic_load_explicit(&rb->write_pos, memory_order_acquire);
+    size_t available = write_pos - read_pos;
+    if (count > available)
+        count = available;
+    if (count == 0)
+        return 0;
+
+    size_t start = read_pos & rb->mask;
+    size_t first = rb->size - start;
+    if (first > count)
+        first = count;
+    memcpy(data, rb->buffer + start, first * sizeof(SAMPLE));
+    memcpy(data + first, rb->buffer, (count - first) * sizeof(SAMPLE));
+
+    atomic_store_explicit(&rb->read_pos, read_pos + count,
+                          memory_order_release);
+    return count;
+}
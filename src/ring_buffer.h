@@ -0,0 +1,34 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "audio_config.h"
+
+#define RB_CACHE_LINE (64)
+
+/* Single-producer/single-consumer ring. The producer only calls rb_write()
+ * and rb_available_write(), the consumer only rb_read() and
+ * rb_available_read(); neither side ever blocks. */
+typedef struct
+{
+    SAMPLE *buffer;
+    size_t size;
+    size_t mask;
+    alignas(RB_CACHE_LINE) atomic_size_t write_pos;
+    alignas(RB_CACHE_LINE) atomic_size_t read_pos;
+} RingBuffer;
+
+/* Returns -1 if the ring cannot be allocated. */
+int rb_init(RingBuffer *rb, size_t min_size);
+void rb_destroy(RingBuffer *rb);
+/* Discards what is queued; only while neither side is using the ring. */
+void rb_clear(RingBuffer *rb);
+size_t rb_available_read(RingBuffer *rb);
+size_t rb_available_write(RingBuffer *rb);
+size_t rb_write(RingBuffer *rb, const SAMPLE *data, size_t count);
+size_t rb_read(RingBuffer *rb, SAMPLE *data, size_t count);
+
+#endif
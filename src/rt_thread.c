@@ -0,0 +1,44 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "rt_thread.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+int rt_thread_set_fifo(pthread_t thread, int priority)
+{
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    if (err != 0)
+    {
+        fprintf(stderr, "[RT] SCHED_FIFO priority %d unavailable: %s\n",
+                priority, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+int rt_thread_pin_cpu(pthread_t thread, int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err != 0)
+    {
+        fprintf(stderr, "[RT] Cannot pin thread to CPU %d: %s\n", cpu,
+                strerror(err));
+        return -1;
+    }
+    return 0;
+#else
+    fprintf(stderr, "[RT] CPU pinning is not supported on this platform\n");
+    return -1;
+#endif
+}
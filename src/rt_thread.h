@@ -0,0 +1,11 @@
+#ifndef RT_THREAD_H
+#define RT_THREAD_H
+
+#include <pthread.h>
+
+/* Both calls are best effort: they return -1 (and leave the thread as it
+ * was) when the platform or the process's privileges do not allow it. */
+int rt_thread_set_fifo(pthread_t thread, int priority);
+int rt_thread_pin_cpu(pthread_t thread, int cpu);
+
+#endif
@@ -0,0 +1,543 @@
+#include "rtp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "time_util.h"
+
+#define RTP_SEQ_MOD (1u << 16)
+#define RTP_MAX_DROPOUT (3000)
+#define RTP_MAX_MISORDER (100)
+#define RTCP_SR (200)
+#define RTCP_RR (201)
+#define RTCP_SDES (202)
+#define RTCP_APP (204)
+#define RTCP_FORMAT_NAME "FMT "
+#define RTCP_SDES_CNAME (1)
+#define RTCP_REPORT_BLOCK_SIZE (24)
+#define NTP_UNIX_OFFSET (2208988800ull)
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void ntp_from_realtime(uint64_t ns, uint32_t *seconds,
+                              uint32_t *fraction)
+{
+    *seconds = (uint32_t)(ns / 1000000000ull + NTP_UNIX_OFFSET);
+    *fraction = (uint32_t)(((ns % 1000000000ull) << 32) / 1000000000ull);
+}
+
+size_t rtp_write_header(uint8_t *buffer, const RtpHeader *header)
+{
+    buffer[0] = RTP_VERSION << 6;
+    buffer[1] = (uint8_t)((header->marker ? 0x80 : 0) |
+                          (header->payload_type & 0x7f));
+    put_u16(buffer + 2, header->sequence_number);
+    put_u32(buffer + 4, header->timestamp);
+    put_u32(buffer + 8, header->ssrc);
+    return RTP_HEADER_SIZE;
+}
+
+int rtp_parse_header(const uint8_t *buffer, size_t length, RtpHeader *header,
+                     size_t *payload_offset)
+{
+    if (length < RTP_HEADER_SIZE || (buffer[0] >> 6) != RTP_VERSION)
+        return -1;
+    size_t offset = RTP_HEADER_SIZE + 4 * (buffer[0] & 0x0f);
+    if (buffer[0] & 0x10)
+    {
+        if (length < offset + 4)
+            return -1;
+        offset += 4 + 4 * (size_t)get_u16(buffer + offset + 2);
+    }
+    size_t padding = 0;
+    if (buffer[0] & 0x20)
+        padding = buffer[length - 1];
+    if (length < offset + padding)
+        return -1;
+    header->marker = (buffer[1] & 0x80) != 0;
+    header->payload_type = buffer[1] & 0x7f;
+    header->sequence_number = get_u16(buffer + 2);
+    header->timestamp = get_u32(buffer + 4);
+    header->ssrc = get_u32(buffer + 8);
+    *payload_offset = offset;
+    return (int)(length - offset - padding);
+}
+
+size_t rtp_write_capture_time(uint8_t *buffer, uint64_t sent_wall_ns,
+                              uint32_t sender_delay_us)
+{
+    uint8_t *ext = buffer + RTP_HEADER_SIZE;
+    uint32_t seconds;
+    uint32_t fraction;
+    buffer[0] |= 0x10;
+    put_u16(ext, RTP_EXT_ONE_BYTE_PROFILE);
+    put_u16(ext + 2, (RTP_EXT_CAPTURE_SIZE - 4) / 4);
+    ext[4] = (RTP_EXT_CAPTURE_ID << 4) | (12 - 1);
+    ntp_from_realtime(sent_wall_ns, &seconds, &fraction);
+    put_u32(ext + 5, seconds);
+    put_u32(ext + 9, fraction);
+    put_u32(ext + 13, sender_delay_us);
+    memset(ext + 17, 0, RTP_EXT_CAPTURE_SIZE - 17);
+    return RTP_HEADER_SIZE + RTP_EXT_CAPTURE_SIZE;
+}
+
+bool rtp_read_capture_time(const uint8_t *buffer, size_t length,
+                           uint64_t *sent_wall_ns, uint32_t *sender_delay_us)
+{
+    if (length < RTP_HEADER_SIZE || !(buffer[0] & 0x10))
+        return false;
+    size_t offset = RTP_HEADER_SIZE + 4 * (buffer[0] & 0x0f);
+    if (length < offset + 4 ||
+        get_u16(buffer + offset) != RTP_EXT_ONE_BYTE_PROFILE)
+        return false;
+    size_t end = offset + 4 + 4 * (size_t)get_u16(buffer + offset + 2);
+    if (end > length)
+        return false;
+    for (offset += 4; offset < end;)
+    {
+        uint8_t id = buffer[offset] >> 4;
+        size_t size = (buffer[offset] & 0x0f) + 1;
+        if (buffer[offset] == 0)
+        {
+            offset++;
+            continue;
+        }
+        if (id == 15 || offset + 1 + size > end)
+            return false;
+        if (id == RTP_EXT_CAPTURE_ID && size == 12)
+        {
+            const uint8_t *data = buffer + offset + 1;
+            uint64_t seconds = get_u32(data);
+            uint64_t fraction = get_u32(data + 4);
+            if (seconds < NTP_UNIX_OFFSET)
+                return false;
+            *sent_wall_ns = (seconds - NTP_UNIX_OFFSET) * 1000000000ull +
+                            ((fraction * 1000000000ull) >> 32);
+            *sender_delay_us = get_u32(data + 8);
+            return true;
+        }
+        offset += 1 + size;
+    }
+    return false;
+}
+
+bool rtp_is_rtcp(const uint8_t *buffer, size_t length)
+{
+    return length >= 8 && (buffer[0] >> 6) == RTP_VERSION &&
+           buffer[1] >= RTCP_SR && buffer[1] <= RTCP_APP;
+}
+
+uint32_t rtp_sender_ssrc(const uint8_t *buffer, size_t length)
+{
+    if (rtp_is_rtcp(buffer, length))
+        return get_u32(buffer + 4);
+    if (length < RTP_HEADER_SIZE || (buffer[0] >> 6) != RTP_VERSION)
+        return 0;
+    return get_u32(buffer + 8);
+}
+
+static uint32_t random32(void)
+{
+    static uint64_t state;
+    if (state == 0)
+        state = monotonic_ns() ^ ((uint64_t)getpid() << 32);
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (uint32_t)(z ^ (z >> 31));
+}
+
+static void ntp_now(uint64_t monotonic_at, uint32_t *seconds,
+                    uint32_t *fraction)
+{
+    ntp_from_realtime(realtime_at(monotonic_at), seconds, fraction);
+}
+
+static uint32_t ntp_middle(uint32_t seconds, uint32_t fraction)
+{
+    return (seconds << 16) | (fraction >> 16);
+}
+
+static void schedule_report(RtpSession *session, uint64_t now_ns,
+                            double scale)
+{
+    /* RFC 3550 6.3.1: randomize to [0.5, 1.5] of the interval so that
+     * reports from many participants do not synchronize. */
+    double factor = 0.5 + (random32() & 0xffff) / 65536.0;
+    session->next_report_ns =
+        now_ns + (uint64_t)(RTCP_INTERVAL_MS * 1e6 * factor * scale);
+}
+
+void rtp_session_init(RtpSession *session, int clock_rate,
+                      int packet_samples)
+{
+    memset(session, 0, sizeof(*session));
+    session->clock_rate = clock_rate;
+    session->packet_samples = packet_samples;
+    session->ssrc = random32();
+    session->next_sequence = (uint16_t)random32();
+    session->next_timestamp = random32();
+    char host[RTP_CNAME_MAX - 16];
+    if (gethostname(host, sizeof(host)) != 0)
+        snprintf(host, sizeof(host), "localhost");
+    host[sizeof(host) - 1] = '\0';
+    snprintf(session->cname, sizeof(session->cname), "voip_phone@%s", host);
+    schedule_report(session, monotonic_ns(), 0.5);
+    pthread_mutex_init(&session->mutex, NULL);
+}
+
+void rtp_session_destroy(RtpSession *session)
+{
+    pthread_mutex_destroy(&session->mutex);
+}
+
+void rtp_session_next_header(RtpSession *session, uint8_t payload_type,
+                             int frames, RtpHeader *header)
+{
+    pthread_mutex_lock(&session->mutex);
+    header->sequence_number = session->next_sequence++;
+    header->timestamp = session->next_timestamp;
+    header->ssrc = session->ssrc;
+    header->payload_type = payload_type;
+    header->marker = false;
+    session->next_timestamp += (uint32_t)frames;
+    pthread_mutex_unlock(&session->mutex);
+}
+
+void rtp_session_skip(RtpSession *session, int frames)
+{
+    pthread_mutex_lock(&session->mutex);
+    session->next_timestamp += (uint32_t)frames;
+    pthread_mutex_unlock(&session->mutex);
+}
+
+void rtp_session_on_sent(RtpSession *session, const RtpHeader *header,
+                         size_t payload_bytes, uint64_t now_ns)
+{
+    pthread_mutex_lock(&session->mutex);
+    session->packets_sent++;
+    session->octets_sent += payload_bytes;
+    session->last_rtp_timestamp = header->timestamp;
+    session->last_send_ns = now_ns;
+    session->sent_since_report = true;
+    pthread_mutex_unlock(&session->mutex);
+}
+
+static void init_seq(RtpSession *session, uint16_t seq)
+{
+    session->base_seq = seq;
+    session->max_seq = seq;
+    session->bad_seq = RTP_SEQ_MOD + 1;
+    session->cycles = 0;
+    session->received = 0;
+    session->received_prior = 0;
+    session->expected_prior = 0;
+    session->have_transit = false;
+    session->jitter = 0.0;
+}
+
+/* RFC 3550 A.1 without the probation period: a call has a single source, so
+ * its first packet is accepted as is. */
+static void update_seq(RtpSession *session, uint16_t seq)
+{
+    uint16_t udelta = (uint16_t)(seq - session->max_seq);
+    if (udelta < RTP_MAX_DROPOUT)
+    {
+        if (seq < session->max_seq)
+            session->cycles += RTP_SEQ_MOD;
+        session->max_seq = seq;
+    }
+    else if (udelta <= RTP_SEQ_MOD - RTP_MAX_MISORDER)
+    {
+        if (seq == session->bad_seq)
+            init_seq(session, seq);
+        else
+            session->bad_seq = (seq + 1) & (RTP_SEQ_MOD - 1);
+    }
+    session->received++;
+}
+
+uint32_t rtp_session_on_received(RtpSession *session,
+                                 const RtpHeader *header,
+                                 uint64_t arrival_ns)
+{
+    pthread_mutex_lock(&session->mutex);
+    if (!session->have_source || header->ssrc != session->remote_ssrc)
+    {
+        session->have_source = true;
+        session->remote_ssrc = header->ssrc;
+        session->last_sr = 0;
+        init_seq(session, header->sequence_number);
+    }
+    update_seq(session, header->sequence_number);
+
+    int64_t arrival =
+        (int64_t)((double)arrival_ns * session->clock_rate / 1e9);
+    int64_t transit = arrival - (int64_t)header->timestamp;
+    if (session->have_transit)
+    {
+        int64_t d = transit - session->transit;
+        if (d < 0)
+            d = -d;
+        session->jitter += ((double)d - session->jitter) / 16.0;
+    }
+    session->transit = transit;
+    session->have_transit = true;
+
+    uint32_t extended = (session->cycles | session->max_seq) +
+                        (int16_t)(header->sequence_number - session->max_seq);
+    pthread_mutex_unlock(&session->mutex);
+    return extended;
+}
+
+static void handle_report_block(RtpSession *session, const uint8_t *block,
+                                uint64_t arrival_ns)
+{
+    if (get_u32(block) != session->ssrc)
+        return;
+    int32_t lost = (int32_t)(get_u32(block + 4) << 8) >> 8;
+    session->remote.remote_fraction_lost = block[4] / 256.0;
+    session->remote.remote_packets_lost = lost;
+    session->remote.remote_jitter_ms =
+        get_u32(block + 12) * 1000.0 / session->clock_rate;
+    session->remote.have_remote_report = true;
+
+    uint32_t lsr = get_u32(block + 16);
+    uint32_t dlsr = get_u32(block + 20);
+    if (lsr == 0)
+        return;
+    uint32_t seconds, fraction;
+    ntp_now(arrival_ns, &seconds, &fraction);
+    int32_t rtt = (int32_t)(ntp_middle(seconds, fraction) - lsr - dlsr);
+    if (rtt < 0)
+        return;
+    session->remote.rtt_ms = rtt * 1000.0 / 65536.0;
+    session->remote.have_rtt = true;
+}
+
+void rtp_session_on_rtcp(RtpSession *session, const uint8_t *buffer,
+                         size_t length, uint64_t arrival_ns)
+{
+    pthread_mutex_lock(&session->mutex);
+    size_t offset = 0;
+    while (offset + 8 <= length)
+    {
+        const uint8_t *packet = buffer + offset;
+        size_t packet_length = 4 * ((size_t)get_u16(packet + 2) + 1);
+        if ((packet[0] >> 6) != RTP_VERSION || offset + packet_length > length)
+            break;
+        int count = packet[0] & 0x1f;
+        size_t blocks = 0;
+        if (packet[1] == RTCP_SR && packet_length >= 28)
+        {
+            if (get_u32(packet + 4) == session->remote_ssrc)
+            {
+                session->last_sr =
+                    ntp_middle(get_u32(packet + 8), get_u32(packet + 12));
+                session->last_sr_arrival_ns = arrival_ns;
+            }
+            blocks = 28;
+        }
+        else if (packet[1] == RTCP_RR)
+        {
+            blocks = 8;
+        }
+        else if (packet[1] == RTCP_APP && packet_length >= RTCP_FORMAT_SIZE &&
+                 memcmp(packet + 8, RTCP_FORMAT_NAME, 4) == 0)
+        {
+            int clock_rate = (int)get_u32(packet + 12);
+            int packet_samples = (int)get_u32(packet + 16);
+            if (clock_rate != session->remote_clock_rate ||
+                packet_samples != session->remote_packet_samples)
+                session->format_pending = true;
+            session->remote_clock_rate = clock_rate;
+            session->remote_packet_samples = packet_samples;
+        }
+        for (int i = 0; blocks && i < count; i++)
+        {
+            size_t block = blocks + (size_t)i * RTCP_REPORT_BLOCK_SIZE;
+            if (block + RTCP_REPORT_BLOCK_SIZE > packet_length)
+                break;
+            handle_report_block(session, packet + block, arrival_ns);
+        }
+        offset += packet_length;
+    }
+    pthread_mutex_unlock(&session->mutex);
+}
+
+bool rtp_session_report_due(RtpSession *session, uint64_t now_ns)
+{
+    pthread_mutex_lock(&session->mutex);
+    bool due = now_ns >= session->next_report_ns;
+    pthread_mutex_unlock(&session->mutex);
+    return due;
+}
+
+static uint64_t expected_packets(const RtpSession *session)
+{
+    uint32_t extended_max = session->cycles + session->max_seq;
+    return (uint64_t)(extended_max - session->base_seq) + 1;
+}
+
+/* RFC 3550 A.3 */
+static size_t write_report_block(RtpSession *session, uint8_t *p,
+                                 uint64_t now_ns)
+{
+    uint64_t expected = expected_packets(session);
+    int64_t lost = (int64_t)expected - (int64_t)session->received;
+    if (lost > 0x7fffff)
+        lost = 0x7fffff;
+    else if (lost < -0x800000)
+        lost = -0x800000;
+    uint64_t expected_interval = expected - session->expected_prior;
+    uint64_t received_interval = session->received - session->received_prior;
+    int64_t lost_interval =
+        (int64_t)expected_interval - (int64_t)received_interval;
+    session->expected_prior = expected;
+    session->received_prior = session->received;
+    uint8_t fraction = 0;
+    if (expected_interval > 0 && lost_interval > 0)
+        fraction = (uint8_t)((lost_interval << 8) / expected_interval);
+    session->interval_fraction_lost = fraction / 256.0;
+
+    uint32_t dlsr = 0;
+    if (session->last_sr != 0)
+        dlsr = (uint32_t)((now_ns - session->last_sr_arrival_ns) * 65536 /
+                          1000000000ull);
+    put_u32(p, session->remote_ssrc);
+    put_u32(p + 4, ((uint32_t)fraction << 24) | ((uint32_t)lost & 0xffffff));
+    put_u32(p + 8, session->cycles + session->max_seq);
+    put_u32(p + 12, (uint32_t)session->jitter);
+    put_u32(p + 16, session->last_sr);
+    put_u32(p + 20, dlsr);
+    return RTCP_REPORT_BLOCK_SIZE;
+}
+
+static size_t write_format(const RtpSession *session, uint8_t *p)
+{
+    p[0] = RTP_VERSION << 6;
+    p[1] = RTCP_APP;
+    put_u16(p + 2, RTCP_FORMAT_SIZE / 4 - 1);
+    put_u32(p + 4, session->ssrc);
+    memcpy(p + 8, RTCP_FORMAT_NAME, 4);
+    put_u32(p + 12, (uint32_t)session->clock_rate);
+    put_u32(p + 16, (uint32_t)session->packet_samples);
+    return RTCP_FORMAT_SIZE;
+}
+
+size_t rtp_session_build_report(RtpSession *session, uint8_t *buffer,
+                                size_t capacity, uint64_t now_ns)
+{
+    size_t cname_length = strlen(session->cname);
+    size_t sdes_length = (8 + 2 + cname_length + 4) & ~(size_t)3;
+    if (capacity <
+        28 + RTCP_REPORT_BLOCK_SIZE + sdes_length + RTCP_FORMAT_SIZE)
+        return 0;
+
+    pthread_mutex_lock(&session->mutex);
+    uint8_t *p = buffer;
+    int blocks = session->have_source ? 1 : 0;
+    bool sender = session->sent_since_report;
+    size_t length = sender ? 28 : 8;
+    p[0] = (uint8_t)((RTP_VERSION << 6) | blocks);
+    p[1] = sender ? RTCP_SR : RTCP_RR;
+    put_u32(p + 4, session->ssrc);
+    if (sender)
+    {
+        uint32_t seconds, fraction;
+        ntp_now(now_ns, &seconds, &fraction);
+        uint32_t rtp_timestamp =
+            session->last_rtp_timestamp +
+            (uint32_t)((now_ns - session->last_send_ns) *
+                       (uint64_t)session->clock_rate / 1000000000ull);
+        put_u32(p + 8, seconds);
+        put_u32(p + 12, fraction);
+        put_u32(p + 16, rtp_timestamp);
+        put_u32(p + 20, (uint32_t)session->packets_sent);
+        put_u32(p + 24, (uint32_t)session->octets_sent);
+    }
+    if (blocks)
+        length += write_report_block(session, p + length, now_ns);
+    put_u16(p + 2, (uint16_t)(length / 4 - 1));
+    p += length;
+
+    memset(p, 0, sdes_length);
+    p[0] = (RTP_VERSION << 6) | 1;
+    p[1] = RTCP_SDES;
+    put_u16(p + 2, (uint16_t)(sdes_length / 4 - 1));
+    put_u32(p + 4, session->ssrc);
+    p[8] = RTCP_SDES_CNAME;
+    p[9] = (uint8_t)cname_length;
+    memcpy(p + 10, session->cname, cname_length);
+    p += sdes_length;
+    p += write_format(session, p);
+
+    session->sent_since_report = false;
+    schedule_report(session, now_ns, 1.0);
+    pthread_mutex_unlock(&session->mutex);
+    return (size_t)(p - buffer);
+}
+
+size_t rtp_session_build_format(RtpSession *session, uint8_t *buffer,
+                                size_t capacity)
+{
+    if (capacity < RTCP_FORMAT_SIZE)
+        return 0;
+    pthread_mutex_lock(&session->mutex);
+    size_t length = write_format(session, buffer);
+    pthread_mutex_unlock(&session->mutex);
+    return length;
+}
+
+bool rtp_session_take_format(RtpSession *session, int *clock_rate,
+                             int *packet_samples)
+{
+    pthread_mutex_lock(&session->mutex);
+    bool pending = session->format_pending;
+    session->format_pending = false;
+    *clock_rate = session->remote_clock_rate;
+    *packet_samples = session->remote_packet_samples;
+    pthread_mutex_unlock(&session->mutex);
+    return pending;
+}
+
+void rtp_session_get_stats(RtpSession *session, RtpStats *stats)
+{
+    pthread_mutex_lock(&session->mutex);
+    *stats = session->remote;
+    stats->packets_sent = session->packets_sent;
+    stats->octets_sent = session->octets_sent;
+    if (session->have_source)
+    {
+        stats->packets_received = session->received;
+        stats->packets_lost =
+            (int64_t)expected_packets(session) - (int64_t)session->received;
+        stats->fraction_lost = session->interval_fraction_lost;
+        stats->jitter_ms = session->jitter * 1000.0 / session->clock_rate;
+    }
+    pthread_mutex_unlock(&session->mutex);
+}
@@ -0,0 +1,153 @@
+#ifndef RTP_H
+#define RTP_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio_packet.h"
+#include "red.h"
+
+#define RTP_VERSION (2)
+#define RTP_HEADER_SIZE (12)
+/* Room for one frame of any codec or for a redundant (RFC 2198) payload. */
+#define RTP_PAYLOAD_MAX                                                        \
+    (AUDIO_PAYLOAD_MAX > RED_PAYLOAD_MAX ? AUDIO_PAYLOAD_MAX : RED_PAYLOAD_MAX)
+/* Media packets may carry the capture time of their frame in an RFC 8285
+ * one-byte header extension: the wall-clock send time as a 64-bit NTP
+ * timestamp and the sender's capture-to-send delay in microseconds. */
+#define RTP_EXT_ONE_BYTE_PROFILE (0xBEDE)
+#define RTP_EXT_CAPTURE_ID (1)
+#define RTP_EXT_CAPTURE_SIZE (20)
+#define RTP_PACKET_MAX                                                         \
+    (RTP_HEADER_SIZE + RTP_EXT_CAPTURE_SIZE + RTP_PAYLOAD_MAX)
+/* Every report also tells the peer the format this side sends: an RTCP
+ * APP packet (RFC 3550 6.7) named "FMT " with the sample rate and the
+ * samples per packet. */
+#define RTCP_FORMAT_SIZE (20)
+#define RTCP_PACKET_MAX (256)
+#define RTCP_INTERVAL_MS (5000)
+#define RTP_CNAME_MAX (64)
+
+typedef struct
+{
+    uint16_t sequence_number;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t payload_type;
+    bool marker;
+} RtpHeader;
+
+/* Quality of both directions of a call. The receive side is measured
+ * locally (RFC 3550 A.3 and A.8); the send side and round-trip time come
+ * from the peer's receiver reports. */
+typedef struct
+{
+    uint64_t packets_received;
+    int64_t packets_lost;
+    double fraction_lost;
+    double jitter_ms;
+    uint64_t packets_sent;
+    uint64_t octets_sent;
+    int64_t remote_packets_lost;
+    double remote_fraction_lost;
+    double remote_jitter_ms;
+    double rtt_ms;
+    bool have_remote_report;
+    bool have_rtt;
+} RtpStats;
+
+/* Per-call RTP/RTCP state. Media may be sent and received from different
+ * threads, and the UI reads the statistics, so every call takes the
+ * mutex. */
+typedef struct
+{
+    int clock_rate;
+    int packet_samples;
+    uint32_t ssrc;
+    uint16_t next_sequence;
+    uint32_t next_timestamp;
+    uint64_t packets_sent;
+    uint64_t octets_sent;
+    uint32_t last_rtp_timestamp;
+    uint64_t last_send_ns;
+    bool sent_since_report;
+    char cname[RTP_CNAME_MAX];
+
+    bool have_source;
+    uint32_t remote_ssrc;
+    uint16_t max_seq;
+    uint32_t cycles;
+    uint32_t base_seq;
+    uint32_t bad_seq;
+    uint64_t received;
+    uint64_t expected_prior;
+    uint64_t received_prior;
+    int64_t transit;
+    bool have_transit;
+    double jitter;
+    double interval_fraction_lost;
+    uint32_t last_sr;
+    uint64_t last_sr_arrival_ns;
+    int remote_clock_rate;
+    int remote_packet_samples;
+    bool format_pending;
+
+    RtpStats remote;
+    uint64_t next_report_ns;
+    pthread_mutex_t mutex;
+} RtpSession;
+
+size_t rtp_write_header(uint8_t *buffer, const RtpHeader *header);
+/* Returns the payload length, or -1 if the datagram is not RTP. The payload
+ * starts at buffer + *payload_offset; padding is excluded. */
+int rtp_parse_header(const uint8_t *buffer, size_t length, RtpHeader *header,
+                     size_t *payload_offset);
+/* Appends the capture time extension to a header just written by
+ * rtp_write_header() and returns the length of both. */
+size_t rtp_write_capture_time(uint8_t *buffer, uint64_t sent_wall_ns,
+                              uint32_t sender_delay_us);
+/* Finds the capture time extension of an RTP packet; false if it has
+ * none. */
+bool rtp_read_capture_time(const uint8_t *buffer, size_t length,
+                           uint64_t *sent_wall_ns, uint32_t *sender_delay_us);
+/* RTP and RTCP share the media port (RFC 5761); RTCP packet types occupy
+ * 200-204 in the second octet. */
+bool rtp_is_rtcp(const uint8_t *buffer, size_t length);
+/* The SSRC of the sender of an RTP or RTCP packet, or 0 if it is
+ * neither. */
+uint32_t rtp_sender_ssrc(const uint8_t *buffer, size_t length);
+
+void rtp_session_init(RtpSession *session, int clock_rate,
+                      int packet_samples);
+void rtp_session_destroy(RtpSession *session);
+/* Fills in the header of the next outgoing packet of frames samples. */
+void rtp_session_next_header(RtpSession *session, uint8_t payload_type,
+                             int frames, RtpHeader *header);
+/* Advances the timestamp over frames that are not sent (DTX). */
+void rtp_session_skip(RtpSession *session, int frames);
+void rtp_session_on_sent(RtpSession *session, const RtpHeader *header,
+                         size_t payload_bytes, uint64_t now_ns);
+/* Updates the receive statistics and returns the extended sequence number
+ * of the packet. */
+uint32_t rtp_session_on_received(RtpSession *session,
+                                 const RtpHeader *header,
+                                 uint64_t arrival_ns);
+void rtp_session_on_rtcp(RtpSession *session, const uint8_t *buffer,
+                         size_t length, uint64_t arrival_ns);
+bool rtp_session_report_due(RtpSession *session, uint64_t now_ns);
+/* Builds a compound SR or RR plus SDES packet; returns its length. */
+size_t rtp_session_build_report(RtpSession *session, uint8_t *buffer,
+                                size_t capacity, uint64_t now_ns);
+/* Builds the format announcement alone, for the start of a call, when
+ * the first report is still seconds away; returns its length. */
+size_t rtp_session_build_format(RtpSession *session, uint8_t *buffer,
+                                size_t capacity);
+/* True once for each format the peer announces that differs from the one
+ * before; the format is stored in *clock_rate and *packet_samples. */
+bool rtp_session_take_format(RtpSession *session, int *clock_rate,
+                             int *packet_samples);
+void rtp_session_get_stats(RtpSession *session, RtpStats *stats);
+
+#endif
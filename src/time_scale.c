@@ -0,0 +1,105 @@
+#include "time_scale.h"
+
+#include <math.h>
+#include <string.h>
+
+static float normalized_correlation(const SAMPLE *a, const SAMPLE *b, int len,
+                                    int step)
+{
+    float cross = 0.0f, energy_a = 0.0f, energy_b = 0.0f;
+    for (int i = 0; i < len; i += step)
+    {
+        float x = (float)a[i];
+        float y = (float)b[i];
+        cross += x * y;
+        energy_a += x * x;
+        energy_b += y * y;
+    }
+    float denom = sqrtf(energy_a * energy_b);
+    if (denom <= 0.0f)
+        return 0.0f;
+    return cross / denom;
+}
+
+int time_scale_best_lag(const SAMPLE *in, int len, int min_lag, int max_lag,
+                        float *correlation)
+{
+    if (max_lag > len / 2)
+        max_lag = len / 2;
+    if (min_lag < 1)
+        min_lag = 1;
+    if (min_lag > max_lag)
+        min_lag = max_lag;
+
+    int best_lag = max_lag;
+    float best_corr = -2.0f;
+    for (int lag = min_lag; lag <= max_lag; lag += 2)
+    {
+        float corr = normalized_correlation(in, in + lag, lag, 2);
+        if (corr > best_corr)
+        {
+            best_corr = corr;
+            best_lag = lag;
+        }
+    }
+
+    /* The refinement compares full-resolution correlations only, starting
+     * from the coarse lag's. */
+    int coarse = best_lag;
+    best_corr = normalized_correlation(in, in + coarse, coarse, 1);
+    for (int lag = coarse - 1; lag <= coarse + 1; lag++)
+    {
+        if (lag == coarse || lag < min_lag || lag > max_lag)
+            continue;
+        float corr = normalized_correlation(in, in + lag, lag, 1);
+        if (corr > best_corr)
+        {
+            best_corr = corr;
+            best_lag = lag;
+        }
+    }
+
+    if (correlation)
+        *correlation = best_corr;
+    return best_lag;
+}
+
+static void cross_fade(const SAMPLE *fade_out, const SAMPLE *fade_in,
+                       SAMPLE *out, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        float w = (float)(i + 1) / (float)(len + 1);
+        float v = (1.0f - w) * (float)fade_out[i] + w * (float)fade_in[i];
+        out[i] = (SAMPLE)lrintf(v);
+    }
+}
+
+int time_scale_compress(const SAMPLE *in, int len, SAMPLE *out, int lag)
+{
+    if (lag <= 0 || 2 * lag > len)
+    {
+        memmove(out, in, len * sizeof(SAMPLE));
+        return len;
+    }
+    SAMPLE head[lag];
+    cross_fade(in, in + lag, head, lag);
+    memmove(out + lag, in + 2 * lag, (len - 2 * lag) * sizeof(SAMPLE));
+    memcpy(out, head, lag * sizeof(SAMPLE));
+    return len - lag;
+}
+
+int time_scale_expand(const SAMPLE *in, int len, SAMPLE *out, int lag)
+{
+    if (lag <= 0 || 2 * lag > len)
+    {
+        memmove(out, in, len * sizeof(SAMPLE));
+        return len;
+    }
+    SAMPLE bridge[lag];
+    cross_fade(in + lag, in, bridge, lag);
+    memmove(out + 2 * lag, in + lag, (len - lag) * sizeof(SAMPLE));
+    memmove(out, in, lag * sizeof(SAMPLE));
+    memcpy(out + lag, bridge, lag * sizeof(SAMPLE));
+    return len + lag;
+}
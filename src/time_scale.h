@@ -0,0 +1,15 @@
+#ifndef TIME_SCALE_H
+#define TIME_SCALE_H
+
+#include "audio_config.h"
+
+/* WSOLA-style time-scale modification of a single frame. Both functions
+ * search for the best-matching pitch lag in [min_lag, max_lag] and return
+ * the number of samples written to out, which is len - lag for compress and
+ * len + lag for expand. out must hold at least len + max_lag samples. */
+int time_scale_best_lag(const SAMPLE *in, int len, int min_lag, int max_lag,
+                        float *correlation);
+int time_scale_compress(const SAMPLE *in, int len, SAMPLE *out, int lag);
+int time_scale_expand(const SAMPLE *in, int len, SAMPLE *out, int lag);
+
+#endif
@@ -0,0 +1,59 @@
+#include "unpack.h"
+
+#include "codec.h"
+
+int unpack_datagram(RtpSession *rtp, PacketBuffer *buffer, int length,
+                    uint64_t arrival_ns, uint64_t media_arrival_ns,
+                    AudioPacket packets[RED_MAX_BLOCKS])
+{
+    const uint8_t *datagram = buffer->data;
+    if (rtp_is_rtcp(datagram, length))
+    {
+        rtp_session_on_rtcp(rtp, datagram, length, arrival_ns);
+        return 0;
+    }
+    RtpHeader header;
+    size_t offset;
+    int payload_size = rtp_parse_header(datagram, length, &header, &offset);
+    if (payload_size <= 0 || header.payload_type == LOCKSTEP_PROBE_PAYLOAD_TYPE)
+        return 0;
+    RedBlock blocks[RED_MAX_BLOCKS];
+    int count = 1;
+    blocks[0].payload_type = header.payload_type;
+    blocks[0].timestamp = header.timestamp;
+    blocks[0].data = datagram + offset;
+    blocks[0].length = payload_size;
+    if (header.payload_type == PAYLOAD_RED)
+    {
+        count = red_parse(datagram + offset, payload_size, header.timestamp,
+                          blocks, RED_MAX_BLOCKS);
+        if (count <= 0)
+            return 0;
+    }
+    uint32_t sequence_number =
+        rtp_session_on_received(rtp, &header, media_arrival_ns);
+    int filled = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (blocks[i].length <= 0 || blocks[i].length > AUDIO_PAYLOAD_MAX)
+            continue;
+        AudioPacket *packet = &packets[filled++];
+        packet->sequence_number = sequence_number;
+        packet->timestamp = blocks[i].timestamp;
+        packet->payload_type = blocks[i].payload_type;
+        packet->flags = i > 0 ? AUDIO_PACKET_REDUNDANT : 0;
+        packet->payload_size = (uint16_t)blocks[i].length;
+        packet->payload = blocks[i].data;
+        packet->buffer = buffer;
+    }
+    return filled;
+}
+
+bool unpack_is_media(const uint8_t *datagram, int length)
+{
+    RtpHeader header;
+    size_t offset;
+    return !rtp_is_rtcp(datagram, length) &&
+           rtp_parse_header(datagram, length, &header, &offset) > 0 &&
+           header.payload_type != LOCKSTEP_PROBE_PAYLOAD_TYPE;
+}
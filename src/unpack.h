@@ -0,0 +1,28 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_packet.h"
+#include "packet_pool.h"
+#include "red.h"
+#include "rtp.h"
+
+/* Lockstep probes are RTP packets of this type that carry no audio. */
+#define LOCKSTEP_PROBE_PAYLOAD_TYPE (127)
+
+/* Parses one datagram from a peer. RTCP is consumed here; a well-formed
+ * RTP media packet is unpacked into packets, the primary frame first and
+ * then any redundant ones, and their number returned. The packets point
+ * into buffer rather than copying their payloads. Probes and malformed
+ * datagrams return 0. media_arrival_ns is the arrival time given to the
+ * receive statistics, which differs from arrival_ns in lockstep. Both the
+ * call and the offline replay (replay.h) receive through here. */
+int unpack_datagram(RtpSession *rtp, PacketBuffer *buffer, int length,
+                    uint64_t arrival_ns, uint64_t media_arrival_ns,
+                    AudioPacket packets[RED_MAX_BLOCKS]);
+/* True for an RTP packet that carries audio. */
+bool unpack_is_media(const uint8_t *datagram, int length);
+
+#endif
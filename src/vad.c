@@ -0,0 +1,79 @@
+#include "vad.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "dsp_kernels.h"
+
+#define VAD_HANGOVER_MS (200)
+#define VAD_INITIAL_NOISE_DB (40.0f)
+#define VAD_SPEECH_SNR_DB (12.0f)
+#define VAD_WEAK_SNR_DB (5.0f)
+#define VAD_TILT_DELTA (0.25f)
+#define VAD_ZCR_DELTA (0.1f)
+
+void vad_init(Vad *vad, int sample_rate, int frame_size)
+{
+    memset(vad, 0, sizeof(*vad));
+    vad->hangover_frames =
+        (VAD_HANGOVER_MS * sample_rate / 1000 + frame_size - 1) / frame_size;
+    vad->noise_db = VAD_INITIAL_NOISE_DB;
+}
+
+static void spectral_features(const SAMPLE *pcm, int len, float *tilt,
+                              float *zcr)
+{
+    double r0 = 0.0, r1 = 0.0;
+    int crossings = 0;
+    for (int i = 1; i < len; i++)
+    {
+        r0 += (double)pcm[i] * pcm[i];
+        r1 += (double)pcm[i] * pcm[i - 1];
+        crossings += (pcm[i] >= 0) != (pcm[i - 1] >= 0);
+    }
+    *tilt = r0 > 0.0 ? (float)(r1 / r0) : 0.0f;
+    *zcr = len > 1 ? (float)crossings / (len - 1) : 0.0f;
+}
+
+bool vad_process(Vad *vad, const SAMPLE *pcm, int len, float floor_rms)
+{
+    if (len <= 0)
+        return vad->active;
+    float rms = dsp_rms(pcm, len);
+    float energy_db = 20.0f * log10f(rms + 1.0f);
+    float tilt, zcr;
+    spectral_features(pcm, len, &tilt, &zcr);
+
+    float snr = energy_db - vad->noise_db;
+    bool spectral_change = fabsf(tilt - vad->noise_tilt) > VAD_TILT_DELTA ||
+                           fabsf(zcr - vad->noise_zcr) > VAD_ZCR_DELTA;
+    bool speech = rms > floor_rms &&
+                  (snr > VAD_SPEECH_SNR_DB ||
+                   (snr > VAD_WEAK_SNR_DB && spectral_change));
+
+    /* The floor follows drops quickly and rises slowly, and only learns
+     * the noise spectrum from frames judged to be noise. */
+    if (energy_db < vad->noise_db)
+        vad->noise_db += (energy_db - vad->noise_db) * 0.2f;
+    else
+        vad->noise_db += (energy_db - vad->noise_db) * (speech ? 0.001f : 0.02f);
+    if (!speech)
+    {
+        float rate = vad->frames_seen < 10 ? 0.5f : 0.05f;
+        vad->noise_tilt += (tilt - vad->noise_tilt) * rate;
+        vad->noise_zcr += (zcr - vad->noise_zcr) * rate;
+    }
+    vad->frames_seen++;
+
+    if (speech)
+        vad->hangover = vad->hangover_frames;
+    else if (vad->hangover > 0)
+        vad->hangover--;
+    vad->active = speech || vad->hangover > 0;
+    return vad->active;
+}
+
+float vad_noise_rms(const Vad *vad)
+{
+    return powf(10.0f, vad->noise_db / 20.0f) - 1.0f;
+}
@@ -0,0 +1,30 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdbool.h>
+
+#include "audio_config.h"
+
+/* Frame-level voice activity detector. A frame is speech when its energy
+ * clears the tracked noise floor by a wide margin, or by a smaller margin
+ * while its spectral tilt (normalized lag-1 autocorrelation) and zero
+ * crossing rate also depart from those of the noise. A hangover keeps the
+ * detector active through short pauses and word endings. */
+typedef struct
+{
+    int hangover_frames;
+    int hangover;
+    int frames_seen;
+    float noise_db;
+    float noise_tilt;
+    float noise_zcr;
+    bool active;
+} Vad;
+
+void vad_init(Vad *vad, int sample_rate, int frame_size);
+/* floor_rms is an absolute level below which a frame is never speech. */
+bool vad_process(Vad *vad, const SAMPLE *pcm, int len, float floor_rms);
+/* The current noise floor estimate as an RMS amplitude. */
+float vad_noise_rms(const Vad *vad);
+
+#endif
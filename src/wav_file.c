@@ -0,0 +1,186 @@
+#include "wav_file.h"
+
+#include <string.h>
+
+#define WAV_HEADER_BYTES (44)
+#define WAV_READ_CHUNK (1024)
+
+static uint32_t read_u32le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_u16le(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void write_u32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void write_u16le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+int wav_reader_open(WavReader *reader, const char *path)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+    if (!reader->file)
+        return -1;
+
+    uint8_t riff[12];
+    if (fread(riff, 1, sizeof(riff), reader->file) != sizeof(riff) ||
+        memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+        goto fail;
+
+    int have_format = 0;
+    for (;;)
+    {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), reader->file) != sizeof(chunk))
+            goto fail;
+        uint32_t size = read_u32le(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) ||
+                fread(fmt, 1, sizeof(fmt), reader->file) != sizeof(fmt))
+                goto fail;
+            if (read_u16le(fmt) != 1 || read_u16le(fmt + 14) != 16)
+                goto fail;
+            reader->channels = read_u16le(fmt + 2);
+            reader->sample_rate = (int)read_u32le(fmt + 4);
+            if (reader->channels < 1)
+                goto fail;
+            fseek(reader->file, (long)(size - sizeof(fmt) + (size & 1)),
+                  SEEK_CUR);
+            have_format = 1;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!have_format)
+                goto fail;
+            reader->frames_remaining =
+                size / (uint32_t)(reader->channels * sizeof(SAMPLE));
+            return 0;
+        }
+        else
+        {
+            fseek(reader->file, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+
+fail:
+    fclose(reader->file);
+    reader->file = NULL;
+    return -1;
+}
+
+int wav_reader_read(WavReader *reader, SAMPLE *out, int frames)
+{
+    int channels = reader->channels;
+    int total = 0;
+    SAMPLE chunk[WAV_READ_CHUNK];
+    while (total < frames && reader->frames_remaining > 0)
+    {
+        int want = frames - total;
+        if ((uint32_t)want > reader->frames_remaining)
+            want = (int)reader->frames_remaining;
+        if (want * channels > WAV_READ_CHUNK)
+            want = WAV_READ_CHUNK / channels;
+        size_t got = fread(chunk, sizeof(SAMPLE) * channels, want, reader->file);
+        if (got == 0)
+        {
+            reader->frames_remaining = 0;
+            break;
+        }
+        for (size_t i = 0; i < got; i++)
+        {
+            int sum = 0;
+            for (int c = 0; c < channels; c++)
+            {
+                const uint8_t *p = (const uint8_t *)&chunk[i * channels + c];
+                sum += (int16_t)read_u16le(p);
+            }
+            out[total + i] = (SAMPLE)(sum / channels);
+        }
+        total += (int)got;
+        reader->frames_remaining -= (uint32_t)got;
+    }
+    return total;
+}
+
+void wav_reader_close(WavReader *reader)
+{
+    if (reader->file)
+        fclose(reader->file);
+    reader->file = NULL;
+}
+
+static void fill_header(uint8_t *header, int sample_rate, int channels,
+                        uint32_t frames)
+{
+    uint32_t data_bytes = frames * (uint32_t)(channels * sizeof(SAMPLE));
+    memcpy(header, "RIFF", 4);
+    write_u32le(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_u32le(header + 16, 16);
+    write_u16le(header + 20, 1);
+    write_u16le(header + 22, (uint16_t)channels);
+    write_u32le(header + 24, (uint32_t)sample_rate);
+    write_u32le(header + 28, (uint32_t)(sample_rate * channels * sizeof(SAMPLE)));
+    write_u16le(header + 32, (uint16_t)(channels * sizeof(SAMPLE)));
+    write_u16le(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    write_u32le(header + 40, data_bytes);
+}
+
+int wav_writer_open(WavWriter *writer, const char *path, int sample_rate,
+                    int channels)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(path, "wb");
+    if (!writer->file)
+        return -1;
+    writer->sample_rate = sample_rate;
+    writer->channels = channels;
+    uint8_t header[WAV_HEADER_BYTES];
+    fill_header(header, sample_rate, channels, 0);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header))
+    {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int wav_writer_write(WavWriter *writer, const SAMPLE *interleaved, int frames)
+{
+    size_t written = fwrite(interleaved, sizeof(SAMPLE) * writer->channels,
+                            frames, writer->file);
+    writer->frames_written += (uint32_t)written;
+    return written == (size_t)frames ? 0 : -1;
+}
+
+void wav_writer_close(WavWriter *writer)
+{
+    if (!writer->file)
+        return;
+    uint8_t header[WAV_HEADER_BYTES];
+    fill_header(header, writer->sample_rate, writer->channels,
+                writer->frames_written);
+    fseek(writer->file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), writer->file);
+    fclose(writer->file);
+    writer->file = NULL;
+}
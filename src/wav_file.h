@@ -0,0 +1,36 @@
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "audio_config.h"
+
+/* 16-bit PCM RIFF/WAVE files. The reader down-mixes multi-channel input to
+ * mono; the writer patches the header sizes on close. */
+typedef struct
+{
+    FILE *file;
+    int sample_rate;
+    int channels;
+    uint32_t frames_remaining;
+} WavReader;
+
+typedef struct
+{
+    FILE *file;
+    int sample_rate;
+    int channels;
+    uint32_t frames_written;
+} WavWriter;
+
+int wav_reader_open(WavReader *reader, const char *path);
+int wav_reader_read(WavReader *reader, SAMPLE *out, int frames);
+void wav_reader_close(WavReader *reader);
+
+int wav_writer_open(WavWriter *writer, const char *path, int sample_rate,
+                    int channels);
+int wav_writer_write(WavWriter *writer, const SAMPLE *interleaved, int frames);
+void wav_writer_close(WavWriter *writer);
+
+#endif
@@ -0,0 +1,128 @@
+/* Load generator for voip_relay: simulates many calls, each member on its own
+ * socket sending a packet per ptime, and reports the rates and end-to-end
+ * latency through the relay. */
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "relay_load.h"
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --relay HOST:PORT  relay to load (default 127.0.0.1:%d)\n"
+            "  --calls N          simultaneous calls (default 500)\n"
+            "  --members N        members per call, 2-%d (default 2)\n"
+            "  --threads N        sending threads (default 1)\n"
+            "  --ptime MS         packet interval (default %d)\n"
+            "  --payload BYTES    RTP payload size (default %d)\n"
+            "  --room N           number of the first room (default 1)\n"
+            "  --duration SECONDS how long to send (default 10)\n",
+            program, RELAY_DEFAULT_PORT, RELAY_ROOM_MEMBERS_MAX,
+            RELAY_LOAD_DEFAULT_PTIME_MS, RELAY_LOAD_DEFAULT_PAYLOAD);
+}
+
+static int parse_destination(const char *text, struct sockaddr_in *addr)
+{
+    char host[64];
+    const char *colon = strrchr(text, ':');
+    if (!colon || colon == text || (size_t)(colon - text) >= sizeof(host))
+        return -1;
+    memcpy(host, text, colon - text);
+    host[colon - text] = '\0';
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(atoi(colon + 1));
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1 ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        {"relay", required_argument, NULL, 'r'},
+        {"calls", required_argument, NULL, 'c'},
+        {"members", required_argument, NULL, 'm'},
+        {"threads", required_argument, NULL, 't'},
+        {"ptime", required_argument, NULL, 'p'},
+        {"payload", required_argument, NULL, 'b'},
+        {"room", required_argument, NULL, 'o'},
+        {"duration", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    RelayLoadConfig config;
+    relay_load_config_default(&config);
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            if (parse_destination(optarg, &config.relay) == -1)
+            {
+                fprintf(stderr, "Invalid --relay '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            config.calls = atoi(optarg);
+            break;
+        case 'm':
+            config.members = atoi(optarg);
+            break;
+        case 't':
+            config.threads = atoi(optarg);
+            break;
+        case 'p':
+            config.ptime_ms = atoi(optarg);
+            break;
+        case 'b':
+            config.payload_bytes = atoi(optarg);
+            break;
+        case 'o':
+            config.first_room = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            config.duration_s = atof(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("[LOAD] %d calls of %d members (%d streams) to %s:%d, one packet "
+           "per %d ms for %.1f s.\n",
+           config.calls, config.members, config.calls * config.members,
+           inet_ntoa(config.relay.sin_addr), ntohs(config.relay.sin_port),
+           config.ptime_ms, config.duration_s);
+    RelayLoadStats stats;
+    if (relay_load_run(&config, &stats) == -1)
+        return 1;
+
+    double lost = stats.packets_expected > stats.packets_received
+                      ? (double)(stats.packets_expected -
+                                 stats.packets_received)
+                      : 0.0;
+    printf("[LOAD] sent %.0f pkt/s, received %.0f pkt/s, %.3f%% lost, "
+           "%llu send failures\n",
+           stats.packets_sent / stats.seconds,
+           stats.packets_received / stats.seconds,
+           stats.packets_expected
+               ? 100.0 * lost / (double)stats.packets_expected
+               : 0.0,
+           (unsigned long long)stats.send_failures);
+    printf("[LOAD] end-to-end latency p50 %.1f us, p99 %.1f us, "
+           "p99.9 %.1f us\n",
+           histogram_percentile(&stats.latency, 0.50) / 1000.0,
+           histogram_percentile(&stats.latency, 0.99) / 1000.0,
+           histogram_percentile(&stats.latency, 0.999) / 1000.0);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/* Standalone impairment relay: datagrams received on --listen are forwarded
+ * to --to through the same impairment stage the call can run in-process.
+ * One instance impairs one direction; run two for both. */
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "impair.h"
+#include "net_io.h"
+#include "time_util.h"
+
+#define RELAY_IDLE_TIMEOUT_MS (100)
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s --listen PORT --to HOST:PORT [options]\n"
+            "  --impair SPEC      e.g. delay=40,jitter=10,dist=pareto,loss=2,\n"
+            "                     burst=3,reorder=1,dup=1,rate=256,seed=7\n"
+            "  --duration SECONDS stop after this long\n",
+            program);
+}
+
+static int parse_destination(const char *text, struct sockaddr_in *addr)
+{
+    char host[64];
+    const char *colon = strrchr(text, ':');
+    if (!colon || colon == text || (size_t)(colon - text) >= sizeof(host))
+        return -1;
+    memcpy(host, text, colon - text);
+    host[colon - text] = '\0';
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(atoi(colon + 1));
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1 ? 0 : -1;
+}
+
+static void forward_due(Impairment *imp, NetSocket *ns,
+                        const struct sockaddr_in *to)
+{
+    static uint8_t datagrams[NET_BATCH_MAX][IMPAIR_PACKET_MAX];
+    const void *buffers[NET_BATCH_MAX];
+    size_t lengths[NET_BATCH_MAX];
+    struct sockaddr_in addrs[NET_BATCH_MAX];
+    uint64_t release_ns;
+    int count;
+    do
+    {
+        uint64_t now = monotonic_ns();
+        count = 0;
+        int length;
+        while (count < NET_BATCH_MAX &&
+               (length = impair_pop(imp, now, datagrams[count],
+                                    IMPAIR_PACKET_MAX, &release_ns, NULL)) > 0)
+        {
+            buffers[count] = datagrams[count];
+            lengths[count] = length;
+            addrs[count] = *to;
+            count++;
+        }
+        if (count > 0)
+            net_send_batch(ns, buffers, lengths, addrs, count);
+    } while (count == NET_BATCH_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        {"listen", required_argument, NULL, 'l'},
+        {"to", required_argument, NULL, 't'},
+        {"impair", required_argument, NULL, 'm'},
+        {"duration", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    ImpairConfig config;
+    impair_config_default(&config);
+    config.enabled = true;
+    int listen_port = 0;
+    struct sockaddr_in to;
+    bool have_destination = false;
+    double duration = 0.0;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            listen_port = atoi(optarg);
+            break;
+        case 't':
+            if (parse_destination(optarg, &to) == -1)
+            {
+                fprintf(stderr, "Invalid --to '%s'\n", optarg);
+                return 1;
+            }
+            have_destination = true;
+            break;
+        case 'm':
+            if (impair_config_parse(&config, optarg) == -1)
+            {
+                fprintf(stderr, "Invalid --impair '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (listen_port <= 0 || !have_destination)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Impairment imp;
+    NetSocket ns;
+    if (impair_init(&imp, &config) == -1)
+    {
+        fprintf(stderr, "impair_init() failed\n");
+        return 1;
+    }
+    if (net_socket_open(&ns, listen_port) == -1)
+    {
+        impair_destroy(&imp);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    char description[256];
+    impair_config_describe(&config, description, sizeof(description));
+    printf("[IMPAIR] Relaying :%d -> %s:%d with %s.\n", listen_port,
+           inet_ntoa(to.sin_addr), ntohs(to.sin_port), description);
+
+    static uint8_t datagrams[NET_BATCH_MAX][IMPAIR_PACKET_MAX];
+    void *buffers[NET_BATCH_MAX];
+    NetDatagramInfo info[NET_BATCH_MAX];
+    for (int i = 0; i < NET_BATCH_MAX; i++)
+        buffers[i] = datagrams[i];
+    uint64_t start_ns = monotonic_ns();
+    while (!stop_requested)
+    {
+        uint64_t now = monotonic_ns();
+        if (duration > 0.0 && (now - start_ns) / 1e9 >= duration)
+            break;
+        int timeout_ms = impair_timeout_ms(&imp, now);
+        if (timeout_ms < 0 || timeout_ms > RELAY_IDLE_TIMEOUT_MS)
+            timeout_ms = RELAY_IDLE_TIMEOUT_MS;
+        if (net_wait_readable(&ns, timeout_ms) > 0)
+        {
+            int count;
+            do
+            {
+                count = net_recv_batch(&ns, buffers, IMPAIR_PACKET_MAX, info,
+                                       NET_BATCH_MAX);
+                for (int i = 0; i < count; i++)
+                    impair_submit(&imp, datagrams[i], info[i].length, NULL,
+                                  info[i].timestamp_ns);
+            } while (count == NET_BATCH_MAX);
+        }
+        forward_due(&imp, &ns, &to);
+    }
+
+    printf("[IMPAIR] %llu datagrams in, %llu forwarded, %llu lost, "
+           "%llu queue drops, %llu reordered, %llu duplicated\n",
+           (unsigned long long)imp.stats.submitted,
+           (unsigned long long)imp.stats.delivered,
+           (unsigned long long)imp.stats.lost,
+           (unsigned long long)imp.stats.queue_drops,
+           (unsigned long long)imp.stats.reordered,
+           (unsigned long long)imp.stats.duplicated);
+    net_socket_close(&ns);
+    impair_destroy(&imp);
+    return 0;
+}
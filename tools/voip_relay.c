@@ -0,0 +1,169 @@
+/* Relay server: forwards RTP and RTCP between the members of many calls and
+ * conferences at once. Clients join a room with an RTCP APP packet (voip_phone
+ * --room N); everything a member sends then goes to the other members of its
+ * room. */
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "relay.h"
+#include "time_util.h"
+
+#define RELAY_STATS_INTERVAL_S (5.0)
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --port PORT        UDP port to serve (default %d)\n"
+            "  --workers N        worker threads, one per core (default: "
+            "all cores)\n"
+            "  --rooms N          rooms the tables are sized for (default "
+            "%d)\n"
+            "  --no-pin           do not pin workers to cores\n"
+            "  --stats SECONDS    print rates this often, 0 for never "
+            "(default %.0f)\n"
+            "  --duration SECONDS stop after this long\n",
+            program, RELAY_DEFAULT_PORT, RELAY_DEFAULT_ROOMS,
+            RELAY_STATS_INTERVAL_S);
+}
+
+static void print_rates(Relay *relay, uint64_t *last_in, double seconds)
+{
+    static uint64_t worker_last[RELAY_WORKERS_MAX];
+    RelayWorkerStats total;
+    relay_total_stats(relay, &total);
+    uint64_t in = atomic_load(&total.packets_in);
+    printf("[RELAY] %.0f pkt/s in, per worker:", (in - *last_in) / seconds);
+    for (int i = 0; i < relay->config.workers; i++)
+    {
+        uint64_t worker_in = atomic_load(&relay->workers[i].stats.packets_in);
+        printf(" %.0f", (worker_in - worker_last[i]) / seconds);
+        worker_last[i] = worker_in;
+    }
+    printf("; %llu members\n",
+           (unsigned long long)(atomic_load(&total.joins) -
+                                atomic_load(&total.reclaimed)));
+    *last_in = in;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        {"port", required_argument, NULL, 'p'},
+        {"workers", required_argument, NULL, 'w'},
+        {"rooms", required_argument, NULL, 'r'},
+        {"no-pin", no_argument, NULL, 'n'},
+        {"stats", required_argument, NULL, 's'},
+        {"duration", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    RelayConfig config;
+    relay_config_default(&config);
+    double stats_interval = RELAY_STATS_INTERVAL_S;
+    double duration = 0.0;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 'w':
+            config.workers = atoi(optarg);
+            break;
+        case 'r':
+            config.rooms = atoi(optarg);
+            break;
+        case 'n':
+            config.pin_workers = false;
+            break;
+        case 's':
+            stats_interval = atof(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Relay relay;
+    if (relay_start(&relay, &config) == -1)
+        return 1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    uint64_t start_ns = monotonic_ns();
+    uint64_t last_stats_ns = start_ns;
+    uint64_t last_in = 0;
+    while (!stop_requested)
+    {
+        usleep(100000);
+        uint64_t now = monotonic_ns();
+        if (duration > 0.0 && (now - start_ns) / 1e9 >= duration)
+            break;
+        double since = (now - last_stats_ns) / 1e9;
+        if (stats_interval > 0.0 && since >= stats_interval)
+        {
+            print_rates(&relay, &last_in, since);
+            last_stats_ns = now;
+        }
+    }
+    double seconds = (monotonic_ns() - start_ns) / 1e9;
+    relay_stop(&relay);
+
+    RelayWorkerStats total;
+    relay_total_stats(&relay, &total);
+    printf("[RELAY] %llu datagrams in, %llu out, %llu members joined, "
+           "%llu timed out and replaced, %llu from unknown senders, "
+           "%llu joins rejected\n",
+           (unsigned long long)total.packets_in,
+           (unsigned long long)total.packets_out,
+           (unsigned long long)total.joins,
+           (unsigned long long)total.reclaimed,
+           (unsigned long long)total.unknown,
+           (unsigned long long)total.rejected);
+    for (int i = 0; i < relay.config.workers; i++)
+    {
+        RelayWorker *worker = &relay.workers[i];
+        printf("[RELAY] worker %d: %.0f pkt/s in, %.0f pkt/s out, "
+               "%.1f datagrams per recvmmsg\n",
+               i, atomic_load(&worker->stats.packets_in) / seconds,
+               atomic_load(&worker->stats.packets_out) / seconds,
+               worker->net.recv_calls
+                   ? (double)worker->net.packets_received /
+                         worker->net.recv_calls
+                   : 0.0);
+    }
+    printf("[RELAY] forwarding latency p50 %.1f us, p99 %.1f us, "
+           "p99.9 %.1f us\n",
+           histogram_percentile(&total.latency, 0.50) / 1000.0,
+           histogram_percentile(&total.latency, 0.99) / 1000.0,
+           histogram_percentile(&total.latency, 0.999) / 1000.0);
+    relay_destroy(&relay);
+    return 0;
+}
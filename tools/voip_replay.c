@@ -0,0 +1,166 @@
+/* Offline replay of a packet capture: the datagrams a phone received
+ * (voip_phone --capture, or tcpdump) go through the same receive path and
+ * jitter buffer on a virtual clock, far faster than real time. The decoded
+ * audio and the statistics come out the same on every run, so jitter
+ * buffer, PLC and drift compensation changes can be compared on real
+ * traces. */
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s CAPTURE.pcap [options]\n"
+            "  --output PATH          write the played audio to a WAV file\n"
+            "  --rate HZ              sample rate of the stream (default %d)\n"
+            "  --frame-ms MS          playout frame, %.1f-%d ms (default %d\n"
+            "                         samples at %d Hz, otherwise 10 ms)\n"
+            "  --packet-frames N      frames per packet until the stream\n"
+            "                         announces its size (default 1)\n"
+            "  --jitter-delay FRAMES  fixed jitter buffer delay, no adaptation\n"
+            "  --no-drift             do not resample playout to follow the\n"
+            "                         sender's clock\n"
+            "  --ssrc HEX             replay this stream (default: the first)\n"
+            "  --port PORT            only datagrams sent to this port\n",
+            program, SAMPLE_RATE, AUDIO_FRAME_MS_MIN, AUDIO_FRAME_MS_MAX,
+            FRAMES_PER_BUFFER, SAMPLE_RATE);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        {"output", required_argument, NULL, 'o'},
+        {"rate", required_argument, NULL, 'z'},
+        {"frame-ms", required_argument, NULL, 'F'},
+        {"packet-frames", required_argument, NULL, 'N'},
+        {"jitter-delay", required_argument, NULL, 'j'},
+        {"no-drift", no_argument, NULL, 'D'},
+        {"ssrc", required_argument, NULL, 's'},
+        {"port", required_argument, NULL, 'p'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    ReplayConfig config;
+    replay_config_default(&config);
+    const char *output_path = NULL;
+    int sample_rate = SAMPLE_RATE;
+    double frame_ms = 0.0;
+    int packet_frames = 1;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'z':
+            sample_rate = atoi(optarg);
+            break;
+        case 'F':
+            frame_ms = atof(optarg);
+            break;
+        case 'N':
+            packet_frames = atoi(optarg);
+            break;
+        case 'j':
+            config.jb_config.initial_delay_frames = atoi(optarg);
+            config.jb_config.adaptive = false;
+            break;
+        case 'D':
+            config.jb_config.drift_compensation = false;
+            break;
+        case 's':
+            config.ssrc = (uint32_t)strtoul(optarg, NULL, 16);
+            break;
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* The frame the phone picks for the same options. */
+    if (frame_ms == 0.0)
+        config.frame_size =
+            sample_rate == SAMPLE_RATE ? FRAMES_PER_BUFFER : sample_rate / 100;
+    else
+        config.frame_size = (int)lrint(sample_rate * frame_ms / 1000.0);
+    int packet = config.frame_size * packet_frames;
+    if (sample_rate <= 0 || sample_rate > AUDIO_RATE_MAX ||
+        config.frame_size <= 0 || config.frame_size > AUDIO_FRAME_MAX ||
+        packet_frames < 1 || packet > AUDIO_PACKET_SAMPLES_MAX)
+    {
+        fprintf(stderr, "Invalid --rate %d, --frame-ms %g or "
+                        "--packet-frames %d\n",
+                sample_rate, frame_ms, packet_frames);
+        return 1;
+    }
+    config.jb_config.sample_rate = sample_rate;
+    config.jb_config.frame_size = packet;
+
+    CaptureReader reader;
+    if (capture_reader_open(&reader, argv[optind]) == -1)
+        return 1;
+    WavWriter writer;
+    if (output_path &&
+        wav_writer_open(&writer, output_path, sample_rate, 1) == -1)
+    {
+        fprintf(stderr, "Cannot create '%s'\n", output_path);
+        capture_reader_close(&reader);
+        return 1;
+    }
+
+    ReplayStats stats;
+    int result = replay_run(&config, &reader, output_path ? &writer : NULL,
+                            &stats);
+    if (output_path)
+        wav_writer_close(&writer);
+    capture_reader_close(&reader);
+
+    printf("[REPLAY] SSRC %08x: %llu datagrams, %llu media, %llu RTCP, "
+           "%llu skipped\n",
+           stats.ssrc, (unsigned long long)stats.datagrams,
+           (unsigned long long)stats.media_packets,
+           (unsigned long long)stats.rtcp_packets,
+           (unsigned long long)stats.skipped);
+    printf("[REPLAY] %.1f s of audio in %.3f s (%.0fx real time), checksum "
+           "%016llx\n",
+           stats.audio_seconds, stats.elapsed_seconds,
+           stats.elapsed_seconds > 0.0
+               ? stats.audio_seconds / stats.elapsed_seconds
+               : 0.0,
+           (unsigned long long)stats.checksum);
+    printf("[RTP] rx %llu packets, lost %lld (%.1f%%), jitter %.2f ms\n",
+           (unsigned long long)stats.rtp.packets_received,
+           (long long)stats.rtp.packets_lost,
+           stats.rtp.fraction_lost * 100.0, stats.rtp.jitter_ms);
+    printf("[JITTER] delay %.1f ms (target %.1f ms), jitter %.2f ms, "
+           "late loss %.2f%%, lost %llu, recovered %llu, underruns %llu, "
+           "concealed %llu, comfort noise %llu, clock drift %+.1f ppm\n",
+           stats.jb.current_delay_ms, stats.jb.target_delay_ms,
+           stats.jb.jitter_ms, stats.jb.late_loss_rate * 100.0,
+           (unsigned long long)stats.jb.packets_lost,
+           (unsigned long long)stats.jb.frames_recovered,
+           (unsigned long long)stats.jb.underruns,
+           (unsigned long long)stats.jb.frames_concealed,
+           (unsigned long long)stats.jb.frames_comfort_noise,
+           stats.jb.drift_ppm);
+    return result < 0 ? 1 : 0;
+}